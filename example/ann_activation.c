@@ -0,0 +1,95 @@
+// ann_activation.c - Layer activation function benchmark
+//
+// Applies each activation built on e^x to a layer of inputs at every accuracy,
+// and reports the time per neuron against the EXACT functions, which call libm
+// for each neuron, along with the largest deviation from them. Build with
+// optimizations enabled for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NEURON_N 1024
+#define REPEAT_N 4096
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Average time of the output layer activation of ann, per neuron
+static double activation_time(ann_t const *ann, fp_t const *input, fp_t *y) {
+  double t = 0;
+
+  for (uint_t r = 0; r < REPEAT_N; r++) {
+    memcpy(y, input, sizeof(fp_t) * NEURON_N);
+
+    double t0 = now();
+    ann->activation_output_layer(y, NEURON_N);
+    t += now() - t0;
+  }
+
+  return t / ((double)REPEAT_N * NEURON_N);
+}
+
+int main(void) {
+  srand(1);
+
+  char const *activation_name[] = {"identity", "binary", "sigmoid",
+                                   "relu",     "elu",    "lrelu",
+                                   "tanh",     "gelu",   "softmax"};
+  char const *accuracy_name[] = {"exact", "approximate", "fast"};
+
+  ann_activation_t activation[] = {SIGMOID, TANH, ELU, GELU, SOFTMAX};
+  uint_t activation_n = sizeof(activation) / sizeof(activation[0]);
+
+  fp_t *input = malloc(sizeof(fp_t) * NEURON_N);
+  fp_t *expected = malloc(sizeof(fp_t) * NEURON_N);
+  fp_t *y = malloc(sizeof(fp_t) * NEURON_N);
+
+  for (uint_t i = 0; i < NEURON_N; i++) {
+    input[i] = 16.0 * rand() / RAND_MAX - 8.0;
+  }
+
+  ann_t *ann = ann_init(2, (uint_t[]){1, 1});
+
+  printf("%-10s %-12s %14s %8s %12s\n", "activation", "accuracy",
+         "neuron (ns)", "speedup", "max error");
+
+  for (uint_t a = 0; a < activation_n; a++) {
+    ann_set_activation(ann, IDENTITY, activation[a]);
+
+    double exact_time = 0;
+
+    for (ann_accuracy_t accuracy = EXACT; accuracy <= FAST; accuracy++) {
+      ann_set_accuracy(ann, accuracy);
+
+      double t = activation_time(ann, input, y);
+
+      if (accuracy == EXACT) {
+        exact_time = t;
+        memcpy(expected, y, sizeof(fp_t) * NEURON_N);
+      }
+
+      fp_t error = 0;
+      for (uint_t i = 0; i < NEURON_N; i++) {
+        fp_t e = fabs(y[i] - expected[i]);
+        error = (e > error) ? e : error;
+      }
+
+      printf("%-10s %-12s %14.3f %8.2f %12g\n", activation_name[activation[a]],
+             accuracy_name[accuracy], t * 1e9, exact_time / t, error);
+    }
+  }
+
+  ann_free(ann);
+  free(input);
+  free(expected);
+  free(y);
+}
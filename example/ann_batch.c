@@ -0,0 +1,132 @@
+// ann_batch.c - Batched propagation benchmark
+//
+// Checks that a batch of one sample trains to the same weights as the
+// per-sample propagation functions, exiting with a non-zero status otherwise.
+// Then trains the same network with the per-sample and the batched
+// propagation functions, and reports the time taken for a single epoch. Build
+// with optimizations enabled for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_N 4096
+#define EPOCH_N 4
+#define RATE 0.001
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static fp_t weight_delta(ann_t const *a, ann_t const *b) {
+  fp_t delta = 0;
+  for (uint_t i = 0; i < a->weight_n; i++) {
+    fp_t d = fabs(a->weight[i] - b->weight[i]);
+    delta = (d > delta) ? d : delta;
+  }
+
+  return delta;
+}
+
+int main(void) {
+  srand(1);
+
+  uint_t layer[] = {64, 256, 256, 16};
+  uint_t layer_n = sizeof(layer) / sizeof(layer[0]);
+  uint_t input_n = layer[0];
+  uint_t output_n = layer[layer_n - 1];
+
+  fp_t *input = malloc(sizeof(fp_t) * SAMPLE_N * input_n);
+  fp_t *target = malloc(sizeof(fp_t) * SAMPLE_N * output_n);
+  fp_t *output = malloc(sizeof(fp_t) * SAMPLE_N * output_n);
+
+  for (uint_t i = 0; i < SAMPLE_N * input_n; i++) {
+    input[i] = (fp_t)rand() / RAND_MAX;
+  }
+
+  for (uint_t i = 0; i < SAMPLE_N * output_n; i++) {
+    target[i] = (fp_t)rand() / RAND_MAX;
+  }
+
+  ann_t *ann = ann_init(layer_n, layer);
+  ann_random(ann);
+
+  // A batch of one sample must match the per-sample functions
+  ann_t *single = ann_copy(ann);
+  ann_t *batched = ann_copy(ann);
+  ann_batch_t *batch = ann_batch_init(batched, 1);
+
+  for (uint_t s = 0; s < 16; s++) {
+    fp_t const *x = input + s * input_n;
+    fp_t const *t = target + s * output_n;
+
+    ann_propagation_forward(single, x, output);
+    ann_propagation_backward(single, x, output, t, RATE);
+
+    ann_propagation_forward_batch(batched, batch, x, 1, output + output_n);
+    ann_propagation_backward_batch(batched, batch, x, output + output_n, t, 1,
+                                   RATE);
+  }
+
+  fp_t delta = weight_delta(single, batched);
+  printf("batch_n = 1 max weight delta: %g\n\n", delta);
+
+  if (delta != 0)
+    return 1;
+
+  ann_batch_free(batch);
+  ann_free(batched);
+  ann_free(single);
+
+  // Per-sample training
+  ann_t *copy = ann_copy(ann);
+  double t0 = now();
+
+  for (uint_t e = 0; e < EPOCH_N; e++) {
+    for (uint_t s = 0; s < SAMPLE_N; s++) {
+      ann_propagation_forward(copy, input + s * input_n, output);
+      ann_propagation_backward(copy, input + s * input_n, output,
+                               target + s * output_n, RATE);
+    }
+  }
+
+  double single_time = (now() - t0) / EPOCH_N;
+  printf("%-12s %12s %12s\n", "batch_n", "epoch (s)", "speedup");
+  printf("%-12s %12.6f %12.2f\n", "per-sample", single_time, 1.0);
+  ann_free(copy);
+
+  // Batched training
+  for (uint_t batch_n = 1; batch_n <= 256; batch_n *= 4) {
+    copy = ann_copy(ann);
+    batch = ann_batch_init(copy, batch_n);
+    t0 = now();
+
+    for (uint_t e = 0; e < EPOCH_N; e++) {
+      for (uint_t s = 0; s < SAMPLE_N; s += batch_n) {
+        ann_propagation_forward_batch(copy, batch, input + s * input_n,
+                                      batch_n, output);
+        ann_propagation_backward_batch(copy, batch, input + s * input_n,
+                                       output, target + s * output_n, batch_n,
+                                       RATE);
+      }
+    }
+
+    double batch_time = (now() - t0) / EPOCH_N;
+    printf("%-12lu %12.6f %12.2f\n", batch_n, batch_time,
+           single_time / batch_time);
+
+    ann_batch_free(batch);
+    ann_free(copy);
+  }
+
+  ann_free(ann);
+  free(input);
+  free(target);
+  free(output);
+}
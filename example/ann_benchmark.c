@@ -0,0 +1,275 @@
+// ann_benchmark.c - Gradient check and training throughput benchmark
+//
+// First checks the backpropagated gradient of every activation and layout
+// against ann_gradient_numeric(), exiting with a non-zero status when the
+// relative error of any exceeds GRADIENT_TOLERANCE. Then reports the samples
+// per second of the forward pass, the backward pass and a full training step
+// for a grid of topologies, activations and batch sizes, as CSV or as JSON,
+// for comparison between versions. The per-sample functions are reported
+// with a batch_n of 0; their backward pass includes the weight update.
+//
+// Usage: ann_benchmark [csv|json] [seconds per measurement]
+//
+// Build with optimizations enabled for meaningful numbers, e.g.
+// CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SAMPLE_N 512
+#define GRADIENT_TOLERANCE 1e-4
+#define MEASURE_TIME 0.1
+
+static char const *const ACTIVATION_NAME[] = {
+    "identity", "binary", "sigmoid", "relu",    "elu",
+    "lrelu",    "tanh",   "gelu",    "softmax",
+};
+
+static char const *const SIMD_NAME[] = {"scalar", "sse2", "avx2", "avx512"};
+
+typedef struct {
+  uint_t layer_n;
+  uint_t layer[4];
+} topology_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Fill x with n values uniformly distributed within [-1, 1]
+static void random_fill(fp_t *x, uint_t n) {
+  for (uint_t i = 0; i < n; i++) {
+    x[i] = 2.0 * rand() / RAND_MAX - 1.0;
+  }
+}
+
+// The largest relative error between the backpropagated and the numeric
+// gradients of a single random sample
+static fp_t gradient_check(ann_activation_t hidden, ann_activation_t output,
+                           ann_layout_t layout) {
+  uint_t layer[] = {5, 7, 6, 4};
+  ann_t *ann = ann_init(4, layer);
+  ann_set_activation(ann, hidden, output);
+  ann_random(ann);
+  ann = ann_set_layout(ann, layout);
+
+  fp_t input[5], target[4], y[4];
+  random_fill(input, 5);
+  random_fill(target, 4);
+
+  // The cross-entropy expects a probability distribution
+  if (output == SOFTMAX) {
+    memset(target, 0, sizeof(target));
+    target[rand() % 4] = 1;
+  }
+
+  ann_batch_t *batch = ann_batch_init(ann, 1);
+  memset(batch->gradient, 0, sizeof(ann_acc_t) * ann->weight_n);
+
+  ann_propagation_forward_batch(ann, batch, input, 1, y);
+  ann_gradient_batch(ann, batch, input, y, target, 1);
+
+  ann_acc_t *numeric = malloc(sizeof(ann_acc_t) * ann->weight_n);
+  ann_gradient_numeric(ann, input, target, numeric);
+
+  fp_t error = 0;
+
+  for (uint_t i = 0; i < ann->weight_n; i++) {
+    fp_t a = batch->gradient[i];
+    fp_t n = numeric[i];
+    fp_t scale = fabs(a) + fabs(n);
+
+    // Gradients too small to resolve numerically are compared absolutely
+    fp_t e = fabs(a - n) / ((scale > 1e-4) ? scale : 1e-4);
+    error = (e > error) ? e : error;
+  }
+
+  free(numeric);
+  ann_batch_free(batch);
+  ann_free(ann);
+
+  return error;
+}
+
+// Time each pass over the samples in batches of batch_n, or with the
+// per-sample functions when batch_n is 0, and return the samples per second
+// of the forward pass, the backward pass and the full training step
+static void measure(ann_t *ann, fp_t const *input, fp_t const *target,
+                    uint_t batch_n, double seconds, double *rate) {
+  uint_t input_n = ann->layer_neuron_n[0];
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+  uint_t step_n = (batch_n > 0) ? batch_n : 1;
+
+  ann_batch_t *batch = (batch_n > 0) ? ann_batch_init(ann, batch_n) : NULL;
+  fp_t *output = malloc(sizeof(fp_t) * SAMPLE_N * output_n);
+
+  for (uint_t pass = 0; pass < 3; pass++) {
+    double time = 0;
+    uint_t sample_n = 0;
+
+    // The first pass over the samples warms the caches, and is not timed
+    for (int warm = 1; time < seconds; warm = 0) {
+      for (uint_t s = 0; s < SAMPLE_N; s += step_n) {
+        fp_t const *x = input + s * input_n;
+        fp_t const *t = target + s * output_n;
+        fp_t *y = output + s * output_n;
+
+        // The backward pass is timed on its own, after an untimed forward
+        if (pass == 1 && batch)
+          ann_propagation_forward_batch(ann, batch, x, batch_n, y);
+        else if (pass == 1)
+          ann_propagation_forward(ann, x, y);
+
+        double t0 = now();
+
+        if (pass != 1 && batch)
+          ann_propagation_forward_batch(ann, batch, x, batch_n, y);
+        else if (pass != 1)
+          ann_propagation_forward(ann, x, y);
+
+        if (pass == 1 && batch) {
+          memset(batch->gradient, 0, sizeof(ann_acc_t) * ann->weight_n);
+          ann_gradient_batch(ann, batch, x, y, t, batch_n);
+        } else if (pass == 2 && batch) {
+          ann_propagation_backward_batch(ann, batch, x, y, t, batch_n, 0.001);
+        } else if (pass > 0) {
+          ann_propagation_backward(ann, x, y, t, 0.001);
+        }
+
+        if (!warm) {
+          time += now() - t0;
+          sample_n += step_n;
+        }
+      }
+    }
+
+    rate[pass] = sample_n / time;
+  }
+
+  free(output);
+
+  if (batch)
+    ann_batch_free(batch);
+}
+
+int main(int argc, char **argv) {
+  srand(1);
+
+  int json = argc > 1 && strcmp(argv[1], "json") == 0;
+  double seconds = (argc > 2) ? atof(argv[2]) : MEASURE_TIME;
+
+  ann_activation_t activation[] = {IDENTITY, SIGMOID, RELU,   ELU,
+                                   LRELU,    TANH,    GELU};
+  uint_t activation_n = sizeof(activation) / sizeof(activation[0]);
+
+  // Gradient check, reported on stderr
+  int failed = 0;
+
+  for (uint_t a = 0; a < activation_n; a++) {
+    for (uint_t o = 0; o < 2; o++) {
+      ann_activation_t output = (o == 0) ? activation[a] : SOFTMAX;
+
+      for (ann_layout_t layout = ROW_MAJOR; layout <= TRANSPOSED; layout++) {
+        fp_t error = gradient_check(activation[a], output, layout);
+
+        if (error <= GRADIENT_TOLERANCE)
+          continue;
+
+        fprintf(stderr, "gradient check failed: %s/%s %s, error %g\n",
+                ACTIVATION_NAME[activation[a]], ACTIVATION_NAME[output],
+                (layout == ROW_MAJOR) ? "row-major" : "transposed", error);
+
+        failed = 1;
+      }
+    }
+  }
+
+  if (failed)
+    return 1;
+
+  fputs("gradient check passed\n", stderr);
+
+  // Throughput
+  topology_t topology[] = {
+      {3, {16, 32, 4}},
+      {4, {64, 128, 128, 10}},
+      {4, {256, 512, 512, 10}},
+  };
+  uint_t topology_n = sizeof(topology) / sizeof(topology[0]);
+
+  ann_activation_t benchmark_activation[] = {SIGMOID, RELU, TANH};
+  uint_t benchmark_activation_n =
+      sizeof(benchmark_activation) / sizeof(benchmark_activation[0]);
+
+  uint_t batch[] = {0, 1, 8, 32, 128};
+  uint_t batch_count = sizeof(batch) / sizeof(batch[0]);
+
+  char const *simd = SIMD_NAME[ann_simd_detect()];
+
+  if (json)
+    printf("[\n");
+  else
+    printf("topology,activation,batch_n,simd,fp_size,forward,backward,train\n");
+
+  for (uint_t t = 0; t < topology_n; t++) {
+    uint_t layer_n = topology[t].layer_n;
+    uint_t *layer = topology[t].layer;
+
+    char name[64] = "";
+    for (uint_t l = 0; l < layer_n; l++) {
+      snprintf(name + strlen(name), sizeof(name) - strlen(name),
+               (l > 0) ? "-%lu" : "%lu", (unsigned long)layer[l]);
+    }
+
+    fp_t *input = malloc(sizeof(fp_t) * SAMPLE_N * layer[0]);
+    fp_t *target = malloc(sizeof(fp_t) * SAMPLE_N * layer[layer_n - 1]);
+    random_fill(input, SAMPLE_N * layer[0]);
+    random_fill(target, SAMPLE_N * layer[layer_n - 1]);
+
+    for (uint_t a = 0; a < benchmark_activation_n; a++) {
+      for (uint_t b = 0; b < batch_count; b++) {
+        ann_t *ann = ann_init(layer_n, layer);
+        ann_set_activation(ann, benchmark_activation[a],
+                           benchmark_activation[a]);
+        ann_random(ann);
+
+        double rate[3];
+        measure(ann, input, target, batch[b], seconds, rate);
+
+        char const *activation_name =
+            ACTIVATION_NAME[benchmark_activation[a]];
+        int last = t == topology_n - 1 && a == benchmark_activation_n - 1 &&
+                   b == batch_count - 1;
+
+        if (json)
+          printf("  {\"topology\": \"%s\", \"activation\": \"%s\", "
+                 "\"batch_n\": %lu, \"simd\": \"%s\", \"fp_size\": %lu, "
+                 "\"forward\": %.0f, \"backward\": %.0f, \"train\": %.0f}%s\n",
+                 name, activation_name, (unsigned long)batch[b], simd,
+                 (unsigned long)sizeof(fp_t), rate[0], rate[1], rate[2],
+                 last ? "" : ",");
+        else
+          printf("%s,%s,%lu,%s,%lu,%.0f,%.0f,%.0f\n", name, activation_name,
+                 (unsigned long)batch[b], simd, (unsigned long)sizeof(fp_t),
+                 rate[0], rate[1], rate[2]);
+
+        fflush(stdout);
+        ann_free(ann);
+      }
+    }
+
+    free(input);
+    free(target);
+  }
+
+  if (json)
+    printf("]\n");
+}
@@ -0,0 +1,163 @@
+// ann_bin.c - Streaming training data benchmark
+//
+// Writes the samples of a randomly initialized teacher network to a bin.h
+// file, checks that an epoch of ann_bin.h visits every sample once, then
+// trains a network from the file with ann_bin.h and from memory, reporting the
+// throughput of each, the error after each epoch and the number of times the
+// training waited for a batch to be read. Build with optimizations enabled
+// for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#include <stdint.h>
+
+typedef int64_t bin_key_t;
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define ANN_BIN_IMPLEMENTATION
+#include "../include/ann_bin.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PATH "./ann_bin.bin"
+
+#define SAMPLE_N 65536
+#define EPOCH_N 4
+#define BATCH_N 32
+#define WINDOW_N 4096
+#define RATE 0.01
+
+#define INPUT_N 32
+#define HIDDEN_N 64
+#define OUTPUT_N 4
+
+typedef struct {
+  bin_key_t key;
+  fp_t input[INPUT_N];
+  fp_t target[OUTPUT_N];
+} sample_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  srand(1);
+
+  uint_t layer[] = {INPUT_N, HIDDEN_N, OUTPUT_N};
+
+  ann_t *teacher = ann_init(3, layer);
+  ann_random(teacher);
+
+  // Every sample is kept in memory too, for comparison
+  sample_t *sample = malloc(sizeof(sample_t) * SAMPLE_N);
+  fp_t input_sum = 0;
+
+  FILE *f = bin_init(PATH, sizeof(sample_t));
+
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    sample[s].key = s;
+
+    for (uint_t i = 0; i < INPUT_N; i++) {
+      sample[s].input[i] = (fp_t)rand() / RAND_MAX;
+      input_sum += sample[s].input[i];
+    }
+
+    ann_propagation_forward(teacher, sample[s].input, sample[s].target);
+  }
+
+  bin_append(f, sample, SAMPLE_N);
+  bin_close(f);
+
+  // An epoch visits every sample once, in any order
+  ann_bin_t *bin =
+      ann_bin_init(PATH, INPUT_N, OUTPUT_N, BATCH_N, WINDOW_N, NULL, NULL);
+
+  fp_t const *input, *target;
+  uint_t sample_n = 0;
+  uint_t batch_n;
+  fp_t sum = 0;
+
+  while ((batch_n = ann_bin_next(bin, &input, &target)) > 0) {
+    for (uint_t i = 0; i < batch_n * INPUT_N; i++) {
+      sum += input[i];
+    }
+
+    sample_n += batch_n;
+  }
+
+  printf("epoch samples: %lu of %d, input sum delta: %g\n\n",
+         (unsigned long)sample_n, SAMPLE_N, fabs(sum - input_sum));
+
+  ann_t *ann = ann_init(3, layer);
+  ann_random(ann);
+
+  ann_t *memory = ann_copy(ann);
+  ann_batch_t *batch = ann_batch_init(ann, BATCH_N);
+  fp_t *output = malloc(sizeof(fp_t) * BATCH_N * OUTPUT_N);
+
+  // The samples in memory are arranged as batches of inputs and targets
+  fp_t *x = malloc(sizeof(fp_t) * SAMPLE_N * INPUT_N);
+  fp_t *t = malloc(sizeof(fp_t) * SAMPLE_N * OUTPUT_N);
+
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    memcpy(x + s * INPUT_N, sample[s].input, sizeof(fp_t) * INPUT_N);
+    memcpy(t + s * OUTPUT_N, sample[s].target, sizeof(fp_t) * OUTPUT_N);
+  }
+
+  printf("%-6s %14s %14s %12s %8s\n", "epoch", "file (s/s)", "memory (s/s)",
+         "error", "stalls");
+
+  for (uint_t e = 0; e < EPOCH_N; e++) {
+    uint_t stall_n = bin->stall_n;
+    double t0 = now();
+
+    while ((batch_n = ann_bin_next(bin, &input, &target)) > 0) {
+      ann_propagation_forward_batch(ann, batch, input, batch_n, output);
+      ann_propagation_backward_batch(ann, batch, input, output, target,
+                                     batch_n, RATE);
+    }
+
+    double file_time = now() - t0;
+    t0 = now();
+
+    for (uint_t s = 0; s < SAMPLE_N; s += BATCH_N) {
+      ann_propagation_forward_batch(memory, batch, x + s * INPUT_N, BATCH_N,
+                                    output);
+      ann_propagation_backward_batch(memory, batch, x + s * INPUT_N, output,
+                                     t + s * OUTPUT_N, BATCH_N, RATE);
+    }
+
+    double memory_time = now() - t0;
+
+    fp_t error = 0;
+    for (uint_t s = 0; s < SAMPLE_N; s++) {
+      ann_propagation_forward(ann, x + s * INPUT_N, output);
+      error += ann_error_total(output, t + s * OUTPUT_N, OUTPUT_N);
+    }
+
+    printf("%-6d %14.0f %14.0f %12g %8lu\n", (int)e + 1,
+           SAMPLE_N / file_time, SAMPLE_N / memory_time, error / SAMPLE_N,
+           (unsigned long)(bin->stall_n - stall_n));
+  }
+
+  ann_bin_free(bin);
+  remove(PATH);
+
+  ann_batch_free(batch);
+  ann_free(teacher);
+  ann_free(ann);
+  ann_free(memory);
+  free(sample);
+  free(output);
+  free(x);
+  free(t);
+}
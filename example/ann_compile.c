@@ -0,0 +1,120 @@
+// ann_compile.c - Compiled inference benchmark
+//
+// Writes a small and a larger randomly initialized network out as headers
+// with ann_compile(). Once the headers exist, rebuilding this example
+// includes them, verifies the compiled forward functions against
+// ann_propagation_forward() and reports the time per sample of each. The
+// networks are seeded, so the headers always match the networks. Build with
+// optimizations and vectorization enabled for meaningful numbers, e.g.
+// CFLAGS="-O3 -march=native" ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#define ANN_COMPILE_IMPLEMENTATION
+#include "../include/ann_compile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__has_include)
+#if __has_include("ann_compile_small.h") && __has_include("ann_compile_large.h")
+#include "ann_compile_small.h"
+#include "ann_compile_large.h"
+#define COMPILED
+#endif
+#endif
+
+#define SAMPLE_N 256
+#define REPEAT_N 1024
+
+#ifdef COMPILED
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Compare forward() against ann_propagation_forward() on random inputs, and
+// print the time per sample of each
+static void benchmark(char const *name, ann_t *ann,
+                      void (*forward)(fp_t const *, fp_t *)) {
+  uint_t input_n = ann->layer_neuron_n[0];
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+
+  fp_t *input = malloc(sizeof(fp_t) * SAMPLE_N * input_n);
+  fp_t *expected = malloc(sizeof(fp_t) * SAMPLE_N * output_n);
+  fp_t *output = malloc(sizeof(fp_t) * SAMPLE_N * output_n);
+
+  for (uint_t i = 0; i < SAMPLE_N * input_n; i++) {
+    input[i] = 2.0 * rand() / RAND_MAX - 1.0;
+  }
+
+  double t0 = now();
+
+  for (uint_t r = 0; r < REPEAT_N; r++) {
+    for (uint_t s = 0; s < SAMPLE_N; s++) {
+      ann_propagation_forward(ann, input + s * input_n,
+                              expected + s * output_n);
+    }
+  }
+
+  double ann_time = (now() - t0) / ((double)REPEAT_N * SAMPLE_N);
+
+  t0 = now();
+
+  for (uint_t r = 0; r < REPEAT_N; r++) {
+    for (uint_t s = 0; s < SAMPLE_N; s++) {
+      forward(input + s * input_n, output + s * output_n);
+    }
+  }
+
+  double compiled_time = (now() - t0) / ((double)REPEAT_N * SAMPLE_N);
+
+  fp_t delta = 0;
+  for (uint_t i = 0; i < SAMPLE_N * output_n; i++) {
+    fp_t d = fabs(output[i] - expected[i]);
+    delta = (d > delta) ? d : delta;
+  }
+
+  printf("%-8s %14.1f %14.1f %8.2f %12g\n", name, ann_time * 1e9,
+         compiled_time * 1e9, ann_time / compiled_time, delta);
+
+  free(input);
+  free(expected);
+  free(output);
+}
+#endif
+
+int main(void) {
+  srand(1);
+
+  ann_t *small = ann_init(3, (uint_t[]){4, 8, 2});
+  ann_set_activation(small, TANH, SIGMOID);
+  ann_random(small);
+
+  ann_t *large = ann_init(4, (uint_t[]){16, 64, 64, 4});
+  ann_set_activation(large, RELU, SOFTMAX);
+  ann_random(large);
+
+  if (ann_compile(small, "ann_compile_small.h", "ann_compile_small") != 0 ||
+      ann_compile(large, "ann_compile_large.h", "ann_compile_large") != 0) {
+    fputs("Unable to write the compiled headers\n", stderr);
+    return 1;
+  }
+
+#ifdef COMPILED
+  printf("%-8s %14s %14s %8s %12s\n", "network", "ann (ns)", "compiled (ns)",
+         "speedup", "max delta");
+
+  benchmark("small", small, ann_compile_small_forward);
+  benchmark("large", large, ann_compile_large_forward);
+#else
+  puts("Headers written, rebuild to benchmark them");
+#endif
+
+  ann_free(small);
+  ann_free(large);
+}
@@ -0,0 +1,108 @@
+// ann_context.c - Concurrent inference example
+//
+// Propagates through a single ann_t instance from several threads at once,
+// each with its own ann_context_t, checks the outputs against a single thread,
+// and compares the memory used per thread with that of an ann_copy(). Build
+// with optimizations enabled for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_N 1024
+#define THREAD_N 4
+
+#define INPUT_N 128
+#define OUTPUT_N 16
+
+typedef struct {
+  ann_t const *ann;
+  fp_t const *input;
+  fp_t *output;
+  uint_t s0, s1;
+} job_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Propagate a range of samples with a private context
+static void *infer(void *arg) {
+  job_t *job = (job_t *)arg;
+  ann_context_t *context = ann_context_init(job->ann);
+
+  for (uint_t s = job->s0; s < job->s1; s++) {
+    ann_propagation_forward_context(job->ann, context, job->input + s * INPUT_N,
+                                    job->output + s * OUTPUT_N);
+  }
+
+  ann_context_free(context);
+
+  return NULL;
+}
+
+int main(void) {
+  srand(1);
+
+  uint_t layer[] = {INPUT_N, 1024, 1024, OUTPUT_N};
+  uint_t layer_n = sizeof(layer) / sizeof(layer[0]);
+
+  fp_t *input = malloc(sizeof(fp_t) * SAMPLE_N * INPUT_N);
+  fp_t *output = malloc(sizeof(fp_t) * SAMPLE_N * OUTPUT_N);
+  fp_t *expected = malloc(sizeof(fp_t) * SAMPLE_N * OUTPUT_N);
+
+  for (uint_t i = 0; i < SAMPLE_N * INPUT_N; i++) {
+    input[i] = (fp_t)rand() / RAND_MAX;
+  }
+
+  ann_t *ann = ann_init(layer_n, layer);
+  ann_set_activation(ann, RELU, SIGMOID);
+  ann_random(ann);
+
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    ann_propagation_forward(ann, input + s * INPUT_N, expected + s * OUTPUT_N);
+  }
+
+  pthread_t thread[THREAD_N];
+  job_t job[THREAD_N];
+
+  double t0 = now();
+
+  for (uint_t t = 0; t < THREAD_N; t++) {
+    job[t] = (job_t){ann, input, output, SAMPLE_N * t / THREAD_N,
+                     SAMPLE_N * (t + 1) / THREAD_N};
+    pthread_create(thread + t, NULL, infer, job + t);
+  }
+
+  for (uint_t t = 0; t < THREAD_N; t++) {
+    pthread_join(thread[t], NULL);
+  }
+
+  double elapsed = now() - t0;
+
+  fp_t delta = 0;
+  for (uint_t i = 0; i < SAMPLE_N * OUTPUT_N; i++) {
+    fp_t d = fabs(output[i] - expected[i]);
+    delta = (d > delta) ? d : delta;
+  }
+
+  ann_context_t *context = ann_context_init(ann);
+
+  printf("%d threads, %d samples in %.6f s, max output delta %g\n", THREAD_N,
+         SAMPLE_N, elapsed, delta);
+  printf("memory per thread: ann_context_t %lu B, ann_copy() %lu B\n",
+         context->n, ann->n);
+
+  ann_context_free(context);
+  ann_free(ann);
+  free(input);
+  free(output);
+  free(expected);
+}
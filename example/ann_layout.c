@@ -0,0 +1,122 @@
+// ann_layout.c - Weight layout benchmark
+//
+// Times backpropagation through a {w, w, w} network with the default row-major
+// weights and with the TRANSPOSED layout, for layer widths from 16 to 4096. The
+// per-sample time is for a single sample, the batched time for BATCH_N.
+// Build with optimizations enabled for meaningful numbers, e.g.
+// CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define RATE 0.001
+#define BATCH_N 16
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Average time of a single ann_propagation_backward() call
+static double backward_time(ann_t *ann, fp_t const *input, fp_t *output,
+                            fp_t const *target, uint_t repeat_n) {
+  double t = 0;
+
+  for (uint_t r = 0; r < repeat_n; r++) {
+    ann_propagation_forward(ann, input, output);
+
+    double t0 = now();
+    ann_propagation_backward(ann, input, output, target, RATE);
+    t += now() - t0;
+  }
+
+  return t / repeat_n;
+}
+
+// Average time of a single ann_propagation_backward_batch() call
+static double backward_batch_time(ann_t *ann, fp_t const *input, fp_t *output,
+                                  fp_t const *target, uint_t repeat_n) {
+  ann_batch_t *batch = ann_batch_init(ann, BATCH_N);
+  double t = 0;
+
+  for (uint_t r = 0; r < repeat_n; r++) {
+    ann_propagation_forward_batch(ann, batch, input, BATCH_N, output);
+
+    double t0 = now();
+    ann_propagation_backward_batch(ann, batch, input, output, target, BATCH_N,
+                                   RATE);
+    t += now() - t0;
+  }
+
+  ann_batch_free(batch);
+
+  return t / repeat_n;
+}
+
+int main(void) {
+  srand(1);
+
+  printf("%-8s %14s %14s %8s %14s %14s %8s %12s\n", "width", "row-major",
+         "transposed", "speedup", "row-major", "transposed", "speedup",
+         "max delta");
+  printf("%-8s %14s %14s %8s %14s %14s %8s\n", "", "sample (s)", "sample (s)",
+         "", "batch (s)", "batch (s)", "");
+
+  for (uint_t w = 16; w <= 4096; w *= 4) {
+    uint_t repeat_n = (1 << 24) / (w * w) + 1;
+
+    fp_t *input = malloc(sizeof(fp_t) * BATCH_N * w);
+    fp_t *target = malloc(sizeof(fp_t) * BATCH_N * w);
+    fp_t *output = malloc(sizeof(fp_t) * BATCH_N * w);
+    fp_t *expected = malloc(sizeof(fp_t) * w);
+
+    for (uint_t i = 0; i < BATCH_N * w; i++) {
+      input[i] = (fp_t)rand() / RAND_MAX;
+      target[i] = (fp_t)rand() / RAND_MAX;
+    }
+
+    ann_t *row = ann_init(3, (uint_t[]){w, w, w});
+    ann_random(row);
+
+    ann_t *transposed = ann_copy(row);
+    transposed = ann_set_layout(transposed, TRANSPOSED);
+
+    double row_time = backward_time(row, input, output, target, repeat_n);
+    double transposed_time =
+        backward_time(transposed, input, output, target, repeat_n);
+
+    uint_t batch_repeat_n = repeat_n / BATCH_N + 1;
+    double row_batch_time =
+        backward_batch_time(row, input, output, target, batch_repeat_n);
+    double transposed_batch_time =
+        backward_batch_time(transposed, input, output, target, batch_repeat_n);
+
+    // Both layouts must train to the same weights, up to rounding
+    ann_propagation_forward(row, input, expected);
+    ann_propagation_forward(transposed, input, output);
+
+    fp_t delta = 0;
+    for (uint_t i = 0; i < w; i++) {
+      fp_t d = fabs(output[i] - expected[i]);
+      delta = (d > delta) ? d : delta;
+    }
+
+    printf("%-8lu %14.9f %14.9f %8.2f %14.9f %14.9f %8.2f %12g\n", w,
+           row_time, transposed_time, row_time / transposed_time,
+           row_batch_time, transposed_batch_time,
+           row_batch_time / transposed_batch_time, delta);
+
+    ann_free(row);
+    ann_free(transposed);
+    free(input);
+    free(target);
+    free(output);
+    free(expected);
+  }
+}
@@ -0,0 +1,139 @@
+// ann_optimizer.c - Optimizer convergence benchmark
+//
+// Trains the same network to imitate a randomly initialized teacher network
+// with each optimizer, and reports the error after each epoch along with the
+// number of epochs taken to reach TARGET_ERROR. Build with optimizations
+// enabled for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_N 1024
+#define EPOCH_N 16
+#define TARGET_ERROR 0.0005
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Mean error of ann over every sample
+static fp_t mean_error(ann_t *ann, fp_t const *input, fp_t const *target,
+                       fp_t *output, uint_t input_n, uint_t output_n) {
+  fp_t error = 0;
+
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    ann_propagation_forward(ann, input + s * input_n, output);
+    error += ann_error_total(output, target + s * output_n, output_n);
+  }
+
+  return error / SAMPLE_N;
+}
+
+int main(void) {
+  srand(1);
+
+  char const *name[] = {"sgd", "momentum", "nesterov", "rmsprop", "adam"};
+  fp_t rate[] = {0.1, 0.01, 0.01, 0.001, 0.001};
+
+  uint_t layer[] = {16, 64, 64, 4};
+  uint_t layer_n = sizeof(layer) / sizeof(layer[0]);
+  uint_t input_n = layer[0];
+  uint_t output_n = layer[layer_n - 1];
+
+  fp_t *input = malloc(sizeof(fp_t) * SAMPLE_N * input_n);
+  fp_t *target = malloc(sizeof(fp_t) * SAMPLE_N * output_n);
+  fp_t *output = malloc(sizeof(fp_t) * 2 * output_n);
+
+  for (uint_t i = 0; i < SAMPLE_N * input_n; i++) {
+    input[i] = (fp_t)rand() / RAND_MAX;
+  }
+
+  ann_t *teacher = ann_init(layer_n, layer);
+  ann_random(teacher);
+
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    ann_propagation_forward(teacher, input + s * input_n,
+                            target + s * output_n);
+  }
+
+  ann_t *ann = ann_init(layer_n, layer);
+  ann_random(ann);
+
+  // A batch of one sample must match the per-sample functions
+  ann_t *single = ann_set_optimizer(ann_copy(ann), ADAM);
+  ann_t *batched = ann_set_optimizer(ann_copy(ann), ADAM);
+  ann_batch_t *batch = ann_batch_init(batched, 1);
+
+  for (uint_t s = 0; s < 16; s++) {
+    fp_t const *x = input + s * input_n;
+    fp_t const *t = target + s * output_n;
+
+    ann_propagation_forward(single, x, output);
+    ann_propagation_backward(single, x, output, t, 0.001);
+
+    ann_propagation_forward_batch(batched, batch, x, 1, output + output_n);
+    ann_propagation_backward_batch(batched, batch, x, output + output_n, t, 1,
+                                   0.001);
+  }
+
+  fp_t delta = 0;
+  for (uint_t i = 0; i < ann->weight_n; i++) {
+    fp_t d = fabs(single->weight[i] - batched->weight[i]);
+    delta = (d > delta) ? d : delta;
+  }
+
+  printf("adam batch_n = 1 max weight delta: %g\n\n", delta);
+
+  ann_batch_free(batch);
+  ann_free(batched);
+  ann_free(single);
+
+  printf("%-10s %8s %12s %12s %12s\n", "optimizer", "rate", "epoch (s)",
+         "final error", "epochs");
+
+  for (ann_optimizer_t optimizer = SGD; optimizer <= ADAM; optimizer++) {
+    ann_t *copy = ann_set_optimizer(ann_copy(ann), optimizer);
+    uint_t epoch_n = 0;
+    double t = 0;
+    fp_t error = 0;
+
+    for (uint_t e = 0; e < EPOCH_N; e++) {
+      double t0 = now();
+
+      for (uint_t s = 0; s < SAMPLE_N; s++) {
+        ann_propagation_forward(copy, input + s * input_n, output);
+        ann_propagation_backward(copy, input + s * input_n, output,
+                                 target + s * output_n, rate[optimizer]);
+      }
+
+      t += now() - t0;
+      error = mean_error(copy, input, target, output, input_n, output_n);
+
+      if (epoch_n == 0 && error < TARGET_ERROR)
+        epoch_n = e + 1;
+    }
+
+    printf("%-10s %8g %12.6f %12g ", name[optimizer], rate[optimizer],
+           t / EPOCH_N, error);
+
+    if (epoch_n)
+      printf("%12d\n", (int)epoch_n);
+    else
+      printf("%12s\n", "-");
+
+    ann_free(copy);
+  }
+
+  ann_free(teacher);
+  ann_free(ann);
+  free(input);
+  free(target);
+  free(output);
+}
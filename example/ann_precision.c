@@ -0,0 +1,162 @@
+// ann_precision.c - Precision variant benchmark
+//
+// Trains the same network with the double precision ann.h, the single
+// precision ann_f32.h and the mixed precision ann_mixed.h, and reports the
+// time per epoch, the size of each network and the final error. Build with
+// optimizations enabled for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+#include "../include/ann_f32.h"
+#include "../include/ann_mixed.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_N 2048
+#define EPOCH_N 4
+#define BATCH_N 32
+#define RATE 0.001
+
+#define INPUT_N 256
+#define HIDDEN_N 512
+#define OUTPUT_N 8
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// TRAIN()
+//
+// Train a network of the given variant on the double precision samples,
+// converting them to the variant's precision first, then print a row of
+// results
+//
+// name - The name printed for the variant
+// prefix - The prefix of the variant, e.g. ann_f32
+
+#define TRAIN(name, prefix)                                                    \
+  {                                                                            \
+    prefix##_fp_t *x = malloc(sizeof(prefix##_fp_t) * SAMPLE_N * INPUT_N);     \
+    prefix##_fp_t *t = malloc(sizeof(prefix##_fp_t) * SAMPLE_N * OUTPUT_N);    \
+    prefix##_fp_t *y = malloc(sizeof(prefix##_fp_t) * SAMPLE_N * OUTPUT_N);    \
+                                                                               \
+    for (uint_t i = 0; i < SAMPLE_N * INPUT_N; i++) {                          \
+      x[i] = input[i];                                                         \
+    }                                                                          \
+                                                                               \
+    for (uint_t i = 0; i < SAMPLE_N * OUTPUT_N; i++) {                         \
+      t[i] = target[i];                                                        \
+    }                                                                          \
+                                                                               \
+    prefix##_t *ann = prefix##_init(3, layer);                                 \
+    prefix##_set_activation(ann, RELU, IDENTITY);                              \
+                                                                               \
+    /* Start from the same weights as every other variant */                   \
+    for (uint_t i = 0; i < ann->weight_n; i++) {                               \
+      ann->weight[i] = weight[i];                                              \
+    }                                                                          \
+                                                                               \
+    prefix##_batch_t *batch = prefix##_batch_init(ann, BATCH_N);               \
+    double t0 = now();                                                         \
+                                                                               \
+    for (uint_t e = 0; e < EPOCH_N; e++) {                                     \
+      for (uint_t s = 0; s < SAMPLE_N; s += BATCH_N) {                         \
+        prefix##_propagation_forward_batch(ann, batch, x + s * INPUT_N,        \
+                                           BATCH_N, y);                        \
+        prefix##_propagation_backward_batch(ann, batch, x + s * INPUT_N, y,    \
+                                            t + s * OUTPUT_N, BATCH_N, RATE);  \
+      }                                                                        \
+    }                                                                          \
+                                                                               \
+    double epoch = (now() - t0) / EPOCH_N;                                     \
+                                                                               \
+    /* Mean error over the samples, and the largest deviation from double */   \
+    double error = 0;                                                          \
+    double deviation = 0;                                                      \
+                                                                               \
+    for (uint_t s = 0; s < SAMPLE_N; s += BATCH_N) {                           \
+      prefix##_propagation_forward_batch(ann, batch, x + s * INPUT_N, BATCH_N, \
+                                         y + s * OUTPUT_N);                    \
+    }                                                                          \
+                                                                               \
+    if (!reference) {                                                          \
+      reference = malloc(sizeof(double) * SAMPLE_N * OUTPUT_N);                \
+      for (uint_t i = 0; i < SAMPLE_N * OUTPUT_N; i++) {                       \
+        reference[i] = y[i];                                                   \
+      }                                                                        \
+    }                                                                          \
+                                                                               \
+    for (uint_t i = 0; i < SAMPLE_N * OUTPUT_N; i++) {                         \
+      double d = fabs(y[i] - reference[i]);                                    \
+      deviation = (d > deviation) ? d : deviation;                             \
+      error += 0.5 * (y[i] - t[i]) * (y[i] - t[i]);                            \
+    }                                                                          \
+                                                                               \
+    printf("%-8s %12.6f %12.2f %12lu %14.8f %14g\n", name, epoch,              \
+           (reference_epoch ? reference_epoch : epoch) / epoch, ann->n,        \
+           error / SAMPLE_N, deviation);                                       \
+                                                                               \
+    reference_epoch = reference_epoch ? reference_epoch : epoch;               \
+                                                                               \
+    prefix##_batch_free(batch);                                                \
+    prefix##_free(ann);                                                        \
+    free(x);                                                                   \
+    free(t);                                                                   \
+    free(y);                                                                   \
+  }
+
+int main(void) {
+  srand(1);
+
+  uint_t layer[] = {INPUT_N, HIDDEN_N, OUTPUT_N};
+
+  double *input = malloc(sizeof(double) * SAMPLE_N * INPUT_N);
+  double *target = malloc(sizeof(double) * SAMPLE_N * OUTPUT_N);
+
+  for (uint_t i = 0; i < SAMPLE_N * INPUT_N; i++) {
+    input[i] = (double)rand() / RAND_MAX - 0.5;
+  }
+
+  // Each target is a fixed random projection of the input
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    for (uint_t j = 0; j < OUTPUT_N; j++) {
+      double sum = 0;
+      for (uint_t i = 0; i < INPUT_N; i++) {
+        sum += input[s * INPUT_N + i] * (((i * 7 + j * 13) % 5) - 2.0);
+      }
+
+      target[s * OUTPUT_N + j] = tanh(sum / INPUT_N);
+    }
+  }
+
+  ann_t *initial = ann_init(3, layer);
+  ann_random(initial);
+
+  // Scaled down so the 512 hidden neurons don't saturate the output
+  double *weight = malloc(sizeof(double) * initial->weight_n);
+  for (uint_t i = 0; i < initial->weight_n; i++) {
+    weight[i] = initial->weight[i] * 0.05;
+  }
+
+  ann_free(initial);
+
+  double *reference = NULL;
+  double reference_epoch = 0;
+
+  printf("%-8s %12s %12s %12s %14s %14s\n", "variant", "epoch (s)", "speedup",
+         "size (B)", "mean error", "max deviation");
+
+  TRAIN("f64", ann)
+  TRAIN("f32", ann_f32)
+  TRAIN("mixed", ann_mixed)
+
+  free(reference);
+  free(weight);
+  free(input);
+  free(target);
+}
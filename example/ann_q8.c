@@ -0,0 +1,136 @@
+// ann_q8.c - Quantized inference benchmark
+//
+// Trains a network, quantizes it with ann_q8.h, then reports the size of both
+// models, the inference throughput of the double precision network and of the
+// quantized network with each instruction set, and the error of the quantized
+// outputs. Build with optimizations enabled for meaningful numbers, e.g.
+// CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#define ANN_Q8_IMPLEMENTATION
+#include "../include/ann_q8.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_N 4096
+#define CALIBRATION_N 256
+#define EPOCH_N 8
+#define BATCH_N 32
+#define RATE 0.001
+
+#define INPUT_N 256
+#define HIDDEN_N 256
+#define OUTPUT_N 8
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  srand(1);
+
+  char const *name[] = {"scalar", "sse2", "avx2", "avx512"};
+
+  uint_t layer[] = {INPUT_N, HIDDEN_N, HIDDEN_N, OUTPUT_N};
+  uint_t layer_n = sizeof(layer) / sizeof(layer[0]);
+
+  fp_t *input = malloc(sizeof(fp_t) * SAMPLE_N * INPUT_N);
+  fp_t *target = malloc(sizeof(fp_t) * SAMPLE_N * OUTPUT_N);
+  fp_t *output = malloc(sizeof(fp_t) * SAMPLE_N * OUTPUT_N);
+
+  for (uint_t i = 0; i < SAMPLE_N * INPUT_N; i++) {
+    input[i] = (fp_t)rand() / RAND_MAX - 0.5;
+  }
+
+  // Each target is a fixed projection of the input
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    for (uint_t j = 0; j < OUTPUT_N; j++) {
+      fp_t sum = 0;
+      for (uint_t i = 0; i < INPUT_N; i++) {
+        sum += input[s * INPUT_N + i] * (((i * 7 + j * 13) % 5) - 2.0);
+      }
+
+      target[s * OUTPUT_N + j] = 1.0 / (1.0 + exp(-sum / 8));
+    }
+  }
+
+  ann_t *ann = ann_init(layer_n, layer);
+  ann_set_activation(ann, RELU, SIGMOID);
+  ann_random(ann);
+
+  // Scaled down so the wide layers don't saturate
+  for (uint_t i = 0; i < ann->weight_n; i++) {
+    ann->weight[i] *= 0.05;
+  }
+
+  ann_batch_t *batch = ann_batch_init(ann, BATCH_N);
+
+  for (uint_t e = 0; e < EPOCH_N; e++) {
+    for (uint_t s = 0; s < SAMPLE_N; s += BATCH_N) {
+      ann_propagation_forward_batch(ann, batch, input + s * INPUT_N, BATCH_N,
+                                    output);
+      ann_propagation_backward_batch(ann, batch, input + s * INPUT_N, output,
+                                     target + s * OUTPUT_N, BATCH_N, RATE);
+    }
+  }
+
+  ann_batch_free(batch);
+
+  fp_t error = 0;
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    ann_propagation_forward(ann, input + s * INPUT_N, output);
+    error += ann_error_total(output, target + s * OUTPUT_N, OUTPUT_N);
+  }
+
+  printf("trained error: %g\n", error / SAMPLE_N);
+
+  // The calibration samples are a subset of the samples compared
+  ann_q8_t *q8 = ann_q8_init(ann, input, CALIBRATION_N);
+  ann_q8_context_t *context = ann_q8_context_init(q8);
+
+  fp_t mean = 0;
+  fp_t max = ann_q8_error(q8, ann, input, SAMPLE_N, &mean);
+
+  printf("quantized error: max %g, mean %g\n", max, mean);
+  printf("size: fp64 %lu B (weights %lu B), q8 %lu B (weights %lu B)\n\n",
+         ann->n, sizeof(fp_t) * ann->weight_n, q8->n,
+         q8->weight_n + sizeof(int32_t) * (q8->neuron_n - INPUT_N));
+
+  double t0 = now();
+
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    ann_propagation_forward(ann, input + s * INPUT_N, output);
+  }
+
+  double forward = SAMPLE_N / (now() - t0);
+
+  printf("%-8s %16s %8s\n", "model", "forward (1/s)", "speedup");
+  printf("%-8s %16.0f %8.2f\n", "fp64", forward, 1.0);
+
+  for (ann_simd_t simd = SCALAR; simd <= ann_simd_detect(); simd++) {
+    ann_q8_set_simd(q8, simd);
+    t0 = now();
+
+    for (uint_t s = 0; s < SAMPLE_N; s++) {
+      ann_q8_propagation_forward(q8, context, input + s * INPUT_N, output);
+    }
+
+    double q8_forward = SAMPLE_N / (now() - t0);
+    printf("q8 %-5s %16.0f %8.2f\n", name[simd], q8_forward,
+           q8_forward / forward);
+  }
+
+  ann_q8_context_free(context);
+  ann_q8_free(q8);
+  ann_free(ann);
+  free(input);
+  free(target);
+  free(output);
+}
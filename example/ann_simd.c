@@ -0,0 +1,104 @@
+// ann_simd.c - Dense layer kernel benchmark
+//
+// Runs inference and training with each instruction set supported by the
+// processor, and reports the throughput relative to the scalar kernels. Build
+// with optimizations enabled for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_N 2048
+#define RATE 0.001
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  srand(1);
+
+  char const *name[] = {"scalar", "sse2", "avx2", "avx512"};
+
+  uint_t layer[] = {128, 512, 512, 32};
+  uint_t layer_n = sizeof(layer) / sizeof(layer[0]);
+  uint_t input_n = layer[0];
+  uint_t output_n = layer[layer_n - 1];
+
+  fp_t *input = malloc(sizeof(fp_t) * SAMPLE_N * input_n);
+  fp_t *target = malloc(sizeof(fp_t) * SAMPLE_N * output_n);
+  fp_t *output = malloc(sizeof(fp_t) * output_n);
+  fp_t *expected = malloc(sizeof(fp_t) * output_n);
+
+  for (uint_t i = 0; i < SAMPLE_N * input_n; i++) {
+    input[i] = (fp_t)rand() / RAND_MAX;
+  }
+
+  for (uint_t i = 0; i < SAMPLE_N * output_n; i++) {
+    target[i] = (fp_t)rand() / RAND_MAX;
+  }
+
+  ann_t *ann = ann_init(layer_n, layer);
+  ann_random(ann);
+
+  ann_set_simd(ann, SCALAR);
+  ann_propagation_forward(ann, input, expected);
+
+  double forward_scalar = 0;
+  double train_scalar = 0;
+
+  printf("%-8s %16s %8s %16s %8s %12s\n", "simd", "forward (1/s)", "speedup",
+         "train (1/s)", "speedup", "max error");
+
+  for (ann_simd_t simd = SCALAR; simd <= ann_simd_detect(); simd++) {
+    ann_t *copy = ann_copy(ann);
+    ann_set_simd(copy, simd);
+
+    ann_propagation_forward(copy, input, output);
+
+    fp_t error = 0;
+    for (uint_t i = 0; i < output_n; i++) {
+      fp_t e = fabs(output[i] - expected[i]);
+      error = (e > error) ? e : error;
+    }
+
+    double t0 = now();
+
+    for (uint_t s = 0; s < SAMPLE_N; s++) {
+      ann_propagation_forward(copy, input + s * input_n, output);
+    }
+
+    double forward = SAMPLE_N / (now() - t0);
+    t0 = now();
+
+    for (uint_t s = 0; s < SAMPLE_N; s++) {
+      ann_propagation_forward(copy, input + s * input_n, output);
+      ann_propagation_backward(copy, input + s * input_n, output,
+                               target + s * output_n, RATE);
+    }
+
+    double train = SAMPLE_N / (now() - t0);
+
+    if (simd == SCALAR) {
+      forward_scalar = forward;
+      train_scalar = train;
+    }
+
+    printf("%-8s %16.0f %8.2f %16.0f %8.2f %12g\n", name[simd], forward,
+           forward / forward_scalar, train, train / train_scalar, error);
+
+    ann_free(copy);
+  }
+
+  ann_free(ann);
+  free(input);
+  free(target);
+  free(output);
+  free(expected);
+}
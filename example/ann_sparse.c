@@ -0,0 +1,112 @@
+// ann_sparse.c - Sparse inference benchmark
+//
+// Prunes copies of a network to increasing sparsities with ann_sparse.h, then
+// reports the size of each sparse model against the dense one, the inference
+// throughput of the dense network and of the sparse network with each
+// instruction set, and the largest difference between the sparse outputs and
+// those of the pruned dense network. Build with optimizations enabled for
+// meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#define ANN_SPARSE_IMPLEMENTATION
+#include "../include/ann_sparse.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_N 256
+#define REPEAT_N 16
+
+#define INPUT_N 256
+#define HIDDEN_N 512
+#define OUTPUT_N 10
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  srand(1);
+
+  char const *name[] = {"scalar", "sse2", "avx2", "avx512"};
+  fp_t sparsity[] = {0, 0.5, 0.8, 0.9, 0.95};
+  uint_t sparsity_n = sizeof(sparsity) / sizeof(sparsity[0]);
+
+  fp_t *input = malloc(sizeof(fp_t) * SAMPLE_N * INPUT_N);
+  fp_t *expected = malloc(sizeof(fp_t) * SAMPLE_N * OUTPUT_N);
+  fp_t *output = malloc(sizeof(fp_t) * OUTPUT_N);
+
+  for (uint_t i = 0; i < SAMPLE_N * INPUT_N; i++) {
+    input[i] = (fp_t)rand() / RAND_MAX;
+  }
+
+  ann_t *ann = ann_init(4, (uint_t[]){INPUT_N, HIDDEN_N, HIDDEN_N, OUTPUT_N});
+  ann_set_activation(ann, RELU, SIGMOID);
+  ann_random(ann);
+
+  printf("%-8s %10s %8s %-8s %14s %8s %12s\n", "sparsity", "bytes", "ratio",
+         "simd", "sample (us)", "speedup", "max delta");
+
+  for (uint_t p = 0; p < sparsity_n; p++) {
+    ann_t *pruned = ann_copy(ann);
+    ann_sparse_prune(pruned, sparsity[p]);
+
+    // The dense network, pruned
+    double t0 = now();
+
+    for (uint_t r = 0; r < REPEAT_N; r++) {
+      for (uint_t s = 0; s < SAMPLE_N; s++) {
+        ann_propagation_forward(pruned, input + s * INPUT_N,
+                                expected + s * OUTPUT_N);
+      }
+    }
+
+    double dense_time = (now() - t0) / (REPEAT_N * SAMPLE_N);
+
+    printf("%-8g %10lu %8.2f %-8s %14.3f %8.2f %12s\n", sparsity[p],
+           (unsigned long)pruned->n, 1.0, "dense", dense_time * 1e6, 1.0, "-");
+
+    ann_sparse_t *sparse = ann_sparse_init(pruned);
+    ann_sparse_context_t *context = ann_sparse_context_init(sparse);
+
+    for (ann_simd_t simd = SCALAR; simd <= ann_simd_detect(); simd++) {
+      ann_sparse_set_simd(sparse, simd);
+
+      fp_t delta = 0;
+      t0 = now();
+
+      for (uint_t r = 0; r < REPEAT_N; r++) {
+        for (uint_t s = 0; s < SAMPLE_N; s++) {
+          ann_sparse_propagation_forward(sparse, context, input + s * INPUT_N,
+                                         output);
+
+          for (uint_t j = 0; j < OUTPUT_N; j++) {
+            fp_t d = fabs(output[j] - expected[s * OUTPUT_N + j]);
+            delta = (d > delta) ? d : delta;
+          }
+        }
+      }
+
+      double t = (now() - t0) / (REPEAT_N * SAMPLE_N);
+
+      printf("%-8g %10lu %8.2f %-8s %14.3f %8.2f %12g\n", sparsity[p],
+             (unsigned long)sparse->n, (double)pruned->n / sparse->n,
+             name[simd], t * 1e6, dense_time / t, delta);
+    }
+
+    ann_sparse_context_free(context);
+    ann_sparse_free(sparse);
+    ann_free(pruned);
+  }
+
+  ann_free(ann);
+  free(input);
+  free(expected);
+  free(output);
+}
@@ -0,0 +1,146 @@
+// ann_thread.c - Parallel training benchmark
+//
+// Trains the same network with ann_thread.h on an increasing number of
+// threads, in both the REDUCE and HOGWILD modes, and reports the time taken
+// for a single epoch and the error afterwards. Build with optimizations
+// enabled for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#define ANN_IMPLEMENTATION
+#include "../include/ann.h"
+
+#define ANN_THREAD_IMPLEMENTATION
+#include "../include/ann_thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_N 8192
+#define EPOCH_N 4
+#define BATCH_N 16
+#define RATE 0.001
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static fp_t weight_delta(ann_t const *a, ann_t const *b) {
+  fp_t delta = 0;
+  for (uint_t i = 0; i < a->weight_n; i++) {
+    fp_t d = fabs(a->weight[i] - b->weight[i]);
+    delta = (d > delta) ? d : delta;
+  }
+
+  return delta;
+}
+
+static fp_t error(ann_t *ann, fp_t const *input, fp_t const *target) {
+  uint_t input_n = ann->layer_neuron_n[0];
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+
+  fp_t output[output_n];
+  fp_t error = 0;
+
+  for (uint_t s = 0; s < SAMPLE_N; s++) {
+    ann_propagation_forward(ann, input + s * input_n, output);
+    error += ann_error_total(output, target + s * output_n, output_n);
+  }
+
+  return error / SAMPLE_N;
+}
+
+int main(void) {
+  srand(1);
+
+  char const *mode_name[] = {"reduce", "hogwild"};
+
+  uint_t layer[] = {64, 256, 256, 16};
+  uint_t layer_n = sizeof(layer) / sizeof(layer[0]);
+  uint_t input_n = layer[0];
+  uint_t output_n = layer[layer_n - 1];
+
+  fp_t *input = malloc(sizeof(fp_t) * SAMPLE_N * input_n);
+  fp_t *target = malloc(sizeof(fp_t) * SAMPLE_N * output_n);
+  fp_t *output = malloc(sizeof(fp_t) * BATCH_N * output_n);
+
+  for (uint_t i = 0; i < SAMPLE_N * input_n; i++) {
+    input[i] = (fp_t)rand() / RAND_MAX;
+  }
+
+  for (uint_t i = 0; i < SAMPLE_N * output_n; i++) {
+    target[i] = (fp_t)rand() / RAND_MAX;
+  }
+
+  ann_t *ann = ann_init(layer_n, layer);
+  ann_random(ann);
+
+  // A single REDUCE thread must match batched training
+  ann_t *single = ann_copy(ann);
+  ann_t *batched = ann_copy(ann);
+  ann_batch_t *batch = ann_batch_init(batched, BATCH_N);
+
+  ann_thread_t *thread = ann_thread_init(single, 1, BATCH_N, REDUCE);
+
+  if (!thread || ann_thread_train(thread, input, target, SAMPLE_N, RATE)) {
+    fprintf(stderr, "Failed to start the worker threads\n");
+    return 1;
+  }
+
+  ann_thread_free(thread);
+
+  for (uint_t s = 0; s < SAMPLE_N; s += BATCH_N) {
+    ann_propagation_forward_batch(batched, batch, input + s * input_n, BATCH_N,
+                                  output);
+    ann_propagation_backward_batch(batched, batch, input + s * input_n, output,
+                                   target + s * output_n, BATCH_N, RATE);
+  }
+
+  printf("thread_n = 1 max weight delta: %g\n\n", weight_delta(single, batched));
+
+  ann_batch_free(batch);
+  ann_free(batched);
+  ann_free(single);
+
+  printf("%-8s %-10s %12s %12s %12s\n", "mode", "thread_n", "epoch (s)",
+         "speedup", "error");
+
+  for (ann_thread_mode_t mode = REDUCE; mode <= HOGWILD; mode++) {
+    double single_time = 0;
+
+    for (uint_t thread_n = 1; thread_n <= 8; thread_n *= 2) {
+      ann_t *copy = ann_copy(ann);
+      thread = ann_thread_init(copy, thread_n, BATCH_N, mode);
+
+      if (!thread) {
+        fprintf(stderr, "Failed to create %lu worker threads\n", thread_n);
+        return 1;
+      }
+
+      double t0 = now();
+
+      for (uint_t e = 0; e < EPOCH_N; e++) {
+        if (ann_thread_train(thread, input, target, SAMPLE_N, RATE)) {
+          fprintf(stderr, "Failed to start %lu worker threads\n", thread_n);
+          return 1;
+        }
+      }
+
+      double epoch = (now() - t0) / EPOCH_N;
+      single_time = (thread_n == 1) ? epoch : single_time;
+
+      printf("%-8s %-10lu %12.6f %12.2f %12g\n", mode_name[mode], thread_n,
+             epoch, single_time / epoch, error(copy, input, target));
+
+      ann_thread_free(thread);
+      ann_free(copy);
+    }
+  }
+
+  ann_free(ann);
+  free(input);
+  free(target);
+  free(output);
+}
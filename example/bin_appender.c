@@ -0,0 +1,120 @@
+// bin_appender.c - Group committed bin.h append benchmark
+//
+// Appends ticks one block at a time through bin_fd_append() and through
+// bin_appender.h, with and without the background thread and with each flush
+// policy, checking every file afterwards. Reports the throughput of each, the
+// number of groups written and of flushes to the storage device, and the mean
+// cost of a flush. Build with optimizations enabled for meaningful numbers,
+// e.g. CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define BIN_APPENDER_IMPLEMENTATION
+#include "../include/bin_appender.h"
+
+#define PATH "./bin_appender.bin"
+
+#define TICK_N 1000000
+#define RING_N 4096
+#define INTERVAL 0.01
+
+typedef struct {
+  bin_key_t time;
+  double price;
+  double volume;
+} tick_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static tick_t tick(bin_key_t i) {
+  return (tick_t){.time = i, .price = 100.0 + i % 97, .volume = i % 13};
+}
+
+// Every tick must have been written, in order, and the length synced
+static void check(uint_t tick_n) {
+  bin_t *b = bin_fd_open(PATH, 0);
+  assert(b && bin_fd_length(b) == tick_n);
+
+  tick_t *x = malloc(sizeof(tick_t) * tick_n);
+  assert(bin_fd_read(b, 0, x, tick_n) == 0);
+
+  for (uint_t i = 0; i < tick_n; i++) {
+    tick_t t = tick(i);
+    assert(x[i].time == t.time && x[i].price == t.price);
+  }
+
+  free(x);
+  bin_fd_close(b);
+}
+
+int main(void) {
+  char const *name[] = {"none", "group", "interval"};
+
+  printf("%-10s %-9s %12s %10s %8s %12s\n", "mode", "policy", "ticks/s",
+         "groups", "syncs", "sync (us)");
+
+  // One pwrite per tick, for comparison
+  bin_t *b = bin_fd_init(PATH, sizeof(tick_t));
+  double t0 = now();
+
+  for (bin_key_t i = 0; i < TICK_N; i++) {
+    tick_t t = tick(i);
+    bin_fd_append(b, &t, 1);
+  }
+
+  bin_sync(b);
+  double t = now() - t0;
+  bin_fd_close(b);
+  check(TICK_N);
+
+  printf("%-10s %-9s %12.0f %10s %8s %12s\n", "bin_fd", "-", TICK_N / t, "-",
+         "-", "-");
+
+  for (int threaded = 0; threaded <= 1; threaded++) {
+    for (bin_sync_policy_t p = BIN_SYNC_NONE; p <= BIN_SYNC_INTERVAL; p++) {
+      // A flush per group is slow, so fewer ticks are written
+      uint_t tick_n = (p == BIN_SYNC_GROUP) ? TICK_N / 10 : TICK_N;
+
+      b = bin_fd_init(PATH, sizeof(tick_t));
+      bin_appender_t *a = bin_appender_init(b, RING_N, p, INTERVAL, threaded);
+      t0 = now();
+
+      for (bin_key_t i = 0; i < (bin_key_t)tick_n; i++) {
+        tick_t t = tick(i);
+        bin_appender_append(a, &t, 1);
+      }
+
+      assert(bin_appender_flush(a) == 0);
+      t = now() - t0;
+
+      uint_t group_n = a->group_n;
+      uint_t sync_n = a->sync_n;
+      double sync_time = a->sync_time;
+
+      assert(bin_appender_free(a) == 0);
+      bin_fd_close(b);
+      check(tick_n);
+
+      printf("%-10s %-9s %12.0f %10lu %8lu %12.1f\n",
+             threaded ? "threaded" : "inline", name[p], tick_n / t,
+             (unsigned long)group_n, (unsigned long)sync_n,
+             sync_n ? sync_time / sync_n * 1e6 : 0.0);
+    }
+  }
+
+  remove(PATH);
+}
@@ -0,0 +1,240 @@
+// bin_async.c - Asynchronous bin.h benchmark
+//
+// Appends blocks one at a time across many files, then reads single blocks
+// at random from them from the page cache, and one block from each page of
+// every file in random order with the files evicted from it, reporting the
+// time per operation of blocking bin_t calls and of bin_async.h through
+// io_uring and through its pool of threads. Build with optimizations enabled
+// for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define BIN_ASYNC_IMPLEMENTATION
+#include "../include/bin_async.h"
+
+#define FILE_N 64
+#define BLOCK_N 16384
+#define READ_N 100000
+#define PAGE_BLOCKS (4096 / sizeof(sample_t))
+#define COLD_N (FILE_N * BLOCK_N / PAGE_BLOCKS)
+
+#define DEPTH 128
+#define THREAD_N 8
+
+typedef struct {
+  bin_key_t time;
+  double data;
+} sample_t;
+
+enum { BLOCKING, URING, THREADS };
+
+static bin_t *file[FILE_N];
+static sample_t *block;
+static sample_t *read_block;
+static uint_t *read_file;
+static int_t *read_index;
+static uint_t *cold_file;
+static int_t *cold_index;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void path(char *p, uint_t f) {
+  sprintf(p, "./bin_async_%lu.bin", (unsigned long)f);
+}
+
+// Reap at least min completions, none of which may have failed
+static void reap(bin_async_t *a, uint_t min) {
+  bin_async_result_t result[DEPTH];
+  uint_t n = bin_async_reap(a, result, DEPTH, min);
+
+  assert(n >= min);
+
+  for (uint_t k = 0; k < n; k++) {
+    assert(result[k].error == 0);
+  }
+}
+
+// Append BLOCK_N blocks to each of the files, one block per operation and one
+// file after another
+static double append_test(int mode) {
+  char p[64];
+
+  for (uint_t f = 0; f < FILE_N; f++) {
+    path(p, f);
+    file[f] = bin_fd_init(p, sizeof(sample_t));
+  }
+
+  bin_async_t *a = (mode == BLOCKING)
+                       ? NULL
+                       : bin_async_init(DEPTH, THREAD_N, mode == URING);
+  double t0 = now();
+
+  for (uint_t i = 0; i < BLOCK_N; i++) {
+    for (uint_t f = 0; f < FILE_N; f++) {
+      sample_t const *x = block + i * FILE_N + f;
+
+      if (mode == BLOCKING) {
+        bin_fd_append(file[f], x, 1);
+        continue;
+      }
+
+      while (bin_async_append(a, file[f], x, 1, NULL) != 0) {
+        reap(a, 1);
+      }
+    }
+  }
+
+  if (a) {
+    reap(a, bin_async_flight(a));
+    assert(a->uring == (mode == URING));
+    bin_async_free(a);
+  }
+
+  for (uint_t f = 0; f < FILE_N; f++) {
+    bin_sync(file[f]);
+  }
+
+  double t = (now() - t0) / (BLOCK_N * FILE_N);
+
+  for (uint_t f = 0; f < FILE_N; f++) {
+    assert(bin_fd_length(file[f]) == BLOCK_N);
+    bin_fd_close(file[f]);
+
+    path(p, f);
+    file[f] = bin_fd_open(p, 0);
+  }
+
+  return t;
+}
+
+// Read the n single blocks given, optionally evicting the files from the page
+// cache first, and check each
+static double read_test(int mode, uint_t n, uint_t const *which,
+                        int_t const *index, int cold) {
+  for (uint_t f = 0; f < FILE_N; f++) {
+    if (cold) {
+      fdatasync(file[f]->fd);
+      posix_fadvise(file[f]->fd, 0, 0, POSIX_FADV_DONTNEED);
+      posix_fadvise(file[f]->fd, 0, 0, POSIX_FADV_RANDOM);
+    }
+  }
+
+  bin_async_t *a = (mode == BLOCKING)
+                       ? NULL
+                       : bin_async_init(DEPTH, THREAD_N, mode == URING);
+  double t0 = now();
+
+  for (uint_t r = 0; r < n; r++) {
+    bin_t *b = file[which[r]];
+
+    if (mode == BLOCKING) {
+      bin_fd_read(b, index[r], read_block + r, 1);
+      continue;
+    }
+
+    while (bin_async_read(a, b, index[r], read_block + r, 1, NULL) != 0) {
+      reap(a, 1);
+    }
+  }
+
+  if (a) {
+    reap(a, bin_async_flight(a));
+    bin_async_free(a);
+  }
+
+  double t = (now() - t0) / n;
+
+  for (uint_t r = 0; r < n; r++) {
+    assert(read_block[r].time == index[r]);
+    assert(read_block[r].data == which[r]);
+    read_block[r].time = -1;
+  }
+
+  return t;
+}
+
+int main(void) {
+  srand(1);
+
+  block = malloc(sizeof(sample_t) * BLOCK_N * FILE_N);
+  read_block = malloc(sizeof(sample_t) * READ_N);
+  read_file = malloc(sizeof(uint_t) * READ_N);
+  read_index = malloc(sizeof(int_t) * READ_N);
+  cold_file = malloc(sizeof(uint_t) * COLD_N);
+  cold_index = malloc(sizeof(int_t) * COLD_N);
+
+  for (uint_t i = 0; i < BLOCK_N; i++) {
+    for (uint_t f = 0; f < FILE_N; f++) {
+      block[i * FILE_N + f] = (sample_t){.time = i, .data = f};
+    }
+  }
+
+  for (uint_t r = 0; r < READ_N; r++) {
+    read_file[r] = rand() % FILE_N;
+    read_index[r] = rand() % BLOCK_N;
+  }
+
+  for (uint_t r = 0; r < COLD_N; r++) {
+    uint_t s = rand() % (r + 1);
+
+    cold_file[r] = cold_file[s];
+    cold_index[r] = cold_index[s];
+    cold_file[s] = r % FILE_N;
+    cold_index[s] = (r / FILE_N) * PAGE_BLOCKS + rand() % PAGE_BLOCKS;
+  }
+
+  bin_async_t *a = bin_async_init(DEPTH, THREAD_N, 1);
+  printf("%d files of %d blocks, io_uring %s\n\n", FILE_N, BLOCK_N,
+         a->uring ? "available" : "unavailable");
+  bin_async_free(a);
+
+  printf("%-8s %14s %14s %14s\n", "test", "blocking (ns)", "io_uring (ns)",
+         "threads (ns)");
+
+  char const *name[] = {"append", "read", "cold"};
+  double t[3][3];
+
+  for (int mode = BLOCKING; mode <= THREADS; mode++) {
+    t[0][mode] = append_test(mode);
+    t[1][mode] = read_test(mode, READ_N, read_file, read_index, 0);
+    t[2][mode] = read_test(mode, COLD_N, cold_file, cold_index, 1);
+
+    for (uint_t f = 0; f < FILE_N; f++) {
+      bin_fd_close(file[f]);
+    }
+  }
+
+  for (uint_t test = 0; test < 3; test++) {
+    printf("%-8s %14.1f %14.1f %14.1f\n", name[test], t[test][0] * 1e9,
+           t[test][1] * 1e9, t[test][2] * 1e9);
+  }
+
+  char p[64];
+
+  for (uint_t f = 0; f < FILE_N; f++) {
+    path(p, f);
+    remove(p);
+  }
+
+  free(block);
+  free(read_block);
+  free(read_file);
+  free(read_index);
+  free(cold_file);
+  free(cold_index);
+}
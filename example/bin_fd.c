@@ -0,0 +1,141 @@
+// bin_fd.c - Cached header bin.h benchmark
+//
+// Checks the bin_t operations against the same sequence as bin.c, then
+// reports the time of appending blocks one at a time and of searching for
+// random keys, through the FILE functions and through a bin_t. Build with
+// optimizations enabled for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define TEST_LENGTH 10
+#define TEST_START -2
+
+#define APPEND_N 200000
+#define SEARCH_N 100000
+
+typedef struct {
+  bin_key_t time;
+  double data;
+} sample_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  srand(1);
+
+  char const *path = "./bin_fd.bin";
+
+  // The sequence of bin.c
+  bin_t *b = bin_fd_init(path, sizeof(sample_t));
+  bin_key_t half = (bin_key_t)((TEST_START + TEST_LENGTH) / 2.0);
+
+  for (bin_key_t i = half - 1; i >= TEST_START; i--) {
+    bin_fd_insert(b, 0, &(sample_t){.time = i, .data = 2.0 * i}, 1);
+  }
+
+  for (bin_key_t i = half; i < TEST_START + TEST_LENGTH; i++) {
+    bin_fd_append(b, &(sample_t){.time = i, .data = 2.0 * i}, 1);
+  }
+
+  assert(bin_fd_length(b) == TEST_LENGTH);
+
+  sample_t x[TEST_LENGTH];
+  assert(bin_fd_read(b, 0, x, TEST_LENGTH) == 0);
+
+  for (int_t i = 0; i < TEST_LENGTH; i++) {
+    bin_key_t key = TEST_START + i;
+
+    assert(x[i].time == key && x[i].data == 2.0 * key);
+    assert(bin_fd_search(b, key) == i);
+  }
+
+  assert(bin_fd_search(b, TEST_START - 1) == -1);
+  assert(bin_fd_search(b, TEST_START + TEST_LENGTH) == -(TEST_LENGTH + 1));
+
+  // The length on disk only changes once synced
+  FILE *f = bin_open(path);
+  assert(bin_length(f) == 0);
+  assert(bin_sync(b) == 0);
+  assert(bin_length(f) == TEST_LENGTH);
+  assert(bin_search(f, half) == half - TEST_START);
+  bin_close(f);
+
+  assert(bin_fd_close(b) == 0);
+
+  puts("bin_t matches bin.c\n");
+  printf("%-8s %14s %14s %8s\n", "test", "file (ns)", "bin_t (ns)",
+         "speedup");
+
+  // Appending one block at a time
+  f = bin_init(path, sizeof(sample_t));
+  double t0 = now();
+
+  for (bin_key_t i = 0; i < APPEND_N; i++) {
+    bin_append(f, &(sample_t){.time = 2 * i, .data = i}, 1);
+  }
+
+  double file_time = (now() - t0) / APPEND_N;
+  bin_close(f);
+
+  b = bin_fd_init(path, sizeof(sample_t));
+  t0 = now();
+
+  for (bin_key_t i = 0; i < APPEND_N; i++) {
+    bin_fd_append(b, &(sample_t){.time = 2 * i, .data = i}, 1);
+  }
+
+  bin_sync(b);
+  double fd_time = (now() - t0) / APPEND_N;
+
+  printf("%-8s %14.1f %14.1f %8.1f\n", "append", file_time * 1e9,
+         fd_time * 1e9, file_time / fd_time);
+
+  // Searching for random keys, half of which are present
+  f = bin_open(path);
+  int_t file_sum = 0, fd_sum = 0;
+
+  bin_key_t *key = malloc(sizeof(bin_key_t) * SEARCH_N);
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    key[s] = rand() % (2 * APPEND_N);
+  }
+
+  t0 = now();
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    file_sum += bin_search(f, key[s]);
+  }
+
+  file_time = (now() - t0) / SEARCH_N;
+  t0 = now();
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    fd_sum += bin_fd_search(b, key[s]);
+  }
+
+  fd_time = (now() - t0) / SEARCH_N;
+  assert(file_sum == fd_sum);
+
+  printf("%-8s %14.1f %14.1f %8.1f\n", "search", file_time * 1e9,
+         fd_time * 1e9, file_time / fd_time);
+
+  bin_close(f);
+  bin_fd_close(b);
+  remove(path);
+
+  free(key);
+}
@@ -0,0 +1,158 @@
+// bin_index.c - Sparse key index benchmark
+//
+// Checks searches through a bin_fd_index() fence index against bisecting the
+// file, as the file is appended to, changed, and its saved index reloaded,
+// then reports the time of building the index and of searching for random
+// keys with and without it. Build with optimizations enabled for meaningful
+// numbers, e.g. CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define PATH "./bin_index.bin"
+#define INDEX_PATH "./bin_index.idx"
+
+#define TEST_N 10000
+#define BLOCK_N 4000000
+#define SEARCH_N 100000
+#define STRIDE 256
+
+typedef struct {
+  bin_key_t time;
+  double data;
+} sample_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Every key around those of the file must be found as by bisection
+static void check(bin_t *b, bin_t *plain, bin_key_t key_n) {
+  bin_sync(b);
+  plain->meta.length = b->meta.length;
+
+  for (bin_key_t k = -2; k < key_n + 2; k++) {
+    assert(bin_fd_search(b, k) == bin_fd_search(plain, k));
+  }
+}
+
+int main(void) {
+  srand(1);
+
+  // Appended a few blocks at a time, with the keys spaced unevenly
+  bin_t *b = bin_fd_init(PATH, sizeof(sample_t));
+  bin_t *plain = bin_fd_open(PATH, 0);
+  assert(bin_fd_index(b, 16, INDEX_PATH) == 0);
+
+  bin_key_t key = 0;
+
+  for (uint_t n = 0; n < TEST_N;) {
+    sample_t s[7];
+    uint_t k = 1 + rand() % 7;
+
+    for (uint_t i = 0; i < k; i++) {
+      key += 1 + rand() % 3;
+      s[i] = (sample_t){.time = key, .data = n + i};
+    }
+
+    bin_fd_append(b, s, k);
+    n += k;
+  }
+
+  assert(b->index->length == bin_fd_length(b));
+  check(b, plain, key);
+
+  // Inserted and overwritten blocks empty the index, which is rebuilt
+  bin_fd_insert(b, 0, &(sample_t){.time = -1}, 1);
+  assert(b->index->key_n == 0);
+  check(b, plain, key);
+
+  bin_fd_write(b, 1, &(sample_t){.time = 0}, 1);
+  check(b, plain, key);
+
+  // The saved index is reloaded, and brought up to date after appends made
+  // without it
+  assert(bin_fd_close(b) == 0);
+
+  b = bin_fd_open(PATH, 1);
+  bin_fd_append(b, &(sample_t){.time = key + 1}, 1);
+  bin_fd_close(b);
+
+  b = bin_fd_open(PATH, 1);
+  assert(bin_fd_index(b, 16, INDEX_PATH) == 0);
+  assert(b->index->key_n > 0 && b->index->length < bin_fd_length(b));
+  check(b, plain, key + 1);
+
+  bin_fd_close(b);
+  bin_fd_close(plain);
+  remove(INDEX_PATH);
+
+  puts("indexed searches match bisection\n");
+
+  // A large file, indexed after the fact
+  sample_t *sample = malloc(sizeof(sample_t) * BLOCK_N);
+
+  for (uint_t i = 0; i < BLOCK_N; i++) {
+    sample[i] = (sample_t){.time = 2 * i, .data = i};
+  }
+
+  b = bin_fd_init(PATH, sizeof(sample_t));
+  bin_fd_append(b, sample, BLOCK_N);
+  bin_sync(b);
+  free(sample);
+
+  plain = bin_fd_open(PATH, 0);
+  bin_fd_index(b, STRIDE, NULL);
+
+  double t0 = now();
+  bin_fd_search(b, 0);
+  double build_time = now() - t0;
+
+  bin_key_t *k = malloc(sizeof(bin_key_t) * SEARCH_N);
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    k[s] = rand() % (2 * BLOCK_N);
+  }
+
+  int_t plain_sum = 0, index_sum = 0;
+  t0 = now();
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    plain_sum += bin_fd_search(plain, k[s]);
+  }
+
+  double plain_time = (now() - t0) / SEARCH_N;
+  t0 = now();
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    index_sum += bin_fd_search(b, k[s]);
+  }
+
+  double index_time = (now() - t0) / SEARCH_N;
+  assert(plain_sum == index_sum);
+
+  printf("index of %d blocks, every %d: %lu keys built in %.1f ms\n\n",
+         BLOCK_N, STRIDE, (unsigned long)b->index->key_n, build_time * 1e3);
+
+  printf("%-8s %14s %14s %8s\n", "test", "bisect (ns)", "index (ns)",
+         "speedup");
+  printf("%-8s %14.1f %14.1f %8.1f\n", "search", plain_time * 1e9,
+         index_time * 1e9, plain_time / index_time);
+
+  bin_fd_close(b);
+  bin_fd_close(plain);
+  remove(PATH);
+
+  free(k);
+}
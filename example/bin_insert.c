@@ -0,0 +1,210 @@
+// bin_insert.c - bin.h insertion benchmark
+//
+// Checks single and merged insertions into bin.h files against a sorted array,
+// then reports the time of inserting blocks at the front of a large file by
+// shifting its tail through a buffer and by inserting a range into the file,
+// and of inserting a sorted batch of late blocks one at a time and in a single
+// merge. Build with optimizations enabled for meaningful numbers, e.g.
+// CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define PATH "./bin_insert.bin"
+
+#define TEST_N 2000
+#define BATCH_N 100
+
+#define BLOCK_N 1000000
+#define PAGE_N 16384
+#define INSERT_N 16
+
+typedef struct {
+  bin_key_t time;
+  double data;
+} sample_t;
+
+typedef struct {
+  bin_key_t time;
+  uint8_t data[4096 - sizeof(bin_key_t)];
+} page_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int compare(void const *a, void const *b) {
+  bin_key_t x = ((sample_t const *)a)->time, y = ((sample_t const *)b)->time;
+  return (x > y) - (x < y);
+}
+
+// The file must hold exactly the n sorted samples of expected
+static void check(bin_t *b, sample_t const *expected, uint_t n) {
+  sample_t *x = malloc(sizeof(sample_t) * n);
+
+  assert(bin_fd_length(b) == n && bin_fd_read(b, 0, x, n) == 0);
+
+  for (uint_t i = 0; i < n; i++) {
+    assert(x[i].time == expected[i].time && x[i].data == expected[i].data);
+  }
+
+  free(x);
+}
+
+int main(void) {
+  srand(1);
+
+  // Random insertions through each interface, against a sorted array
+  sample_t *expected = malloc(sizeof(sample_t) * (TEST_N + BATCH_N));
+  bin_t *b = bin_fd_init(PATH, sizeof(sample_t));
+  FILE *f = bin_init("./bin_insert_file.bin", sizeof(sample_t));
+
+  for (uint_t n = 0; n < TEST_N; n++) {
+    sample_t s = {.time = rand() % 1000, .data = n};
+    uint_t i = bin_fuzzy_index(bin_fd_search(b, s.time));
+
+    assert(bin_fd_insert(b, i, &s, 1) == 0);
+    bin_insert(f, bin_fuzzy_index(bin_search(f, s.time)), &s, 1);
+
+    // Equal keys are placed in any order by a search, so the array follows
+    memmove(expected + i + 1, expected + i, sizeof(sample_t) * (n - i));
+    expected[i] = s;
+  }
+
+  check(b, expected, TEST_N);
+
+  sample_t *x = malloc(sizeof(sample_t) * TEST_N);
+  bin_read(f, 0, x, TEST_N);
+  assert(bin_length(f) == TEST_N);
+  assert(memcmp(x, expected, sizeof(sample_t) * TEST_N) == 0);
+  bin_close(f);
+  remove("./bin_insert_file.bin");
+  free(x);
+
+  // A late batch, merged, follows the blocks with equal keys
+  sample_t batch[BATCH_N];
+
+  for (uint_t n = 0; n < BATCH_N; n++) {
+    batch[n] = (sample_t){.time = rand() % 1200 - 100, .data = -1.0 - n};
+  }
+
+  qsort(batch, BATCH_N, sizeof(sample_t), compare);
+  assert(bin_fd_merge(b, batch, BATCH_N) == 0);
+
+  for (uint_t n = 0; n < BATCH_N; n++) {
+    uint_t i = 0;
+    uint_t l = TEST_N + n;
+
+    while (i < l && expected[i].time <= batch[n].time)
+      i++;
+
+    memmove(expected + i + 1, expected + i, sizeof(sample_t) * (l - i));
+    expected[i] = batch[n];
+  }
+
+  check(b, expected, TEST_N + BATCH_N);
+  bin_fd_close(b);
+  free(expected);
+
+  puts("insertions match a sorted array\n");
+
+  // Inserting pages at the front, through a buffer and as a range
+  page_t *page = calloc(PAGE_N, sizeof(page_t));
+
+  for (uint_t i = 0; i < PAGE_N; i++) {
+    page[i].time = INSERT_N + i;
+  }
+
+  f = bin_init(PATH, sizeof(page_t));
+  bin_append(f, page, PAGE_N);
+
+  double t0 = now();
+
+  for (bin_key_t i = INSERT_N - 1; i >= 0; i--) {
+    bin_insert(f, 0, &(page_t){.time = i}, 1);
+  }
+
+  double shift_time = (now() - t0) / INSERT_N;
+  bin_close(f);
+
+  b = bin_fd_init(PATH, sizeof(page_t));
+  bin_fd_append(b, page, PAGE_N);
+
+  t0 = now();
+
+  for (bin_key_t i = INSERT_N - 1; i >= 0; i--) {
+    bin_fd_insert(b, 0, &(page_t){.time = i}, 1);
+  }
+
+  double range_time = (now() - t0) / INSERT_N;
+
+  for (bin_key_t i = 0; i < INSERT_N + PAGE_N; i += 1 + i / 2) {
+    assert(bin_fd_search(b, i) == i);
+  }
+
+  bin_fd_close(b);
+  free(page);
+
+  printf("%-26s %12s %12s\n", "test", "time (ms)", "speedup");
+  printf("%-26s %12.3f %12s\n", "64 MiB front, shift", shift_time * 1e3, "-");
+  printf("%-26s %12.3f %12.1f\n", "64 MiB front, range", range_time * 1e3,
+         shift_time / range_time);
+
+  // A late batch of samples, inserted one at a time and merged
+  sample_t *sample = malloc(sizeof(sample_t) * BLOCK_N);
+
+  for (uint_t i = 0; i < BLOCK_N; i++) {
+    sample[i] = (sample_t){.time = 2 * i, .data = i};
+  }
+
+  for (uint_t n = 0; n < BATCH_N; n++) {
+    batch[n] = (sample_t){.time = 2 * (rand() % BLOCK_N) + 1, .data = -1};
+  }
+
+  qsort(batch, BATCH_N, sizeof(sample_t), compare);
+
+  double time[2];
+
+  for (int merge = 0; merge <= 1; merge++) {
+    b = bin_fd_init(PATH, sizeof(sample_t));
+    bin_fd_append(b, sample, BLOCK_N);
+
+    t0 = now();
+
+    if (merge) {
+      bin_fd_merge(b, batch, BATCH_N);
+    } else {
+      for (uint_t n = 0; n < BATCH_N; n++) {
+        uint_t i = bin_fuzzy_index(bin_fd_search(b, batch[n].time));
+        bin_fd_insert(b, i, batch + n, 1);
+      }
+    }
+
+    time[merge] = now() - t0;
+
+    for (uint_t n = 0; n < BATCH_N; n++) {
+      assert(bin_fd_search(b, batch[n].time) >= 0);
+    }
+
+    bin_fd_close(b);
+  }
+
+  printf("%-26s %12.3f %12s\n", "100 late, one at a time", time[0] * 1e3, "-");
+  printf("%-26s %12.3f %12.1f\n", "100 late, merged", time[1] * 1e3,
+         time[0] / time[1]);
+
+  remove(PATH);
+  free(sample);
+}
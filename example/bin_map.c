@@ -0,0 +1,173 @@
+// bin_map.c - Memory-mapped bin.h benchmark
+//
+// Checks the bin_map_t operations against the same sequence as bin.c, then
+// reports the time of appending blocks one at a time, searching for random
+// keys and summing every block, through the FILE functions and through a
+// mapping. Build with optimizations enabled for meaningful numbers, e.g.
+// CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define TEST_LENGTH 10
+#define TEST_START -2
+
+#define BLOCK_N 1000000
+#define APPEND_N 100000
+#define SEARCH_N 100000
+
+typedef struct {
+  bin_key_t time;
+  double data;
+} sample_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  srand(1);
+
+  char const *path = "./bin_map.bin";
+
+  // The sequence of bin.c
+  bin_map_t *m = bin_map_init(path, sizeof(sample_t));
+  bin_key_t half = (bin_key_t)((TEST_START + TEST_LENGTH) / 2.0);
+
+  for (bin_key_t i = half - 1; i >= TEST_START; i--) {
+    bin_map_insert(m, 0, &(sample_t){.time = i, .data = 2.0 * i}, 1);
+  }
+
+  for (bin_key_t i = half; i < TEST_START + TEST_LENGTH; i++) {
+    bin_map_append(m, &(sample_t){.time = i, .data = 2.0 * i}, 1);
+  }
+
+  assert(bin_map_length(m) == TEST_LENGTH);
+
+  for (int_t i = 0; i < TEST_LENGTH; i++) {
+    sample_t const *x = bin_map_block(m, i);
+    bin_key_t key = TEST_START + i;
+
+    assert(x->time == key && x->data == 2.0 * key);
+    assert(bin_map_search(m, key) == i);
+  }
+
+  assert(bin_map_search(m, TEST_START - 1) == -1);
+  assert(bin_map_search(m, TEST_START + TEST_LENGTH) == -(TEST_LENGTH + 1));
+  assert(bin_map_close(m) == 0);
+
+  // The file is trimmed, and readable by the FILE functions
+  FILE *f = bin_open(path);
+  assert(bin_length(f) == TEST_LENGTH);
+  assert(bin_search(f, half) == half - TEST_START);
+  bin_close(f);
+
+  puts("bin_map_t matches bin.c\n");
+  printf("%-8s %14s %14s %8s\n", "test", "file (ns)", "map (ns)", "speedup");
+
+  // Appending one block at a time
+  f = bin_init(path, sizeof(sample_t));
+  double t0 = now();
+
+  for (bin_key_t i = 0; i < APPEND_N; i++) {
+    bin_append(f, &(sample_t){.time = i, .data = i}, 1);
+  }
+
+  double file_time = (now() - t0) / APPEND_N;
+  bin_close(f);
+
+  m = bin_map_init(path, sizeof(sample_t));
+  t0 = now();
+
+  for (bin_key_t i = 0; i < APPEND_N; i++) {
+    bin_map_append(m, &(sample_t){.time = i, .data = i}, 1);
+  }
+
+  double map_time = (now() - t0) / APPEND_N;
+
+  printf("%-8s %14.1f %14.1f %8.1f\n", "append", file_time * 1e9,
+         map_time * 1e9, file_time / map_time);
+
+  for (bin_key_t i = APPEND_N; i < BLOCK_N; i++) {
+    bin_map_append(m, &(sample_t){.time = 2 * i, .data = i}, 1);
+  }
+
+  bin_map_close(m);
+
+  // Searching for random keys, half of which are present
+  bin_key_t *key = malloc(sizeof(bin_key_t) * SEARCH_N);
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    key[s] = rand() % (2 * BLOCK_N);
+  }
+
+  f = bin_open(path);
+  int_t file_sum = 0;
+  t0 = now();
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    file_sum += bin_search(f, key[s]);
+  }
+
+  file_time = (now() - t0) / SEARCH_N;
+
+  m = bin_map_open(path, 0);
+  int_t map_sum = 0;
+  t0 = now();
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    map_sum += bin_map_search(m, key[s]);
+  }
+
+  map_time = (now() - t0) / SEARCH_N;
+  assert(file_sum == map_sum);
+
+  printf("%-8s %14.1f %14.1f %8.1f\n", "search", file_time * 1e9,
+         map_time * 1e9, file_time / map_time);
+
+  // Summing every block, copied into a buffer or read in place
+  sample_t *x = malloc(sizeof(sample_t) * BLOCK_N);
+  double file_total = 0;
+  t0 = now();
+
+  bin_read(f, 0, x, BLOCK_N);
+
+  for (uint_t i = 0; i < BLOCK_N; i++) {
+    file_total += x[i].data;
+  }
+
+  file_time = (now() - t0) / BLOCK_N;
+
+  double map_total = 0;
+  t0 = now();
+
+  sample_t const *b = bin_map_block(m, 0);
+
+  for (uint_t i = 0; i < BLOCK_N; i++) {
+    map_total += b[i].data;
+  }
+
+  map_time = (now() - t0) / BLOCK_N;
+  assert(file_total == map_total);
+
+  printf("%-8s %14.1f %14.1f %8.1f\n", "scan", file_time * 1e9,
+         map_time * 1e9, file_time / map_time);
+
+  bin_close(f);
+  bin_map_close(m);
+  remove(path);
+
+  free(key);
+  free(x);
+}
@@ -0,0 +1,222 @@
+// bin_part.c - Time partitioned bin.h benchmark
+//
+// Writes a month of samples into a store partitioned by hour in a directory
+// per day, and checks reads, searches, range scans, merged late samples and
+// retention against the keys written. Then reports the time of searching for
+// random keys of the last day and of scanning an hour, in the store and in a
+// single bin_t holding the same samples. Build with optimizations enabled
+// for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define FLAT_IMPLEMENTATION
+#include "../include/flat.h"
+
+#define BIN_PART_IMPLEMENTATION
+#include "../include/bin_part.h"
+
+#define HOUR 3600
+#define DAY (24 * HOUR)
+#define DAY_N 30
+#define STEP 10
+#define BLOCK_N (DAY_N * DAY / STEP)
+#define BATCH_N 1000
+
+#define SEARCH_N 100000
+#define SCAN_N 100
+
+typedef struct {
+  bin_key_t time;
+  double data;
+} sample_t;
+
+static char const *root = "./bin_part_store";
+static char const *path = "./bin_part.bin";
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Count and check the blocks with keys from k_0 up to k_1
+static uint_t scan(bin_part_t *p, bin_key_t k_0, bin_key_t k_1) {
+  bin_part_range_t *range = bin_part_range(p, k_0, k_1);
+  sample_t const *x;
+  uint_t total = 0, n;
+
+  while ((n = bin_part_range_next(range, (void const **)&x)) > 0) {
+    for (uint_t i = 0; i < n; i++) {
+      assert(x[i].time >= k_0 && x[i].time < k_1);
+    }
+
+    total += n;
+  }
+
+  bin_part_range_free(range);
+
+  return total;
+}
+
+int main(void) {
+  srand(1);
+
+  // A sample every STEP seconds, written in batches
+  bin_part_t *p = bin_part_open(root, sizeof(sample_t), HOUR, DAY, 1);
+  bin_t *b = bin_fd_init(path, sizeof(sample_t));
+  sample_t *batch = malloc(sizeof(sample_t) * BATCH_N);
+
+  assert(p && bin_part_length(p) == 0);
+
+  for (uint_t i = 0; i < BLOCK_N; i += BATCH_N) {
+    uint_t n = (BLOCK_N - i < BATCH_N) ? BLOCK_N - i : BATCH_N;
+
+    for (uint_t j = 0; j < n; j++) {
+      batch[j] = (sample_t){.time = (i + j) * STEP, .data = i + j};
+    }
+
+    assert(bin_part_append(p, batch, n) == 0);
+    bin_fd_append(b, batch, n);
+  }
+
+  assert(bin_part_close(p) == 0);
+
+  // The manifest is rebuilt from the directory tree
+  double t0 = now();
+  p = bin_part_open(root, sizeof(sample_t), HOUR, DAY, 1);
+  double open_time = now() - t0;
+
+  assert(p && p->part_n == DAY_N * 24 && bin_part_length(p) == BLOCK_N);
+
+  for (uint_t s = 0; s < 1000; s++) {
+    bin_key_t k = rand() % (DAY_N * DAY);
+    int_t i = bin_part_search(p, k);
+
+    assert((k % STEP == 0) ? i == k / STEP : i == -(k / STEP + 1) - 1);
+  }
+
+  assert(bin_part_search(p, -1) == -1);
+  assert(bin_part_search(p, DAY_N * DAY) == -(int_t)BLOCK_N - 1);
+
+  // Reads and scans across partitions
+  bin_part_read(p, HOUR / STEP - 5, batch, 10);
+
+  for (uint_t j = 0; j < 10; j++) {
+    assert(batch[j].time == (bin_key_t)(HOUR - 5 * STEP + j * STEP));
+  }
+
+  assert(scan(p, 0, DAY_N * DAY) == BLOCK_N);
+  assert(scan(p, HOUR - 1, 3 * HOUR + 1) == 2 * HOUR / STEP + 1);
+  assert(scan(p, DAY + 5, DAY + 5) == 0);
+
+  // Late samples are merged among those of their hour
+  sample_t late = {.time = HOUR + 5, .data = -1};
+  assert(bin_part_append(p, &late, 1) == 0);
+  assert(bin_part_search(p, HOUR + 5) == HOUR / STEP + 1);
+  assert(bin_part_search(p, HOUR + 10) == HOUR / STEP + 2);
+  assert(bin_part_length(p) == BLOCK_N + 1);
+
+  // Retention drops the first days whole
+  assert(bin_part_drop(p, 10 * DAY + HOUR) == 0);
+  assert(bin_part_length(p) == BLOCK_N - 10 * DAY / STEP);
+  assert(bin_part_search(p, 10 * DAY) == 0);
+  assert(bin_part_close(p) == 0);
+
+  p = bin_part_open(root, sizeof(sample_t), HOUR, DAY, 0);
+  assert(p->part_n == (DAY_N - 10) * 24);
+  assert(flat_directory_entry_count(root) == DAY_N - 10);
+
+  printf("manifest of %d partitions built in %.2f ms, %d kept\n\n",
+         DAY_N * 24, open_time * 1e3, (DAY_N - 10) * 24);
+  printf("%-8s %14s %14s %8s\n", "test", "file (ns)", "store (ns)",
+         "speedup");
+
+  // Searching for random keys of the last day
+  bin_key_t *key = malloc(sizeof(bin_key_t) * SEARCH_N);
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    key[s] = (DAY_N - 1) * DAY + rand() % DAY;
+  }
+
+  int_t file_sum = 0;
+  t0 = now();
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    file_sum += bin_fd_search(b, key[s]) < 0;
+  }
+
+  double file_time = (now() - t0) / SEARCH_N;
+
+  int_t part_sum = 0;
+  t0 = now();
+
+  for (uint_t s = 0; s < SEARCH_N; s++) {
+    part_sum += bin_part_search(p, key[s]) < 0;
+  }
+
+  double part_time = (now() - t0) / SEARCH_N;
+  assert(file_sum == part_sum);
+
+  printf("%-8s %14.1f %14.1f %8.1f\n", "search", file_time * 1e9,
+         part_time * 1e9, file_time / part_time);
+
+  // Scanning a random hour
+  srand(2);
+  uint_t file_total = 0;
+  t0 = now();
+
+  for (uint_t s = 0; s < SCAN_N; s++) {
+    bin_key_t k = (10 + rand() % (DAY_N - 10)) * (bin_key_t)DAY;
+    bin_range_t *range = bin_fd_range(b, k, k + HOUR);
+    void const *x;
+    uint_t n;
+
+    while ((n = bin_range_next(range, &x)) > 0) {
+      file_total += n;
+    }
+
+    bin_range_free(range);
+  }
+
+  file_time = (now() - t0) / SCAN_N;
+  assert(file_total == SCAN_N * HOUR / STEP);
+
+  srand(2);
+  uint_t part_total = 0;
+  t0 = now();
+
+  for (uint_t s = 0; s < SCAN_N; s++) {
+    bin_key_t k = (10 + rand() % (DAY_N - 10)) * (bin_key_t)DAY;
+    part_total += scan(p, k, k + HOUR);
+  }
+
+  part_time = (now() - t0) / SCAN_N;
+  assert(part_total == SCAN_N * HOUR / STEP);
+
+  printf("%-8s %14.1f %14.1f %8.1f\n", "scan", file_time * 1e9,
+         part_time * 1e9, file_time / part_time);
+
+  bin_part_close(p);
+  bin_fd_close(b);
+
+  // Dropping every day empties the store
+  p = bin_part_open(root, sizeof(sample_t), HOUR, DAY, 1);
+  assert(bin_part_drop(p, DAY_N * DAY) == 0 && bin_part_length(p) == 0);
+  bin_part_close(p);
+
+  remove(root);
+  remove(path);
+
+  free(batch);
+  free(key);
+}
@@ -0,0 +1,194 @@
+// bin_range.c - bin.h range scan and multiple key search benchmark
+//
+// Checks range scans and sorted multiple key searches against the blocks held
+// in memory, then reports the time of scanning a range with bin_fd_range()
+// against searching for its bounds and reading it a block at a time, and of
+// searching for sorted sets of keys, spread across the file and clustered,
+// with bin_fd_search_sorted() against a bin_fd_search() for each, with the
+// blocks read by each. Build with optimizations enabled for meaningful
+// numbers, e.g. CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define PATH "./bin_range.bin"
+
+#define BLOCK_N 4000000
+#define RANGE_N 1000000
+#define KEY_N 10000
+
+typedef struct {
+  bin_key_t time;
+  double data;
+} sample_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int compare(void const *a, void const *b) {
+  bin_key_t x = *(bin_key_t const *)a, y = *(bin_key_t const *)b;
+  return (x > y) - (x < y);
+}
+
+int main(void) {
+  srand(1);
+
+  // Keys in steps of 0 to 3, so that some repeat and some are missing
+  sample_t *sample = malloc(sizeof(sample_t) * BLOCK_N);
+  bin_key_t t = 0;
+
+  for (uint_t i = 0; i < BLOCK_N; i++) {
+    t += rand() % 4;
+    sample[i] = (sample_t){.time = t, .data = i};
+  }
+
+  bin_t *b = bin_fd_init(PATH, sizeof(sample_t));
+  bin_fd_append(b, sample, BLOCK_N);
+
+  // Ranges begin at the first repeat of their smallest key
+  for (uint_t r = 0; r < 100; r++) {
+    bin_key_t k_0 = rand() % (t + 2) - 1;
+    bin_key_t k_1 = k_0 + rand() % 10000;
+
+    uint_t i = 0;
+
+    while (i < BLOCK_N && sample[i].time < k_0)
+      i++;
+
+    bin_range_t *range = bin_fd_range(b, k_0, k_1);
+    sample_t const *x;
+    uint_t n;
+
+    assert(range->start == i);
+
+    while ((n = bin_range_next(range, (void const **)&x)) > 0) {
+      for (uint_t j = 0; j < n; j++, i++) {
+        assert(x[j].data == sample[i].data && x[j].time < k_1);
+      }
+    }
+
+    assert(i == BLOCK_N || sample[i].time >= k_1);
+    bin_range_free(range);
+  }
+
+  // Multiple keys resolve as each would alone, repeats to any of their blocks
+  bin_key_t *key = malloc(sizeof(bin_key_t) * KEY_N);
+  int_t *index = malloc(sizeof(int_t) * KEY_N);
+
+  for (int clustered = 0; clustered <= 1; clustered++) {
+    for (uint_t s = 0; s < KEY_N; s++) {
+      key[s] = clustered ? t / 2 + rand() % (KEY_N * 4) : rand() % (t + 2) - 1;
+    }
+
+    qsort(key, KEY_N, sizeof(bin_key_t), compare);
+    assert(bin_fd_search_sorted(b, key, KEY_N, index) == 0);
+
+    for (uint_t s = 0; s < KEY_N; s++) {
+      int_t i = bin_fd_search(b, key[s]);
+
+      if (i < 0)
+        assert(index[s] == i);
+      else
+        assert(index[s] >= 0 && sample[index[s]].time == key[s]);
+    }
+  }
+
+  puts("range scans and multiple key searches match\n");
+
+  // A range of a quarter of the file
+  bin_key_t k_0 = sample[BLOCK_N / 4].time;
+  bin_key_t k_1 = sample[BLOCK_N / 4 + RANGE_N].time;
+  double sum[2] = {0, 0};
+
+  double t0 = now();
+
+  bin_range_t *range = bin_fd_range(b, k_0, k_1);
+  assert(range);
+  sample_t const *x;
+  uint_t n;
+
+  while ((n = bin_range_next(range, (void const **)&x)) > 0) {
+    for (uint_t j = 0; j < n; j++) {
+      sum[0] += x[j].data;
+    }
+  }
+
+  bin_range_free(range);
+  double range_time = now() - t0;
+
+  t0 = now();
+
+  uint_t start, end;
+  int error = bin_fd_lower_bound(b, k_0, &start) ||
+              bin_fd_lower_bound(b, k_1, &end);
+  assert(!error);
+
+  for (uint_t i = start; i < end; i++) {
+    sample_t y;
+    bin_fd_read(b, i, &y, 1);
+    sum[1] += y.data;
+  }
+
+  double block_time = now() - t0;
+  assert(sum[0] == sum[1]);
+
+  printf("%-22s %12s %12s %8s\n", "test", "time (ms)", "blocks read",
+         "speedup");
+  printf("%-22s %12.2f %12s %8s\n", "range, block at a time", block_time * 1e3,
+         "-", "-");
+  printf("%-22s %12.2f %12s %8.1f\n", "range, bin_fd_range", range_time * 1e3,
+         "-", block_time / range_time);
+
+  // Sorted keys, spread across the file and clustered
+  for (int clustered = 0; clustered <= 1; clustered++) {
+    char const *name = clustered ? "clustered" : "spread";
+
+    for (uint_t s = 0; s < KEY_N; s++) {
+      key[s] = clustered ? t / 2 + rand() % (KEY_N * 4) : rand() % t;
+    }
+
+    qsort(key, KEY_N, sizeof(bin_key_t), compare);
+
+    b->probe_n = 0;
+    t0 = now();
+
+    for (uint_t s = 0; s < KEY_N; s++) {
+      index[s] = bin_fd_search(b, key[s]);
+    }
+
+    double each_time = now() - t0;
+    uint_t each_n = b->probe_n;
+
+    b->probe_n = 0;
+    t0 = now();
+
+    bin_fd_search_sorted(b, key, KEY_N, index);
+
+    double sorted_time = now() - t0;
+
+    printf("%-12s %-9s %12.2f %12lu %8s\n", name, "each", each_time * 1e3,
+           (unsigned long)each_n, "-");
+    printf("%-12s %-9s %12.2f %12lu %8.1f\n", name, "sorted",
+           sorted_time * 1e3, (unsigned long)b->probe_n,
+           each_time / sorted_time);
+  }
+
+  bin_fd_close(b);
+  remove(PATH);
+
+  free(sample);
+  free(key);
+  free(index);
+}
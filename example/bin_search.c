@@ -0,0 +1,157 @@
+// bin_search.c - bin.h search mode benchmark
+//
+// Checks a learned index fit as blocks are appended against bisection, then
+// writes files of evenly spaced and of bursty keys, then searches each for
+// random keys, half of which are present, by bisection through bin_search()
+// and bin_fd_search(), by interpolation, and through learned indexes of two
+// error bounds, checking that every mode agrees. Reports the mean number of
+// blocks read per search, the time per search and the segments of each
+// model. Build with optimizations enabled for meaningful numbers, e.g.
+// CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define PATH "./bin_search.bin"
+
+#define TEST_N 10000
+#define BLOCK_N 4000000
+#define SEARCH_N 100000
+
+typedef struct {
+  bin_key_t time;
+  double data;
+} sample_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  srand(1);
+
+  char const *data[] = {"even", "bursty"};
+  char const *mode[] = {"bin_search", "bisect", "interpolate", "model e=8",
+                        "model e=64"};
+
+  // Appended a few blocks at a time, with repeated keys and uneven gaps
+  bin_t *b = bin_fd_init(PATH, sizeof(sample_t));
+  bin_t *plain = bin_fd_open(PATH, 0);
+  bin_fd_model(b, 4);
+
+  bin_key_t t = 0;
+
+  for (uint_t n = 0; n < TEST_N; n++) {
+    t += (rand() % 4 == 0) ? 0 : (rand() % 50 == 0) ? rand() % 1000 : 1;
+    bin_fd_append(b, &(sample_t){.time = t, .data = n}, 1);
+  }
+
+  assert(b->model->length == TEST_N);
+  bin_sync(b);
+  plain->meta.length = TEST_N;
+
+  for (bin_key_t k = -1; k <= t + 1; k++) {
+    int_t i = bin_fd_search(b, k);
+    int_t j = bin_fd_search(plain, k);
+    sample_t x;
+
+    // Repeated keys may be found at any of their blocks
+    if (j >= 0) {
+      assert(i >= 0 && bin_fd_read(plain, i, &x, 1) == 0 && x.time == k);
+    } else {
+      assert(i == j);
+    }
+  }
+
+  bin_fd_close(b);
+  bin_fd_close(plain);
+
+  puts("learned index searches match bisection\n");
+
+  sample_t *sample = malloc(sizeof(sample_t) * BLOCK_N);
+  bin_key_t *key = malloc(sizeof(bin_key_t) * SEARCH_N);
+  int_t *expected = malloc(sizeof(int_t) * SEARCH_N);
+
+  printf("%-7s %-12s %10s %12s %10s\n", "data", "mode", "probes", "time (ns)",
+         "segments");
+
+  for (int d = 0; d < 2; d++) {
+    t = 0;
+
+    // Timestamps a second apart with jitter, or in bursts with long gaps
+    for (uint_t i = 0; i < BLOCK_N; i++) {
+      if (d == 0)
+        t = 1000 * (bin_key_t)i + rand() % 100;
+      else
+        t += (rand() % 100 == 0) ? 1 + rand() % 1000000 : 1;
+
+      sample[i] = (sample_t){.time = t, .data = i};
+    }
+
+    for (uint_t s = 0; s < SEARCH_N; s++) {
+      key[s] = (rand() % 2) ? sample[rand() % BLOCK_N].time : rand() % t;
+    }
+
+    b = bin_fd_init(PATH, sizeof(sample_t));
+    bin_fd_append(b, sample, BLOCK_N);
+    bin_fd_close(b);
+
+    for (int m = 0; m < 5; m++) {
+      FILE *f = bin_open(PATH);
+      b = bin_fd_open(PATH, 0);
+
+      if (m >= 3) {
+        bin_fd_model(b, (m == 3) ? 8 : 64);
+        bin_fd_search(b, 0);
+      }
+
+      b->probe_n = 0;
+      double t0 = now();
+
+      for (uint_t s = 0; s < SEARCH_N; s++) {
+        int_t i = (m == 0)   ? bin_search(f, key[s])
+                  : (m == 2) ? bin_fd_search_interpolate(b, key[s])
+                             : bin_fd_search(b, key[s]);
+
+        if (m == 0)
+          expected[s] = i;
+        else
+          assert(i == expected[s]);
+      }
+
+      double time = (now() - t0) / SEARCH_N;
+
+      if (m == 0) {
+        printf("%-7s %-12s %10s %12.1f %10s\n", data[d], mode[m], "-",
+               time * 1e9, "-");
+      } else if (m < 3) {
+        printf("%-7s %-12s %10.2f %12.1f %10s\n", data[d], mode[m],
+               (double)b->probe_n / SEARCH_N, time * 1e9, "-");
+      } else {
+        printf("%-7s %-12s %10.2f %12.1f %10lu\n", data[d], mode[m],
+               (double)b->probe_n / SEARCH_N, time * 1e9,
+               (unsigned long)b->model->segment_n);
+      }
+
+      bin_close(f);
+      bin_fd_close(b);
+    }
+  }
+
+  remove(PATH);
+
+  free(sample);
+  free(key);
+  free(expected);
+}
@@ -0,0 +1,178 @@
+// bin_seg.c - Compressed segment benchmark
+//
+// Writes a bin.h file of ticks, converts it to a compressed segment and checks
+// that every block, and a random selection of partial reads and searches,
+// match the original. Reports the size of each file, and the time of reading
+// every block, of reading single blocks at random, and of searching for random
+// keys in each. Build with optimizations enabled for meaningful numbers, e.g.
+// CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define BIN_SEG_IMPLEMENTATION
+#include "../include/bin_seg.h"
+
+#define BIN_PATH "./bin_seg.bin"
+#define SEG_PATH "./bin_seg.seg"
+
+#define TICK_N 4000000
+#define READ_N 1000
+#define SEARCH_N 100000
+
+typedef struct {
+  bin_key_t time;
+  double price;
+  double volume;
+  int32_t flags;
+} tick_t;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  srand(1);
+
+  // A tick a second, occasionally late, with the price moving by cents and
+  // whole volumes
+  tick_t *tick = calloc(TICK_N, sizeof(tick_t));
+  bin_key_t t = 1700000000000;
+  double cents = 10000;
+
+  for (uint_t i = 0; i < TICK_N; i++) {
+    t += (rand() % 10 == 0) ? 1000 + rand() % 50 : 1000;
+    cents += rand() % 5 - 2;
+
+    tick[i].time = t;
+    tick[i].price = cents / 100;
+    tick[i].volume = 1 + rand() % 100;
+    tick[i].flags = (rand() % 100 == 0);
+  }
+
+  bin_t *b = bin_fd_init(BIN_PATH, sizeof(tick_t));
+  bin_fd_append(b, tick, TICK_N);
+  bin_fd_close(b);
+
+  double t0 = now();
+  assert(bin_seg_convert(BIN_PATH, SEG_PATH, 0) == 0);
+  double convert_time = now() - t0;
+
+  // Every block, partial reads across chunks, and searches match
+  bin_seg_t *s = bin_seg_open(SEG_PATH);
+  tick_t *x = malloc(sizeof(tick_t) * TICK_N);
+
+  assert(bin_seg_length(s) == TICK_N);
+  assert(bin_seg_read(s, 0, x, TICK_N) == 0);
+  assert(memcmp(x, tick, sizeof(tick_t) * TICK_N) == 0);
+
+  for (uint_t r = 0; r < READ_N; r++) {
+    uint_t n = 1 + rand() % 3000;
+    uint_t i = rand() % (TICK_N - n);
+
+    assert(bin_seg_read(s, i, x, n) == 0);
+    assert(memcmp(x, tick + i, sizeof(tick_t) * n) == 0);
+  }
+
+  b = bin_fd_open(BIN_PATH, 0);
+  bin_key_t *key = malloc(sizeof(bin_key_t) * SEARCH_N);
+
+  for (uint_t r = 0; r < SEARCH_N; r++) {
+    key[r] = tick[0].time - 10 + rand() % (t - tick[0].time + 20);
+
+    if (r % 2)
+      key[r] = tick[rand() % TICK_N].time;
+
+    assert(bin_seg_search(s, key[r]) == bin_fd_search(b, key[r]));
+  }
+
+  puts("segment matches the bin.h file\n");
+
+  FILE *f = fopen(BIN_PATH, "rb");
+  fseek(f, 0, SEEK_END);
+  double bin_size = ftell(f);
+  fclose(f);
+
+  f = fopen(SEG_PATH, "rb");
+  fseek(f, 0, SEEK_END);
+  double seg_size = ftell(f);
+  fclose(f);
+
+  printf("bin.h %.1f MB, segment %.1f MB, %.1fx smaller, converted in %.0f "
+         "ms\n\n",
+         bin_size / 1e6, seg_size / 1e6, bin_size / seg_size,
+         convert_time * 1e3);
+
+  // Reading every block
+  t0 = now();
+  bin_fd_read(b, 0, x, TICK_N);
+  double bin_time = now() - t0;
+
+  t0 = now();
+  bin_seg_read(s, 0, x, TICK_N);
+  double seg_time = now() - t0;
+
+  printf("%-8s %14s %14s\n", "test", "bin.h", "segment");
+  printf("%-8s %11.0f MB/s %11.0f MB/s\n", "read", bin_size / bin_time / 1e6,
+         bin_size / seg_time / 1e6);
+
+  // Reading single blocks at random, with the keys as random positions
+  t0 = now();
+
+  for (uint_t r = 0; r < SEARCH_N; r++) {
+    bin_fd_read(b, (uint_t)key[r] % TICK_N, x, 1);
+  }
+
+  bin_time = (now() - t0) / SEARCH_N;
+  t0 = now();
+
+  for (uint_t r = 0; r < SEARCH_N; r++) {
+    bin_seg_read(s, (uint_t)key[r] % TICK_N, x, 1);
+  }
+
+  seg_time = (now() - t0) / SEARCH_N;
+
+  printf("%-8s %11.1f ns %11.1f ns\n", "block", bin_time * 1e9,
+         seg_time * 1e9);
+
+  // Searching for random keys
+  t0 = now();
+
+  for (uint_t r = 0; r < SEARCH_N; r++) {
+    bin_fd_search(b, key[r]);
+  }
+
+  bin_time = (now() - t0) / SEARCH_N;
+  t0 = now();
+
+  for (uint_t r = 0; r < SEARCH_N; r++) {
+    bin_seg_search(s, key[r]);
+  }
+
+  seg_time = (now() - t0) / SEARCH_N;
+
+  printf("%-8s %11.1f ns %11.1f ns\n", "search", bin_time * 1e9,
+         seg_time * 1e9);
+
+  bin_fd_close(b);
+  bin_seg_close(s);
+  remove(BIN_PATH);
+  remove(SEG_PATH);
+
+  free(tick);
+  free(x);
+  free(key);
+}
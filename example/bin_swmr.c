@@ -0,0 +1,175 @@
+// bin_swmr.c - Single writer, multiple reader bin.h benchmark
+//
+// A writer process appends blocks one at a time while reader processes tail
+// the file, checking every block as it appears. The processes are first
+// serialized with a file lock, the writer updating the header after every
+// append and the readers reading it back, and then share the file without
+// locking through bin_fd_share(). Reports the time per append of the writer
+// and until every reader has read every block. Build with optimizations
+// enabled for meaningful numbers, e.g. CFLAGS=-O2 ./build
+
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+
+typedef int64_t bin_key_t;
+
+#define BIN_IMPLEMENTATION
+#include "../include/bin.h"
+
+#define APPEND_N 500000
+#define READER_N 2
+#define CHUNK_N 4096
+
+typedef struct {
+  bin_key_t time;
+  double data;
+} sample_t;
+
+static char const *path = "./bin_swmr.bin";
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Append APPEND_N blocks one at a time, returning the seconds taken
+static double writer(int shared) {
+  bin_t *b = bin_fd_open(path, 1);
+
+  if (shared)
+    assert(bin_fd_share(b, 0) == 0);
+
+  double t0 = now();
+
+  for (bin_key_t i = 0; i < APPEND_N; i++) {
+    sample_t x = {.time = i, .data = 2.0 * i};
+
+    if (shared) {
+      assert(bin_fd_append(b, &x, 1) == 0);
+      continue;
+    }
+
+    flock(b->fd, LOCK_EX);
+    assert(bin_fd_append(b, &x, 1) == 0);
+    assert(bin_sync(b) == 0);
+    flock(b->fd, LOCK_UN);
+  }
+
+  double t = now() - t0;
+
+  // Blocks of a shared file are never moved or overwritten
+  if (shared) {
+    sample_t x = {.time = 0, .data = 0};
+
+    assert(bin_fd_write(b, 0, &x, 1) == -1);
+    assert(bin_fd_insert(b, 0, &x, 1) == -1);
+    assert(bin_fd_merge(b, &x, 1) == -1);
+  }
+
+  bin_fd_close(b);
+
+  return t;
+}
+
+// Read every block as it appears, checking each
+static void reader(int shared) {
+  bin_t *b = bin_fd_open(path, 0);
+  sample_t *x = malloc(sizeof(sample_t) * CHUNK_N);
+  uint_t seen = 0;
+
+  if (shared)
+    assert(bin_fd_share(b, 0) == 0);
+
+  while (seen < APPEND_N) {
+    if (!shared) {
+      flock(b->fd, LOCK_SH);
+      pread(b->fd, &b->meta, sizeof(bin_meta_t), 0);
+    }
+
+    uint_t l = shared ? bin_fd_refresh(b) : bin_fd_length(b);
+    uint_t n = (l - seen < CHUNK_N) ? l - seen : CHUNK_N;
+
+    if (n > 0)
+      assert(bin_fd_read(b, seen, x, n) == 0);
+
+    if (!shared)
+      flock(b->fd, LOCK_UN);
+
+    if (n == 0) {
+      sched_yield();
+      continue;
+    }
+
+    for (uint_t i = 0; i < n; i++) {
+      assert(x[i].time == (bin_key_t)(seen + i));
+      assert(x[i].data == 2.0 * (seen + i));
+    }
+
+    seen += n;
+  }
+
+  free(x);
+  bin_fd_close(b);
+}
+
+// Run the writer and the readers each in a process, returning the seconds
+// per append of the writer and until every block has been read
+static void run(int shared, double *write_time, double *total_time) {
+  double *t = mmap(NULL, sizeof(double), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+  bin_fd_close(bin_fd_init(path, sizeof(sample_t)));
+
+  double t0 = now();
+
+  for (int p = 0; p <= READER_N; p++) {
+    if (fork() != 0)
+      continue;
+
+    if (p == 0)
+      *t = writer(shared);
+    else
+      reader(shared);
+
+    exit(0);
+  }
+
+  int status;
+
+  for (int p = 0; p <= READER_N; p++) {
+    wait(&status);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  *write_time = *t / APPEND_N;
+  *total_time = (now() - t0) / APPEND_N;
+
+  munmap(t, sizeof(double));
+}
+
+int main(void) {
+  double write_time[2], total_time[2];
+
+  for (int shared = 0; shared < 2; shared++) {
+    run(shared, write_time + shared, total_time + shared);
+  }
+
+  printf("%d readers tailing %d appends\n\n", READER_N, APPEND_N);
+  printf("%-8s %14s %14s %8s\n", "test", "locked (ns)", "shared (ns)",
+         "speedup");
+  printf("%-8s %14.1f %14.1f %8.1f\n", "append", write_time[0] * 1e9,
+         write_time[1] * 1e9, write_time[0] / write_time[1]);
+  printf("%-8s %14.1f %14.1f %8.1f\n", "tail", total_time[0] * 1e9,
+         total_time[1] * 1e9, total_time[0] / total_time[1]);
+
+  remove(path);
+}
@@ -1,14 +1,15 @@
 // ann.h - Artificial Neural Nework Libray
-
-#ifndef ANN_H
-#define ANN_H
+//
+// The network is built from ann_fp_t, which is fp_t by default. The single
+// precision and mixed precision variants are declared by ann_f32.h and
+// ann_mixed.h, which include this file with the ann_ prefix renamed, so that
+// every variant may be used within a single program.
 
 #include <stdint.h>
 #include "./type.h"
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+#ifndef ANN_COMMON_H
+#define ANN_COMMON_H
 
 typedef enum {
   IDENTITY,
@@ -18,8 +19,104 @@ typedef enum {
   ELU,
   LRELU,
   TANH,
+  GELU,
+  SOFTMAX,
 } ann_activation_t;
 
+typedef enum {
+  EXACT,
+  APPROXIMATE,
+  FAST,
+} ann_accuracy_t;
+
+typedef enum {
+  SGD,
+  MOMENTUM,
+  NESTEROV,
+  RMSPROP,
+  ADAM,
+} ann_optimizer_t;
+
+typedef enum {
+  ROW_MAJOR,
+  TRANSPOSED,
+} ann_layout_t;
+
+typedef enum {
+  SCALAR,
+  SSE2,
+  AVX2,
+  AVX512,
+} ann_simd_t;
+
+// The parameters of the activation functions, which ann_compile.h also emits
+#define SQUARE_ROOT_2_OVER_PI 0.7978845608028653558798921198687
+
+#define ELU_ALPHA 0.2
+#define LRELU_ALPHA 0.2
+#define GELU_BETA 0.044715
+
+#endif // ANN_COMMON_H
+
+#ifndef ANN_PREFIX
+#ifndef ANN_H
+#define ANN_H
+#define ANN_DECLARATION
+#endif
+#endif
+
+#ifdef ANN_DECLARATION
+#undef ANN_DECLARATION
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ann_fp_t
+//
+// The type of the weights, neurons and deltas
+
+// ann_acc_t
+//
+// The type used to accumulate dot products and gradients, which may be wider
+// than ann_fp_t
+
+#ifdef ANN_PREFIX
+typedef ANN_FP ann_fp_t;
+typedef ANN_ACC ann_acc_t;
+#else
+typedef fp_t ann_fp_t;
+typedef fp_t ann_acc_t;
+#endif
+
+// ann_kernel_t
+//
+// The dense layer kernels, selected for the instruction set of the processor
+//
+// dot - Returns the dot product of x and w, each of length n
+// dot4 - Stores in y[s] the dot product of w and x + s * stride, for s < 4,
+//        each summed as by dot, loading each element of w once for all four
+// axpy - Performs y += a * x, for vectors of length n
+// delta - Performs y[j] = sum( x[q] * w[q * stride + j] ) for j < n and q < m,
+//         accumulating a column of weights without striding through memory
+// gradient - Performs g += a * x, accumulating into a gradient of length n
+// update - Performs y += a * g, applying a gradient of length n
+// activation - The layer activation functions built on an approximation of
+//              e^x, indexed by [accuracy - 1][activation], or NULL where the
+//              activation is only available at EXACT accuracy
+
+typedef struct {
+  ann_acc_t (*dot)(ann_fp_t const *, ann_fp_t const *, uint_t);
+  void (*dot4)(ann_acc_t *, ann_fp_t const *, ann_fp_t const *, uint_t,
+               uint_t);
+  void (*axpy)(ann_fp_t *, ann_acc_t, ann_fp_t const *, uint_t);
+  void (*delta)(ann_fp_t *, ann_fp_t const *, uint_t, ann_fp_t const *, uint_t,
+                uint_t);
+  void (*gradient)(ann_acc_t *, ann_acc_t, ann_fp_t const *, uint_t);
+  void (*update)(ann_fp_t *, ann_acc_t, ann_acc_t const *, uint_t);
+  void (*activation[2][SOFTMAX + 1])(ann_fp_t *, uint_t);
+} ann_kernel_t;
+
 typedef struct {
   // The full size of the allocated structure
   uint_t n;
@@ -37,54 +134,189 @@ typedef struct {
   uint_t *layer_neuron_n;
 
   // The pointer to the neurons
-  fp_t *neuron;
+  ann_fp_t *neuron;
 
   // The weights and biases for each neuron
   //   - w_lji denotes the connection between the jth neuron in layer l, and
   //     the ith neuron in the previous layer
   //   - b_lj denotes the bias for the jth neuron in layer l
   // { w_000, w_001, w_002, .... , b_00, ...., w_ijk, b_ij }`
-  fp_t *weight;
+  ann_fp_t *weight;
+
+  // The state of the optimizer, held in the allocation directly after weight[]
+  //   - MOMENTUM and NESTEROV hold the velocity of each weight, and RMSPROP the
+  //     moving average of its squared gradient
+  //   - ADAM holds the first moment of each weight, followed by the second
+  //   - Each vector is stored in the same order as weight[]
+  ann_fp_t *state;
 
   // The delta between between the actual and the cost function
-  fp_t *delta;
+  ann_fp_t *delta;
+
+  // The sums of the neurons before their activation, stored as in delta
+  ann_fp_t *sum;
+
+  // The arrangement of the weights used by the hidden delta calculation
+  ann_layout_t layout;
+
+  // A transposed copy of the weights for each layer after the first, used in
+  // place of column-wise reads of weight[] when layout is TRANSPOSED
+  //   - Each layer is stored as [layer_neuron_n[l - 1]][layer_neuron_n[l]],
+  //     without the biases
+  //   - The copy is followed by a row of scratch, as wide as the widest layer
+  ann_fp_t *transpose;
 
   // The activation function used in the hidden layer neurons
-  fp_t (*activation_hidden)(fp_t);
+  ann_fp_t (*activation_hidden)(ann_fp_t);
 
   // The partial derivative of the activation function used in the hidden
-  // layer neurons
-  fp_t (*activation_hidden_partial)(fp_t);
+  // layer neurons, a function of the output, or of the sum for GELU
+  ann_fp_t (*activation_hidden_partial)(ann_fp_t);
 
   // The activation function used in the ouput neurons
-  fp_t (*activation_output)(fp_t);
+  ann_fp_t (*activation_output)(ann_fp_t);
 
   // The partial derivative of the activation function used in the output
-  // layer neurons
-  fp_t (*activation_output_partial)(fp_t);
+  // layer neurons, a function of the output, or of the sum for GELU
+  ann_fp_t (*activation_output_partial)(ann_fp_t);
+
+  // The activation functions and their partial derivatives, applied to every
+  // neuron of a layer at once
+  //   - activation(y, n) replaces each y[j] with f(y[j])
+  //   - partial(d, y, x, n) multiplies each d[j] by f'(x[j]), given the
+  //     outputs y and the sums x before activation
+  void (*activation_hidden_layer)(ann_fp_t *, uint_t);
+  void (*activation_hidden_layer_partial)(ann_fp_t *, ann_fp_t const *,
+                                          ann_fp_t const *, uint_t);
+  void (*activation_output_layer)(ann_fp_t *, uint_t);
+  void (*activation_output_layer_partial)(ann_fp_t *, ann_fp_t const *,
+                                          ann_fp_t const *, uint_t);
+
+  // The activation functions, as set by ann_set_activation()
+  ann_activation_t activation_hidden_id;
+  ann_activation_t activation_output_id;
+
+  // The accuracy of the layer activation functions, see ann_set_accuracy()
+  ann_accuracy_t accuracy;
+
+  // The optimizer applying the gradients, see ann_set_optimizer()
+  ann_optimizer_t optimizer;
+
+  // The hyperparameters of the optimizer, which may be changed between steps
+  //   - beta1 - The decay of the velocity, or of ADAM's first moment
+  //   - beta2 - The decay of the second moment
+  //   - epsilon - Keeps the update finite where the second moment is zero
+  ann_fp_t beta1;
+  ann_fp_t beta2;
+  ann_fp_t epsilon;
+
+  // The number of optimizer steps taken, and ADAM's bias corrections for the
+  // current step, 1 - beta1^step and 1 - beta2^step
+  uint_t step;
+  ann_acc_t correction1;
+  ann_acc_t correction2;
+
+  // The dense layer kernels used for propagation
+  ann_kernel_t const *kernel;
+
+  // The read-only mapping of the model file holding the weights, when loaded
+  // by ann_load_mmap(), in which case weight[] is not part of the allocation
+  void *map;
+  uint_t map_n;
 } ann_t;
 
+typedef struct {
+  // The full size of the allocated structure
+  uint_t n;
+
+  // The maximum number of samples in a single batch
+  uint_t batch_n;
+
+  // The neurons for every sample, stored layer by layer
+  //   - Each layer is a [batch_n][layer_neuron_n[l]] block
+  ann_fp_t *neuron;
+
+  // The deltas for every sample, stored in the same order as the neurons
+  ann_fp_t *delta;
+
+  // The sums before activation for every sample, stored as the deltas
+  ann_fp_t *sum;
+
+  // The accumulated gradient, stored in the same order as ann_t.weight
+  ann_acc_t *gradient;
+} ann_batch_t;
+
+typedef struct {
+  // The full size of the allocated structure
+  uint_t n;
+
+  // The neurons of a single sample, stored as in ann_t.neuron
+  ann_fp_t *neuron;
+
+  // The deltas of a single sample, stored as in ann_t.delta
+  ann_fp_t *delta;
+
+  // The sums before activation of a single sample, stored as in ann_t.sum
+  ann_fp_t *sum;
+} ann_context_t;
+
 ann_t *ann_init(uint_t, uint_t *);
 ann_t *ann_copy(ann_t const *);
 void ann_free(ann_t *);
 void ann_random(ann_t *);
 
-void ann_propagation_forward(ann_t *, fp_t const *const, fp_t *);
-void ann_propagation_backward(ann_t *, fp_t const *, fp_t *, fp_t const *,
-                              fp_t);
-void ann_train_numeric(ann_t *, fp_t const *, fp_t const *, fp_t);
-
-fp_t ann_error_total(fp_t const *, fp_t const *, uint_t);
+int ann_save(ann_t const *, char const *);
+ann_t *ann_load(char const *);
+ann_t *ann_load_mmap(char const *);
+
+void ann_propagation_forward(ann_t *, ann_fp_t const *const, ann_fp_t *);
+void ann_propagation_backward(ann_t *, ann_fp_t const *, ann_fp_t *,
+                              ann_fp_t const *, ann_fp_t);
+void ann_train_numeric(ann_t *, ann_fp_t const *, ann_fp_t const *, ann_fp_t);
+void ann_gradient_numeric(ann_t *, ann_fp_t const *, ann_fp_t const *,
+                          ann_acc_t *);
+
+ann_context_t *ann_context_init(ann_t const *);
+void ann_context_free(ann_context_t *);
+
+void ann_propagation_forward_context(ann_t const *, ann_context_t *,
+                                     ann_fp_t const *, ann_fp_t *);
+void ann_propagation_backward_context(ann_t *, ann_context_t *,
+                                      ann_fp_t const *, ann_fp_t const *,
+                                      ann_fp_t const *, ann_fp_t);
+
+ann_batch_t *ann_batch_init(ann_t const *, uint_t);
+void ann_batch_free(ann_batch_t *);
+
+void ann_propagation_forward_batch(ann_t const *, ann_batch_t *,
+                                   ann_fp_t const *, uint_t, ann_fp_t *);
+void ann_propagation_backward_batch(ann_t *, ann_batch_t *, ann_fp_t const *,
+                                    ann_fp_t const *, ann_fp_t const *, uint_t,
+                                    ann_fp_t);
+void ann_gradient_batch(ann_t const *, ann_batch_t *, ann_fp_t const *,
+                        ann_fp_t const *, ann_fp_t const *, uint_t);
+void ann_gradient_apply(ann_t *, ann_acc_t const *, ann_fp_t);
+void ann_gradient_apply_range(ann_t *, ann_acc_t const *, uint_t, uint_t,
+                              ann_fp_t);
+
+ann_fp_t ann_error_total(ann_fp_t const *, ann_fp_t const *, uint_t);
 void ann_set_activation(ann_t *, ann_activation_t, ann_activation_t);
+void ann_set_accuracy(ann_t *, ann_accuracy_t);
+void ann_set_simd(ann_t *, ann_simd_t);
+ann_t *ann_set_layout(ann_t *, ann_layout_t);
+void ann_layout_sync(ann_t *);
+ann_t *ann_set_optimizer(ann_t *, ann_optimizer_t);
+void ann_optimizer_step(ann_t *);
+ann_simd_t ann_simd_detect(void);
 
 void ann_print_weight(ann_t *);
-void ann_print_neuron(ann_t *, fp_t const *const, fp_t const *const);
+void ann_print_neuron(ann_t *, ann_fp_t const *const, ann_fp_t const *const);
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif // ANN_H
+#endif // ANN_DECLARATION
 
 ////////////////////////////////////////////////////////////////////////////////
 // IMPELEMENTATION SECTION
@@ -98,37 +330,122 @@ void ann_print_neuron(ann_t *, fp_t const *const, fp_t const *const);
 #include <string.h>
 #include <tgmath.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ANN_MMAP
+#endif
+
 #define PRINT_PRECISION 10
 
 #define SQUARE_ROOT_2 1.4142135623730950488016887242096
 #define PI 3.1415926535897932384626433832795
 #define SQUARE_ROOT_PI 1.7724538509055160272981674833411
-#define SQUARE_ROOT_2_OVER_PI 0.7978845608028653558798921198687
 
-#define ELU_ALPHA 0.2
-#define LRELU_ALPHA 0.2
+// Tile size for the batched propagation. A block of samples shares each
+// weight row while it is hot in cache.
+#define ANN_BLOCK_SAMPLE 8
+
+// Tile size for maintaining the transposed weights
+#define ANN_BLOCK_TRANSPOSE 32
+
+// The perturbation of each weight by the numeric gradient, near the cube root
+// of the machine epsilon, which balances truncation against rounding error
+#define ANN_NUMERIC_STEP ((sizeof(ann_fp_t) == 8) ? 1e-5 : 1e-2)
+
+// The model file format, see ann_file_t
+#define ANN_FILE_MAGIC 0x004e4e41 // "ANN\0"
+#define ANN_FILE_VERSION 1
+#define ANN_FILE_ALIGN 64
+
+// ann_file_t
+//
+// The header of a model file, which is followed by layer_neuron_n[] as
+// uint64_t, then by weight[] at the next multiple of ANN_FILE_ALIGN bytes, so
+// that a mapped file may be used in place. Values are stored in the byte order
+// of the machine which saved the file.
 
-static fp_t ann_random_range(fp_t, fp_t);
-
-static fp_t ann_error(fp_t, fp_t);
-static fp_t ann_error_partial(fp_t, fp_t);
-
-static fp_t ann_activation_identity(fp_t);
-static fp_t ann_activation_identity_partial(fp_t);
-static fp_t ann_activation_binary(fp_t);
-static fp_t ann_activation_binary_partial(fp_t);
-static fp_t ann_activation_sigmoid(fp_t);
-static fp_t ann_activation_sigmoid_partial(fp_t);
-static fp_t ann_activation_relu(fp_t);
-static fp_t ann_activation_relu_partial(fp_t);
-static fp_t ann_activation_elu(fp_t);
-static fp_t ann_activation_elu_partial(fp_t);
-static fp_t ann_activation_lrelu(fp_t);
-static fp_t ann_activation_lrelu_partial(fp_t);
-static fp_t ann_activation_tanh(fp_t);
-static fp_t ann_activation_tanh_partial(fp_t);
-
-static fp_t (*ACTIVATION[][2])(fp_t) = {
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+
+  // sizeof(ann_fp_t), so that a model isn't loaded at the wrong precision
+  uint32_t fp_size;
+
+  uint32_t activation_hidden;
+  uint32_t activation_output;
+  uint32_t reserved;
+
+  uint64_t layer_n;
+  uint64_t neuron_n;
+  uint64_t weight_n;
+} ann_file_t;
+
+static void ann_rebase(ann_t *);
+static uint_t ann_file_offset(uint_t);
+static int ann_file_check(ann_file_t const *, uint64_t const *, uint_t);
+static uint_t ann_transpose_n(ann_t const *);
+static uint_t ann_transpose_size(ann_t const *);
+static uint_t ann_optimizer_state_n(ann_optimizer_t);
+static void ann_optimize_row(ann_t *, ann_fp_t *, ann_fp_t, ann_fp_t const *,
+                             uint_t, ann_fp_t);
+static void ann_backward_update(ann_t *, ann_fp_t const *, ann_fp_t const *,
+                                ann_fp_t const *, uint_t, ann_fp_t);
+static void ann_delta_batch(ann_t const *, ann_batch_t *, ann_fp_t const *,
+                            ann_fp_t const *, uint_t);
+static void ann_forward(ann_t const *, ann_fp_t *, ann_fp_t *,
+                        ann_fp_t const *, ann_fp_t *);
+static void ann_backward(ann_t *, ann_fp_t const *, ann_fp_t const *,
+                         ann_fp_t *, ann_fp_t const *, ann_fp_t const *,
+                         ann_fp_t const *, ann_fp_t);
+static ann_fp_t ann_random_range(ann_fp_t, ann_fp_t);
+
+static void ann_layer_forward_batch(ann_kernel_t const *, ann_fp_t const *,
+                                    ann_fp_t const *, ann_fp_t *, ann_fp_t *,
+                                    uint_t, uint_t, uint_t,
+                                    void (*)(ann_fp_t *, uint_t));
+static void ann_layer_delta_batch(ann_kernel_t const *, ann_fp_t const *,
+                                  ann_fp_t const *, ann_fp_t const *,
+                                  ann_fp_t const *, ann_fp_t const *,
+                                  ann_fp_t *, uint_t, uint_t, uint_t,
+                                  void (*)(ann_fp_t *, ann_fp_t const *,
+                                           ann_fp_t const *, uint_t));
+static void ann_layer_gradient_batch(ann_kernel_t const *, ann_fp_t const *,
+                                     ann_fp_t const *, ann_acc_t *, uint_t,
+                                     uint_t, uint_t);
+
+static ann_fp_t ann_error(ann_fp_t, ann_fp_t);
+static ann_fp_t ann_error_partial(ann_fp_t, ann_fp_t);
+static ann_acc_t ann_loss(ann_t const *, ann_fp_t const *, ann_fp_t const *);
+
+static ann_fp_t ann_activation_identity(ann_fp_t);
+static ann_fp_t ann_activation_identity_partial(ann_fp_t);
+static ann_fp_t ann_activation_binary(ann_fp_t);
+static ann_fp_t ann_activation_binary_partial(ann_fp_t);
+static ann_fp_t ann_activation_sigmoid(ann_fp_t);
+static ann_fp_t ann_activation_sigmoid_partial(ann_fp_t);
+static ann_fp_t ann_activation_relu(ann_fp_t);
+static ann_fp_t ann_activation_relu_partial(ann_fp_t);
+static ann_fp_t ann_activation_elu(ann_fp_t);
+static ann_fp_t ann_activation_elu_partial(ann_fp_t);
+static ann_fp_t ann_activation_lrelu(ann_fp_t);
+static ann_fp_t ann_activation_lrelu_partial(ann_fp_t);
+static ann_fp_t ann_activation_tanh(ann_fp_t);
+static ann_fp_t ann_activation_tanh_partial(ann_fp_t);
+static ann_fp_t ann_activation_gelu(ann_fp_t);
+static ann_fp_t ann_activation_gelu_partial(ann_fp_t);
+static void ann_activation_softmax_layer(ann_fp_t *, uint_t);
+static void ann_activation_resolve(ann_t *);
+
+// SOFTMAX normalizes the whole layer, so it has no per-neuron function, and is
+// treated as IDENTITY by code which evaluates a single neuron. Its partial
+// derivative is taken as 1, which paired with ann_error_partial() gives the
+// exact gradient of the cross-entropy error of a softmax output, so SOFTMAX
+// may only be the output activation.
+
+static ann_fp_t (*ACTIVATION[][2])(ann_fp_t) = {
     {ann_activation_identity, ann_activation_identity_partial}, // IDENTITY
     {ann_activation_binary, ann_activation_binary_partial},     // BINARY
     {ann_activation_sigmoid, ann_activation_sigmoid_partial},   // SIGMOID
@@ -136,8 +453,511 @@ static fp_t (*ACTIVATION[][2])(fp_t) = {
     {ann_activation_elu, ann_activation_elu_partial},           // ELU
     {ann_activation_lrelu, ann_activation_lrelu_partial},       // LRELU
     {ann_activation_tanh, ann_activation_tanh_partial},         // TANH
+    {ann_activation_gelu, ann_activation_gelu_partial},         // GELU
+    {ann_activation_identity, ann_activation_identity_partial}, // SOFTMAX
+};
+
+// ANN_ACTIVATION_LAYER()
+//
+// Define the EXACT layer activation function and partial derivative for an
+// activation, applying its per-neuron functions to every neuron of the layer
+//
+// name - The name of the per-neuron functions, e.g. sigmoid
+// at - The argument of the per-neuron partial derivative, y for the outputs
+//      or x for the sums before activation
+
+#define ANN_ACTIVATION_LAYER(name, at)                                         \
+  static void ann_activation_##name##_layer(ann_fp_t *y, uint_t n) {           \
+    for (uint_t i = 0; i < n; i++) {                                           \
+      y[i] = ann_activation_##name(y[i]);                                      \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static void ann_activation_##name##_layer_partial(                           \
+      ann_fp_t *d, ann_fp_t const *y, ann_fp_t const *x, uint_t n) {           \
+    (void)y;                                                                   \
+    (void)x;                                                                   \
+                                                                               \
+    for (uint_t i = 0; i < n; i++) {                                           \
+      d[i] *= ann_activation_##name##_partial(at[i]);                          \
+    }                                                                          \
+  }
+
+ANN_ACTIVATION_LAYER(identity, y)
+ANN_ACTIVATION_LAYER(binary, y)
+ANN_ACTIVATION_LAYER(sigmoid, y)
+ANN_ACTIVATION_LAYER(relu, y)
+ANN_ACTIVATION_LAYER(elu, y)
+ANN_ACTIVATION_LAYER(lrelu, y)
+ANN_ACTIVATION_LAYER(tanh, y)
+ANN_ACTIVATION_LAYER(gelu, x)
+
+static void (*ACTIVATION_LAYER[])(ann_fp_t *, uint_t) = {
+    ann_activation_identity_layer, // IDENTITY
+    ann_activation_binary_layer,   // BINARY
+    ann_activation_sigmoid_layer,  // SIGMOID
+    ann_activation_relu_layer,     // RELU
+    ann_activation_elu_layer,      // ELU
+    ann_activation_lrelu_layer,    // LRELU
+    ann_activation_tanh_layer,     // TANH
+    ann_activation_gelu_layer,     // GELU
+    ann_activation_softmax_layer,  // SOFTMAX
+};
+
+static void (*ACTIVATION_LAYER_PARTIAL[])(ann_fp_t *, ann_fp_t const *,
+                                          ann_fp_t const *, uint_t) = {
+    ann_activation_identity_layer_partial, // IDENTITY
+    ann_activation_binary_layer_partial,   // BINARY
+    ann_activation_sigmoid_layer_partial,  // SIGMOID
+    ann_activation_relu_layer_partial,     // RELU
+    ann_activation_elu_layer_partial,      // ELU
+    ann_activation_lrelu_layer_partial,    // LRELU
+    ann_activation_tanh_layer_partial,     // TANH
+    ann_activation_gelu_layer_partial,     // GELU
+    ann_activation_identity_layer_partial, // SOFTMAX
+};
+
+static ann_acc_t ann_dot_scalar(ann_fp_t const *, ann_fp_t const *, uint_t);
+static void ann_dot4_scalar(ann_acc_t *, ann_fp_t const *, ann_fp_t const *,
+                            uint_t, uint_t);
+static void ann_axpy_scalar(ann_fp_t *, ann_acc_t, ann_fp_t const *, uint_t);
+static void ann_delta_scalar(ann_fp_t *, ann_fp_t const *, uint_t,
+                             ann_fp_t const *, uint_t, uint_t);
+static void ann_gradient_scalar(ann_acc_t *, ann_acc_t, ann_fp_t const *,
+                                uint_t);
+static void ann_update_scalar(ann_fp_t *, ann_acc_t, ann_acc_t const *, uint_t);
+
+static ann_kernel_t const ann_kernel_scalar = {
+    ann_dot_scalar,    ann_dot4_scalar,     ann_axpy_scalar,
+    ann_delta_scalar,  ann_gradient_scalar, ann_update_scalar,
+    {{NULL}},
 };
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ANN_SIMD_X86
+#endif
+
+#ifdef ANN_SIMD_X86
+
+// ANN_VECTOR()
+//
+// Declare the vector types used within a kernel, v_t holding v_n elements of
+// ann_fp_t and a_t holding v_n elements of ann_acc_t. Neither type requires
+// more than element alignment.
+//
+// bytes - The width of a vector register in bytes
+
+#define ANN_VECTOR(bytes)                                                      \
+  typedef ann_fp_t v_t __attribute__((                                         \
+      vector_size(bytes), aligned(sizeof(ann_fp_t)), may_alias));              \
+  typedef ann_acc_t a_t __attribute__((                                        \
+      vector_size((bytes) / sizeof(ann_fp_t) * sizeof(ann_acc_t)),             \
+      aligned(sizeof(ann_acc_t)), may_alias));                                 \
+  uint_t const v_n = (bytes) / sizeof(ann_fp_t);
+
+// Load v_n elements of ann_fp_t, widened to a_t
+#define ANN_LOAD(p) __builtin_convertvector(*(v_t const *)(p), a_t)
+
+// Store an a_t as v_n elements of ann_fp_t
+#define ANN_STORE(p, v) (*(v_t *)(p) = __builtin_convertvector(v, v_t))
+
+// ANN_VECTOR_INTEGER()
+//
+// Declare the vector types used within an activation kernel, v_t holding v_n
+// elements of ann_fp_t as in ANN_VECTOR(), and i_t holding v_n signed integers
+// as wide as ann_fp_t. i_t is the type of a comparison of two v_t, and may
+// hold the bits of a v_t.
+//
+// bytes - The width of a vector register in bytes
+
+#define ANN_VECTOR_INTEGER(bytes)                                              \
+  typedef ann_fp_t v_t __attribute__((                                         \
+      vector_size(bytes), aligned(sizeof(ann_fp_t)), may_alias));              \
+  typedef __typeof__(__builtin_choose_expr(sizeof(ann_fp_t) == 8, (int64_t)0,  \
+                                           (int32_t)0)) i_t                    \
+      __attribute__((vector_size(bytes)));                                     \
+  uint_t const v_n = (bytes) / sizeof(ann_fp_t);
+
+// Select a where the comparison m is true, otherwise b, without branching
+#define ANN_SELECT(m, a, b)                                                    \
+  ((v_t)(((i_t)(m) & (i_t)(a)) | (~(i_t)(m) & (i_t)(b))))
+
+// Broadcast a constant to every element of a v_t
+#define ANN_SPLAT(c) ((v_t){0} + (ann_fp_t)(c))
+
+// The parameters of ANN_EXP() for the format of ann_fp_t
+#define ANN_EXP_DOUBLE (sizeof(ann_fp_t) == 8)
+#define ANN_EXP_MANTISSA (ANN_EXP_DOUBLE ? 52 : 23)
+#define ANN_EXP_BIAS (ANN_EXP_DOUBLE ? 1023 : 127)
+#define ANN_EXP_SHIFT (ANN_EXP_DOUBLE ? 0x1.8p52 : 0x1.8p23)
+#define ANN_EXP_LIMIT ((ANN_EXP_BIAS - 1) * 0.69314718055994530942)
+#define ANN_EXP_LN2_HI (ANN_EXP_DOUBLE ? 0x1.62e42feep-1 : 0x1.63p-1)
+#define ANN_EXP_LN2_LO                                                         \
+  (ANN_EXP_DOUBLE ? 0x1.a39ef35793c76p-33 : -2.12194440054690583e-4)
+
+// The polynomial degrees of ANN_EXP() for each accuracy. APPROXIMATE is within
+// a few units in the last place of libm, FAST within about 1e-5.
+#define ANN_EXP_DEGREE_APPROXIMATE (ANN_EXP_DOUBLE ? 12 : 7)
+#define ANN_EXP_DEGREE_FAST 4
+
+// ANN_EXP()
+//
+// Approximate e^x for every element of a v_t, within a kernel declaring v_t
+// and i_t. x is clamped to the normal range, then split as x = k * ln(2) + r
+// with |r| <= ln(2) / 2, so that e^x = 2^k * e^r. 2^k is built directly in the
+// exponent bits, and e^r is evaluated as its Taylor polynomial.
+//
+// x - The v_t to exponentiate
+// degree - The degree of the polynomial, see ANN_EXP_DEGREE_APPROXIMATE
+
+#define ANN_EXP(x, degree)                                                     \
+  ({                                                                           \
+    static ann_fp_t const c_[] = {                                             \
+        1.0,          1.0,           1.0 / 2,          1.0 / 6,                \
+        1.0 / 24,     1.0 / 120,     1.0 / 720,        1.0 / 5040,             \
+        1.0 / 40320,  1.0 / 362880,  1.0 / 3628800,    1.0 / 39916800,         \
+        1.0 / 479001600};                                                      \
+                                                                               \
+    v_t x_ = (x);                                                              \
+    v_t l_ = ANN_SPLAT(ANN_EXP_LIMIT);                                         \
+    x_ = ANN_SELECT(x_ < -l_, -l_, x_);                                        \
+    x_ = ANN_SELECT(x_ > l_, l_, x_);                                          \
+                                                                               \
+    /* Rounds k to an integer, held in the low bits of the mantissa */         \
+    v_t k_ = x_ * (ann_fp_t)1.44269504088896340736 + ANN_SPLAT(ANN_EXP_SHIFT); \
+    i_t e_ = (i_t)k_ - (i_t)ANN_SPLAT(ANN_EXP_SHIFT);                          \
+    k_ -= ANN_SPLAT(ANN_EXP_SHIFT);                                            \
+                                                                               \
+    v_t r_ = x_ - k_ * (ann_fp_t)ANN_EXP_LN2_HI;                               \
+    r_ -= k_ * (ann_fp_t)ANN_EXP_LN2_LO;                                       \
+    v_t p_ = ANN_SPLAT(c_[degree]);                                            \
+                                                                               \
+    for (int d_ = (degree) - 1; d_ >= 0; d_--) {                               \
+      p_ = p_ * r_ + c_[d_];                                                   \
+    }                                                                          \
+                                                                               \
+    p_ * (v_t)((e_ + ANN_EXP_BIAS) << ANN_EXP_MANTISSA);                       \
+  })
+
+// ANN_ELEMENTWISE()
+//
+// Replace each element of y[] with an expression of x, evaluated a v_t at a
+// time. The last partial vector is padded with zeros.
+//
+// y - The array to update in place
+// n - The length of y[]
+// expression - The new value of the v_t x
+
+#define ANN_ELEMENTWISE(y, n, expression)                                      \
+  for (uint_t i = 0; i < (n); i += v_n) {                                      \
+    uint_t m = ((n) - i < v_n) ? (n) - i : v_n;                                \
+    v_t x = {0};                                                               \
+                                                                               \
+    if (m == v_n)                                                              \
+      x = *(v_t const *)((y) + i);                                             \
+    else                                                                       \
+      for (uint_t k = 0; k < m; k++)                                           \
+        x[k] = (y)[i + k];                                                     \
+                                                                               \
+    x = (expression);                                                          \
+                                                                               \
+    if (m == v_n)                                                              \
+      *(v_t *)((y) + i) = x;                                                   \
+    else                                                                       \
+      for (uint_t k = 0; k < m; k++)                                           \
+        (y)[i + k] = x[k];                                                     \
+  }
+
+// ANN_ACTIVATION_KERNEL()
+//
+// Define the layer activation functions built on ANN_EXP() for a single
+// instruction set and accuracy, see ann_kernel_t
+//
+// name - The suffix of the kernel table
+// isa - The target attribute for the instruction set
+// bytes - The width of a vector register in bytes
+// accuracy - The name of the accuracy, e.g. fast
+// degree - The polynomial degree of ANN_EXP()
+
+#define ANN_ACTIVATION_KERNEL(name, isa, bytes, accuracy, degree)              \
+  __attribute__((target(isa))) static void ann_sigmoid_##accuracy##_##name(    \
+      ann_fp_t *y, uint_t n) {                                                 \
+    ANN_VECTOR_INTEGER(bytes)                                                  \
+                                                                               \
+    ANN_ELEMENTWISE(y, n, 1 / (1 + ANN_EXP(-x, degree)))                       \
+  }                                                                            \
+                                                                               \
+  /* tanh(x) = sign(x) * ( 1 - e^-2|x| ) / ( 1 + e^-2|x| ) */                  \
+  __attribute__((target(isa))) static void ann_tanh_##accuracy##_##name(       \
+      ann_fp_t *y, uint_t n) {                                                 \
+    ANN_VECTOR_INTEGER(bytes)                                                  \
+                                                                               \
+    ANN_ELEMENTWISE(y, n, ({                                                   \
+                      v_t e = ANN_EXP(-2 * ANN_SELECT(x < 0, -x, x), degree);  \
+                      v_t t = (1 - e) / (1 + e);                               \
+                      ANN_SELECT(x < 0, -t, t);                                \
+                    }))                                                        \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa))) static void ann_elu_##accuracy##_##name(        \
+      ann_fp_t *y, uint_t n) {                                                 \
+    ANN_VECTOR_INTEGER(bytes)                                                  \
+                                                                               \
+    ANN_ELEMENTWISE(y, n, ({                                                   \
+                      v_t e = ANN_EXP(ANN_SELECT(x > 0, ANN_SPLAT(0), x),      \
+                                      degree);                                 \
+                      ANN_SELECT(x > 0, x, (ann_fp_t)ELU_ALPHA * (e - 1));     \
+                    }))                                                        \
+  }                                                                            \
+                                                                               \
+  /* 0.5 * x * ( 1 + tanh(u) ) = x / ( 1 + e^-2u ) */                          \
+  __attribute__((target(isa))) static void ann_gelu_##accuracy##_##name(       \
+      ann_fp_t *y, uint_t n) {                                                 \
+    ANN_VECTOR_INTEGER(bytes)                                                  \
+                                                                               \
+    ANN_ELEMENTWISE(y, n, ({                                                   \
+                      v_t u = (ann_fp_t)SQUARE_ROOT_2_OVER_PI *                \
+                              (x + (ann_fp_t)GELU_BETA * x * x * x);           \
+                      x / (1 + ANN_EXP(-2 * u, degree));                       \
+                    }))                                                        \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa))) static void ann_softmax_##accuracy##_##name(    \
+      ann_fp_t *y, uint_t n) {                                                 \
+    ANN_VECTOR_INTEGER(bytes)                                                  \
+                                                                               \
+    ann_fp_t max = y[0];                                                       \
+    for (uint_t i = 1; i < n; i++) {                                           \
+      max = (y[i] > max) ? y[i] : max;                                         \
+    }                                                                          \
+                                                                               \
+    ANN_ELEMENTWISE(y, n, ANN_EXP(x - max, degree))                            \
+                                                                               \
+    ann_acc_t sum = 0;                                                         \
+    for (uint_t i = 0; i < n; i++) {                                           \
+      sum += y[i];                                                             \
+    }                                                                          \
+                                                                               \
+    ann_fp_t scale = 1 / sum;                                                  \
+    for (uint_t i = 0; i < n; i++) {                                           \
+      y[i] *= scale;                                                           \
+    }                                                                          \
+  }
+
+// The ann_kernel_t.activation row of an ANN_ACTIVATION_KERNEL()
+#define ANN_ACTIVATION_ROW(name, accuracy)                                     \
+  {                                                                            \
+    [SIGMOID] = ann_sigmoid_##accuracy##_##name,                               \
+    [TANH] = ann_tanh_##accuracy##_##name,                                     \
+    [ELU] = ann_elu_##accuracy##_##name,                                       \
+    [GELU] = ann_gelu_##accuracy##_##name,                                     \
+    [SOFTMAX] = ann_softmax_##accuracy##_##name,                               \
+  }
+
+// ANN_KERNEL()
+//
+// Define the dense layer kernels and the layer activation functions for a
+// single instruction set, using the compiler's vector extensions. Each kernel
+// is compiled for its target alone, so the library itself may be built for the
+// baseline architecture.
+//
+// name - The suffix for the kernel functions and table
+// isa - The target attribute for the instruction set
+// bytes - The width of a vector register in bytes
+
+#define ANN_KERNEL(name, isa, bytes)                                           \
+  __attribute__((target(isa))) static ann_acc_t ann_dot_##name(                \
+      ann_fp_t const *x, ann_fp_t const *w, uint_t n) {                        \
+    ANN_VECTOR(bytes)                                                          \
+    a_t y_0 = {0}, y_1 = {0}, y_2 = {0}, y_3 = {0};                            \
+    uint_t i = 0;                                                              \
+                                                                               \
+    for (; i + 4 * v_n <= n; i += 4 * v_n) {                                   \
+      y_0 += ANN_LOAD(x + i) * ANN_LOAD(w + i);                                \
+      y_1 += ANN_LOAD(x + i + v_n) * ANN_LOAD(w + i + v_n);                    \
+      y_2 += ANN_LOAD(x + i + 2 * v_n) * ANN_LOAD(w + i + 2 * v_n);            \
+      y_3 += ANN_LOAD(x + i + 3 * v_n) * ANN_LOAD(w + i + 3 * v_n);            \
+    }                                                                          \
+                                                                               \
+    for (; i + v_n <= n; i += v_n) {                                           \
+      y_0 += ANN_LOAD(x + i) * ANN_LOAD(w + i);                                \
+    }                                                                          \
+                                                                               \
+    y_0 += (y_1 + y_2) + y_3;                                                  \
+                                                                               \
+    ann_acc_t y = 0;                                                           \
+    for (uint_t k = 0; k < v_n; k++) {                                         \
+      y += y_0[k];                                                             \
+    }                                                                          \
+                                                                               \
+    for (; i < n; i++) {                                                       \
+      y += (ann_acc_t)x[i] * w[i];                                             \
+    }                                                                          \
+                                                                               \
+    return y;                                                                  \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa))) static void ann_dot4_##name(                    \
+      ann_acc_t *y, ann_fp_t const *w, ann_fp_t const *x, uint_t stride,       \
+      uint_t n) {                                                              \
+    ANN_VECTOR(bytes)                                                          \
+    ann_fp_t const *x_0 = x, *x_1 = x + stride;                                \
+    ann_fp_t const *x_2 = x + 2 * stride, *x_3 = x + 3 * stride;               \
+    uint_t b = n - n % (4 * v_n);                                              \
+    a_t y_s[4][4];                                                             \
+                                                                               \
+    /* Two of the four sums of dot() at a time, to fit in registers */         \
+    for (uint_t k = 0; k < 4; k += 2) {                                        \
+      a_t y_00 = {0}, y_01 = {0}, y_10 = {0}, y_11 = {0};                      \
+      a_t y_20 = {0}, y_21 = {0}, y_30 = {0}, y_31 = {0};                      \
+                                                                               \
+      for (uint_t i = k * v_n; i < b; i += 4 * v_n) {                          \
+        a_t w_0 = ANN_LOAD(w + i), w_1 = ANN_LOAD(w + i + v_n);                \
+                                                                               \
+        y_00 += ANN_LOAD(x_0 + i) * w_0;                                       \
+        y_01 += ANN_LOAD(x_0 + i + v_n) * w_1;                                 \
+        y_10 += ANN_LOAD(x_1 + i) * w_0;                                       \
+        y_11 += ANN_LOAD(x_1 + i + v_n) * w_1;                                 \
+        y_20 += ANN_LOAD(x_2 + i) * w_0;                                       \
+        y_21 += ANN_LOAD(x_2 + i + v_n) * w_1;                                 \
+        y_30 += ANN_LOAD(x_3 + i) * w_0;                                       \
+        y_31 += ANN_LOAD(x_3 + i + v_n) * w_1;                                 \
+      }                                                                        \
+                                                                               \
+      y_s[0][k] = y_00;                                                        \
+      y_s[0][k + 1] = y_01;                                                    \
+      y_s[1][k] = y_10;                                                        \
+      y_s[1][k + 1] = y_11;                                                    \
+      y_s[2][k] = y_20;                                                        \
+      y_s[2][k + 1] = y_21;                                                    \
+      y_s[3][k] = y_30;                                                        \
+      y_s[3][k + 1] = y_31;                                                    \
+    }                                                                          \
+                                                                               \
+    for (uint_t s = 0; s < 4; s++) {                                           \
+      ann_fp_t const *x_s = x + s * stride;                                    \
+      a_t y_0 = y_s[s][0];                                                     \
+      uint_t i = b;                                                            \
+                                                                               \
+      for (; i + v_n <= n; i += v_n) {                                         \
+        y_0 += ANN_LOAD(x_s + i) * ANN_LOAD(w + i);                            \
+      }                                                                        \
+                                                                               \
+      y_0 += (y_s[s][1] + y_s[s][2]) + y_s[s][3];                              \
+                                                                               \
+      ann_acc_t y_j = 0;                                                       \
+      for (uint_t k = 0; k < v_n; k++) {                                       \
+        y_j += y_0[k];                                                         \
+      }                                                                        \
+                                                                               \
+      for (; i < n; i++) {                                                     \
+        y_j += (ann_acc_t)x_s[i] * w[i];                                       \
+      }                                                                        \
+                                                                               \
+      y[s] = y_j;                                                              \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa))) static void ann_axpy_##name(                    \
+      ann_fp_t *y, ann_acc_t a, ann_fp_t const *x, uint_t n) {                 \
+    ANN_VECTOR(bytes)                                                          \
+    uint_t i = 0;                                                              \
+                                                                               \
+    for (; i + v_n <= n; i += v_n) {                                           \
+      ANN_STORE(y + i, ANN_LOAD(y + i) + a * ANN_LOAD(x + i));                 \
+    }                                                                          \
+                                                                               \
+    for (; i < n; i++) {                                                       \
+      y[i] = y[i] + a * x[i];                                                  \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa))) static void ann_delta_##name(                   \
+      ann_fp_t *y, ann_fp_t const *w, uint_t stride, ann_fp_t const *x,        \
+      uint_t m, uint_t n) {                                                    \
+    ANN_VECTOR(bytes)                                                          \
+    uint_t j = 0;                                                              \
+                                                                               \
+    for (; j + 4 * v_n <= n; j += 4 * v_n) {                                   \
+      a_t y_0 = {0}, y_1 = {0}, y_2 = {0}, y_3 = {0};                          \
+                                                                               \
+      for (uint_t q = 0; q < m; q++) {                                         \
+        ann_fp_t const *w_q = w + q * stride + j;                              \
+        ann_acc_t x_q = x[q];                                                  \
+                                                                               \
+        y_0 += ANN_LOAD(w_q) * x_q;                                            \
+        y_1 += ANN_LOAD(w_q + v_n) * x_q;                                      \
+        y_2 += ANN_LOAD(w_q + 2 * v_n) * x_q;                                  \
+        y_3 += ANN_LOAD(w_q + 3 * v_n) * x_q;                                  \
+      }                                                                        \
+                                                                               \
+      ANN_STORE(y + j, y_0);                                                   \
+      ANN_STORE(y + j + v_n, y_1);                                             \
+      ANN_STORE(y + j + 2 * v_n, y_2);                                         \
+      ANN_STORE(y + j + 3 * v_n, y_3);                                         \
+    }                                                                          \
+                                                                               \
+    for (; j + v_n <= n; j += v_n) {                                           \
+      a_t y_0 = {0};                                                           \
+                                                                               \
+      for (uint_t q = 0; q < m; q++) {                                         \
+        y_0 += ANN_LOAD(w + q * stride + j) * (ann_acc_t)x[q];                 \
+      }                                                                        \
+                                                                               \
+      ANN_STORE(y + j, y_0);                                                   \
+    }                                                                          \
+                                                                               \
+    ann_delta_scalar(y + j, w + j, stride, x, m, n - j);                       \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa))) static void ann_gradient_##name(                \
+      ann_acc_t *g, ann_acc_t a, ann_fp_t const *x, uint_t n) {                \
+    ANN_VECTOR(bytes)                                                          \
+    uint_t i = 0;                                                              \
+                                                                               \
+    for (; i + v_n <= n; i += v_n) {                                           \
+      *(a_t *)(g + i) += a * ANN_LOAD(x + i);                                  \
+    }                                                                          \
+                                                                               \
+    for (; i < n; i++) {                                                       \
+      g[i] += a * x[i];                                                        \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa))) static void ann_update_##name(                  \
+      ann_fp_t *y, ann_acc_t a, ann_acc_t const *g, uint_t n) {                \
+    ANN_VECTOR(bytes)                                                          \
+    uint_t i = 0;                                                              \
+                                                                               \
+    for (; i + v_n <= n; i += v_n) {                                           \
+      ANN_STORE(y + i, ANN_LOAD(y + i) + a * *(a_t const *)(g + i));           \
+    }                                                                          \
+                                                                               \
+    for (; i < n; i++) {                                                       \
+      y[i] = y[i] + a * g[i];                                                  \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  ANN_ACTIVATION_KERNEL(name, isa, bytes, approximate,                         \
+                        ANN_EXP_DEGREE_APPROXIMATE)                            \
+  ANN_ACTIVATION_KERNEL(name, isa, bytes, fast, ANN_EXP_DEGREE_FAST)           \
+                                                                               \
+  static ann_kernel_t const ann_kernel_##name = {                              \
+      ann_dot_##name,                                                          \
+      ann_dot4_##name,                                                         \
+      ann_axpy_##name,                                                         \
+      ann_delta_##name,                                                        \
+      ann_gradient_##name,                                                     \
+      ann_update_##name,                                                       \
+      {ANN_ACTIVATION_ROW(name, approximate), ANN_ACTIVATION_ROW(name, fast)}, \
+  };
+
+ANN_KERNEL(sse2, "sse2", 16)
+ANN_KERNEL(avx2, "avx2,fma", 32)
+ANN_KERNEL(avx512, "avx512f", 64)
+
+#endif // ANN_SIMD_X86
+
 // ann_init()
 //
 // Initialize the neural network
@@ -163,27 +983,34 @@ ann_t *ann_init(uint_t layer_n, uint_t *layer_neuron_n) {
   weight_n += layer_neuron_n[l] * (layer_neuron_n[l - 1] + 1);
 
   uint_t n =
-      sizeof(ann_t) +              // ANN
-      (sizeof(uint_t) * layer_n) + // layer_neuron_n[]
-      (sizeof(fp_t) * (neuron_n +  // neuron[]
-                       weight_n +  // weight[]
-                       neuron_n + layer_neuron_n[layer_n - 1])); // delta[]
+      sizeof(ann_t) +                 // ANN
+      (sizeof(uint_t) * layer_n) +    // layer_neuron_n[]
+      (sizeof(ann_fp_t) * (neuron_n + // neuron[]
+                           weight_n + // weight[]
+                           neuron_n + layer_neuron_n[layer_n - 1] + // delta[]
+                           neuron_n + layer_neuron_n[layer_n - 1])); // sum[]
 
   // Allocate everything as one structure
   ann_t *ann = (ann_t *)malloc(n);
 
-  // ann_t | layer_neuron_n[] | neuron[] | weight[] | delta[]
+  // ann_t | layer_neuron_n[] | neuron[] | weight[] | state[] | delta[] |
+  // sum[]
   ann->n = n;
   ann->layer_n = layer_n;
   ann->weight_n = weight_n;
   ann->neuron_n = neuron_n;
-  ann->layer_neuron_n = (uint_t *)((uint8_t *)ann + sizeof(ann_t));
-  memcpy(ann->layer_neuron_n, layer_neuron_n, sizeof(uint_t) * layer_n);
-  ann->neuron = (fp_t *)(ann->layer_neuron_n + ann->layer_n);
-  ann->weight = ann->neuron + ann->neuron_n;
-  ann->delta = ann->weight + ann->weight_n;
+  ann->layout = ROW_MAJOR;
+  ann->accuracy = EXACT;
+  ann->optimizer = SGD;
+  ann->step = 0;
+  ann->map = NULL;
+  ann->map_n = 0;
+  memcpy((uint8_t *)ann + sizeof(ann_t), layer_neuron_n,
+         sizeof(uint_t) * layer_n);
+  ann_rebase(ann);
 
   ann_set_activation(ann, SIGMOID, SIGMOID);
+  ann_set_simd(ann, ann_simd_detect());
 
   return ann;
 }
@@ -194,262 +1021,1570 @@ ann_t *ann_init(uint_t layer_n, uint_t *layer_neuron_n) {
 //
 // ann - The instance of ann_t to free
 
-void ann_free(ann_t *ann) { free(ann); }
+void ann_free(ann_t *ann) {
+#ifdef ANN_MMAP
+  if (ann->map)
+    munmap(ann->map, ann->map_n);
+#endif
+
+  free(ann);
+}
 
 // ann_copy()
 //
-// Make a copy of the given ann_t instance
+// Make a copy of the given ann_t instance. The copy of a mapped instance holds
+// its own weights, which may be trained.
 //
 // ann - The instance of ann_t to copy
 //
 // return - The copied ann_t instance
 
 ann_t *ann_copy(ann_t const *ann) {
+  if (ann->map) {
+    ann_t *copy = ann_init(ann->layer_n, ann->layer_neuron_n);
+    memcpy(copy->weight, ann->weight, sizeof(ann_fp_t) * ann->weight_n);
+    ann_set_activation(copy, ann->activation_hidden_id,
+                       ann->activation_output_id);
+    copy->kernel = ann->kernel;
+    ann_set_accuracy(copy, ann->accuracy);
+
+    return ann_set_layout(copy, ann->layout);
+  }
+
   ann_t *copy = (ann_t *)malloc(ann->n);
   memcpy(copy, ann, ann->n);
+  ann_rebase(copy);
 
   return copy;
 }
 
-// ann_propagation_forward()
+// ann_save()
 //
-// Perform forward propagation on the ann_t instance
+// Write the network to a model file, see ann_file_t. The neurons, deltas and
+// layout are not saved.
 //
-// ann - The ann_t instance to perform the propagation on
-// input - An array containing the input vector
-// output - The destination array for the output vector
+// ann - The ann_t instance to save
+// path - The path and file name of the model file
+//
+// return - 0 on success, or -1 if the file could not be written
+
+int ann_save(ann_t const *ann, char const *path) {
+  FILE *f = fopen(path, "wb");
+
+  if (!f)
+    return -1;
+
+  ann_file_t header = {
+      .magic = ANN_FILE_MAGIC,
+      .version = ANN_FILE_VERSION,
+      .fp_size = sizeof(ann_fp_t),
+      .activation_hidden = ann->activation_hidden_id,
+      .activation_output = ann->activation_output_id,
+      .layer_n = ann->layer_n,
+      .neuron_n = ann->neuron_n,
+      .weight_n = ann->weight_n,
+  };
+
+  uint_t offset = sizeof(ann_file_t);
+  uint_t written = fwrite(&header, sizeof(ann_file_t), 1, f);
+
+  for (uint_t l = 0; l < ann->layer_n; l++) {
+    uint64_t layer_neuron_n = ann->layer_neuron_n[l];
+    written += fwrite(&layer_neuron_n, sizeof(uint64_t), 1, f);
+    offset += sizeof(uint64_t);
+  }
 
-void ann_propagation_forward(ann_t *ann, fp_t const *const input,
-                             fp_t *output) {
-  // printf("ann:\t\t%p\n", ann);
-  // printf("output:\t\t%p\n", output);
-  fp_t *w_ij = ann->weight;
-  // printf("ann->weight:\t%p\n", w_ij);
-  fp_t const *x = input; // Input neuron into y
-  fp_t *y = ann->neuron; // The current neuron being calculated
+  // Pad up to the weights, fewer than ANN_FILE_ALIGN bytes
+  uint8_t const zero[ANN_FILE_ALIGN] = {0};
+  uint_t pad_n = ann_file_offset(ann->layer_n) - offset;
+  int error = fwrite(zero, 1, pad_n, f) != pad_n;
 
-  uint_t l = 1;
+  written += fwrite(ann->weight, sizeof(ann_fp_t), ann->weight_n, f);
 
-  for (; l < ann->layer_n - 1; l++) {
-    for (uint_t j = 0; j < ann->layer_neuron_n[l]; j++) {
-      // printf("neuron[%u]:\t%p\n", j, &(y[j]));
-      y[j] = 0;
-      for (uint_t i = 0; i < ann->layer_neuron_n[l - 1]; i++) {
-        y[j] += x[i] * *w_ij++;
-      }
+  if (fclose(f) != 0 || error || written != 1 + ann->layer_n + ann->weight_n)
+    return -1;
 
-      y[j] += *w_ij++;
-      y[j] = ann->activation_hidden(y[j]);
-    }
+  return 0;
+}
 
-    x = y;
-    y += ann->layer_neuron_n[l];
+// ann_load()
+//
+// Read a network from a model file into memory
+//
+// path - The path and file name of the model file
+//
+// return - The loaded ann_t instance, or NULL if the file could not be read,
+//          or was saved by an incompatible version or precision
+
+ann_t *ann_load(char const *path) {
+  FILE *f = fopen(path, "rb");
+
+  if (!f)
+    return NULL;
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  rewind(f);
+
+  ann_file_t header;
+
+  if (size < (long)sizeof(ann_file_t) ||
+      fread(&header, sizeof(ann_file_t), 1, f) != 1 ||
+      header.magic != ANN_FILE_MAGIC || header.layer_n < 2 ||
+      header.layer_n > size / sizeof(uint64_t)) {
+    fclose(f);
+    return NULL;
   }
 
-  // Last layer
-  for (uint_t j = 0; j < ann->layer_neuron_n[l]; j++) {
-    // printf("output[%u]:\t%p\n", j, &(output[j]));
-    output[j] = 0;
+  uint64_t *layer_neuron_n = malloc(sizeof(uint64_t) * header.layer_n);
+  uint_t *layer = malloc(sizeof(uint_t) * header.layer_n);
+  ann_t *ann = NULL;
 
-    for (uint_t i = 0; i < ann->layer_neuron_n[l - 1]; i++) {
-      output[j] += x[i] * *w_ij++;
+  if (fread(layer_neuron_n, sizeof(uint64_t), header.layer_n, f) ==
+          header.layer_n &&
+      ann_file_check(&header, layer_neuron_n, size) == 0) {
+    for (uint_t l = 0; l < header.layer_n; l++) {
+      layer[l] = layer_neuron_n[l];
     }
 
-    output[j] += *w_ij++;
-    output[j] = ann->activation_output(output[j]);
+    ann = ann_init(header.layer_n, layer);
+    ann_set_activation(ann, header.activation_hidden,
+                       header.activation_output);
+
+    if (fseek(f, ann_file_offset(ann->layer_n), SEEK_SET) != 0 ||
+        fread(ann->weight, sizeof(ann_fp_t), ann->weight_n, f) !=
+            ann->weight_n) {
+      ann_free(ann);
+      ann = NULL;
+    }
   }
+
+  free(layer_neuron_n);
+  free(layer);
+  fclose(f);
+
+  return ann;
 }
 
-// ann_propagation_backward()
+// ann_load_mmap()
 //
-// Perform backpropagation on the ann_t instance
+// Map a model file into memory, read-only. The weights are used in place, so
+// every process mapping the same file shares a single copy of them, and only
+// the neurons, deltas and sums are allocated. The instance may be used for
+// propagation, but not trained, as its weights may not be written; train an
+// ann_copy() of it instead. Falls back to ann_load() where mmap() is not
+// available.
 //
-// ann - The ann_t instance to perform backpropagation upon
-// input - Input vector array
-// output - Output vector array
-// target - Target output vector array
-// rate - Learning rate
-
-void ann_propagation_backward(ann_t *ann, fp_t const *input, fp_t *output,
-                              fp_t const *target, fp_t rate) {
-  int_t l = ann->layer_n - 1;
-  uint_t i, j, q;
-
-  // First output layer delta
-  fp_t *d_j = ann->delta + ann->neuron_n;
-
-  // Output Deltas
-  for (j = 0; j < ann->layer_neuron_n[l]; j++) {
-    d_j[j] = ann->activation_output_partial(output[j]) *
-             ann_error_partial(output[j], target[j]);
-  }
+// path - The path and file name of the model file
+//
+// return - The mapped ann_t instance, or NULL if the file could not be
+//          mapped, or was saved by an incompatible version or precision
 
-  // First weight in the set between the last layer and the current
-  fp_t *w_jq = ann->weight + ann->weight_n -
-               ann->layer_neuron_n[l] * ann->layer_neuron_n[l - 1] -
-               ann->layer_neuron_n[l];
+ann_t *ann_load_mmap(char const *path) {
+#ifdef ANN_MMAP
+  int fd = open(path, O_RDONLY);
 
-  fp_t *o_j = ann->neuron + ann->neuron_n;
-  fp_t *d_q;
+  if (fd < 0)
+    return NULL;
 
-  l--;
+  struct stat st;
+  void *map = MAP_FAILED;
 
-  // Hidden Deltas
-  for (; l > 0; --l) {
-    d_q = d_j;
-    d_j -= ann->layer_neuron_n[l];
-    o_j -= ann->layer_neuron_n[l];
+  if (fstat(fd, &st) == 0 && (uint_t)st.st_size >= sizeof(ann_file_t))
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
 
-    for (j = 0; j < ann->layer_neuron_n[l]; j++) {
-      d_j[j] = 0;
+  // The mapping remains valid once the descriptor is closed
+  close(fd);
 
-      for (q = 0; q < ann->layer_neuron_n[l + 1]; q++) {
-        d_j[j] += w_jq[q * (ann->layer_neuron_n[l] + 1) + j] * d_q[q];
-      }
+  if (map == MAP_FAILED)
+    return NULL;
 
-      d_j[j] *= ann->activation_hidden_partial(o_j[j]);
-    }
+  ann_file_t const *header = (ann_file_t const *)map;
+  uint64_t const *layer_neuron_n = (uint64_t const *)(header + 1);
 
-    w_jq -= (ann->layer_neuron_n[l - 1] * ann->layer_neuron_n[l] +
-             ann->layer_neuron_n[l - 1]);
+  if (header->magic != ANN_FILE_MAGIC || header->layer_n < 2 ||
+      header->layer_n > st.st_size / sizeof(uint64_t) ||
+      ann_file_check(header, layer_neuron_n, st.st_size) != 0) {
+    munmap(map, st.st_size);
+    return NULL;
   }
 
-  fp_t *w_ij = ann->weight;
-  d_j = ann->delta;
+  uint_t layer_n = header->layer_n;
+  uint_t neuron_n = header->neuron_n;
+  uint_t output_n = layer_neuron_n[layer_n - 1];
 
-  l = 1;
+  uint_t n = sizeof(ann_t) +                 // ANN
+             (sizeof(uint_t) * layer_n) +    // layer_neuron_n[]
+             (sizeof(ann_fp_t) * (neuron_n +            // neuron[]
+                                  neuron_n + output_n + // delta[]
+                                  neuron_n + output_n)); // sum[]
 
-  // Input training
-  for (j = 0; j < ann->layer_neuron_n[l]; j++) {
-    for (i = 0; i < ann->layer_neuron_n[l - 1]; i++) {
-      *w_ij -= rate * input[i] * d_j[j];
-      w_ij++;
-    }
+  // Allocate everything but the weights as one structure
+  ann_t *ann = (ann_t *)malloc(n);
 
-    *w_ij -= rate * d_j[j];
-    w_ij++;
+  // ann_t | layer_neuron_n[] | neuron[] | delta[] | sum[]
+  ann->n = n;
+  ann->layer_n = layer_n;
+  ann->weight_n = header->weight_n;
+  ann->neuron_n = neuron_n;
+  ann->layout = ROW_MAJOR;
+  ann->accuracy = EXACT;
+  ann->optimizer = SGD;
+  ann->step = 0;
+  ann->map = map;
+  ann->map_n = st.st_size;
+
+  // The layer sizes follow the ann_t, as set by ann_rebase()
+  uint_t *layer = (uint_t *)((uint8_t *)ann + sizeof(ann_t));
+
+  for (uint_t l = 0; l < layer_n; l++) {
+    layer[l] = layer_neuron_n[l];
   }
 
-  l++;
-  fp_t *i_i = ann->neuron;
-
-  // Hidden training
-  for (; l < (int_t)ann->layer_n; l++) {
-    d_j += ann->layer_neuron_n[l - 1];
-
-    for (j = 0; j < ann->layer_neuron_n[l]; j++) {
-      for (i = 0; i < ann->layer_neuron_n[l - 1]; i++) {
-        *w_ij -= rate * i_i[i] * d_j[j];
-        w_ij++;
-      }
+  ann_rebase(ann);
 
-      *w_ij -= rate * d_j[j];
-      w_ij++;
-    }
+  ann_set_activation(ann, header->activation_hidden,
+                     header->activation_output);
+  ann_set_simd(ann, ann_simd_detect());
 
-    i_i += ann->layer_neuron_n[l - 1];
-  }
+  return ann;
+#else
+  return ann_load(path);
+#endif
 }
 
-// ann_activation_identity()
+// ann_file_offset()
 //
-// y = x
-// dy/dx = 1
-
-static fp_t ann_activation_identity(fp_t x) { return x; }
-static fp_t ann_activation_identity_partial(fp_t x) { return 1; }
-
-// ann_activation_binary()
+// Locate the weights within a model file
 //
-// y = { x < 0 -> 0, x > 0 -> 1 }
-// dy/dx = 0
+// layer_n - The layer count of the saved network
+//
+// return - The offset of the weights, in bytes
 
-static fp_t ann_activation_binary(fp_t x) {
-  return (x > 0.0) ? 1.0 : (x < 0.0) ? -1.0 : 0.0;
+static uint_t ann_file_offset(uint_t layer_n) {
+  uint_t offset = sizeof(ann_file_t) + sizeof(uint64_t) * layer_n;
+
+  return (offset + ANN_FILE_ALIGN - 1) / ANN_FILE_ALIGN * ANN_FILE_ALIGN;
 }
-static fp_t ann_activation_binary_partial(fp_t x) { return 0.0; }
 
-// ann_activation_sign()
+// ann_file_check()
 //
-// y = { x < 0 -> -1, x = 0 -> 0, x > 0 -> 1 }
-// dy/dx = 0
+// Validate the header of a model file against this build and against the
+// layer sizes which follow it
+//
+// header - The model file header
+// layer_neuron_n - The header->layer_n layer sizes
+// size - The size of the file in bytes
+//
+// return - 0 if the file may be loaded, otherwise -1
 
-static fp_t ann_activation_sign(fp_t x) { return (x > 0.0) ? 1.0 : 0.0; }
-static fp_t ann_activation_sign_partial(fp_t x) { return 0.0; }
+static int ann_file_check(ann_file_t const *header,
+                          uint64_t const *layer_neuron_n, uint_t size) {
+  if (ann_file_offset(header->layer_n) > size ||
+      header->version != ANN_FILE_VERSION ||
+      header->fp_size != sizeof(ann_fp_t) ||
+      header->activation_hidden >= SOFTMAX ||
+      header->activation_output > SOFTMAX)
+    return -1;
 
-// ann_activation_sigmoid()
-//
-// y = 1.0 / ( 1.0 + e^-x )
-// dy/dx = f(x) * ( 1.0 - f(x) )
+  uint64_t neuron_n = 0;
+  uint64_t weight_n = 0;
 
-static fp_t ann_activation_sigmoid(fp_t x) { return 1.0 / (1.0 + exp(-x)); }
-static fp_t ann_activation_sigmoid_partial(fp_t x) { return x * (1.0 - x); }
+  for (uint_t l = 1; l < header->layer_n; l++) {
+    if (layer_neuron_n[l - 1] == 0 || layer_neuron_n[l] == 0)
+      return -1;
 
-// ann_activation_relu()
-//
-// y = { x < 0 -> 0, x >= 0 -> x }
-// dy/dx = { x < 0 -> 0, x >= 0 -> 1 }
+    if (l < header->layer_n - 1)
+      neuron_n += layer_neuron_n[l];
 
-static fp_t ann_activation_relu(fp_t x) { return (x > 0.0) ? x : 0.0; }
-static fp_t ann_activation_relu_partial(fp_t x) {
-  return (x > 0.0) ? 1.0 : 0.0;
-}
+    weight_n += layer_neuron_n[l] * (layer_neuron_n[l - 1] + 1);
+  }
 
-// ann_activation_elu()
-//
-// y = { x < 0 -> a * ( e^x - 1 ), x >= 0 -> x }
-// dy/dx = { x < 0 -> x + a, x >= 0 -> 1 }
+  if (neuron_n != header->neuron_n || weight_n != header->weight_n)
+    return -1;
 
-static fp_t ann_activation_elu(fp_t x) {
-  return (x > 0.0) ? x : ELU_ALPHA * (expm1(x));
-}
-static fp_t ann_activation_elu_partial(fp_t x) {
-  return (x > 0.0) ? 1.0 : x + ELU_ALPHA;
+  if (ann_file_offset(header->layer_n) + sizeof(ann_fp_t) * weight_n > size)
+    return -1;
+
+  return 0;
 }
 
-// ann_activation_lelu()
+// ann_rebase()
 //
-// y = { x < 0 -> a * x, x >= 0 -> x }
-// dy/dx = { x < 0 -> a, x >= 0 -> 1 }
+// Point the interior pointers of an ann_t instance at its own allocation
+//
+// ann - The ann_t instance, with its counts and layer sizes already set
 
-static fp_t ann_activation_lrelu(fp_t x) {
-  return (x > 0.0) ? x : LRELU_ALPHA * x;
-}
-static fp_t ann_activation_lrelu_partial(fp_t x) {
-  return (x > 0.0) ? 1.0 : LRELU_ALPHA;
-}
+static void ann_rebase(ann_t *ann) {
+  ann->layer_neuron_n = (uint_t *)((uint8_t *)ann + sizeof(ann_t));
+  ann->neuron = (ann_fp_t *)(ann->layer_neuron_n + ann->layer_n);
+
+  if (ann->map) {
+    ann->weight =
+        (ann_fp_t *)((uint8_t *)ann->map + ann_file_offset(ann->layer_n));
+    ann->state = NULL;
+    ann->delta = ann->neuron + ann->neuron_n;
+  } else {
+    ann->weight = ann->neuron + ann->neuron_n;
+    ann->state = ann->weight + ann->weight_n;
+    ann->delta =
+        ann->state + ann_optimizer_state_n(ann->optimizer) * ann->weight_n;
+  }
 
-// ann_activation_tanh()
-//
-// y = sinh( x ) / cosh( x ) = ( e^2x - 1 ) / ( e^2x + 1 )
-// dy/dx = 1.0 - f(x)^2
+  ann->sum = ann->delta + ann->neuron_n + ann->layer_neuron_n[ann->layer_n - 1];
 
-static fp_t ann_activation_tanh(fp_t x) { return tanh(x); }
-static fp_t ann_activation_tanh_partial(fp_t x) { return 1.0 - (x * x); }
+  ann->transpose = NULL;
+  if (ann->layout == TRANSPOSED) {
+    ann->transpose = ann->sum + ann->neuron_n +
+                     ann->layer_neuron_n[ann->layer_n - 1];
+  }
+}
 
-// ann_error()
+// ann_transpose_n()
 //
-// Implementation of mean squared error for calculating the difference between
-// the current and target outputs for the ann_t instance
+// Count the weights held by the transposed copy, excluding biases
 //
-// output - The current ann_t output
-// target - The target ann_t output
+// ann - The ann_t instance
+//
+// return - The size of ann->transpose, in elements
 
-fp_t ann_error(fp_t output, fp_t target) {
-  fp_t error = output - target;
-  error = 0.5 * error * error;
+static uint_t ann_transpose_n(ann_t const *ann) {
+  uint_t n = 0;
+  for (uint_t l = 2; l < ann->layer_n; l++) {
+    n += ann->layer_neuron_n[l] * ann->layer_neuron_n[l - 1];
+  }
 
-  return error;
+  return n;
 }
 
-// ann_error_partial()
+// ann_transpose_size()
 //
-// The partial derivative of mean squared error where n = 2
+// Measure the memory required by the TRANSPOSED layout
 //
-// output - The current ann_t output
-// target - The target ann_t output
+// ann - The ann_t instance
+//
+// return - The size of the transposed copy and its scratch row, in bytes
 
-fp_t ann_error_partial(fp_t output, fp_t target) { return (output - target); }
+static uint_t ann_transpose_size(ann_t const *ann) {
+  uint_t n = 0;
+  for (uint_t l = 1; l < ann->layer_n; l++) {
+    n = (ann->layer_neuron_n[l] > n) ? ann->layer_neuron_n[l] : n;
+  }
+
+  return sizeof(ann_fp_t) * (ann_transpose_n(ann) + n);
+}
+
+// ann_set_layout()
+//
+// Set the arrangement of the weights used by the hidden delta calculation. The
+// TRANSPOSED layout keeps a second, transposed copy of the weights so that
+// backpropagation reads them sequentially, at the cost of the memory and of
+// updating both copies. As the allocation is resized, the
+// ann_t instance may be moved.
+//
+// ann - The current ann_t instance
+// layout - The weight layout
+//
+// return - The ann_t instance, at its possibly new address
+
+ann_t *ann_set_layout(ann_t *ann, ann_layout_t layout) {
+  uint_t n = ann->n;
+
+  if (ann->layout == TRANSPOSED)
+    n -= ann_transpose_size(ann);
+
+  if (layout == TRANSPOSED)
+    n += ann_transpose_size(ann);
+
+  ann = (ann_t *)realloc(ann, n);
+  ann->n = n;
+  ann->layout = layout;
+  ann_rebase(ann);
+  ann_layout_sync(ann);
+
+  return ann;
+}
+
+// ann_layout_sync()
+//
+// Refresh the transposed copy of the weights. This must be called after the
+// weights are modified outside of the library's own training functions.
+//
+// ann - The current ann_t instance
+
+void ann_layout_sync(ann_t *ann) {
+  if (ann->layout != TRANSPOSED)
+    return;
+
+  ann_fp_t const *w = ann->weight + ann->layer_neuron_n[1] *
+                                    (ann->layer_neuron_n[0] + 1);
+  ann_fp_t *t = ann->transpose;
+
+  for (uint_t l = 2; l < ann->layer_n; l++) {
+    uint_t i_n = ann->layer_neuron_n[l - 1];
+    uint_t j_n = ann->layer_neuron_n[l];
+
+    // Copy tile by tile, so both sides are read and written in cache lines
+    for (uint_t j0 = 0; j0 < j_n; j0 += ANN_BLOCK_TRANSPOSE) {
+      uint_t j1 = (j0 + ANN_BLOCK_TRANSPOSE < j_n) ? j0 + ANN_BLOCK_TRANSPOSE
+                                                    : j_n;
+
+      for (uint_t i0 = 0; i0 < i_n; i0 += ANN_BLOCK_TRANSPOSE) {
+        uint_t i1 = (i0 + ANN_BLOCK_TRANSPOSE < i_n)
+                        ? i0 + ANN_BLOCK_TRANSPOSE
+                        : i_n;
+
+        for (uint_t j = j0; j < j1; j++) {
+          for (uint_t i = i0; i < i1; i++) {
+            t[i * j_n + j] = w[j * (i_n + 1) + i];
+          }
+        }
+      }
+    }
+
+    w += j_n * (i_n + 1);
+    t += j_n * i_n;
+  }
+}
+
+// ann_set_optimizer()
+//
+// Set the optimizer which applies the gradients during training, resetting
+// its state and its hyperparameters to their defaults. The state is held in
+// the allocation, which is resized, so the ann_t instance may be moved. The
+// optimizer state is not saved with the model, and a mapped network is
+// limited to SGD.
+//
+//   - SGD - w -= rate * g
+//   - MOMENTUM - v = beta1 * v + g, w -= rate * v
+//   - NESTEROV - v = beta1 * v + g, w -= rate * ( g + beta1 * v )
+//   - RMSPROP - s = beta2 * s + ( 1 - beta2 ) * g^2,
+//               w -= rate * g / ( sqrt(s) + epsilon )
+//   - ADAM - m = beta1 * m + ( 1 - beta1 ) * g,
+//            v = beta2 * v + ( 1 - beta2 ) * g^2,
+//            w -= rate * m' / ( sqrt(v') + epsilon ), where m' and v' are m and
+//            v divided by their bias corrections
+//
+// ann - The current ann_t instance
+// optimizer - The optimizer
+//
+// return - The ann_t instance, at its possibly new address
+
+ann_t *ann_set_optimizer(ann_t *ann, ann_optimizer_t optimizer) {
+  assert(!ann->map || optimizer == SGD);
+
+  uint_t n = ann->n + sizeof(ann_fp_t) * ann->weight_n *
+                          ann_optimizer_state_n(optimizer) -
+             sizeof(ann_fp_t) * ann->weight_n *
+                 ann_optimizer_state_n(ann->optimizer);
+
+  ann = (ann_t *)realloc(ann, n);
+  ann->n = n;
+  ann->optimizer = optimizer;
+  ann->beta1 = 0.9;
+  ann->beta2 = (optimizer == RMSPROP) ? 0.99 : 0.999;
+  ann->epsilon = 1e-8;
+  ann->step = 0;
+  ann_rebase(ann);
+
+  if (ann->state) {
+    memset(ann->state, 0,
+           sizeof(ann_fp_t) * ann->weight_n * ann_optimizer_state_n(optimizer));
+  }
+
+  // The deltas, sums and transposed weights follow the state, and have moved
+  ann_layout_sync(ann);
+
+  return ann;
+}
+
+// ann_optimizer_step()
+//
+// Begin a training step, advancing the step count and ADAM's bias
+// corrections. Called by the training functions; only needed before
+// ann_gradient_apply_range().
+//
+// ann - The current ann_t instance
+
+void ann_optimizer_step(ann_t *ann) {
+  ann->step++;
+
+  if (ann->optimizer == ADAM) {
+    ann->correction1 = 1 - pow((ann_acc_t)ann->beta1, (ann_acc_t)ann->step);
+    ann->correction2 = 1 - pow((ann_acc_t)ann->beta2, (ann_acc_t)ann->step);
+  }
+}
+
+// ann_optimizer_state_n()
+//
+// Count the state vectors of an optimizer
+//
+// optimizer - The optimizer
+//
+// return - The number of vectors of weight_n elements held by the optimizer
+
+static uint_t ann_optimizer_state_n(ann_optimizer_t optimizer) {
+  switch (optimizer) {
+  case MOMENTUM:
+  case NESTEROV:
+  case RMSPROP:
+    return 1;
+
+  case ADAM:
+    return 2;
+
+  default:
+    return 0;
+  }
+}
+
+// ann_propagation_forward()
+//
+// Perform forward propagation on the ann_t instance
+//
+// ann - The ann_t instance to perform the propagation on
+// input - An array containing the input vector
+// output - The destination array for the output vector
+
+void ann_propagation_forward(ann_t *ann, ann_fp_t const *const input,
+                             ann_fp_t *output) {
+  ann_forward(ann, ann->neuron, ann->sum, input, output);
+}
+
+// ann_propagation_backward()
+//
+// Perform backpropagation on the ann_t instance
+//
+// ann - The ann_t instance to perform backpropagation upon
+// input - Input vector array
+// output - Output vector array
+// target - Target output vector array
+// rate - Learning rate
+
+void ann_propagation_backward(ann_t *ann, ann_fp_t const *input,
+                              ann_fp_t *output, ann_fp_t const *target,
+                              ann_fp_t rate) {
+  assert(!ann->map);
+
+  ann_backward(ann, ann->neuron, ann->sum, ann->delta, input, output, target,
+               rate);
+}
+
+// ann_train_numeric()
+//
+// Train the ann_t instance on a single sample using the numeric gradient, see
+// ann_gradient_numeric(). Orders of magnitude slower than backpropagation,
+// and intended for checking it.
+//
+// ann - The ann_t instance to train
+// input - Input vector array
+// target - Target output vector array
+// rate - Learning rate
+
+void ann_train_numeric(ann_t *ann, ann_fp_t const *input,
+                       ann_fp_t const *target, ann_fp_t rate) {
+  ann_acc_t *gradient = (ann_acc_t *)malloc(sizeof(ann_acc_t) * ann->weight_n);
+
+  ann_gradient_numeric(ann, input, target, gradient);
+  ann_gradient_apply(ann, gradient, rate);
+
+  free(gradient);
+}
+
+// ann_gradient_numeric()
+//
+// Calculate the gradient of the error for a single sample by central
+// differences, perturbing each weight in turn by ANN_NUMERIC_STEP and
+// propagating forward twice. The error is that differentiated by
+// backpropagation, the squared error, or the cross-entropy when the output
+// layer is SOFTMAX, so the result may be compared against ann_gradient_batch()
+// to check the analytic gradient. Each weight is restored afterwards.
+//
+// ann - The ann_t instance, whose neurons are overwritten
+// input - Input vector array
+// target - Target output vector array
+// gradient - The destination of the gradient, stored in the same order as
+//            ann->weight
+
+void ann_gradient_numeric(ann_t *ann, ann_fp_t const *input,
+                          ann_fp_t const *target, ann_acc_t *gradient) {
+  assert(!ann->map);
+
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+  ann_fp_t *output = (ann_fp_t *)malloc(sizeof(ann_fp_t) * output_n);
+
+  for (uint_t i = 0; i < ann->weight_n; i++) {
+    ann_fp_t w = ann->weight[i];
+    ann_fp_t h = ANN_NUMERIC_STEP * ((fabs(w) > 1) ? fabs(w) : 1);
+
+    ann->weight[i] = w + h;
+    ann_forward(ann, ann->neuron, ann->sum, input, output);
+    ann_acc_t error_1 = ann_loss(ann, output, target);
+
+    ann->weight[i] = w - h;
+    ann_forward(ann, ann->neuron, ann->sum, input, output);
+    ann_acc_t error_0 = ann_loss(ann, output, target);
+
+    ann->weight[i] = w;
+    gradient[i] = (error_1 - error_0) / (2 * (ann_acc_t)h);
+  }
+
+  free(output);
+}
+
+// ann_context_init()
+//
+// Allocate the neurons, sums and deltas needed to propagate a single sample
+// through the given ann_t instance, so that the instance itself is not written
+// by ann_propagation_forward_context(). Each thread propagating through a
+// shared ann_t instance uses its own context.
+//
+// ann - The ann_t instance the context will be used with
+//
+// return - The created ann_context_t instance
+
+ann_context_t *ann_context_init(ann_t const *ann) {
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+
+  uint_t n = sizeof(ann_context_t) +
+             (sizeof(ann_fp_t) * (ann->neuron_n +            // neuron[]
+                                  ann->neuron_n + output_n + // delta[]
+                                  ann->neuron_n + output_n)); // sum[]
+
+  // Allocate everything as one structure
+  ann_context_t *context = (ann_context_t *)malloc(n);
+
+  // ann_context_t | neuron[] | delta[] | sum[]
+  context->n = n;
+  context->neuron = (ann_fp_t *)((uint8_t *)context + sizeof(ann_context_t));
+  context->delta = context->neuron + ann->neuron_n;
+  context->sum = context->delta + ann->neuron_n + output_n;
+
+  return context;
+}
+
+// ann_context_free()
+//
+// Free the context's memory
+//
+// context - The instance of ann_context_t to free
+
+void ann_context_free(ann_context_t *context) { free(context); }
+
+// ann_propagation_forward_context()
+//
+// Perform forward propagation, keeping the hidden neurons in the given
+// context. The ann_t instance is only read, so any number of threads may
+// propagate through it at once, each with its own context.
+//
+// ann - The ann_t instance to perform the propagation on
+// context - The context receiving the hidden neurons
+// input - An array containing the input vector
+// output - The destination array for the output vector
+
+void ann_propagation_forward_context(ann_t const *ann, ann_context_t *context,
+                                     ann_fp_t const *input, ann_fp_t *output) {
+  ann_forward(ann, context->neuron, context->sum, input, output);
+}
+
+// ann_propagation_backward_context()
+//
+// Perform backpropagation, using the hidden neurons kept in the given context
+// by ann_propagation_forward_context(), and the context's deltas
+//
+// ann - The ann_t instance to perform backpropagation upon
+// context - The context used for the preceding forward propagation
+// input - Input vector array
+// output - Output vector array
+// target - Target output vector array
+// rate - Learning rate
+
+void ann_propagation_backward_context(ann_t *ann, ann_context_t *context,
+                                      ann_fp_t const *input,
+                                      ann_fp_t const *output,
+                                      ann_fp_t const *target, ann_fp_t rate) {
+  ann_backward(ann, context->neuron, context->sum, context->delta, input,
+               output, target, rate);
+}
+
+// ann_forward()
+//
+// Forward propagation, writing the hidden neurons and the sums before
+// activation to the given arrays
+//
+// ann - The ann_t instance to perform the propagation on
+// neuron - The destination of the hidden neurons, stored as in ann->neuron
+// sum - The destination of the sums, stored as in ann->sum
+// input - An array containing the input vector
+// output - The destination array for the output vector
+
+static void ann_forward(ann_t const *ann, ann_fp_t *neuron, ann_fp_t *sum,
+                        ann_fp_t const *input, ann_fp_t *output) {
+  ann_fp_t const *w_ij = ann->weight;
+  ann_fp_t const *x = input; // Input neuron into y
+  ann_fp_t *y = neuron;      // The current neuron being calculated
+  ann_fp_t *s = sum;         // The sum of the current neuron
+
+  uint_t l = 1;
+
+  for (; l < ann->layer_n - 1; l++) {
+    for (uint_t j = 0; j < ann->layer_neuron_n[l]; j++) {
+      ann_acc_t y_j = ann->kernel->dot(x, w_ij, ann->layer_neuron_n[l - 1]);
+      w_ij += ann->layer_neuron_n[l - 1];
+
+      y_j += *w_ij++;
+      y[j] = s[j] = y_j;
+    }
+
+    ann->activation_hidden_layer(y, ann->layer_neuron_n[l]);
+
+    x = y;
+    y += ann->layer_neuron_n[l];
+    s += ann->layer_neuron_n[l];
+  }
+
+  // Last layer
+  for (uint_t j = 0; j < ann->layer_neuron_n[l]; j++) {
+    ann_acc_t y_j = ann->kernel->dot(x, w_ij, ann->layer_neuron_n[l - 1]);
+    w_ij += ann->layer_neuron_n[l - 1];
+
+    y_j += *w_ij++;
+    output[j] = s[j] = y_j;
+  }
+
+  ann->activation_output_layer(output, ann->layer_neuron_n[l]);
+}
+
+// ann_backward()
+//
+// Backpropagation, using the hidden neurons, sums and deltas in the given
+// arrays
+//
+// ann - The ann_t instance to perform backpropagation upon
+// neuron - The hidden neurons of the preceding forward propagation
+// sum - The sums of the preceding forward propagation, stored as in ann->sum
+// delta - The scratch for the deltas, stored as in ann->delta
+// input - Input vector array
+// output - Output vector array
+// target - Target output vector array
+// rate - Learning rate
+
+static void ann_backward(ann_t *ann, ann_fp_t const *neuron,
+                         ann_fp_t const *sum, ann_fp_t *delta,
+                         ann_fp_t const *input, ann_fp_t const *output,
+                         ann_fp_t const *target, ann_fp_t rate) {
+  int_t l = ann->layer_n - 1;
+  uint_t j;
+
+  // The weights of a mapped ann_t are read only
+  assert(!ann->map);
+
+  ann_optimizer_step(ann);
+
+  // First output layer delta
+  ann_fp_t *d_j = delta + ann->neuron_n;
+
+  // Output Deltas
+  for (j = 0; j < ann->layer_neuron_n[l]; j++) {
+    d_j[j] = ann_error_partial(output[j], target[j]);
+  }
+
+  ann->activation_output_layer_partial(d_j, output, sum + ann->neuron_n,
+                                       ann->layer_neuron_n[l]);
+
+  // First weight in the set between the last layer and the current
+  ann_fp_t *w_jq = ann->weight + ann->weight_n -
+                   ann->layer_neuron_n[l] * ann->layer_neuron_n[l - 1] -
+                   ann->layer_neuron_n[l];
+
+  // One past the transposed weights of the last layer
+  ann_fp_t *t_jq = (ann->layout == TRANSPOSED)
+                       ? ann->transpose + ann_transpose_n(ann)
+                       : NULL;
+
+  ann_fp_t const *o_j = neuron + ann->neuron_n;
+  ann_fp_t const *s_j = sum + ann->neuron_n;
+  ann_fp_t *d_q;
+
+  l--;
+
+  // Hidden Deltas
+  for (; l > 0; --l) {
+    d_q = d_j;
+    d_j -= ann->layer_neuron_n[l];
+    o_j -= ann->layer_neuron_n[l];
+    s_j -= ann->layer_neuron_n[l];
+
+    if (ann->layout == TRANSPOSED) {
+      t_jq -= ann->layer_neuron_n[l + 1] * ann->layer_neuron_n[l];
+
+      for (j = 0; j < ann->layer_neuron_n[l]; j++) {
+        d_j[j] = ann->kernel->dot(t_jq + j * ann->layer_neuron_n[l + 1], d_q,
+                                  ann->layer_neuron_n[l + 1]);
+      }
+    } else {
+      ann->kernel->delta(d_j, w_jq, ann->layer_neuron_n[l] + 1, d_q,
+                         ann->layer_neuron_n[l + 1], ann->layer_neuron_n[l]);
+    }
+
+    ann->activation_hidden_layer_partial(d_j, o_j, s_j,
+                                         ann->layer_neuron_n[l]);
+
+    w_jq -= ann->layer_neuron_n[l] * (ann->layer_neuron_n[l - 1] + 1);
+  }
+
+  ann_backward_update(ann, neuron, delta, input, 1, rate);
+}
+
+// ann_backward_update()
+//
+// Update the weights row by row from the deltas of a single sample, as the
+// last step of backpropagation
+//
+// ann - The ann_t instance to update
+// neuron - The hidden neurons of the sample
+// delta - The deltas of the sample
+// input - Input vector array
+// stride - The number of samples the neuron and delta arrays are laid out
+//          for, each layer taking stride times its neuron count, 1 for those
+//          of ann_t or ann_context_t, or batch_n for those of ann_batch_t
+// rate - Learning rate
+
+static void ann_backward_update(ann_t *ann, ann_fp_t const *neuron,
+                                ann_fp_t const *delta, ann_fp_t const *input,
+                                uint_t stride, ann_fp_t rate) {
+  ann_fp_t *w_ij = ann->weight;
+  ann_fp_t const *d_j = delta;
+  uint_t l = 1, j;
+
+  // Input training
+  for (j = 0; j < ann->layer_neuron_n[l]; j++) {
+    ann_optimize_row(ann, w_ij, d_j[j], input, ann->layer_neuron_n[l - 1],
+                     rate);
+    w_ij += ann->layer_neuron_n[l - 1] + 1;
+  }
+
+  l++;
+  ann_fp_t const *i_i = neuron;
+
+  ann_fp_t *t_ij = ann->transpose;
+  ann_fp_t *r_j = (ann->layout == TRANSPOSED)
+                      ? ann->transpose + ann_transpose_n(ann)
+                      : NULL;
+
+  // Hidden training
+  for (; l < ann->layer_n; l++) {
+    d_j += stride * ann->layer_neuron_n[l - 1];
+
+    for (j = 0; j < ann->layer_neuron_n[l]; j++) {
+      ann_optimize_row(ann, w_ij, d_j[j], i_i, ann->layer_neuron_n[l - 1],
+                       rate);
+      w_ij += ann->layer_neuron_n[l - 1] + 1;
+    }
+
+    // Apply the same products to the transposed copy, one sequential row at a
+    // time, so that both copies hold identical weights
+    if (ann->layout == TRANSPOSED && ann->optimizer == SGD) {
+      for (j = 0; j < ann->layer_neuron_n[l]; j++) {
+        r_j[j] = -rate * d_j[j];
+      }
+
+      for (uint_t i = 0; i < ann->layer_neuron_n[l - 1]; i++) {
+        ann->kernel->axpy(t_ij, i_i[i], r_j, ann->layer_neuron_n[l]);
+        t_ij += ann->layer_neuron_n[l];
+      }
+    }
+
+    i_i += stride * ann->layer_neuron_n[l - 1];
+  }
+
+  // The other optimizers' updates aren't products of the deltas and neurons
+  if (ann->optimizer != SGD)
+    ann_layout_sync(ann);
+}
+
+// ANN_OPTIMIZE()
+//
+// Update consecutive weights with the optimizer of the network, other than
+// SGD, from the gradient of each weight
+//
+// ann - The ann_t instance
+// w - The first weight to update, within ann->weight
+// n - The number of weights
+// gradient - The gradient of w[i], as an expression of i
+// rate - Learning rate
+
+#define ANN_OPTIMIZE(ann, w, n, gradient, rate)                                \
+  do {                                                                         \
+    ann_fp_t *s_ = (ann)->state + ((w) - (ann)->weight);                       \
+    ann_fp_t *v_ = s_ + (ann)->weight_n;                                       \
+    ann_acc_t b1_ = (ann)->beta1, b2_ = (ann)->beta2;                          \
+                                                                               \
+    /* ADAM's bias corrections, folded into its rate and epsilon */            \
+    ann_acc_t r_ = (rate), e_ = (ann)->epsilon;                                \
+    if ((ann)->optimizer == ADAM) {                                            \
+      r_ *= sqrt((ann)->correction2) / (ann)->correction1;                     \
+      e_ *= sqrt((ann)->correction2);                                          \
+    }                                                                          \
+                                                                               \
+    switch ((ann)->optimizer) {                                                \
+    case MOMENTUM:                                                             \
+      for (uint_t i = 0; i < (n); i++) {                                       \
+        ann_acc_t g_ = (gradient);                                             \
+        s_[i] = b1_ * s_[i] + g_;                                              \
+        (w)[i] -= r_ * s_[i];                                                  \
+      }                                                                        \
+      break;                                                                   \
+                                                                               \
+    case NESTEROV:                                                             \
+      for (uint_t i = 0; i < (n); i++) {                                       \
+        ann_acc_t g_ = (gradient);                                             \
+        s_[i] = b1_ * s_[i] + g_;                                              \
+        (w)[i] -= r_ * (g_ + b1_ * s_[i]);                                     \
+      }                                                                        \
+      break;                                                                   \
+                                                                               \
+    case RMSPROP:                                                              \
+      for (uint_t i = 0; i < (n); i++) {                                       \
+        ann_acc_t g_ = (gradient);                                             \
+        s_[i] = b2_ * s_[i] + (1 - b2_) * g_ * g_;                             \
+        (w)[i] -= r_ * g_ / (sqrt((ann_acc_t)s_[i]) + e_);                     \
+      }                                                                        \
+      break;                                                                   \
+                                                                               \
+    case ADAM:                                                                 \
+      for (uint_t i = 0; i < (n); i++) {                                       \
+        ann_acc_t g_ = (gradient);                                             \
+        s_[i] = b1_ * s_[i] + (1 - b1_) * g_;                                  \
+        v_[i] = b2_ * v_[i] + (1 - b2_) * g_ * g_;                             \
+        (w)[i] -= r_ * s_[i] / (sqrt((ann_acc_t)v_[i]) + e_);                  \
+      }                                                                        \
+      break;                                                                   \
+                                                                               \
+    default:                                                                   \
+      break;                                                                   \
+    }                                                                          \
+  } while (0)
+
+// ann_optimize_row()
+//
+// Update the weights and bias of a single neuron from its delta, within the
+// backpropagation of a single sample, so that each weight is read and written
+// once
+//
+// ann - The ann_t instance
+// w - The n weights of the neuron, followed by its bias
+// d - The delta of the neuron
+// x - The n neurons of the previous layer
+// n - The neuron count of the previous layer
+// rate - Learning rate
+
+static void ann_optimize_row(ann_t *ann, ann_fp_t *w, ann_fp_t d,
+                             ann_fp_t const *x, uint_t n, ann_fp_t rate) {
+  if (ann->optimizer == SGD) {
+    ann->kernel->axpy(w, -rate * d, x, n);
+    w[n] -= rate * d;
+    return;
+  }
+
+  ANN_OPTIMIZE(ann, w, n, d * x[i], rate);
+  ANN_OPTIMIZE(ann, w + n, 1, d, rate);
+}
+
+// ann_batch_init()
+//
+// Allocate the scratch memory required to propagate a batch of samples
+// through the given ann_t instance
+//
+// ann - The ann_t instance the batch will be used with
+// batch_n - The maximum number of samples in a single batch
+//
+// return - The created ann_batch_t instance, or NULL if it could not be
+//          allocated
+
+ann_batch_t *ann_batch_init(ann_t const *ann, uint_t batch_n) {
+  assert(batch_n > 0);
+
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+
+  uint_t n = sizeof(ann_batch_t) +
+             (sizeof(ann_acc_t) * ann->weight_n) + // gradient[]
+             (sizeof(ann_fp_t) *
+              (batch_n * ann->neuron_n +               // neuron[]
+               batch_n * (ann->neuron_n + output_n) +  // delta[]
+               batch_n * (ann->neuron_n + output_n))); // sum[]
+
+  // Allocate everything as one structure
+  ann_batch_t *batch = (ann_batch_t *)malloc(n);
+
+  if (!batch)
+    return NULL;
+
+  // ann_batch_t | gradient[] | neuron[] | delta[] | sum[]
+  //   - The gradient comes first, as ann_acc_t may be wider than ann_fp_t
+  batch->n = n;
+  batch->batch_n = batch_n;
+  batch->gradient = (ann_acc_t *)((uint8_t *)batch + sizeof(ann_batch_t));
+  batch->neuron = (ann_fp_t *)(batch->gradient + ann->weight_n);
+  batch->delta = batch->neuron + batch_n * ann->neuron_n;
+  batch->sum = batch->delta + batch_n * (ann->neuron_n + output_n);
+
+  memset(batch->gradient, 0, sizeof(ann_acc_t) * ann->weight_n);
+
+  return batch;
+}
+
+// ann_batch_free()
+//
+// Free the batch's memory
+//
+// batch - The instance of ann_batch_t to free
+
+void ann_batch_free(ann_batch_t *batch) { free(batch); }
+
+// ann_propagation_forward_batch()
+//
+// Perform forward propagation for a batch of samples. Each layer is evaluated
+// as a blocked matrix product, so each weight row is reused across a block of
+// samples. The results are identical to calling ann_propagation_forward() on
+// each sample.
+//
+// ann - The ann_t instance to perform the propagation on
+// batch - The scratch memory receiving the hidden neurons
+// input - An array of batch_n input vectors, stored contiguously
+// batch_n - The number of samples in the batch
+// output - The destination array for the batch_n output vectors
+
+void ann_propagation_forward_batch(ann_t const *ann, ann_batch_t *batch,
+                                   ann_fp_t const *input, uint_t batch_n,
+                                   ann_fp_t *output) {
+  assert(batch_n <= batch->batch_n);
+
+  ann_fp_t const *w = ann->weight;
+  ann_fp_t const *x = input;
+  ann_fp_t *y = batch->neuron;
+  ann_fp_t *s = batch->sum;
+
+  uint_t l = 1;
+
+  for (; l < ann->layer_n - 1; l++) {
+    ann_layer_forward_batch(ann->kernel, x, w, y, s, batch_n,
+                            ann->layer_neuron_n[l - 1], ann->layer_neuron_n[l],
+                            ann->activation_hidden_layer);
+
+    w += ann->layer_neuron_n[l] * (ann->layer_neuron_n[l - 1] + 1);
+    x = y;
+    y += batch->batch_n * ann->layer_neuron_n[l];
+    s += batch->batch_n * ann->layer_neuron_n[l];
+  }
+
+  // Last layer
+  ann_layer_forward_batch(ann->kernel, x, w, output, s, batch_n,
+                          ann->layer_neuron_n[l - 1], ann->layer_neuron_n[l],
+                          ann->activation_output_layer);
+}
+
+// ann_propagation_backward_batch()
+//
+// Perform backpropagation for a batch of samples. The gradients of every
+// sample are summed before the weights are updated. A batch of one sample
+// updates the weights row by row from its deltas instead, as
+// ann_propagation_backward() does, so that both give identical weights.
+//
+// ann - The ann_t instance to perform backpropagation upon
+// batch - The batch used for the preceding ann_propagation_forward_batch()
+// input - The batch_n input vectors
+// output - The batch_n output vectors
+// target - The batch_n target output vectors
+// batch_n - The number of samples in the batch
+// rate - Learning rate
+
+void ann_propagation_backward_batch(ann_t *ann, ann_batch_t *batch,
+                                    ann_fp_t const *input,
+                                    ann_fp_t const *output,
+                                    ann_fp_t const *target, uint_t batch_n,
+                                    ann_fp_t rate) {
+  assert(!ann->map);
+
+  if (batch_n == 1) {
+    ann_delta_batch(ann, batch, output, target, batch_n);
+    ann_optimizer_step(ann);
+    ann_backward_update(ann, batch->neuron, batch->delta, input,
+                        batch->batch_n, rate);
+    return;
+  }
+
+  memset(batch->gradient, 0, sizeof(ann_acc_t) * ann->weight_n);
+
+  ann_gradient_batch(ann, batch, input, output, target, batch_n);
+  ann_gradient_apply(ann, batch->gradient, rate);
+}
+
+// ann_gradient_batch()
+//
+// Accumulate the gradient of the error for a batch of samples into
+// batch->gradient. The gradient is not cleared beforehand, allowing several
+// batches to be accumulated before a single update.
+//
+// ann - The ann_t instance the gradient is calculated for
+// batch - The batch used for the preceding ann_propagation_forward_batch()
+// input - The batch_n input vectors
+// output - The batch_n output vectors
+// target - The batch_n target output vectors
+// batch_n - The number of samples in the batch
+
+void ann_gradient_batch(ann_t const *ann, ann_batch_t *batch,
+                        ann_fp_t const *input, ann_fp_t const *output,
+                        ann_fp_t const *target, uint_t batch_n) {
+  ann_delta_batch(ann, batch, output, target, batch_n);
+
+  ann_acc_t *g = batch->gradient;
+  ann_fp_t const *d_j = batch->delta;
+
+  uint_t l = 1;
+
+  // Input gradients
+  ann_layer_gradient_batch(ann->kernel, input, d_j, g, batch_n,
+                           ann->layer_neuron_n[l - 1], ann->layer_neuron_n[l]);
+
+  l++;
+  ann_fp_t const *i_i = batch->neuron;
+
+  // Hidden gradients
+  for (; l < ann->layer_n; l++) {
+    g += ann->layer_neuron_n[l - 1] * (ann->layer_neuron_n[l - 2] + 1);
+    d_j += batch->batch_n * ann->layer_neuron_n[l - 1];
+
+    ann_layer_gradient_batch(ann->kernel, i_i, d_j, g, batch_n,
+                             ann->layer_neuron_n[l - 1],
+                             ann->layer_neuron_n[l]);
+
+    i_i += batch->batch_n * ann->layer_neuron_n[l - 1];
+  }
+}
+
+// ann_delta_batch()
+//
+// Calculate the deltas of every layer for a batch of samples into
+// batch->delta
+//
+// ann - The ann_t instance the deltas are calculated for
+// batch - The batch used for the preceding ann_propagation_forward_batch()
+// output - The batch_n output vectors
+// target - The batch_n target output vectors
+// batch_n - The number of samples in the batch
+
+static void ann_delta_batch(ann_t const *ann, ann_batch_t *batch,
+                            ann_fp_t const *output, ann_fp_t const *target,
+                            uint_t batch_n) {
+  assert(batch_n <= batch->batch_n);
+
+  uint_t l = ann->layer_n - 1;
+  uint_t output_n = ann->layer_neuron_n[l];
+
+  // Output deltas
+  ann_fp_t *d_q = batch->delta + batch->batch_n * ann->neuron_n;
+
+  for (uint_t s = 0; s < batch_n * output_n; s++) {
+    d_q[s] = ann_error_partial(output[s], target[s]);
+  }
+
+  ann_fp_t const *s_j = batch->sum + batch->batch_n * ann->neuron_n;
+
+  ann->activation_output_layer_partial(d_q, output, s_j, batch_n * output_n);
+
+  // The weights between the last hidden layer and the output layer
+  ann_fp_t const *w_q =
+      ann->weight + ann->weight_n -
+      ann->layer_neuron_n[l] * (ann->layer_neuron_n[l - 1] + 1);
+
+  // One past the transposed weights of the last layer
+  ann_fp_t const *t_q = (ann->layout == TRANSPOSED)
+                            ? ann->transpose + ann_transpose_n(ann)
+                            : NULL;
+
+  ann_fp_t const *o_j = batch->neuron + batch->batch_n * ann->neuron_n;
+  ann_fp_t *d_j = d_q;
+
+  // Hidden deltas
+  for (l--; l > 0; l--) {
+    d_j -= batch->batch_n * ann->layer_neuron_n[l];
+    o_j -= batch->batch_n * ann->layer_neuron_n[l];
+    s_j -= batch->batch_n * ann->layer_neuron_n[l];
+
+    if (t_q)
+      t_q -= ann->layer_neuron_n[l + 1] * ann->layer_neuron_n[l];
+
+    ann_layer_delta_batch(ann->kernel, w_q, t_q, d_q, o_j, s_j, d_j, batch_n,
+                          ann->layer_neuron_n[l], ann->layer_neuron_n[l + 1],
+                          ann->activation_hidden_layer_partial);
+
+    d_q = d_j;
+    w_q -= ann->layer_neuron_n[l] * (ann->layer_neuron_n[l - 1] + 1);
+  }
+}
+
+// ann_gradient_apply()
+//
+// Update the weights of the ann_t instance from an accumulated gradient, as a
+// single step of its optimizer
+//
+// ann - The ann_t instance to update
+// gradient - The gradient, stored in the same order as ann->weight
+// rate - Learning rate
+
+void ann_gradient_apply(ann_t *ann, ann_acc_t const *gradient, ann_fp_t rate) {
+  assert(!ann->map);
+
+  ann_optimizer_step(ann);
+  ann_gradient_apply_range(ann, gradient, 0, ann->weight_n, rate);
+  ann_layout_sync(ann);
+}
+
+// ann_gradient_apply_range()
+//
+// Apply the gradient to the weights from i0 up to i1 alone, as part of an
+// optimizer step begun by ann_optimizer_step(). The transposed weights are
+// not refreshed. Disjoint ranges may be applied by several threads at once.
+//
+// ann - The ann_t instance to update
+// gradient - The gradient, stored in the same order as ann->weight
+// i0 - The first weight to update
+// i1 - One past the last weight to update
+// rate - Learning rate
+
+void ann_gradient_apply_range(ann_t *ann, ann_acc_t const *gradient, uint_t i0,
+                              uint_t i1, ann_fp_t rate) {
+  assert(!ann->map);
+
+  if (ann->optimizer == SGD) {
+    ann->kernel->update(ann->weight + i0, -rate, gradient + i0, i1 - i0);
+    return;
+  }
+
+  ann_acc_t const *g = gradient + i0;
+  ANN_OPTIMIZE(ann, ann->weight + i0, i1 - i0, g[i], rate);
+}
+
+// ann_layer_forward_batch()
+//
+// Evaluate a single layer for a batch of samples, y = f( x * w^T + b )
+//
+// kernel - The dense layer kernels
+// x - The [batch_n][x_n] layer inputs
+// w - The [y_n][x_n + 1] layer weights and biases
+// y - The [batch_n][y_n] layer outputs
+// sum - The [batch_n][y_n] layer sums, x * w^T + b
+// batch_n - The number of samples
+// x_n - The neuron count of the previous layer
+// y_n - The neuron count of the current layer
+// activation - The layer activation function of the current layer
+
+static void ann_layer_forward_batch(ann_kernel_t const *kernel,
+                                    ann_fp_t const *x, ann_fp_t const *w,
+                                    ann_fp_t *y, ann_fp_t *sum, uint_t batch_n,
+                                    uint_t x_n, uint_t y_n,
+                                    void (*activation)(ann_fp_t *, uint_t)) {
+  for (uint_t s0 = 0; s0 < batch_n; s0 += ANN_BLOCK_SAMPLE) {
+    uint_t s1 = (s0 + ANN_BLOCK_SAMPLE < batch_n) ? s0 + ANN_BLOCK_SAMPLE
+                                                   : batch_n;
+
+    for (uint_t j = 0; j < y_n; j++) {
+      ann_fp_t const *w_j = w + j * (x_n + 1);
+      uint_t s = s0;
+
+      // Each sum is accumulated in ann_acc_t before it is stored, four
+      // samples sharing each load of the weight row
+      for (; s + 4 <= s1; s += 4) {
+        ann_acc_t y_s[4];
+        kernel->dot4(y_s, w_j, x + s * x_n, x_n, x_n);
+
+        for (uint_t k = 0; k < 4; k++) {
+          y[(s + k) * y_n + j] = sum[(s + k) * y_n + j] = y_s[k] + w_j[x_n];
+        }
+      }
+
+      for (; s < s1; s++) {
+        ann_acc_t y_sj = kernel->dot(x + s * x_n, w_j, x_n);
+        y[s * y_n + j] = sum[s * y_n + j] = y_sj + w_j[x_n];
+      }
+    }
+
+    for (uint_t s = s0; s < s1; s++) {
+      activation(y + s * y_n, y_n);
+    }
+  }
+}
+
+// ann_layer_delta_batch()
+//
+// Calculate the deltas of a hidden layer for a batch of samples. The weights
+// of the following layer are walked row by row, so each row is read
+// sequentially and reused for a block of samples.
+//
+// kernel - The dense layer kernels
+// w - The [q_n][j_n + 1] weights of the following layer
+// t - The [j_n][q_n] transposed weights of the following layer, or NULL
+// d_q - The [batch_n][q_n] deltas of the following layer
+// o_j - The [batch_n][j_n] neurons of the current layer
+// s_j - The [batch_n][j_n] sums of the current layer
+// d_j - The [batch_n][j_n] destination deltas of the current layer
+// batch_n - The number of samples
+// j_n - The neuron count of the current layer
+// q_n - The neuron count of the following layer
+// partial - The layer partial derivative of the hidden activation function
+
+static void ann_layer_delta_batch(ann_kernel_t const *kernel,
+                                  ann_fp_t const *w, ann_fp_t const *t,
+                                  ann_fp_t const *d_q, ann_fp_t const *o_j,
+                                  ann_fp_t const *s_j, ann_fp_t *d_j,
+                                  uint_t batch_n, uint_t j_n, uint_t q_n,
+                                  void (*partial)(ann_fp_t *, ann_fp_t const *,
+                                                  ann_fp_t const *, uint_t)) {
+  for (uint_t s0 = 0; s0 < batch_n; s0 += ANN_BLOCK_SAMPLE) {
+    uint_t s1 = (s0 + ANN_BLOCK_SAMPLE < batch_n) ? s0 + ANN_BLOCK_SAMPLE
+                                                   : batch_n;
+
+    if (t) {
+      // Each transposed row is reused for the block of samples
+      for (uint_t j = 0; j < j_n; j++) {
+        uint_t s = s0;
+
+        for (; s + 4 <= s1; s += 4) {
+          ann_acc_t d_s[4];
+          kernel->dot4(d_s, t + j * q_n, d_q + s * q_n, q_n, q_n);
+
+          for (uint_t k = 0; k < 4; k++) {
+            d_j[(s + k) * j_n + j] = d_s[k];
+          }
+        }
+
+        for (; s < s1; s++) {
+          d_j[s * j_n + j] = kernel->dot(t + j * q_n, d_q + s * q_n, q_n);
+        }
+      }
+    } else {
+      for (uint_t s = s0; s < s1; s++) {
+        kernel->delta(d_j + s * j_n, w, j_n + 1, d_q + s * q_n, q_n, j_n);
+      }
+    }
+
+    partial(d_j + s0 * j_n, o_j + s0 * j_n, s_j + s0 * j_n, (s1 - s0) * j_n);
+  }
+}
+
+// ann_layer_gradient_batch()
+//
+// Accumulate the weight and bias gradients of a single layer for a batch of
+// samples, g += d^T * x
+//
+// kernel - The dense layer kernels
+// x - The [batch_n][x_n] layer inputs
+// d - The [batch_n][y_n] layer deltas
+// g - The [y_n][x_n + 1] layer gradient
+// batch_n - The number of samples
+// x_n - The neuron count of the previous layer
+// y_n - The neuron count of the current layer
+
+static void ann_layer_gradient_batch(ann_kernel_t const *kernel,
+                                     ann_fp_t const *x, ann_fp_t const *d,
+                                     ann_acc_t *g, uint_t batch_n, uint_t x_n,
+                                     uint_t y_n) {
+  for (uint_t s0 = 0; s0 < batch_n; s0 += ANN_BLOCK_SAMPLE) {
+    uint_t s1 = (s0 + ANN_BLOCK_SAMPLE < batch_n) ? s0 + ANN_BLOCK_SAMPLE
+                                                   : batch_n;
+
+    for (uint_t j = 0; j < y_n; j++) {
+      ann_acc_t *g_j = g + j * (x_n + 1);
+
+      for (uint_t s = s0; s < s1; s++) {
+        kernel->gradient(g_j, d[s * y_n + j], x + s * x_n, x_n);
+        g_j[x_n] += d[s * y_n + j];
+      }
+    }
+  }
+}
+
+// ann_activation_identity()
+//
+// y = x
+// dy/dx = 1
+
+static ann_fp_t ann_activation_identity(ann_fp_t x) { return x; }
+static ann_fp_t ann_activation_identity_partial(ann_fp_t x) { return 1; }
+
+// ann_activation_binary()
+//
+// y = { x < 0 -> 0, x > 0 -> 1 }
+// dy/dx = 0
+
+static ann_fp_t ann_activation_binary(ann_fp_t x) {
+  return (x > 0.0) ? 1.0 : (x < 0.0) ? -1.0 : 0.0;
+}
+static ann_fp_t ann_activation_binary_partial(ann_fp_t x) { return 0.0; }
+
+// ann_activation_sign()
+//
+// y = { x < 0 -> -1, x = 0 -> 0, x > 0 -> 1 }
+// dy/dx = 0
+
+static ann_fp_t ann_activation_sign(ann_fp_t x) {
+  return (x > 0.0) ? 1.0 : 0.0;
+}
+static ann_fp_t ann_activation_sign_partial(ann_fp_t x) { return 0.0; }
+
+// ann_activation_sigmoid()
+//
+// y = 1.0 / ( 1.0 + e^-x )
+// dy/dx = f(x) * ( 1.0 - f(x) )
+
+static ann_fp_t ann_activation_sigmoid(ann_fp_t x) {
+  return 1.0 / (1.0 + exp(-x));
+}
+static ann_fp_t ann_activation_sigmoid_partial(ann_fp_t x) {
+  return x * (1.0 - x);
+}
+
+// ann_activation_relu()
+//
+// y = { x < 0 -> 0, x >= 0 -> x }
+// dy/dx = { x < 0 -> 0, x >= 0 -> 1 }
+
+static ann_fp_t ann_activation_relu(ann_fp_t x) { return (x > 0.0) ? x : 0.0; }
+static ann_fp_t ann_activation_relu_partial(ann_fp_t x) {
+  return (x > 0.0) ? 1.0 : 0.0;
+}
+
+// ann_activation_elu()
+//
+// y = { x < 0 -> a * ( e^x - 1 ), x >= 0 -> x }
+// dy/dx = { x < 0 -> x + a, x >= 0 -> 1 }
+
+static ann_fp_t ann_activation_elu(ann_fp_t x) {
+  return (x > 0.0) ? x : ELU_ALPHA * (expm1(x));
+}
+static ann_fp_t ann_activation_elu_partial(ann_fp_t x) {
+  return (x > 0.0) ? 1.0 : x + ELU_ALPHA;
+}
+
+// ann_activation_lelu()
+//
+// y = { x < 0 -> a * x, x >= 0 -> x }
+// dy/dx = { x < 0 -> a, x >= 0 -> 1 }
+
+static ann_fp_t ann_activation_lrelu(ann_fp_t x) {
+  return (x > 0.0) ? x : LRELU_ALPHA * x;
+}
+static ann_fp_t ann_activation_lrelu_partial(ann_fp_t x) {
+  return (x > 0.0) ? 1.0 : LRELU_ALPHA;
+}
+
+// ann_activation_tanh()
+//
+// y = sinh( x ) / cosh( x ) = ( e^2x - 1 ) / ( e^2x + 1 )
+// dy/dx = 1.0 - f(x)^2
+
+static ann_fp_t ann_activation_tanh(ann_fp_t x) { return tanh(x); }
+static ann_fp_t ann_activation_tanh_partial(ann_fp_t x) {
+  return 1.0 - (x * x);
+}
+
+// ann_activation_gelu()
+//
+// y = 0.5 * x * ( 1.0 + tanh( sqrt( 2 / pi ) * ( x + b * x^3 ) ) )
+// dy/dx = 0.5 * ( 1.0 + tanh(u) ) + 0.5 * x * ( 1.0 - tanh(u)^2 ) * du/dx
+//
+// GELU is not invertible, so unlike the others its partial derivative is a
+// function of the sum x rather than of the output y
+
+static ann_fp_t ann_activation_gelu(ann_fp_t x) {
+  ann_fp_t u = SQUARE_ROOT_2_OVER_PI * (x + GELU_BETA * x * x * x);
+
+  return 0.5 * x * (1.0 + tanh(u));
+}
+static ann_fp_t ann_activation_gelu_partial(ann_fp_t x) {
+  ann_fp_t u = SQUARE_ROOT_2_OVER_PI * (x + GELU_BETA * x * x * x);
+  ann_fp_t du = SQUARE_ROOT_2_OVER_PI * (1.0 + 3.0 * GELU_BETA * x * x);
+  ann_fp_t t = tanh(u);
+
+  return 0.5 * (1.0 + t) + 0.5 * x * (1.0 - t * t) * du;
+}
+
+// ann_activation_softmax_layer()
+//
+// y_j = e^x_j / sum( e^x_k )
+//
+// The largest x is subtracted from every x before exponentiation, which leaves
+// y unchanged but keeps e^x from overflowing
+
+static void ann_activation_softmax_layer(ann_fp_t *y, uint_t n) {
+  ann_fp_t max = y[0];
+  for (uint_t i = 1; i < n; i++) {
+    max = (y[i] > max) ? y[i] : max;
+  }
+
+  ann_acc_t sum = 0;
+  for (uint_t i = 0; i < n; i++) {
+    y[i] = exp(y[i] - max);
+    sum += y[i];
+  }
+
+  for (uint_t i = 0; i < n; i++) {
+    y[i] /= sum;
+  }
+}
+
+// ann_error()
+//
+// Implementation of mean squared error for calculating the difference between
+// the current and target outputs for the ann_t instance
+//
+// output - The current ann_t output
+// target - The target ann_t output
+
+ann_fp_t ann_error(ann_fp_t output, ann_fp_t target) {
+  ann_fp_t error = output - target;
+  error = 0.5 * error * error;
+
+  return error;
+}
+
+// ann_error_partial()
+//
+// The partial derivative of mean squared error where n = 2
+//
+// output - The current ann_t output
+// target - The target ann_t output
+
+ann_fp_t ann_error_partial(ann_fp_t output, ann_fp_t target) {
+  return (output - target);
+}
+
+// ann_loss()
+//
+// The error of a single output vector minimized by backpropagation, the
+// squared error, or the cross-entropy when the output layer is SOFTMAX
+//
+// ann - The ann_t instance which calculated the output
+// output - The array of current outputs
+// target - The array of target outputs
+//
+// return - The error
+
+static ann_acc_t ann_loss(ann_t const *ann, ann_fp_t const *output,
+                          ann_fp_t const *target) {
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+
+  if (ann->activation_output_id != SOFTMAX)
+    return ann_error_total(output, target, output_n);
+
+  ann_acc_t error = 0;
+  for (uint_t i = 0; i < output_n; i++) {
+    error -= target[i] * log((ann_acc_t)output[i]);
+  }
+
+  return error;
+}
 
 // ann_error_total()
 //
@@ -459,8 +2594,9 @@ fp_t ann_error_partial(fp_t output, fp_t target) { return (output - target); }
 // target - The array of target outputs
 // n - The size of the output and target arrays
 
-fp_t ann_error_total(fp_t const *output, fp_t const *target, uint_t n) {
-  fp_t error = 0;
+ann_fp_t ann_error_total(ann_fp_t const *output, ann_fp_t const *target,
+                         uint_t n) {
+  ann_acc_t error = 0;
   for (uint_t i = 0; i < n; i++) {
     error += ann_error(output[i], target[i]);
   }
@@ -470,7 +2606,9 @@ fp_t ann_error_total(fp_t const *output, fp_t const *target, uint_t n) {
 
 // ann_set_activation()
 //
-// Set the activation functions for the hidden and output layers
+// Set the activation functions for the hidden and output layers. SOFTMAX is
+// only differentiated as an output paired with the cross-entropy error, and
+// may not be used in the hidden layers.
 //
 // ann - The current ann_t instance
 // activation_hidden - The hidden layer activation function
@@ -478,10 +2616,205 @@ fp_t ann_error_total(fp_t const *output, fp_t const *target, uint_t n) {
 
 void ann_set_activation(ann_t *ann, ann_activation_t activation_hidden,
                         ann_activation_t activation_output) {
+  assert(activation_hidden != SOFTMAX);
+
+  ann->activation_hidden_id = activation_hidden;
+  ann->activation_output_id = activation_output;
+
   ann->activation_hidden = ACTIVATION[activation_hidden][0];
   ann->activation_hidden_partial = ACTIVATION[activation_hidden][1];
   ann->activation_output = ACTIVATION[activation_output][0];
   ann->activation_output_partial = ACTIVATION[activation_output][1];
+
+  ann_activation_resolve(ann);
+}
+
+// ann_set_accuracy()
+//
+// Set the accuracy of the layer activation functions. EXACT evaluates e^x and
+// tanh(x) with libm, one neuron at a time. APPROXIMATE and FAST evaluate a
+// whole vector register of neurons at once with a polynomial approximation of
+// e^x, see ANN_EXP(), and fall back to EXACT with the SCALAR kernels. The
+// accuracy is not saved with the model.
+//
+// ann - The current ann_t instance
+// accuracy - The accuracy of the activation functions
+
+void ann_set_accuracy(ann_t *ann, ann_accuracy_t accuracy) {
+  ann->accuracy = accuracy;
+
+  ann_activation_resolve(ann);
+}
+
+// ann_activation_resolve()
+//
+// Select the layer activation functions for the activations, the accuracy and
+// the kernels of the network, so that propagation makes one indirect call per
+// layer rather than one per neuron
+//
+// ann - The current ann_t instance
+
+static void ann_activation_resolve(ann_t *ann) {
+  ann_activation_t hidden = ann->activation_hidden_id;
+  ann_activation_t output = ann->activation_output_id;
+
+  ann->activation_hidden_layer = ACTIVATION_LAYER[hidden];
+  ann->activation_hidden_layer_partial = ACTIVATION_LAYER_PARTIAL[hidden];
+  ann->activation_output_layer = ACTIVATION_LAYER[output];
+  ann->activation_output_layer_partial = ACTIVATION_LAYER_PARTIAL[output];
+
+  if (ann->accuracy == EXACT)
+    return;
+
+  void (*const *activation)(ann_fp_t *, uint_t) =
+      ann->kernel->activation[ann->accuracy - 1];
+
+  if (activation[hidden])
+    ann->activation_hidden_layer = activation[hidden];
+
+  if (activation[output])
+    ann->activation_output_layer = activation[output];
+}
+
+// ann_set_simd()
+//
+// Set the instruction set used by the dense layer kernels
+//
+// ann - The current ann_t instance
+// simd - The instruction set, which must be supported by the processor
+
+void ann_set_simd(ann_t *ann, ann_simd_t simd) {
+  switch (simd) {
+#ifdef ANN_SIMD_X86
+  case AVX512:
+    ann->kernel = &ann_kernel_avx512;
+    break;
+
+  case AVX2:
+    ann->kernel = &ann_kernel_avx2;
+    break;
+
+  case SSE2:
+    ann->kernel = &ann_kernel_sse2;
+    break;
+#endif
+
+  default:
+    ann->kernel = &ann_kernel_scalar;
+    break;
+  }
+
+  ann_activation_resolve(ann);
+}
+
+// ann_simd_detect()
+//
+// Query the processor for the widest supported instruction set
+//
+// return - The best instruction set available for the dense layer kernels
+
+ann_simd_t ann_simd_detect(void) {
+#ifdef ANN_SIMD_X86
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512f"))
+    return AVX512;
+
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return AVX2;
+
+  if (__builtin_cpu_supports("sse2"))
+    return SSE2;
+#endif
+
+  return SCALAR;
+}
+
+// ann_dot_scalar()
+//
+// Portable dot product kernel, see ann_kernel_t
+
+static ann_acc_t ann_dot_scalar(ann_fp_t const *x, ann_fp_t const *w,
+                                uint_t n) {
+  ann_acc_t y = 0;
+  for (uint_t i = 0; i < n; i++) {
+    y += (ann_acc_t)x[i] * w[i];
+  }
+
+  return y;
+}
+
+// ann_dot4_scalar()
+//
+// Portable dot product kernel for four samples at once, see ann_kernel_t
+
+static void ann_dot4_scalar(ann_acc_t *y, ann_fp_t const *w,
+                            ann_fp_t const *x, uint_t stride, uint_t n) {
+  ann_acc_t y_0 = 0, y_1 = 0, y_2 = 0, y_3 = 0;
+
+  for (uint_t i = 0; i < n; i++) {
+    ann_acc_t w_i = w[i];
+
+    y_0 += (ann_acc_t)x[i] * w_i;
+    y_1 += (ann_acc_t)x[stride + i] * w_i;
+    y_2 += (ann_acc_t)x[2 * stride + i] * w_i;
+    y_3 += (ann_acc_t)x[3 * stride + i] * w_i;
+  }
+
+  y[0] = y_0;
+  y[1] = y_1;
+  y[2] = y_2;
+  y[3] = y_3;
+}
+
+// ann_axpy_scalar()
+//
+// Portable y += a * x kernel, see ann_kernel_t
+
+static void ann_axpy_scalar(ann_fp_t *y, ann_acc_t a, ann_fp_t const *x,
+                            uint_t n) {
+  for (uint_t i = 0; i < n; i++) {
+    y[i] = y[i] + a * x[i];
+  }
+}
+
+// ann_delta_scalar()
+//
+// Portable delta accumulation kernel, see ann_kernel_t
+
+static void ann_delta_scalar(ann_fp_t *y, ann_fp_t const *w, uint_t stride,
+                             ann_fp_t const *x, uint_t m, uint_t n) {
+  for (uint_t j = 0; j < n; j++) {
+    ann_acc_t y_j = 0;
+
+    for (uint_t q = 0; q < m; q++) {
+      y_j += (ann_acc_t)w[q * stride + j] * x[q];
+    }
+
+    y[j] = y_j;
+  }
+}
+
+// ann_gradient_scalar()
+//
+// Portable gradient accumulation kernel, see ann_kernel_t
+
+static void ann_gradient_scalar(ann_acc_t *g, ann_acc_t a, ann_fp_t const *x,
+                                uint_t n) {
+  for (uint_t i = 0; i < n; i++) {
+    g[i] += a * x[i];
+  }
+}
+
+// ann_update_scalar()
+//
+// Portable gradient application kernel, see ann_kernel_t
+
+static void ann_update_scalar(ann_fp_t *y, ann_acc_t a, ann_acc_t const *g,
+                              uint_t n) {
+  for (uint_t i = 0; i < n; i++) {
+    y[i] = y[i] + a * g[i];
+  }
 }
 
 // ann_random()
@@ -492,7 +2825,7 @@ void ann_set_activation(ann_t *ann, ann_activation_t activation_hidden,
 
 void ann_random(ann_t *ann) {
   uint_t l, j, i;
-  fp_t *wb = ann->weight;
+  ann_fp_t *wb = ann->weight;
   for (l = 1; l < ann->layer_n; l++) {
     for (j = 0; j < ann->layer_neuron_n[l]; j++) {
       i = 0;
@@ -503,6 +2836,8 @@ void ann_random(ann_t *ann) {
       *wb++ = 0;
     }
   }
+
+  ann_layout_sync(ann);
 }
 
 // ann_random_range()
@@ -512,8 +2847,8 @@ void ann_random(ann_t *ann) {
 // low - The lower bounds of the range
 // high - The upper bounds of the range
 
-static fp_t ann_random_range(fp_t low, fp_t high) {
-  return (low + ((fp_t)rand()) * (high - low) / RAND_MAX);
+static ann_fp_t ann_random_range(ann_fp_t low, ann_fp_t high) {
+  return (low + ((ann_fp_t)rand()) * (high - low) / RAND_MAX);
 }
 
 // ann_print_neuron()
@@ -524,8 +2859,8 @@ static fp_t ann_random_range(fp_t low, fp_t high) {
 // input - The input used for the ann_t propagation being printed
 // output - The output used for the ann_t propagation being printed
 
-void ann_print_neuron(ann_t *ann, fp_t const *const input,
-                      fp_t const *const output) {
+void ann_print_neuron(ann_t *ann, ann_fp_t const *const input,
+                      ann_fp_t const *const output) {
   fputs("-> ", stderr);
   for (uint_t i = 0; i < ann->layer_neuron_n[0]; i++) {
     fprintf(stderr, "  %+.*f", PRINT_PRECISION, input[i]);
@@ -533,7 +2868,7 @@ void ann_print_neuron(ann_t *ann, fp_t const *const input,
 
   fputs("\n", stderr);
 
-  fp_t *n = ann->neuron;
+  ann_fp_t *n = ann->neuron;
 
   for (uint_t l = 1; l < ann->layer_n - 1; l++) {
     fprintf(stderr, "   ", l);
@@ -560,7 +2895,7 @@ void ann_print_neuron(ann_t *ann, fp_t const *const input,
 // ann - The current ann_t instance
 
 void ann_print_weight(ann_t *ann) {
-  fp_t *weight = ann->weight;
+  ann_fp_t *weight = ann->weight;
 
   for (uint_t i = 1; i < ann->layer_n; i++) {
     for (uint_t j = 0; j < ann->layer_neuron_n[i - 1] + 1; j++) {
@@ -0,0 +1,472 @@
+// ann_bin.h - Artificial Neural Network training data from bin.h files
+//
+// Streams the blocks of a bin.h file into mini-batches of input and target
+// vectors, without loading the file into memory. The file is read
+// sequentially in large chunks, and the blocks are shuffled within a bounded
+// window: each sample is drawn at random from the window, and replaced by the
+// next block of the file. A background thread reads, shuffles and decodes the
+// following batches while the current batch trains, so that reading the file
+// overlaps training.
+//
+// Only the default ann_t is supported, as the batches are fp_t vectors, and
+// not the ann_f32.h or ann_mixed.h variants.
+//
+// Requires ann.h and bin.h, which are included here when they have not been
+// already, so bin_key_t must be declared first as for bin.h. Link with
+// -lpthread.
+
+#ifndef ANN_BIN_H
+#define ANN_BIN_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "./type.h"
+
+#ifndef ANN_H
+#include "./ann.h"
+#endif
+
+#ifndef BIN_H
+#include "./bin.h"
+#endif
+
+// The number of batches prepared ahead of the one being trained, plus one
+#ifndef ANN_BIN_QUEUE
+#define ANN_BIN_QUEUE 8
+#endif
+
+// The size of each read from the file
+#ifndef ANN_BIN_CHUNK
+#define ANN_BIN_CHUNK (1 << 18)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ann_bin_decode_t
+//
+// Decode a block of the file into a sample
+//
+// block - The block, as stored in the file
+// input - The destination of the input vector
+// target - The destination of the target output vector
+// arg - The argument given to ann_bin_init()
+
+typedef void (*ann_bin_decode_t)(void const *, fp_t *, fp_t *, void *);
+
+typedef struct {
+  // The input and target vectors of the batch, stored contiguously
+  fp_t *input;
+  fp_t *target;
+
+  // The number of samples in the batch, 0 marking the end of an epoch
+  uint_t sample_n;
+
+  // Whether the batch has been prepared, and not yet returned
+  int full;
+} ann_bin_batch_t;
+
+typedef struct {
+  // The file, used by the background thread alone
+  FILE *file;
+
+  // The number of blocks in the file, and the size of each
+  uint_t length;
+  uint_t block_size;
+
+  // The size of each sample
+  uint_t input_n;
+  uint_t output_n;
+
+  // The largest number of samples in a batch
+  uint_t batch_n;
+
+  // Converts a block into a sample
+  ann_bin_decode_t decode;
+  void *arg;
+
+  // The shuffling window of window_n blocks, of which window_fill are held
+  uint8_t *window;
+  uint_t window_n;
+  uint_t window_fill;
+
+  // The blocks read from the file, of which chunk_i have been used
+  uint8_t *chunk;
+  uint_t chunk_n;
+  uint_t chunk_fill;
+  uint_t chunk_i;
+
+  // The index of the next block to read from the file
+  uint_t next;
+
+  // The state of the shuffle's random numbers
+  unsigned seed;
+
+  // The ring of batches, filled by the background thread in order
+  ann_bin_batch_t batch[ANN_BIN_QUEUE];
+
+  // The batch returned by the last ann_bin_next(), ANN_BIN_QUEUE before the
+  // first, and the next batch to fill
+  uint_t current;
+  uint_t fill;
+
+  // The number of times ann_bin_next() waited for a batch to be prepared
+  uint_t stall_n;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int stop;
+} ann_bin_t;
+
+ann_bin_t *ann_bin_init(char const *, uint_t, uint_t, uint_t, uint_t,
+                        ann_bin_decode_t, void *);
+void ann_bin_free(ann_bin_t *);
+uint_t ann_bin_next(ann_bin_t *, fp_t const **, fp_t const **);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANN_BIN_H
+
+////////////////////////////////////////////////////////////////////////////////
+// IMPELEMENTATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef ANN_BIN_IMPLEMENTATION
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static void *ann_bin_producer(void *);
+static uint_t ann_bin_fill(ann_bin_t *, fp_t *, fp_t *);
+static uint8_t const *ann_bin_fetch(ann_bin_t *);
+static void ann_bin_decode(void const *, fp_t *, fp_t *, void *);
+
+// ann_bin_init()
+//
+// Open a bin.h file for training, and begin preparing its first batches on a
+// background thread. Each epoch visits every block of the file once.
+//
+// path - The path and file name of the bin.h file
+// input_n - The size of each input vector
+// output_n - The size of each target output vector
+// batch_n - The largest number of samples in a batch
+// window_n - The number of blocks the samples are drawn from at random, 1
+//            keeping the order of the file
+// decode - Converts a block into a sample, or NULL when each block ends with
+//          the input_n inputs followed by the output_n targets as fp_t
+// arg - The argument passed to decode
+//
+// return - The created ann_bin_t instance, or NULL if the file could not be
+//          opened, is shorter than its header claims, or the background
+//          thread could not be started
+
+ann_bin_t *ann_bin_init(char const *path, uint_t input_n, uint_t output_n,
+                        uint_t batch_n, uint_t window_n,
+                        ann_bin_decode_t decode, void *arg) {
+  assert(batch_n > 0 && window_n > 0);
+
+  FILE *f = bin_open(path);
+
+  if (!f)
+    return NULL;
+
+  uint_t length = bin_length(f);
+  uint_t block_size = bin_block_size(f);
+
+  // Every block the header counts must be present
+  struct stat st;
+
+  if (fstat(fileno(f), &st) != 0 || block_size == 0 ||
+      (uint_t)st.st_size < sizeof(bin_meta_t) ||
+      length > ((uint_t)st.st_size - sizeof(bin_meta_t)) / block_size) {
+    bin_close(f);
+    return NULL;
+  }
+
+  assert(decode || block_size >= sizeof(fp_t) * (input_n + output_n));
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fileno(f), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  uint_t chunk_n = ANN_BIN_CHUNK / block_size;
+  chunk_n = (chunk_n > 0) ? chunk_n : 1;
+
+  uint_t sample_n = batch_n * (input_n + output_n);
+
+  uint_t n = sizeof(ann_bin_t) +                                // ann_bin_t
+             (sizeof(fp_t) * ANN_BIN_QUEUE * sample_n) +        // batch[]
+             (block_size * (window_n +                          // window[]
+                            chunk_n));                          // chunk[]
+
+  // Allocate everything as one structure
+  ann_bin_t *bin = (ann_bin_t *)malloc(n);
+
+  if (!bin) {
+    bin_close(f);
+    return NULL;
+  }
+
+  // ann_bin_t | batch[].input, batch[].target | window[] | chunk[]
+  bin->file = f;
+  bin->length = length;
+  bin->block_size = block_size;
+  bin->input_n = input_n;
+  bin->output_n = output_n;
+  bin->batch_n = batch_n;
+  bin->decode = decode ? decode : ann_bin_decode;
+  bin->arg = decode ? arg : bin;
+
+  fp_t *x = (fp_t *)((uint8_t *)bin + sizeof(ann_bin_t));
+
+  for (uint_t q = 0; q < ANN_BIN_QUEUE; q++) {
+    bin->batch[q].input = x;
+    bin->batch[q].target = x + batch_n * input_n;
+    bin->batch[q].full = 0;
+    x += sample_n;
+  }
+
+  bin->window = (uint8_t *)x;
+  bin->window_n = window_n;
+  bin->window_fill = 0;
+  bin->chunk = bin->window + block_size * window_n;
+  bin->chunk_n = chunk_n;
+  bin->chunk_fill = 0;
+  bin->chunk_i = 0;
+  bin->next = 0;
+  bin->seed = rand();
+  bin->current = ANN_BIN_QUEUE;
+  bin->fill = 0;
+  bin->stall_n = 0;
+  bin->stop = 0;
+
+  if (pthread_mutex_init(&bin->mutex, NULL) != 0)
+    goto fail;
+
+  if (pthread_cond_init(&bin->cond, NULL) != 0)
+    goto fail_mutex;
+
+  if (pthread_create(&bin->thread, NULL, ann_bin_producer, bin) != 0)
+    goto fail_cond;
+
+  return bin;
+
+fail_cond:
+  pthread_cond_destroy(&bin->cond);
+fail_mutex:
+  pthread_mutex_destroy(&bin->mutex);
+fail:
+  bin_close(f);
+  free(bin);
+  return NULL;
+}
+
+// ann_bin_free()
+//
+// Stop the background thread, close the file and free the memory
+//
+// bin - The instance of ann_bin_t to free
+
+void ann_bin_free(ann_bin_t *bin) {
+  pthread_mutex_lock(&bin->mutex);
+  bin->stop = 1;
+  pthread_cond_broadcast(&bin->cond);
+  pthread_mutex_unlock(&bin->mutex);
+
+  pthread_join(bin->thread, NULL);
+
+  pthread_mutex_destroy(&bin->mutex);
+  pthread_cond_destroy(&bin->cond);
+  bin_close(bin->file);
+  free(bin);
+}
+
+// ann_bin_next()
+//
+// Return the next batch, releasing the previous one to be refilled. The last
+// batch of an epoch may hold fewer than batch_n samples, and is followed by an
+// empty batch, after which the next epoch begins.
+//
+// bin - The ann_bin_t instance
+// input - The destination of the batch's input vectors, valid until the next
+//         call
+// target - The destination of the batch's target output vectors, valid until
+//          the next call
+//
+// return - The number of samples in the batch, or 0 at the end of an epoch
+
+uint_t ann_bin_next(ann_bin_t *bin, fp_t const **input, fp_t const **target) {
+  pthread_mutex_lock(&bin->mutex);
+
+  if (bin->current < ANN_BIN_QUEUE) {
+    bin->batch[bin->current].full = 0;
+    bin->current = (bin->current + 1) % ANN_BIN_QUEUE;
+  } else {
+    bin->current = 0;
+  }
+
+  ann_bin_batch_t *batch = bin->batch + bin->current;
+
+  pthread_cond_broadcast(&bin->cond);
+
+  if (!batch->full)
+    bin->stall_n++;
+
+  while (!batch->full) {
+    pthread_cond_wait(&bin->cond, &bin->mutex);
+  }
+
+  pthread_mutex_unlock(&bin->mutex);
+
+  *input = batch->input;
+  *target = batch->target;
+
+  return batch->sample_n;
+}
+
+// ann_bin_producer()
+//
+// The background thread, filling each batch of the ring in turn as soon as it
+// has been released
+//
+// arg - The ann_bin_t instance
+
+static void *ann_bin_producer(void *arg) {
+  ann_bin_t *bin = (ann_bin_t *)arg;
+
+  for (;;) {
+    ann_bin_batch_t *batch = bin->batch + bin->fill;
+
+    pthread_mutex_lock(&bin->mutex);
+
+    while (batch->full && !bin->stop) {
+      pthread_cond_wait(&bin->cond, &bin->mutex);
+    }
+
+    int stop = bin->stop;
+    pthread_mutex_unlock(&bin->mutex);
+
+    if (stop)
+      break;
+
+    // The batch is not read until it is marked full
+    batch->sample_n = ann_bin_fill(bin, batch->input, batch->target);
+
+    pthread_mutex_lock(&bin->mutex);
+    batch->full = 1;
+    pthread_cond_broadcast(&bin->cond);
+    pthread_mutex_unlock(&bin->mutex);
+
+    bin->fill = (bin->fill + 1) % ANN_BIN_QUEUE;
+  }
+
+  return NULL;
+}
+
+// ann_bin_fill()
+//
+// Draw up to batch_n samples from the shuffling window, refilling it from the
+// file. Once every block of the file has been drawn, the file is rewound for
+// the next epoch.
+//
+// bin - The ann_bin_t instance
+// input - The destination of the input vectors
+// target - The destination of the target output vectors
+//
+// return - The number of samples drawn, 0 at the end of an epoch
+
+static uint_t ann_bin_fill(ann_bin_t *bin, fp_t *input, fp_t *target) {
+  uint_t bs = bin->block_size;
+  uint_t s = 0;
+
+  for (; s < bin->batch_n; s++) {
+    while (bin->window_fill < bin->window_n) {
+      uint8_t const *block = ann_bin_fetch(bin);
+
+      if (!block)
+        break;
+
+      memcpy(bin->window + bin->window_fill++ * bs, block, bs);
+    }
+
+    if (bin->window_fill == 0)
+      break;
+
+    uint_t k = rand_r(&bin->seed) % bin->window_fill;
+
+    bin->decode(bin->window + k * bs, input + s * bin->input_n,
+                target + s * bin->output_n, bin->arg);
+
+    // The last block of the window takes the place of the one drawn
+    if (k != --bin->window_fill)
+      memcpy(bin->window + k * bs, bin->window + bin->window_fill * bs, bs);
+  }
+
+  if (s == 0)
+    bin->next = 0;
+
+  return s;
+}
+
+// ann_bin_fetch()
+//
+// Return the next block of the file, reading another chunk when needed. A
+// short read, from a file truncated after ann_bin_init(), ends the epoch after
+// the blocks which were read.
+//
+// bin - The ann_bin_t instance
+//
+// return - The block, or NULL at the end of the file
+
+static uint8_t const *ann_bin_fetch(ann_bin_t *bin) {
+  if (bin->chunk_i == bin->chunk_fill) {
+    if (bin->next == bin->length)
+      return NULL;
+
+    uint_t n = bin->length - bin->next;
+    n = (n < bin->chunk_n) ? n : bin->chunk_n;
+
+    uint_t read_n = bin_read(bin->file, bin->next, bin->chunk, n);
+
+    bin->next = (read_n == n) ? bin->next + n : bin->length;
+    bin->chunk_fill = read_n;
+    bin->chunk_i = 0;
+
+    if (read_n == 0)
+      return NULL;
+  }
+
+  return bin->chunk + bin->chunk_i++ * bin->block_size;
+}
+
+// ann_bin_decode()
+//
+// The default decoder, for blocks ending with the input vector followed by
+// the target output vector
+//
+// block - The block, as stored in the file
+// input - The destination of the input vector
+// target - The destination of the target output vector
+// arg - The ann_bin_t instance
+
+static void ann_bin_decode(void const *block, fp_t *input, fp_t *target,
+                           void *arg) {
+  ann_bin_t const *bin = (ann_bin_t const *)arg;
+
+  uint8_t const *x = (uint8_t const *)block + bin->block_size -
+                     sizeof(fp_t) * (bin->input_n + bin->output_n);
+
+  memcpy(input, x, sizeof(fp_t) * bin->input_n);
+  memcpy(target, x + sizeof(fp_t) * bin->input_n,
+         sizeof(fp_t) * bin->output_n);
+}
+
+#endif // ANN_BIN_IMPLEMENTATION
@@ -0,0 +1,332 @@
+// ann_compile.h - Artificial Neural Network header compiler
+//
+// Writes a trained ann_t instance out as a C header holding a single forward
+// propagation function specialized for its topology. The layer sizes become
+// constants, and each neuron's dot product, bias and activation are fused into
+// one expression. Layers of up to ANN_COMPILE_UNROLL weights are unrolled into
+// straight-line code with the weights inlined as literals; larger layers are
+// emitted as constant-bound loops over static arrays, which the compiler may
+// unroll and vectorize for the exact sizes. The generated header depends only
+// on <tgmath.h>, and its results match ann_propagation_forward() up to
+// rounding.
+//
+// Only the default ann_t may be compiled, and the generated function takes
+// fp_t vectors. The ann_f32.h and ann_mixed.h variants are not supported.
+//
+// Requires ann.h, which is included here when it has not been already.
+
+#ifndef ANN_COMPILE_H
+#define ANN_COMPILE_H
+
+#include <stdint.h>
+#include "./type.h"
+
+#ifndef ANN_H
+#include "./ann.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int ann_compile(ann_t const *, char const *, char const *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANN_COMPILE_H
+
+////////////////////////////////////////////////////////////////////////////////
+// IMPELEMENTATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef ANN_COMPILE_IMPLEMENTATION
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+// The largest layer, in weights and biases, which is unrolled
+#ifndef ANN_COMPILE_UNROLL
+#define ANN_COMPILE_UNROLL 256
+#endif
+
+// The number of values written on each line of a weight array
+#define ANN_COMPILE_COLUMN 4
+
+// The longest name, which leaves room for the suffixes of every identifier
+#define ANN_COMPILE_NAME 200
+
+// The names of the generated activation functions
+static char const *const ANN_COMPILE_ACTIVATION[] = {
+    "identity", "binary", "sigmoid", "relu",    "elu",
+    "lrelu",    "tanh",   "gelu",    "softmax",
+};
+
+static void ann_compile_activation(FILE *, char const *, char const *,
+                                   ann_activation_t);
+static void ann_compile_value(FILE *, char const *, fp_t);
+
+// ann_compile()
+//
+// Write the network to a C header, declaring name_forward() along with the
+// NAME_INPUT_N and NAME_OUTPUT_N sizes, where NAME is the name in upper case.
+// The header must be regenerated whenever the network is retrained.
+//
+// ann - The ann_t instance to compile
+// path - The path and file name of the header
+// name - The prefix of every identifier in the header, a valid C identifier
+//        of at most ANN_COMPILE_NAME characters
+//
+// return - 0 on success, or -1 if the name is too long or the file could not
+//          be written
+
+int ann_compile(ann_t const *ann, char const *path, char const *name) {
+  if (strlen(name) > ANN_COMPILE_NAME)
+    return -1;
+
+  FILE *f = fopen(path, "w");
+
+  if (!f)
+    return -1;
+
+  char const *type = (sizeof(fp_t) == sizeof(float)) ? "float" : "double";
+  char const *suffix = (sizeof(fp_t) == sizeof(float)) ? "f" : "";
+
+  char guard[ANN_COMPILE_NAME + 1];
+  uint_t n = 0;
+
+  for (; name[n]; n++) {
+    guard[n] = toupper((unsigned char)name[n]);
+  }
+
+  guard[n] = '\0';
+
+  fprintf(f, "// %s.h - Generated by ann_compile()\n//\n// A {", name);
+
+  for (uint_t l = 0; l < ann->layer_n; l++) {
+    fprintf(f, (l > 0) ? ", %lu" : "%lu",
+            (unsigned long)ann->layer_neuron_n[l]);
+  }
+
+  fprintf(f, "} network, specialized by ann_compile.h\n\n");
+  fprintf(f, "#ifndef %s_H\n#define %s_H\n\n#include <tgmath.h>\n\n", guard,
+          guard);
+  fprintf(f, "#define %s_INPUT_N %lu\n", guard,
+          (unsigned long)ann->layer_neuron_n[0]);
+  fprintf(f, "#define %s_OUTPUT_N %lu\n\n", guard,
+          (unsigned long)ann->layer_neuron_n[ann->layer_n - 1]);
+
+  ann_compile_activation(f, name, type, ann->activation_hidden_id);
+
+  if (ann->activation_output_id != ann->activation_hidden_id)
+    ann_compile_activation(f, name, type, ann->activation_output_id);
+
+  // The weights of the layers which aren't unrolled
+  fp_t const *w = ann->weight;
+
+  for (uint_t l = 1; l < ann->layer_n; l++) {
+    uint_t x_n = ann->layer_neuron_n[l - 1];
+    uint_t y_n = ann->layer_neuron_n[l];
+
+    // Stored transposed, with the biases last, so that the inner loop runs
+    // over the outputs and vectorizes without reordering any sum
+    if (y_n * (x_n + 1) > ANN_COMPILE_UNROLL) {
+      fprintf(f, "static %s const %s_w%lu[%lu][%lu] = {\n", type, name,
+              (unsigned long)l, (unsigned long)(x_n + 1), (unsigned long)y_n);
+
+      for (uint_t i = 0; i <= x_n; i++) {
+        fprintf(f, "    {");
+
+        for (uint_t j = 0; j < y_n; j++) {
+          if (j > 0)
+            fprintf(f, (j % ANN_COMPILE_COLUMN) ? ", " : ",\n     ");
+
+          ann_compile_value(f, suffix, w[j * (x_n + 1) + i]);
+        }
+
+        fprintf(f, "},\n");
+      }
+
+      fprintf(f, "};\n\n");
+    }
+
+    w += y_n * (x_n + 1);
+  }
+
+  fprintf(f, "static inline void %s_forward(%s const *input, %s *output) {\n",
+          name, type, type);
+
+  w = ann->weight;
+
+  for (uint_t l = 1; l < ann->layer_n; l++) {
+    uint_t x_n = ann->layer_neuron_n[l - 1];
+    uint_t y_n = ann->layer_neuron_n[l];
+
+    ann_activation_t activation = (l < ann->layer_n - 1)
+                                      ? ann->activation_hidden_id
+                                      : ann->activation_output_id;
+
+    // SOFTMAX is applied once the whole layer is known
+    char f_j[ANN_COMPILE_NAME + 16] = "";
+
+    if (activation != SOFTMAX)
+      snprintf(f_j, sizeof(f_j), "%s_%s", name,
+               ANN_COMPILE_ACTIVATION[activation]);
+
+    // The layer's inputs and outputs
+    char x[32] = "input", y[32] = "output";
+
+    if (l > 1)
+      snprintf(x, sizeof(x), "x%lu", (unsigned long)l - 1);
+
+    if (l < ann->layer_n - 1)
+      snprintf(y, sizeof(y), "x%lu", (unsigned long)l);
+
+    fprintf(f, "  // Layer %lu\n", (unsigned long)l);
+
+    if (l < ann->layer_n - 1)
+      fprintf(f, "  %s %s[%lu];\n", type, y, (unsigned long)y_n);
+
+    if (y_n * (x_n + 1) > ANN_COMPILE_UNROLL) {
+      fprintf(f,
+              "  for (int j = 0; j < %lu; j++) {\n"
+              "    %s[j] = %s_w%lu[%lu][j];\n"
+              "  }\n\n"
+              "  for (int i = 0; i < %lu; i++) {\n"
+              "    for (int j = 0; j < %lu; j++) {\n"
+              "      %s[j] += %s_w%lu[i][j] * %s[i];\n"
+              "    }\n"
+              "  }\n",
+              (unsigned long)y_n, y, name, (unsigned long)l,
+              (unsigned long)x_n, (unsigned long)x_n, (unsigned long)y_n, y,
+              name, (unsigned long)l, x);
+
+      if (activation != SOFTMAX)
+        fprintf(f,
+                "\n  for (int j = 0; j < %lu; j++) {\n"
+                "    %s[j] = %s(%s[j]);\n"
+                "  }\n",
+                (unsigned long)y_n, y, f_j, y);
+    } else {
+      for (uint_t j = 0; j < y_n; j++) {
+        fp_t const *w_j = w + j * (x_n + 1);
+
+        fprintf(f, "  %s[%lu] = %s(", y, (unsigned long)j, f_j);
+
+        for (uint_t i = 0; i < x_n; i++) {
+          if (i > 0)
+            fprintf(f, (i % ANN_COMPILE_COLUMN) ? " + " : " +\n      ");
+
+          ann_compile_value(f, suffix, w_j[i]);
+          fprintf(f, " * %s[%lu]", x, (unsigned long)i);
+        }
+
+        fprintf(f, " + ");
+        ann_compile_value(f, suffix, w_j[x_n]);
+        fprintf(f, ");\n");
+      }
+    }
+
+    if (activation == SOFTMAX)
+      fprintf(f, "  %s_softmax(%s, %lu);\n", name, y, (unsigned long)y_n);
+
+    fprintf(f, (l < ann->layer_n - 1) ? "\n" : "}\n\n");
+
+    w += y_n * (x_n + 1);
+  }
+
+  fprintf(f, "#endif // %s_H\n", guard);
+
+  int error = ferror(f);
+
+  if (fclose(f) != 0 || error)
+    return -1;
+
+  return 0;
+}
+
+// ann_compile_activation()
+//
+// Write an activation function used by the generated layers, e.g.
+// name_sigmoid() taking a single sum, or name_softmax() normalizing a whole
+// layer. The functions match those of ann.h at EXACT accuracy.
+//
+// f - The header being written
+// name - The prefix of every identifier in the header
+// type - The name of fp_t
+// activation - The activation function
+
+static void ann_compile_activation(FILE *f, char const *name, char const *type,
+                                   ann_activation_t activation) {
+  if (activation == SOFTMAX) {
+    fprintf(f,
+            "static inline void %s_softmax(%s *y, int n) {\n"
+            "  %s max = y[0];\n"
+            "  for (int i = 1; i < n; i++) {\n"
+            "    max = (y[i] > max) ? y[i] : max;\n"
+            "  }\n\n"
+            "  %s sum = 0;\n"
+            "  for (int i = 0; i < n; i++) {\n"
+            "    y[i] = exp(y[i] - max);\n"
+            "    sum += y[i];\n"
+            "  }\n\n"
+            "  for (int i = 0; i < n; i++) {\n"
+            "    y[i] /= sum;\n"
+            "  }\n"
+            "}\n\n",
+            name, type, type, type);
+    return;
+  }
+
+  char const *body[] = {
+      "x",                                  // IDENTITY
+      "(x > 0) ? 1 : (x < 0) ? -1 : 0",     // BINARY
+      "1 / (1 + exp(-x))",                  // SIGMOID
+      "(x > 0) ? x : 0",                    // RELU
+      "(x > 0) ? x : (%s)%.17g * expm1(x)", // ELU
+      "(x > 0) ? x : (%s)%.17g * x",        // LRELU
+      "tanh(x)",                            // TANH
+      "(%s)0.5 * x *\n"
+      "         (1 + tanh((%s)%.17g * (x + (%s)%.17g * x * x * x)))", // GELU
+  };
+
+  fprintf(f, "static inline %s %s_%s(%s x) {\n  return ", type, name,
+          ANN_COMPILE_ACTIVATION[activation], type);
+
+  switch (activation) {
+  case ELU:
+    fprintf(f, body[activation], type, ELU_ALPHA);
+    break;
+
+  case LRELU:
+    fprintf(f, body[activation], type, LRELU_ALPHA);
+    break;
+
+  case GELU:
+    fprintf(f, body[activation], type, type, SQUARE_ROOT_2_OVER_PI, type,
+            GELU_BETA);
+    break;
+
+  default:
+    fputs(body[activation], f);
+    break;
+  }
+
+  fprintf(f, ";\n}\n\n");
+}
+
+// ann_compile_value()
+//
+// Write a weight as a hexadecimal floating point literal, which is exact
+//
+// f - The header being written
+// suffix - The literal suffix of fp_t
+// value - The weight
+
+static void ann_compile_value(FILE *f, char const *suffix, fp_t value) {
+  fprintf(f, "%a%s", (double)value, suffix);
+}
+
+#endif // ANN_COMPILE_IMPLEMENTATION
@@ -0,0 +1,23 @@
+// ann_f32.h - Artificial Neural Network, single precision
+//
+// ann.h with float weights, neurons and accumulators, declared with the
+// ann_f32_ prefix, e.g. ann_f32_t, ann_f32_init(). Define ANN_IMPLEMENTATION
+// before including this file for the implementation, as with ann.h.
+//
+// Halves the memory of the double precision ann_t, and doubles the number of
+// elements processed by each SIMD instruction.
+
+#ifndef ANN_F32_H
+#define ANN_F32_H
+#define ANN_DECLARATION
+#endif
+
+#define ANN_FP float
+#define ANN_ACC float
+#define ANN_PREFIX ann_f32
+
+#include "./ann_variant.h"
+#include "./ann.h"
+
+#define ANN_VARIANT_UNDEF
+#include "./ann_variant.h"
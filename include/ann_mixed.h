@@ -0,0 +1,24 @@
+// ann_mixed.h - Artificial Neural Network, mixed precision
+//
+// ann.h with float weights, neurons and deltas, but double accumulators for
+// dot products and gradients, declared with the ann_mixed_ prefix, e.g.
+// ann_mixed_t, ann_mixed_init(). Define ANN_IMPLEMENTATION before including
+// this file for the implementation, as with ann.h.
+//
+// Keeps the memory and bandwidth of ann_f32.h, while wide layers and large
+// batches sum without the rounding error of single precision.
+
+#ifndef ANN_MIXED_H
+#define ANN_MIXED_H
+#define ANN_DECLARATION
+#endif
+
+#define ANN_FP float
+#define ANN_ACC double
+#define ANN_PREFIX ann_mixed
+
+#include "./ann_variant.h"
+#include "./ann.h"
+
+#define ANN_VARIANT_UNDEF
+#include "./ann_variant.h"
@@ -0,0 +1,694 @@
+// ann_q8.h - Quantized Artificial Neural Network inference
+//
+// Converts a trained ann_t instance into an 8 bit integer model, for inference
+// only. Each layer's neurons are quantized with their own scale and zero
+// point, calibrated from a set of sample inputs, and each layer's weights with
+// a single scale. Dot products are accumulated in 32 bit integers, and the
+// activation functions are replaced by lookup tables.
+//
+// Only the default ann_t, whose ann_fp_t is fp_t, may be quantized. The
+// ann_f32.h and ann_mixed.h variants are not supported.
+//
+// Requires ann.h, which is included here when it has not been already.
+
+#ifndef ANN_Q8_H
+#define ANN_Q8_H
+
+#include <stdint.h>
+#include "./type.h"
+
+#ifndef ANN_H
+#include "./ann.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  // The quantization of the layer's neurons, x = scale * ( q - zero )
+  fp_t scale;
+  int32_t zero;
+
+  // The scale of the layer's weights, which are quantized symmetrically
+  fp_t weight_scale;
+
+  // The quantization of the layer's sums, before the activation function
+  fp_t sum_scale;
+  int32_t sum_zero;
+
+  // The fixed point factor converting an accumulator into a quantized sum,
+  // multiplier * 2^-( 31 + shift )
+  int32_t multiplier;
+  int32_t shift;
+
+  // The activation function, indexed by the quantized sum + 128
+  int8_t activation[256];
+} ann_q8_layer_t;
+
+typedef struct {
+  // The full size of the allocated structure
+  uint_t n;
+
+  // The number of layers in the neural network
+  uint_t layer_n;
+
+  // The neuron count, including the input layer
+  uint_t neuron_n;
+
+  // The total number of weights, excluding the biases
+  uint_t weight_n;
+
+  // The number of neurons in each layer
+  uint_t *layer_neuron_n;
+
+  // The quantization parameters of each layer
+  ann_q8_layer_t *layer;
+
+  // The output activation function, indexed by the quantized sum + 128,
+  // returning the dequantized output
+  fp_t *output;
+
+  // The biases of each neuron, in units of the accumulator, with the zero
+  // point of the layer's inputs folded in
+  int32_t *bias;
+
+  // The weights of each layer, without the biases
+  //   - Each layer is stored as [layer_neuron_n[l]][layer_neuron_n[l - 1]]
+  int8_t *weight;
+
+  // The integer dot product kernel, selected for the instruction set
+  int32_t (*dot)(int8_t const *, int8_t const *, uint_t);
+} ann_q8_t;
+
+typedef struct {
+  // The full size of the allocated structure
+  uint_t n;
+
+  // The quantized neurons of each layer, including the input layer
+  int8_t *neuron;
+} ann_q8_context_t;
+
+ann_q8_t *ann_q8_init(ann_t const *, fp_t const *, uint_t);
+void ann_q8_free(ann_q8_t *);
+
+ann_q8_context_t *ann_q8_context_init(ann_q8_t const *);
+void ann_q8_context_free(ann_q8_context_t *);
+
+void ann_q8_propagation_forward(ann_q8_t const *, ann_q8_context_t *,
+                                fp_t const *, fp_t *);
+fp_t ann_q8_error(ann_q8_t const *, ann_t *, fp_t const *, uint_t, fp_t *);
+void ann_q8_set_simd(ann_q8_t *, ann_simd_t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANN_Q8_H
+
+////////////////////////////////////////////////////////////////////////////////
+// IMPELEMENTATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef ANN_Q8_IMPLEMENTATION
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tgmath.h>
+
+static void ann_q8_range(fp_t, fp_t, fp_t *, int32_t *);
+static int8_t ann_q8_quantize(fp_t, fp_t, int32_t);
+static int8_t ann_q8_requantize(int32_t, ann_q8_layer_t const *);
+
+static int32_t ann_q8_dot_scalar(int8_t const *, int8_t const *, uint_t);
+static ann_simd_t ann_q8_simd_detect(void);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ANN_SIMD_X86
+#endif
+
+#ifdef ANN_SIMD_X86
+
+#include <immintrin.h>
+
+// The integer kernels are written with intrinsics, as the vector extensions
+// widen 8 bit elements one at a time. Each pair of 8 bit values is sign
+// extended to 16 bits and multiplied with pmaddwd, which sums adjacent
+// products into 32 bits, so neither the products nor their sums may overflow.
+
+// ann_q8_dot_sse2()
+//
+// SSE2 integer dot product kernel, sign extending by unpacking
+
+__attribute__((target("sse2"))) static int32_t
+ann_q8_dot_sse2(int8_t const *x, int8_t const *w, uint_t n) {
+  __m128i y = _mm_setzero_si128();
+  uint_t i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i x_i = _mm_loadu_si128((__m128i const *)(x + i));
+    __m128i w_i = _mm_loadu_si128((__m128i const *)(w + i));
+
+    __m128i x_lo = _mm_srai_epi16(_mm_unpacklo_epi8(x_i, x_i), 8);
+    __m128i x_hi = _mm_srai_epi16(_mm_unpackhi_epi8(x_i, x_i), 8);
+    __m128i w_lo = _mm_srai_epi16(_mm_unpacklo_epi8(w_i, w_i), 8);
+    __m128i w_hi = _mm_srai_epi16(_mm_unpackhi_epi8(w_i, w_i), 8);
+
+    y = _mm_add_epi32(y, _mm_madd_epi16(x_lo, w_lo));
+    y = _mm_add_epi32(y, _mm_madd_epi16(x_hi, w_hi));
+  }
+
+  y = _mm_add_epi32(y, _mm_shuffle_epi32(y, _MM_SHUFFLE(1, 0, 3, 2)));
+  y = _mm_add_epi32(y, _mm_shuffle_epi32(y, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  int32_t sum = _mm_cvtsi128_si32(y);
+  for (; i < n; i++) {
+    sum += (int32_t)x[i] * w[i];
+  }
+
+  return sum;
+}
+
+// ann_q8_dot_avx2()
+//
+// AVX2 integer dot product kernel
+
+__attribute__((target("avx2"))) static int32_t
+ann_q8_dot_avx2(int8_t const *x, int8_t const *w, uint_t n) {
+  __m256i y_0 = _mm256_setzero_si256();
+  __m256i y_1 = _mm256_setzero_si256();
+  uint_t i = 0;
+
+  for (; i + 32 <= n; i += 32) {
+    __m256i x_0 =
+        _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i const *)(x + i)));
+    __m256i w_0 =
+        _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i const *)(w + i)));
+    __m256i x_1 =
+        _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i const *)(x + i + 16)));
+    __m256i w_1 =
+        _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i const *)(w + i + 16)));
+
+    y_0 = _mm256_add_epi32(y_0, _mm256_madd_epi16(x_0, w_0));
+    y_1 = _mm256_add_epi32(y_1, _mm256_madd_epi16(x_1, w_1));
+  }
+
+  y_0 = _mm256_add_epi32(y_0, y_1);
+
+  __m128i y = _mm_add_epi32(_mm256_castsi256_si128(y_0),
+                            _mm256_extracti128_si256(y_0, 1));
+  y = _mm_add_epi32(y, _mm_shuffle_epi32(y, _MM_SHUFFLE(1, 0, 3, 2)));
+  y = _mm_add_epi32(y, _mm_shuffle_epi32(y, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  int32_t sum = _mm_cvtsi128_si32(y);
+  for (; i < n; i++) {
+    sum += (int32_t)x[i] * w[i];
+  }
+
+  return sum;
+}
+
+// ann_q8_dot_avx512()
+//
+// AVX-512 integer dot product kernel
+
+__attribute__((target("avx512f,avx512bw"))) static int32_t
+ann_q8_dot_avx512(int8_t const *x, int8_t const *w, uint_t n) {
+  __m512i y_0 = _mm512_setzero_si512();
+  __m512i y_1 = _mm512_setzero_si512();
+  uint_t i = 0;
+
+  for (; i + 64 <= n; i += 64) {
+    __m512i x_0 =
+        _mm512_cvtepi8_epi16(_mm256_loadu_si256((__m256i const *)(x + i)));
+    __m512i w_0 =
+        _mm512_cvtepi8_epi16(_mm256_loadu_si256((__m256i const *)(w + i)));
+    __m512i x_1 =
+        _mm512_cvtepi8_epi16(_mm256_loadu_si256((__m256i const *)(x + i + 32)));
+    __m512i w_1 =
+        _mm512_cvtepi8_epi16(_mm256_loadu_si256((__m256i const *)(w + i + 32)));
+
+    y_0 = _mm512_add_epi32(y_0, _mm512_madd_epi16(x_0, w_0));
+    y_1 = _mm512_add_epi32(y_1, _mm512_madd_epi16(x_1, w_1));
+  }
+
+  for (; i + 32 <= n; i += 32) {
+    __m512i x_0 =
+        _mm512_cvtepi8_epi16(_mm256_loadu_si256((__m256i const *)(x + i)));
+    __m512i w_0 =
+        _mm512_cvtepi8_epi16(_mm256_loadu_si256((__m256i const *)(w + i)));
+
+    y_0 = _mm512_add_epi32(y_0, _mm512_madd_epi16(x_0, w_0));
+  }
+
+  int32_t sum = _mm512_reduce_add_epi32(_mm512_add_epi32(y_0, y_1));
+  for (; i < n; i++) {
+    sum += (int32_t)x[i] * w[i];
+  }
+
+  return sum;
+}
+
+#endif // ANN_SIMD_X86
+
+// ann_q8_init()
+//
+// Quantize a trained neural network. The range of every layer's neurons and
+// sums is measured by propagating the calibration samples through the
+// original network, so the samples should be representative of the inputs
+// used for inference.
+//
+// ann - The trained ann_t instance
+// input - The sample_n calibration input vectors, stored contiguously
+// sample_n - The number of calibration samples
+//
+// return - The created ann_q8_t instance
+
+ann_q8_t *ann_q8_init(ann_t const *ann, fp_t const *input, uint_t sample_n) {
+  assert(sample_n > 0);
+
+  // The activations are tabulated per neuron, which SOFTMAX cannot be
+  assert(ann->activation_hidden_id != SOFTMAX &&
+         ann->activation_output_id != SOFTMAX);
+
+  uint_t layer_n = ann->layer_n;
+  uint_t neuron_n = 0;
+  uint_t weight_n = 0;
+  uint_t width = 0;
+
+  for (uint_t l = 0; l < layer_n; l++) {
+    neuron_n += ann->layer_neuron_n[l];
+    width = (ann->layer_neuron_n[l] > width) ? ann->layer_neuron_n[l] : width;
+
+    if (l > 0)
+      weight_n += ann->layer_neuron_n[l] * ann->layer_neuron_n[l - 1];
+  }
+
+  uint_t bias_n = neuron_n - ann->layer_neuron_n[0];
+
+  uint_t n = sizeof(ann_q8_t) +                   // ANN
+             (sizeof(ann_q8_layer_t) * layer_n) + // layer[]
+             (sizeof(fp_t) * 256) +               // output[]
+             (sizeof(uint_t) * layer_n) +         // layer_neuron_n[]
+             (sizeof(int32_t) * bias_n) +         // bias[]
+             (sizeof(int8_t) * weight_n);         // weight[]
+
+  // Allocate everything as one structure
+  ann_q8_t *q8 = (ann_q8_t *)malloc(n);
+
+  // ann_q8_t | layer[] | output[] | layer_neuron_n[] | bias[] | weight[]
+  q8->n = n;
+  q8->layer_n = layer_n;
+  q8->neuron_n = neuron_n;
+  q8->weight_n = weight_n;
+  q8->layer = (ann_q8_layer_t *)((uint8_t *)q8 + sizeof(ann_q8_t));
+  q8->output = (fp_t *)(q8->layer + layer_n);
+  q8->layer_neuron_n = (uint_t *)(q8->output + 256);
+  q8->bias = (int32_t *)(q8->layer_neuron_n + layer_n);
+  q8->weight = (int8_t *)(q8->bias + bias_n);
+  memcpy(q8->layer_neuron_n, ann->layer_neuron_n, sizeof(uint_t) * layer_n);
+
+  // Measure the range of the neurons and sums of every layer
+  fp_t *range = malloc(sizeof(fp_t) * 4 * layer_n);
+  fp_t *x = malloc(sizeof(fp_t) * 2 * width);
+
+  for (uint_t r = 0; r < 4 * layer_n; r += 2) {
+    range[r] = INFINITY;
+    range[r + 1] = -INFINITY;
+  }
+
+  for (uint_t s = 0; s < sample_n; s++) {
+    fp_t const *x_i = input + s * ann->layer_neuron_n[0];
+    fp_t const *w = ann->weight;
+
+    for (uint_t i = 0; i < ann->layer_neuron_n[0]; i++) {
+      range[0] = (x_i[i] < range[0]) ? x_i[i] : range[0];
+      range[1] = (x_i[i] > range[1]) ? x_i[i] : range[1];
+    }
+
+    for (uint_t l = 1; l < layer_n; l++) {
+      fp_t *y = (x_i == x) ? x + width : x;
+      fp_t *r = range + 4 * l;
+
+      fp_t (*activation)(fp_t) = (l < layer_n - 1) ? ann->activation_hidden
+                                                   : ann->activation_output;
+
+      for (uint_t j = 0; j < ann->layer_neuron_n[l]; j++) {
+        fp_t sum = ann->kernel->dot(x_i, w, ann->layer_neuron_n[l - 1]);
+        w += ann->layer_neuron_n[l - 1];
+        sum += *w++;
+        y[j] = activation(sum);
+
+        r[0] = (y[j] < r[0]) ? y[j] : r[0];
+        r[1] = (y[j] > r[1]) ? y[j] : r[1];
+        r[2] = (sum < r[2]) ? sum : r[2];
+        r[3] = (sum > r[3]) ? sum : r[3];
+      }
+
+      x_i = y;
+    }
+  }
+
+  free(x);
+
+  ann_q8_range(range[0], range[1], &q8->layer[0].scale, &q8->layer[0].zero);
+
+  fp_t const *w = ann->weight;
+  int8_t *w_q = q8->weight;
+  int32_t *b_q = q8->bias;
+
+  for (uint_t l = 1; l < layer_n; l++) {
+    ann_q8_layer_t *layer = q8->layer + l;
+    ann_q8_layer_t const *previous = q8->layer + l - 1;
+    fp_t const *r = range + 4 * l;
+
+    uint_t i_n = ann->layer_neuron_n[l - 1];
+    uint_t j_n = ann->layer_neuron_n[l];
+
+    ann_q8_range(r[0], r[1], &layer->scale, &layer->zero);
+    ann_q8_range(r[2], r[3], &layer->sum_scale, &layer->sum_zero);
+
+    // The weights are symmetric, so that the zero point of the layer's
+    // inputs is the only one to fold into the biases
+    fp_t w_max = 0;
+    for (uint_t j = 0; j < j_n; j++) {
+      for (uint_t i = 0; i < i_n; i++) {
+        fp_t w_ji = fabs(w[j * (i_n + 1) + i]);
+        w_max = (w_ji > w_max) ? w_ji : w_max;
+      }
+    }
+
+    layer->weight_scale = (w_max > 0) ? w_max / 127 : 1;
+
+    // One unit of the accumulator
+    fp_t unit = previous->scale * layer->weight_scale;
+
+    for (uint_t j = 0; j < j_n; j++) {
+      int64_t sum = 0;
+
+      for (uint_t i = 0; i < i_n; i++) {
+        *w_q = ann_q8_quantize(*w++, layer->weight_scale, 0);
+        sum += *w_q++;
+      }
+
+      fp_t b = round(*w++ / unit) - (fp_t)previous->zero * sum;
+      *b_q++ = (b > INT32_MAX) ? INT32_MAX : (b < INT32_MIN) ? INT32_MIN : b;
+    }
+
+    // Split the rescaling factor into a 31 bit mantissa and an exponent
+    int exponent;
+    fp_t mantissa = frexp(unit / layer->sum_scale, &exponent);
+    int64_t multiplier = (int64_t)round(mantissa * (1ll << 31));
+
+    if (multiplier == (1ll << 31)) {
+      multiplier >>= 1;
+      exponent++;
+    }
+
+    layer->multiplier = multiplier;
+    layer->shift = -exponent;
+
+    // Tabulate the activation function over every quantized sum
+    fp_t (*activation)(fp_t) = (l < layer_n - 1) ? ann->activation_hidden
+                                                 : ann->activation_output;
+
+    for (int32_t q = -128; q < 128; q++) {
+      fp_t y = activation(layer->sum_scale * (q - layer->sum_zero));
+
+      layer->activation[q + 128] =
+          ann_q8_quantize(y, layer->scale, layer->zero);
+
+      if (l == layer_n - 1)
+        q8->output[q + 128] = y;
+    }
+  }
+
+  free(range);
+
+  ann_q8_set_simd(q8, ann_q8_simd_detect());
+
+  return q8;
+}
+
+// ann_q8_free()
+//
+// Free the quantized neural network's memory
+//
+// q8 - The instance of ann_q8_t to free
+
+void ann_q8_free(ann_q8_t *q8) { free(q8); }
+
+// ann_q8_context_init()
+//
+// Allocate the quantized neurons needed to propagate a single sample through
+// the given ann_q8_t instance. Each thread propagating through a shared
+// ann_q8_t instance uses its own context.
+//
+// q8 - The ann_q8_t instance the context will be used with
+//
+// return - The created ann_q8_context_t instance
+
+ann_q8_context_t *ann_q8_context_init(ann_q8_t const *q8) {
+  uint_t n = sizeof(ann_q8_context_t) +        // ann_q8_context_t
+             (sizeof(int8_t) * q8->neuron_n); // neuron[]
+
+  // Allocate everything as one structure
+  ann_q8_context_t *context = (ann_q8_context_t *)malloc(n);
+
+  // ann_q8_context_t | neuron[]
+  context->n = n;
+  context->neuron = (int8_t *)context + sizeof(ann_q8_context_t);
+
+  return context;
+}
+
+// ann_q8_context_free()
+//
+// Free the context's memory
+//
+// context - The instance of ann_q8_context_t to free
+
+void ann_q8_context_free(ann_q8_context_t *context) { free(context); }
+
+// ann_q8_propagation_forward()
+//
+// Perform forward propagation with the quantized network. The inputs are
+// quantized, and the outputs dequantized, so that it may be used in place of
+// ann_propagation_forward(). The ann_q8_t instance is only read, so any number
+// of threads may propagate through it at once, each with its own context.
+//
+// q8 - The ann_q8_t instance to perform the propagation on
+// context - The context receiving the quantized neurons
+// input - The input vector
+// output - The destination of the output vector
+
+void ann_q8_propagation_forward(ann_q8_t const *q8, ann_q8_context_t *context,
+                                fp_t const *input, fp_t *output) {
+  int8_t const *w = q8->weight;
+  int32_t const *b = q8->bias;
+  int8_t *x = context->neuron;
+
+  for (uint_t i = 0; i < q8->layer_neuron_n[0]; i++) {
+    x[i] = ann_q8_quantize(input[i], q8->layer[0].scale, q8->layer[0].zero);
+  }
+
+  int8_t *y = x + q8->layer_neuron_n[0];
+
+  uint_t l = 1;
+
+  for (; l < q8->layer_n - 1; l++) {
+    ann_q8_layer_t const *layer = q8->layer + l;
+    uint_t i_n = q8->layer_neuron_n[l - 1];
+
+    for (uint_t j = 0; j < q8->layer_neuron_n[l]; j++) {
+      int32_t sum = *b++ + q8->dot(x, w, i_n);
+      w += i_n;
+
+      y[j] = layer->activation[ann_q8_requantize(sum, layer) + 128];
+    }
+
+    x = y;
+    y += q8->layer_neuron_n[l];
+  }
+
+  // Last layer
+  ann_q8_layer_t const *layer = q8->layer + l;
+  uint_t i_n = q8->layer_neuron_n[l - 1];
+
+  for (uint_t j = 0; j < q8->layer_neuron_n[l]; j++) {
+    int32_t sum = *b++ + q8->dot(x, w, i_n);
+    w += i_n;
+
+    output[j] = q8->output[ann_q8_requantize(sum, layer) + 128];
+  }
+}
+
+// ann_q8_error()
+//
+// Compare the quantized network against the network it was created from
+//
+// q8 - The ann_q8_t instance
+// ann - The original ann_t instance
+// input - The sample_n input vectors to compare, stored contiguously
+// sample_n - The number of samples
+// mean - The destination of the mean absolute error, or NULL
+//
+// return - The largest absolute difference between any two outputs
+
+fp_t ann_q8_error(ann_q8_t const *q8, ann_t *ann, fp_t const *input,
+                  uint_t sample_n, fp_t *mean) {
+  uint_t input_n = ann->layer_neuron_n[0];
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+
+  ann_q8_context_t *context = ann_q8_context_init(q8);
+  fp_t *expected = malloc(sizeof(fp_t) * 2 * output_n);
+  fp_t *output = expected + output_n;
+
+  fp_t max = 0;
+  fp_t sum = 0;
+
+  for (uint_t s = 0; s < sample_n; s++) {
+    ann_propagation_forward(ann, input + s * input_n, expected);
+    ann_q8_propagation_forward(q8, context, input + s * input_n, output);
+
+    for (uint_t j = 0; j < output_n; j++) {
+      fp_t e = fabs(output[j] - expected[j]);
+      max = (e > max) ? e : max;
+      sum += e;
+    }
+  }
+
+  free(expected);
+  ann_q8_context_free(context);
+
+  if (mean)
+    *mean = sum / (sample_n * output_n);
+
+  return max;
+}
+
+// ann_q8_set_simd()
+//
+// Set the instruction set used by the integer dot product kernel
+//
+// q8 - The current ann_q8_t instance
+// simd - The instruction set, which must be supported by the processor. The
+//        AVX2 kernel is used for AVX512 on processors without AVX-512BW.
+
+void ann_q8_set_simd(ann_q8_t *q8, ann_simd_t simd) {
+  if (simd == AVX512 && ann_q8_simd_detect() != AVX512)
+    simd = AVX2;
+
+  switch (simd) {
+#ifdef ANN_SIMD_X86
+  case AVX512:
+    q8->dot = ann_q8_dot_avx512;
+    break;
+
+  case AVX2:
+    q8->dot = ann_q8_dot_avx2;
+    break;
+
+  case SSE2:
+    q8->dot = ann_q8_dot_sse2;
+    break;
+#endif
+
+  default:
+    q8->dot = ann_q8_dot_scalar;
+    break;
+  }
+}
+
+// ann_q8_simd_detect()
+//
+// Query the processor for the widest instruction set supported by the integer
+// kernels, which unlike the dense layer kernels require AVX-512BW for AVX512
+//
+// return - The best instruction set available for the integer kernels
+
+static ann_simd_t ann_q8_simd_detect(void) {
+  ann_simd_t simd = ann_simd_detect();
+
+#ifdef ANN_SIMD_X86
+  if (simd == AVX512 && !__builtin_cpu_supports("avx512bw"))
+    return AVX2;
+#endif
+
+  return simd;
+}
+
+// ann_q8_range()
+//
+// Choose the quantization of a range of values. The range is extended to
+// include zero, so that zero is represented exactly.
+//
+// min - The smallest value
+// max - The largest value
+// scale - The destination of the scale
+// zero - The destination of the zero point
+
+static void ann_q8_range(fp_t min, fp_t max, fp_t *scale, int32_t *zero) {
+  min = (min < 0) ? min : 0;
+  max = (max > 0) ? max : 0;
+
+  *scale = (max > min) ? (max - min) / 255 : 1;
+
+  fp_t z = round(-128 - min / *scale);
+  *zero = (z < -128) ? -128 : (z > 127) ? 127 : z;
+}
+
+// ann_q8_quantize()
+//
+// q = round( x / scale ) + zero, saturated to 8 bits
+
+static int8_t ann_q8_quantize(fp_t x, fp_t scale, int32_t zero) {
+  fp_t q = round(x / scale) + zero;
+
+  return (q < -128) ? -128 : (q > 127) ? 127 : q;
+}
+
+// ann_q8_requantize()
+//
+// Convert an accumulator into a quantized sum, using only integer arithmetic
+//
+// sum - The accumulated dot product and bias
+// layer - The layer the sum belongs to
+//
+// return - The quantized sum, saturated to 8 bits
+
+static int8_t ann_q8_requantize(int32_t sum, ann_q8_layer_t const *layer) {
+  int32_t shift = 31 + layer->shift;
+  int64_t q = (int64_t)sum * layer->multiplier;
+
+  if (shift > 62) {
+    q = 0;
+  } else if (shift > 0) {
+    q = (q + (1ll << (shift - 1))) >> shift;
+  } else {
+    // Any sum of 256 or more saturates even once the zero point is added, so
+    // clamping first and scaling by at most 2^9 cannot overflow
+    q = (q < -256) ? -256 : (q > 256) ? 256 : q;
+    q *= 1ll << ((-shift < 9) ? -shift : 9);
+  }
+
+  q += layer->sum_zero;
+
+  return (q < -128) ? -128 : (q > 127) ? 127 : q;
+}
+
+// ann_q8_dot_scalar()
+//
+// Portable integer dot product kernel
+
+static int32_t ann_q8_dot_scalar(int8_t const *x, int8_t const *w, uint_t n) {
+  int32_t y = 0;
+  for (uint_t i = 0; i < n; i++) {
+    y += (int32_t)x[i] * w[i];
+  }
+
+  return y;
+}
+
+#endif // ANN_Q8_IMPLEMENTATION
@@ -0,0 +1,554 @@
+// ann_sparse.h - Sparse Artificial Neural Network inference
+//
+// Prunes the weights of a trained ann_t instance by magnitude, and converts
+// the pruned network into a block sparse model for inference only. Each row
+// of a layer's weights is divided into blocks of ANN_SPARSE_BLOCK consecutive
+// weights, and only the blocks holding a non-zero weight are stored, in
+// compressed sparse row order. Each stored block is multiplied by a single
+// vector load of the layer's inputs, so the size of the model and the time of
+// its forward pass shrink with the fraction of blocks pruned. With an
+// ANN_SPARSE_BLOCK of 1 the format is plain CSR.
+//
+// Storing the column of every block costs more than the blocks saved, and
+// the gathered loads are slower than the dense kernel, until about a tenth of
+// the blocks are pruned. Unpruned, the sparse model is about 12% larger than
+// the dense network and its forward pass up to 25% slower. The sparse model
+// only pays off above that break-even sparsity.
+//
+// Only the default ann_t, whose ann_fp_t is fp_t, may be pruned and
+// converted. The ann_f32.h and ann_mixed.h variants are not supported.
+//
+// Requires ann.h, which is included here when it has not been already.
+
+#ifndef ANN_SPARSE_H
+#define ANN_SPARSE_H
+
+#include <stdint.h>
+#include "./type.h"
+
+#ifndef ANN_H
+#include "./ann.h"
+#endif
+
+// The number of consecutive weights in a block, a power of two. Pruning
+// whole blocks keeps the stored blocks dense; pruning single weights leaves
+// most blocks in place unless the sparsity is very high.
+#ifndef ANN_SPARSE_BLOCK
+#define ANN_SPARSE_BLOCK 4
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  // The full size of the allocated structure
+  uint_t n;
+
+  // The number of layers in the neural network
+  uint_t layer_n;
+
+  // The neuron count, including the input layer
+  uint_t neuron_n;
+
+  // The number of stored blocks of weights
+  uint_t block_n;
+
+  // The number of neurons in each layer
+  uint_t *layer_neuron_n;
+
+  // The first block of each neuron after the input layer, with one more
+  // entry holding block_n, so that the blocks of neuron r are
+  // row[r] <= b < row[r + 1]
+  uint_t *row;
+
+  // The bias of each neuron after the input layer
+  fp_t *bias;
+
+  // The weights of the stored blocks, ANN_SPARSE_BLOCK each
+  fp_t *weight;
+
+  // The index of the first input of each stored block
+  uint32_t *column;
+
+  // The layer activation functions of the original network
+  void (*activation_hidden_layer)(fp_t *, uint_t);
+  void (*activation_output_layer)(fp_t *, uint_t);
+
+  // The sparse dot product kernel, selected for the instruction set
+  fp_t (*dot)(fp_t const *, uint32_t const *, uint_t, fp_t const *);
+} ann_sparse_t;
+
+typedef struct {
+  // The full size of the allocated structure
+  uint_t n;
+
+  // The neurons of each layer, including the input layer
+  //   - Each layer is padded to a multiple of ANN_SPARSE_BLOCK with zeros,
+  //     which are multiplied by the weights past the end of a row
+  fp_t *neuron;
+} ann_sparse_context_t;
+
+uint_t ann_sparse_prune(ann_t *, fp_t);
+ann_sparse_t *ann_sparse_init(ann_t const *);
+void ann_sparse_free(ann_sparse_t *);
+
+ann_sparse_context_t *ann_sparse_context_init(ann_sparse_t const *);
+void ann_sparse_context_free(ann_sparse_context_t *);
+
+void ann_sparse_propagation_forward(ann_sparse_t const *,
+                                    ann_sparse_context_t *, fp_t const *,
+                                    fp_t *);
+void ann_sparse_set_simd(ann_sparse_t *, ann_simd_t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANN_SPARSE_H
+
+////////////////////////////////////////////////////////////////////////////////
+// IMPELEMENTATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef ANN_SPARSE_IMPLEMENTATION
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tgmath.h>
+
+static uint_t ann_sparse_pad(uint_t);
+static uint_t ann_sparse_block_n(uint_t, uint_t);
+static int ann_sparse_compare(void const *, void const *);
+
+static fp_t ann_sparse_dot_scalar(fp_t const *, uint32_t const *, uint_t,
+                                  fp_t const *);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ANN_SIMD_X86
+#endif
+
+#ifdef ANN_SIMD_X86
+
+// ANN_SPARSE_KERNEL()
+//
+// Generate the sparse dot product kernel of an instruction set. A block is a
+// single vector of ANN_SPARSE_BLOCK elements, so every instruction set shares
+// the same code, compiled for its own registers. Two blocks are accumulated
+// at once to hide the latency of the additions.
+//
+// name - The suffix of the kernel's name
+// isa - The target attribute of the instruction set
+
+#define ANN_SPARSE_KERNEL(name, isa)                                           \
+  __attribute__((target(isa))) static fp_t ann_sparse_dot_##name(              \
+      fp_t const *w, uint32_t const *column, uint_t block_n, fp_t const *x) {  \
+    typedef fp_t v_t __attribute__((vector_size(sizeof(fp_t) *                 \
+                                                ANN_SPARSE_BLOCK),             \
+                                    aligned(sizeof(fp_t)), may_alias));        \
+    v_t y_0 = {0}, y_1 = {0};                                                  \
+    uint_t b = 0;                                                              \
+                                                                               \
+    for (; b + 2 <= block_n; b += 2) {                                         \
+      y_0 += *(v_t const *)(w + b * ANN_SPARSE_BLOCK) *                        \
+             *(v_t const *)(x + column[b]);                                    \
+      y_1 += *(v_t const *)(w + (b + 1) * ANN_SPARSE_BLOCK) *                  \
+             *(v_t const *)(x + column[b + 1]);                                \
+    }                                                                          \
+                                                                               \
+    if (b < block_n)                                                           \
+      y_0 += *(v_t const *)(w + b * ANN_SPARSE_BLOCK) *                        \
+             *(v_t const *)(x + column[b]);                                    \
+                                                                               \
+    y_0 += y_1;                                                                \
+                                                                               \
+    fp_t y = 0;                                                                \
+    for (uint_t k = 0; k < ANN_SPARSE_BLOCK; k++) {                            \
+      y += y_0[k];                                                             \
+    }                                                                          \
+                                                                               \
+    return y;                                                                  \
+  }
+
+ANN_SPARSE_KERNEL(sse2, "sse2")
+ANN_SPARSE_KERNEL(avx2, "avx2,fma")
+
+// A block of fewer than 8 doubles doesn't fill a 512 bit register, and
+// pairing two blocks in one was measured slower than the AVX2 kernel, as the
+// loads of the inputs bound the kernel. AVX512 then uses the AVX2 kernel.
+#if ANN_SPARSE_BLOCK >= 8
+ANN_SPARSE_KERNEL(avx512, "avx512f")
+#else
+#define ann_sparse_dot_avx512 ann_sparse_dot_avx2
+#endif
+
+#endif // ANN_SIMD_X86
+
+// ann_sparse_prune()
+//
+// Zero the blocks of weights with the smallest magnitudes, leaving the
+// biases. Each layer is pruned by the same fraction, so that no layer is
+// removed entirely. The blocks are those of ann_sparse_init(), and are ranked
+// by the sum of their squared weights. Training the network further may make
+// pruned weights non-zero again, so the network should be pruned once more
+// after any fine-tuning.
+//
+// ann - The ann_t instance to prune
+// sparsity - The fraction of each layer's blocks to zero, from 0 to 1
+//
+// return - The number of weights which are zero after pruning
+
+uint_t ann_sparse_prune(ann_t *ann, fp_t sparsity) {
+  assert(!ann->map && sparsity >= 0 && sparsity <= 1);
+
+  fp_t *w = ann->weight;
+  uint_t zero_n = 0;
+
+  for (uint_t l = 1; l < ann->layer_n; l++) {
+    uint_t x_n = ann->layer_neuron_n[l - 1];
+    uint_t y_n = ann->layer_neuron_n[l];
+    uint_t row_n = ann_sparse_pad(x_n) / ANN_SPARSE_BLOCK;
+    uint_t block_n = y_n * row_n;
+
+    // The magnitude of every block in the layer, and a copy to rank them
+    fp_t *norm = malloc(sizeof(fp_t) * 2 * block_n);
+
+    for (uint_t j = 0; j < y_n; j++) {
+      for (uint_t b = 0; b < row_n; b++) {
+        fp_t const *w_b = w + j * (x_n + 1) + b * ANN_SPARSE_BLOCK;
+        fp_t sum = 0;
+
+        for (uint_t i = 0; i < ann_sparse_block_n(x_n, b); i++) {
+          sum += w_b[i] * w_b[i];
+        }
+
+        norm[j * row_n + b] = sum;
+      }
+    }
+
+    memcpy(norm + block_n, norm, sizeof(fp_t) * block_n);
+    qsort(norm + block_n, block_n, sizeof(fp_t), ann_sparse_compare);
+
+    uint_t prune_n = floor(sparsity * block_n);
+    fp_t threshold = (prune_n > 0) ? norm[block_n + prune_n - 1] : -1;
+
+    // Every block below the threshold is pruned, then as many of the blocks
+    // equal to it as remain
+    for (uint_t pass = 0; pass < 2; pass++) {
+      for (uint_t k = 0; k < block_n && prune_n > 0; k++) {
+        if ((pass == 0) ? norm[k] < threshold : norm[k] == threshold) {
+          memset(w + k / row_n * (x_n + 1) + k % row_n * ANN_SPARSE_BLOCK, 0,
+                 sizeof(fp_t) * ann_sparse_block_n(x_n, k % row_n));
+
+          prune_n--;
+        }
+      }
+    }
+
+    for (uint_t j = 0; j < y_n; j++) {
+      for (uint_t i = 0; i < x_n; i++) {
+        zero_n += (w[j * (x_n + 1) + i] == 0);
+      }
+    }
+
+    free(norm);
+    w += y_n * (x_n + 1);
+  }
+
+  ann_layout_sync(ann);
+
+  return zero_n;
+}
+
+// ann_sparse_init()
+//
+// Convert a pruned neural network into a block sparse network, storing every
+// block which holds a non-zero weight. The network need not have been pruned
+// by ann_sparse_prune(), though fewer blocks are stored when it was.
+//
+// ann - The pruned ann_t instance
+//
+// return - The created ann_sparse_t instance
+
+ann_sparse_t *ann_sparse_init(ann_t const *ann) {
+  uint_t layer_n = ann->layer_n;
+  uint_t neuron_n = 0;
+  uint_t block_n = 0;
+
+  for (uint_t l = 0; l < layer_n; l++) {
+    neuron_n += ann->layer_neuron_n[l];
+  }
+
+  // Count the blocks holding a non-zero weight
+  fp_t const *w = ann->weight;
+
+  for (uint_t l = 1; l < layer_n; l++) {
+    uint_t x_n = ann->layer_neuron_n[l - 1];
+
+    for (uint_t j = 0; j < ann->layer_neuron_n[l]; j++) {
+      for (uint_t i = 0; i < x_n; i++) {
+        if (w[i] != 0) {
+          block_n++;
+          i = (i / ANN_SPARSE_BLOCK + 1) * ANN_SPARSE_BLOCK - 1;
+        }
+      }
+
+      w += x_n + 1;
+    }
+  }
+
+  uint_t row_n = neuron_n - ann->layer_neuron_n[0];
+
+  uint_t n = sizeof(ann_sparse_t) +                          // ANN
+             (sizeof(uint_t) * layer_n) +                    // layer_neuron_n[]
+             (sizeof(uint_t) * (row_n + 1)) +                // row[]
+             (sizeof(fp_t) * (row_n +                        // bias[]
+                              block_n * ANN_SPARSE_BLOCK)) + // weight[]
+             (sizeof(uint32_t) * block_n);                   // column[]
+
+  // Allocate everything as one structure
+  ann_sparse_t *sparse = (ann_sparse_t *)malloc(n);
+
+  // ann_sparse_t | layer_neuron_n[] | row[] | bias[] | weight[] | column[]
+  sparse->n = n;
+  sparse->layer_n = layer_n;
+  sparse->neuron_n = neuron_n;
+  sparse->block_n = block_n;
+  sparse->layer_neuron_n =
+      (uint_t *)((uint8_t *)sparse + sizeof(ann_sparse_t));
+  sparse->row = sparse->layer_neuron_n + layer_n;
+  sparse->bias = (fp_t *)(sparse->row + row_n + 1);
+  sparse->weight = sparse->bias + row_n;
+  sparse->column = (uint32_t *)(sparse->weight + block_n * ANN_SPARSE_BLOCK);
+  memcpy(sparse->layer_neuron_n, ann->layer_neuron_n, sizeof(uint_t) * layer_n);
+
+  sparse->activation_hidden_layer = ann->activation_hidden_layer;
+  sparse->activation_output_layer = ann->activation_output_layer;
+
+  w = ann->weight;
+
+  fp_t *w_s = sparse->weight;
+  uint32_t *c_s = sparse->column;
+  uint_t r = 0;
+  uint_t b = 0;
+
+  for (uint_t l = 1; l < layer_n; l++) {
+    uint_t x_n = ann->layer_neuron_n[l - 1];
+
+    for (uint_t j = 0; j < ann->layer_neuron_n[l]; j++, r++) {
+      sparse->row[r] = b;
+      sparse->bias[r] = w[x_n];
+
+      for (uint_t i0 = 0; i0 < x_n; i0 += ANN_SPARSE_BLOCK) {
+        uint_t i1 = (i0 + ANN_SPARSE_BLOCK < x_n) ? i0 + ANN_SPARSE_BLOCK : x_n;
+        uint_t i = i0;
+
+        while (i < i1 && w[i] == 0) {
+          i++;
+        }
+
+        if (i == i1)
+          continue;
+
+        // The weights past the end of the row meet the zero padding
+        memset(w_s, 0, sizeof(fp_t) * ANN_SPARSE_BLOCK);
+        memcpy(w_s, w + i0, sizeof(fp_t) * (i1 - i0));
+
+        *c_s++ = i0;
+        w_s += ANN_SPARSE_BLOCK;
+        b++;
+      }
+
+      w += x_n + 1;
+    }
+  }
+
+  sparse->row[r] = b;
+
+  ann_sparse_set_simd(sparse, ann_simd_detect());
+
+  return sparse;
+}
+
+// ann_sparse_free()
+//
+// Free the sparse neural network's memory
+//
+// sparse - The instance of ann_sparse_t to free
+
+void ann_sparse_free(ann_sparse_t *sparse) { free(sparse); }
+
+// ann_sparse_context_init()
+//
+// Allocate the neurons needed to propagate a single sample through the given
+// ann_sparse_t instance. Each thread propagating through a shared
+// ann_sparse_t instance uses its own context.
+//
+// sparse - The ann_sparse_t instance the context will be used with
+//
+// return - The created ann_sparse_context_t instance
+
+ann_sparse_context_t *ann_sparse_context_init(ann_sparse_t const *sparse) {
+  uint_t pad_n = 0;
+
+  for (uint_t l = 0; l < sparse->layer_n; l++) {
+    pad_n += ann_sparse_pad(sparse->layer_neuron_n[l]);
+  }
+
+  uint_t n = sizeof(ann_sparse_context_t) + // ann_sparse_context_t
+             (sizeof(fp_t) * pad_n);        // neuron[]
+
+  // Allocate everything as one structure
+  ann_sparse_context_t *context = (ann_sparse_context_t *)malloc(n);
+
+  // ann_sparse_context_t | neuron[]
+  context->n = n;
+  context->neuron =
+      (fp_t *)((uint8_t *)context + sizeof(ann_sparse_context_t));
+
+  // The padding of every layer must be zero, and is never written
+  memset(context->neuron, 0, sizeof(fp_t) * pad_n);
+
+  return context;
+}
+
+// ann_sparse_context_free()
+//
+// Free the context's memory
+//
+// context - The instance of ann_sparse_context_t to free
+
+void ann_sparse_context_free(ann_sparse_context_t *context) { free(context); }
+
+// ann_sparse_propagation_forward()
+//
+// Perform forward propagation with the sparse network, which matches
+// ann_propagation_forward() of the pruned network up to rounding. The
+// ann_sparse_t instance is only read, so any number of threads may propagate
+// through it at once, each with its own context.
+//
+// sparse - The ann_sparse_t instance to perform the propagation on
+// context - The context receiving the neurons
+// input - The input vector
+// output - The destination of the output vector
+
+void ann_sparse_propagation_forward(ann_sparse_t const *sparse,
+                                    ann_sparse_context_t *context,
+                                    fp_t const *input, fp_t *output) {
+  fp_t *x = context->neuron;
+  memcpy(x, input, sizeof(fp_t) * sparse->layer_neuron_n[0]);
+
+  uint_t const *row = sparse->row;
+  fp_t const *bias = sparse->bias;
+
+  for (uint_t l = 1; l < sparse->layer_n; l++) {
+    uint_t y_n = sparse->layer_neuron_n[l];
+    fp_t *y = x + ann_sparse_pad(sparse->layer_neuron_n[l - 1]);
+
+    for (uint_t j = 0; j < y_n; j++) {
+      uint_t b = row[j];
+
+      y[j] = bias[j] + sparse->dot(sparse->weight + b * ANN_SPARSE_BLOCK,
+                                   sparse->column + b, row[j + 1] - b, x);
+    }
+
+    if (l < sparse->layer_n - 1)
+      sparse->activation_hidden_layer(y, y_n);
+    else
+      sparse->activation_output_layer(y, y_n);
+
+    row += y_n;
+    bias += y_n;
+    x = y;
+  }
+
+  memcpy(output, x, sizeof(fp_t) * sparse->layer_neuron_n[sparse->layer_n - 1]);
+}
+
+// ann_sparse_set_simd()
+//
+// Set the instruction set used by the sparse dot product kernel. AVX512 uses
+// the AVX2 kernel unless a block fills a 512 bit register.
+//
+// sparse - The current ann_sparse_t instance
+// simd - The instruction set, which must be supported by the processor
+
+void ann_sparse_set_simd(ann_sparse_t *sparse, ann_simd_t simd) {
+  switch (simd) {
+#ifdef ANN_SIMD_X86
+  case AVX512:
+    sparse->dot = ann_sparse_dot_avx512;
+    break;
+
+  case AVX2:
+    sparse->dot = ann_sparse_dot_avx2;
+    break;
+
+  case SSE2:
+    sparse->dot = ann_sparse_dot_sse2;
+    break;
+#endif
+
+  default:
+    sparse->dot = ann_sparse_dot_scalar;
+    break;
+  }
+}
+
+// ann_sparse_pad()
+//
+// Round a number of neurons up to a whole number of blocks
+
+static uint_t ann_sparse_pad(uint_t n) {
+  return (n + ANN_SPARSE_BLOCK - 1) / ANN_SPARSE_BLOCK * ANN_SPARSE_BLOCK;
+}
+
+// ann_sparse_block_n()
+//
+// Count the weights of a row within a block, which is less than
+// ANN_SPARSE_BLOCK for the last block of a row when x_n isn't a multiple of it
+//
+// x_n - The number of weights in the row, excluding the bias
+// b - The index of the block within the row
+
+static uint_t ann_sparse_block_n(uint_t x_n, uint_t b) {
+  uint_t i0 = b * ANN_SPARSE_BLOCK;
+
+  return (x_n - i0 < ANN_SPARSE_BLOCK) ? x_n - i0 : ANN_SPARSE_BLOCK;
+}
+
+// ann_sparse_compare()
+//
+// Order two fp_t values for qsort()
+
+static int ann_sparse_compare(void const *a, void const *b) {
+  fp_t x = *(fp_t const *)a;
+  fp_t y = *(fp_t const *)b;
+
+  return (x > y) - (x < y);
+}
+
+// ann_sparse_dot_scalar()
+//
+// Portable sparse dot product kernel
+//
+// w - The weights of the row's blocks
+// column - The index of the first input of each block
+// block_n - The number of blocks in the row
+// x - The layer's inputs, padded to a whole number of blocks
+
+static fp_t ann_sparse_dot_scalar(fp_t const *w, uint32_t const *column,
+                                  uint_t block_n, fp_t const *x) {
+  fp_t y = 0;
+
+  for (uint_t b = 0; b < block_n; b++) {
+    for (uint_t k = 0; k < ANN_SPARSE_BLOCK; k++) {
+      y += w[b * ANN_SPARSE_BLOCK + k] * x[column[b] + k];
+    }
+  }
+
+  return y;
+}
+
+#endif // ANN_SPARSE_IMPLEMENTATION
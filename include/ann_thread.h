@@ -0,0 +1,429 @@
+// ann_thread.h - Artificial Neural Network parallel training
+//
+// Trains an ann_t instance on several threads at once. The samples are
+// sharded across the threads, each of which computes the gradient of its
+// shard into its own ann_batch_t. In the REDUCE mode the gradients are summed
+// into the weights after every step, so the result matches batched training
+// with thread_n * batch_n samples per batch. In the HOGWILD mode every thread
+// applies its own gradient as soon as it is calculated, without any
+// synchronization, which is only sound for the stateless SGD optimizer.
+//
+// Only the default ann_t is supported, as the samples and the learning rate
+// are fp_t, and not the ann_f32.h or ann_mixed.h variants.
+//
+// Requires ann.h, which is included here when it has not been already, and
+// linking with -lpthread.
+
+#ifndef ANN_THREAD_H
+#define ANN_THREAD_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "./type.h"
+
+#ifndef ANN_H
+#include "./ann.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  REDUCE,
+  HOGWILD,
+} ann_thread_mode_t;
+
+typedef struct ann_thread_s ann_thread_t;
+
+typedef struct {
+  // The shared training state
+  ann_thread_t *thread;
+
+  // The index of the worker, from 0 to thread_n - 1
+  uint_t index;
+
+  // The worker's neurons, deltas and gradient
+  ann_batch_t *batch;
+
+  // The worker's [batch_n][output_n] outputs
+  fp_t *output;
+} ann_thread_worker_t;
+
+struct ann_thread_s {
+  // The network being trained, which must not be moved while training
+  ann_t *ann;
+
+  // The number of worker threads
+  uint_t thread_n;
+
+  // The number of samples in each worker's batch
+  uint_t batch_n;
+
+  // How the gradients of the workers are applied to the weights
+  ann_thread_mode_t mode;
+
+  // The state of each worker
+  ann_thread_worker_t *worker;
+
+  // The samples of the current ann_thread_train() call
+  fp_t const *input;
+  fp_t const *target;
+  uint_t sample_n;
+  fp_t rate;
+
+  // Separates the gradient and update phases of each REDUCE step
+  pthread_barrier_t barrier;
+
+  // Holds the workers of an ann_thread_train() call until every worker has
+  // been started, 1 once they may train and -1 if they must return at once
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  int start;
+};
+
+ann_thread_t *ann_thread_init(ann_t *, uint_t, uint_t, ann_thread_mode_t);
+void ann_thread_free(ann_thread_t *);
+int ann_thread_train(ann_thread_t *, fp_t const *, fp_t const *, uint_t,
+                     fp_t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANN_THREAD_H
+
+////////////////////////////////////////////////////////////////////////////////
+// IMPELEMENTATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef ANN_THREAD_IMPLEMENTATION
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Each thread's share of the weights is a multiple of this many weights, so
+// that no two threads update the same cache line
+#define ANN_THREAD_ALIGN 16
+
+static void *ann_thread_run(void *);
+static void *ann_thread_reduce(void *);
+static void *ann_thread_hogwild(void *);
+
+// ann_thread_init()
+//
+// Create the state for training a network on several threads
+//
+// ann - The ann_t instance to train
+// thread_n - The number of worker threads
+// batch_n - The number of samples each worker propagates at once
+// mode - How the gradients of the workers are applied to the weights
+//
+// return - The created ann_thread_t instance, or NULL if it could not be
+//          allocated
+
+ann_thread_t *ann_thread_init(ann_t *ann, uint_t thread_n, uint_t batch_n,
+                              ann_thread_mode_t mode) {
+  assert(thread_n > 0 && batch_n > 0);
+
+  // The transposed weights are only refreshed between steps, and the state
+  // of any other optimizer cannot be updated by several steps at once
+  assert(mode == REDUCE ||
+         (ann->layout == ROW_MAJOR && ann->optimizer == SGD));
+
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+
+  uint_t n = sizeof(ann_thread_t) +                             // ann_thread_t
+             (sizeof(ann_thread_worker_t) * thread_n) +         // worker[]
+             (sizeof(fp_t) * thread_n * batch_n * output_n);    // output[]
+
+  // Allocate everything as one structure
+  ann_thread_t *thread = (ann_thread_t *)malloc(n);
+
+  if (!thread)
+    return NULL;
+
+  // ann_thread_t | worker[] | output[]
+  thread->ann = ann;
+  thread->thread_n = thread_n;
+  thread->batch_n = batch_n;
+  thread->mode = mode;
+  thread->worker =
+      (ann_thread_worker_t *)((uint8_t *)thread + sizeof(ann_thread_t));
+
+  fp_t *output = (fp_t *)(thread->worker + thread_n);
+
+  uint_t t = 0;
+
+  for (; t < thread_n; t++) {
+    thread->worker[t].thread = thread;
+    thread->worker[t].index = t;
+    thread->worker[t].batch = ann_batch_init(ann, batch_n);
+    thread->worker[t].output = output + t * batch_n * output_n;
+
+    if (!thread->worker[t].batch)
+      goto fail_batch;
+  }
+
+  if (pthread_barrier_init(&thread->barrier, NULL, thread_n) != 0)
+    goto fail_batch;
+
+  if (pthread_mutex_init(&thread->lock, NULL) != 0)
+    goto fail_barrier;
+
+  if (pthread_cond_init(&thread->ready, NULL) != 0)
+    goto fail_lock;
+
+  return thread;
+
+fail_lock:
+  pthread_mutex_destroy(&thread->lock);
+fail_barrier:
+  pthread_barrier_destroy(&thread->barrier);
+fail_batch:
+  while (t-- > 0) {
+    ann_batch_free(thread->worker[t].batch);
+  }
+
+  free(thread);
+  return NULL;
+}
+
+// ann_thread_free()
+//
+// Free the memory of the training state, but not the network
+//
+// thread - The instance of ann_thread_t to free
+
+void ann_thread_free(ann_thread_t *thread) {
+  for (uint_t t = 0; t < thread->thread_n; t++) {
+    ann_batch_free(thread->worker[t].batch);
+  }
+
+  pthread_cond_destroy(&thread->ready);
+  pthread_mutex_destroy(&thread->lock);
+  pthread_barrier_destroy(&thread->barrier);
+  free(thread);
+}
+
+// ann_thread_train()
+//
+// Train the network on each sample once, returning when every worker thread
+// has finished. No worker trains until every worker thread has been started,
+// so the network is left untouched when one cannot be.
+//
+// thread - The ann_thread_t instance
+// input - The sample_n input vectors, stored contiguously
+// target - The sample_n target output vectors, stored contiguously
+// sample_n - The number of samples
+// rate - Learning rate
+//
+// return - 0 on success, or -1 if the worker threads could not be started
+
+int ann_thread_train(ann_thread_t *thread, fp_t const *input,
+                     fp_t const *target, uint_t sample_n, fp_t rate) {
+  thread->input = input;
+  thread->target = target;
+  thread->sample_n = sample_n;
+  thread->rate = rate;
+
+  assert(thread->mode == REDUCE || thread->ann->optimizer == SGD);
+
+  pthread_t *id = malloc(sizeof(pthread_t) * thread->thread_n);
+
+  if (!id)
+    return -1;
+
+  thread->start = 0;
+
+  // The calling thread acts as the first worker
+  uint_t started = 1;
+
+  for (; started < thread->thread_n; started++) {
+    if (pthread_create(id + started, NULL, ann_thread_run,
+                       thread->worker + started) != 0)
+      break;
+  }
+
+  pthread_mutex_lock(&thread->lock);
+  thread->start = (started == thread->thread_n) ? 1 : -1;
+  pthread_cond_broadcast(&thread->ready);
+  pthread_mutex_unlock(&thread->lock);
+
+  if (started == thread->thread_n)
+    ann_thread_run(thread->worker);
+
+  for (uint_t t = 1; t < started; t++) {
+    pthread_join(id[t], NULL);
+  }
+
+  free(id);
+
+  if (started != thread->thread_n)
+    return -1;
+
+  // The HOGWILD workers apply their gradients without advancing the step
+  // count, which is advanced here once for each of them instead
+  if (thread->mode == HOGWILD) {
+    for (uint_t t = 0; t < thread->thread_n; t++) {
+      uint_t s0 = sample_n * t / thread->thread_n;
+      uint_t s1 = sample_n * (t + 1) / thread->thread_n;
+
+      thread->ann->step += (s1 - s0 + thread->batch_n - 1) / thread->batch_n;
+    }
+  }
+
+  return 0;
+}
+
+// ann_thread_run()
+//
+// The entry point of every worker, which waits until every worker thread has
+// been started before running the worker of the training mode
+//
+// arg - The ann_thread_worker_t of the thread
+
+static void *ann_thread_run(void *arg) {
+  ann_thread_worker_t *worker = (ann_thread_worker_t *)arg;
+  ann_thread_t *thread = worker->thread;
+
+  pthread_mutex_lock(&thread->lock);
+
+  while (thread->start == 0) {
+    pthread_cond_wait(&thread->ready, &thread->lock);
+  }
+
+  int start = thread->start;
+  pthread_mutex_unlock(&thread->lock);
+
+  if (start < 0)
+    return NULL;
+
+  return (thread->mode == HOGWILD) ? ann_thread_hogwild(arg)
+                                   : ann_thread_reduce(arg);
+}
+
+// ann_thread_reduce()
+//
+// The REDUCE worker. Every step, each worker calculates the gradient of its
+// batch_n samples against the same weights, then each worker sums every
+// gradient within its own share of the weights and applies it with the
+// network's optimizer.
+//
+// arg - The ann_thread_worker_t of the thread
+
+static void *ann_thread_reduce(void *arg) {
+  ann_thread_worker_t *worker = (ann_thread_worker_t *)arg;
+  ann_thread_t *thread = worker->thread;
+  ann_t *ann = thread->ann;
+
+  uint_t input_n = ann->layer_neuron_n[0];
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+  uint_t step_n = thread->thread_n * thread->batch_n;
+
+  // This worker's share of the weights
+  uint_t share = (ann->weight_n + thread->thread_n - 1) / thread->thread_n;
+  share = (share + ANN_THREAD_ALIGN - 1) / ANN_THREAD_ALIGN * ANN_THREAD_ALIGN;
+
+  uint_t w0 = worker->index * share;
+  uint_t w1 = w0 + share;
+  w0 = (w0 < ann->weight_n) ? w0 : ann->weight_n;
+  w1 = (w1 < ann->weight_n) ? w1 : ann->weight_n;
+
+  for (uint_t s0 = 0; s0 < thread->sample_n; s0 += step_n) {
+    uint_t s = s0 + worker->index * thread->batch_n;
+    uint_t batch_n = 0;
+
+    // The last step may leave some workers with fewer samples, or none
+    if (s < thread->sample_n)
+      batch_n = thread->sample_n - s;
+
+    batch_n = (batch_n < thread->batch_n) ? batch_n : thread->batch_n;
+
+    memset(worker->batch->gradient, 0, sizeof(ann_acc_t) * ann->weight_n);
+
+    if (batch_n > 0) {
+      ann_propagation_forward_batch(ann, worker->batch,
+                                    thread->input + s * input_n, batch_n,
+                                    worker->output);
+      ann_gradient_batch(ann, worker->batch, thread->input + s * input_n,
+                         worker->output, thread->target + s * output_n,
+                         batch_n);
+    }
+
+    // No worker applies a gradient until every gradient is complete
+    if (worker->index == 0)
+      ann_optimizer_step(ann);
+
+    pthread_barrier_wait(&thread->barrier);
+
+    // The gradients are summed into the first worker's, within this share
+    ann_acc_t *g = thread->worker[0].batch->gradient;
+
+    for (uint_t t = 1; t < thread->thread_n; t++) {
+      ann_acc_t const *g_t = thread->worker[t].batch->gradient;
+
+      for (uint_t i = w0; i < w1; i++) {
+        g[i] += g_t[i];
+      }
+    }
+
+    ann_gradient_apply_range(ann, g, w0, w1, thread->rate);
+
+    // Every weight is updated, and no gradient is read any longer
+    int serial = pthread_barrier_wait(&thread->barrier);
+
+    if (ann->layout == TRANSPOSED) {
+      if (serial == PTHREAD_BARRIER_SERIAL_THREAD)
+        ann_layout_sync(ann);
+
+      // The transposed weights are refreshed
+      pthread_barrier_wait(&thread->barrier);
+    }
+  }
+
+  return NULL;
+}
+
+// ann_thread_hogwild()
+//
+// The HOGWILD worker. Each worker trains on its own contiguous shard of the
+// samples, applying each gradient to the shared weights without locking. The
+// updates of other threads may be lost or observed part way through, which
+// is tolerated for sparse enough gradients, in exchange for never waiting.
+// The gradients are applied without ann_optimizer_step(), which no worker
+// may call while the others apply theirs.
+//
+// arg - The ann_thread_worker_t of the thread
+
+static void *ann_thread_hogwild(void *arg) {
+  ann_thread_worker_t *worker = (ann_thread_worker_t *)arg;
+  ann_thread_t *thread = worker->thread;
+  ann_t *ann = thread->ann;
+
+  uint_t input_n = ann->layer_neuron_n[0];
+  uint_t output_n = ann->layer_neuron_n[ann->layer_n - 1];
+
+  uint_t s0 = thread->sample_n * worker->index / thread->thread_n;
+  uint_t s1 = thread->sample_n * (worker->index + 1) / thread->thread_n;
+
+  for (uint_t s = s0; s < s1; s += thread->batch_n) {
+    uint_t batch_n = (s + thread->batch_n < s1) ? thread->batch_n : s1 - s;
+
+    ann_propagation_forward_batch(ann, worker->batch,
+                                  thread->input + s * input_n, batch_n,
+                                  worker->output);
+
+    memset(worker->batch->gradient, 0, sizeof(ann_acc_t) * ann->weight_n);
+
+    ann_gradient_batch(ann, worker->batch, thread->input + s * input_n,
+                       worker->output, thread->target + s * output_n, batch_n);
+    ann_gradient_apply_range(ann, worker->batch->gradient, 0, ann->weight_n,
+                             thread->rate);
+  }
+
+  return NULL;
+}
+
+#endif // ANN_THREAD_IMPLEMENTATION
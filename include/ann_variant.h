@@ -0,0 +1,348 @@
+// ann_variant.h - Artificial Neural Network precision variants
+//
+// Renames every identifier of ann.h with ANN_PREFIX, so that ann.h may be
+// included once for each precision within a single program. A variant header
+// defines ANN_FP, ANN_ACC and ANN_PREFIX, includes this file, includes ann.h,
+// then includes this file again with ANN_VARIANT_UNDEF defined to restore the
+// original names. See ann_f32.h and ann_mixed.h.
+//
+// The activation, accuracy, optimizer, layout and instruction set enums are
+// shared by every variant, and are not renamed.
+//
+// Identifiers added to ann.h must also be added to both lists below.
+
+#ifndef ANN_VARIANT_UNDEF
+
+// ANN_NAME()
+//
+// Prefix the name of an identifier with ANN_PREFIX, e.g. ANN_NAME(init) is
+// ann_f32_init when ANN_PREFIX is ann_f32
+
+#define ANN_NAME(name) ANN_PASTE(ANN_PREFIX, name)
+#define ANN_PASTE(prefix, name) ANN_PASTE_(prefix, name)
+#define ANN_PASTE_(prefix, name) prefix##_##name
+
+#define ann_fp_t ANN_NAME(fp_t)
+#define ann_acc_t ANN_NAME(acc_t)
+#define ann_kernel_t ANN_NAME(kernel_t)
+#define ann_t ANN_NAME(t)
+#define ann_batch_t ANN_NAME(batch_t)
+#define ann_context_t ANN_NAME(context_t)
+#define ann_init ANN_NAME(init)
+#define ann_copy ANN_NAME(copy)
+#define ann_free ANN_NAME(free)
+#define ann_save ANN_NAME(save)
+#define ann_load ANN_NAME(load)
+#define ann_load_mmap ANN_NAME(load_mmap)
+#define ann_random ANN_NAME(random)
+#define ann_propagation_forward ANN_NAME(propagation_forward)
+#define ann_propagation_backward ANN_NAME(propagation_backward)
+#define ann_train_numeric ANN_NAME(train_numeric)
+#define ann_gradient_numeric ANN_NAME(gradient_numeric)
+#define ann_context_init ANN_NAME(context_init)
+#define ann_context_free ANN_NAME(context_free)
+#define ann_propagation_forward_context ANN_NAME(propagation_forward_context)
+#define ann_propagation_backward_context ANN_NAME(propagation_backward_context)
+#define ann_batch_init ANN_NAME(batch_init)
+#define ann_batch_free ANN_NAME(batch_free)
+#define ann_propagation_forward_batch ANN_NAME(propagation_forward_batch)
+#define ann_propagation_backward_batch ANN_NAME(propagation_backward_batch)
+#define ann_gradient_batch ANN_NAME(gradient_batch)
+#define ann_gradient_apply ANN_NAME(gradient_apply)
+#define ann_gradient_apply_range ANN_NAME(gradient_apply_range)
+#define ann_error_total ANN_NAME(error_total)
+#define ann_set_activation ANN_NAME(set_activation)
+#define ann_set_accuracy ANN_NAME(set_accuracy)
+#define ann_set_simd ANN_NAME(set_simd)
+#define ann_set_layout ANN_NAME(set_layout)
+#define ann_layout_sync ANN_NAME(layout_sync)
+#define ann_set_optimizer ANN_NAME(set_optimizer)
+#define ann_optimizer_step ANN_NAME(optimizer_step)
+#define ann_simd_detect ANN_NAME(simd_detect)
+#define ann_print_weight ANN_NAME(print_weight)
+#define ann_print_neuron ANN_NAME(print_neuron)
+#define ann_rebase ANN_NAME(rebase)
+#define ann_file_t ANN_NAME(file_t)
+#define ann_file_offset ANN_NAME(file_offset)
+#define ann_file_check ANN_NAME(file_check)
+#define ann_transpose_n ANN_NAME(transpose_n)
+#define ann_transpose_size ANN_NAME(transpose_size)
+#define ann_optimizer_state_n ANN_NAME(optimizer_state_n)
+#define ann_optimize_row ANN_NAME(optimize_row)
+#define ann_forward ANN_NAME(forward)
+#define ann_backward ANN_NAME(backward)
+#define ann_backward_update ANN_NAME(backward_update)
+#define ann_delta_batch ANN_NAME(delta_batch)
+#define ann_random_range ANN_NAME(random_range)
+#define ann_layer_forward_batch ANN_NAME(layer_forward_batch)
+#define ann_layer_delta_batch ANN_NAME(layer_delta_batch)
+#define ann_layer_gradient_batch ANN_NAME(layer_gradient_batch)
+#define ann_error ANN_NAME(error)
+#define ann_error_partial ANN_NAME(error_partial)
+#define ann_loss ANN_NAME(loss)
+#define ann_activation_identity ANN_NAME(activation_identity)
+#define ann_activation_identity_partial ANN_NAME(activation_identity_partial)
+#define ann_activation_binary ANN_NAME(activation_binary)
+#define ann_activation_binary_partial ANN_NAME(activation_binary_partial)
+#define ann_activation_sign ANN_NAME(activation_sign)
+#define ann_activation_sign_partial ANN_NAME(activation_sign_partial)
+#define ann_activation_sigmoid ANN_NAME(activation_sigmoid)
+#define ann_activation_sigmoid_partial ANN_NAME(activation_sigmoid_partial)
+#define ann_activation_relu ANN_NAME(activation_relu)
+#define ann_activation_relu_partial ANN_NAME(activation_relu_partial)
+#define ann_activation_elu ANN_NAME(activation_elu)
+#define ann_activation_elu_partial ANN_NAME(activation_elu_partial)
+#define ann_activation_lrelu ANN_NAME(activation_lrelu)
+#define ann_activation_lrelu_partial ANN_NAME(activation_lrelu_partial)
+#define ann_activation_tanh ANN_NAME(activation_tanh)
+#define ann_activation_tanh_partial ANN_NAME(activation_tanh_partial)
+#define ann_activation_gelu ANN_NAME(activation_gelu)
+#define ann_activation_gelu_partial ANN_NAME(activation_gelu_partial)
+#define ann_activation_softmax_layer ANN_NAME(activation_softmax_layer)
+#define ann_activation_resolve ANN_NAME(activation_resolve)
+#define ann_activation_identity_layer ANN_NAME(activation_identity_layer)
+#define ann_activation_identity_layer_partial ANN_NAME(activation_identity_layer_partial)
+#define ann_activation_binary_layer ANN_NAME(activation_binary_layer)
+#define ann_activation_binary_layer_partial ANN_NAME(activation_binary_layer_partial)
+#define ann_activation_sigmoid_layer ANN_NAME(activation_sigmoid_layer)
+#define ann_activation_sigmoid_layer_partial ANN_NAME(activation_sigmoid_layer_partial)
+#define ann_activation_relu_layer ANN_NAME(activation_relu_layer)
+#define ann_activation_relu_layer_partial ANN_NAME(activation_relu_layer_partial)
+#define ann_activation_elu_layer ANN_NAME(activation_elu_layer)
+#define ann_activation_elu_layer_partial ANN_NAME(activation_elu_layer_partial)
+#define ann_activation_lrelu_layer ANN_NAME(activation_lrelu_layer)
+#define ann_activation_lrelu_layer_partial ANN_NAME(activation_lrelu_layer_partial)
+#define ann_activation_tanh_layer ANN_NAME(activation_tanh_layer)
+#define ann_activation_tanh_layer_partial ANN_NAME(activation_tanh_layer_partial)
+#define ann_activation_gelu_layer ANN_NAME(activation_gelu_layer)
+#define ann_activation_gelu_layer_partial ANN_NAME(activation_gelu_layer_partial)
+#define ann_dot_scalar ANN_NAME(dot_scalar)
+#define ann_dot4_scalar ANN_NAME(dot4_scalar)
+#define ann_axpy_scalar ANN_NAME(axpy_scalar)
+#define ann_delta_scalar ANN_NAME(delta_scalar)
+#define ann_gradient_scalar ANN_NAME(gradient_scalar)
+#define ann_update_scalar ANN_NAME(update_scalar)
+#define ann_kernel_scalar ANN_NAME(kernel_scalar)
+#define ann_dot_sse2 ANN_NAME(dot_sse2)
+#define ann_dot4_sse2 ANN_NAME(dot4_sse2)
+#define ann_axpy_sse2 ANN_NAME(axpy_sse2)
+#define ann_delta_sse2 ANN_NAME(delta_sse2)
+#define ann_gradient_sse2 ANN_NAME(gradient_sse2)
+#define ann_update_sse2 ANN_NAME(update_sse2)
+#define ann_sigmoid_approximate_sse2 ANN_NAME(sigmoid_approximate_sse2)
+#define ann_tanh_approximate_sse2 ANN_NAME(tanh_approximate_sse2)
+#define ann_elu_approximate_sse2 ANN_NAME(elu_approximate_sse2)
+#define ann_gelu_approximate_sse2 ANN_NAME(gelu_approximate_sse2)
+#define ann_softmax_approximate_sse2 ANN_NAME(softmax_approximate_sse2)
+#define ann_sigmoid_fast_sse2 ANN_NAME(sigmoid_fast_sse2)
+#define ann_tanh_fast_sse2 ANN_NAME(tanh_fast_sse2)
+#define ann_elu_fast_sse2 ANN_NAME(elu_fast_sse2)
+#define ann_gelu_fast_sse2 ANN_NAME(gelu_fast_sse2)
+#define ann_softmax_fast_sse2 ANN_NAME(softmax_fast_sse2)
+#define ann_kernel_sse2 ANN_NAME(kernel_sse2)
+#define ann_dot_avx2 ANN_NAME(dot_avx2)
+#define ann_dot4_avx2 ANN_NAME(dot4_avx2)
+#define ann_axpy_avx2 ANN_NAME(axpy_avx2)
+#define ann_delta_avx2 ANN_NAME(delta_avx2)
+#define ann_gradient_avx2 ANN_NAME(gradient_avx2)
+#define ann_update_avx2 ANN_NAME(update_avx2)
+#define ann_sigmoid_approximate_avx2 ANN_NAME(sigmoid_approximate_avx2)
+#define ann_tanh_approximate_avx2 ANN_NAME(tanh_approximate_avx2)
+#define ann_elu_approximate_avx2 ANN_NAME(elu_approximate_avx2)
+#define ann_gelu_approximate_avx2 ANN_NAME(gelu_approximate_avx2)
+#define ann_softmax_approximate_avx2 ANN_NAME(softmax_approximate_avx2)
+#define ann_sigmoid_fast_avx2 ANN_NAME(sigmoid_fast_avx2)
+#define ann_tanh_fast_avx2 ANN_NAME(tanh_fast_avx2)
+#define ann_elu_fast_avx2 ANN_NAME(elu_fast_avx2)
+#define ann_gelu_fast_avx2 ANN_NAME(gelu_fast_avx2)
+#define ann_softmax_fast_avx2 ANN_NAME(softmax_fast_avx2)
+#define ann_kernel_avx2 ANN_NAME(kernel_avx2)
+#define ann_dot_avx512 ANN_NAME(dot_avx512)
+#define ann_dot4_avx512 ANN_NAME(dot4_avx512)
+#define ann_axpy_avx512 ANN_NAME(axpy_avx512)
+#define ann_delta_avx512 ANN_NAME(delta_avx512)
+#define ann_gradient_avx512 ANN_NAME(gradient_avx512)
+#define ann_update_avx512 ANN_NAME(update_avx512)
+#define ann_sigmoid_approximate_avx512 ANN_NAME(sigmoid_approximate_avx512)
+#define ann_tanh_approximate_avx512 ANN_NAME(tanh_approximate_avx512)
+#define ann_elu_approximate_avx512 ANN_NAME(elu_approximate_avx512)
+#define ann_gelu_approximate_avx512 ANN_NAME(gelu_approximate_avx512)
+#define ann_softmax_approximate_avx512 ANN_NAME(softmax_approximate_avx512)
+#define ann_sigmoid_fast_avx512 ANN_NAME(sigmoid_fast_avx512)
+#define ann_tanh_fast_avx512 ANN_NAME(tanh_fast_avx512)
+#define ann_elu_fast_avx512 ANN_NAME(elu_fast_avx512)
+#define ann_gelu_fast_avx512 ANN_NAME(gelu_fast_avx512)
+#define ann_softmax_fast_avx512 ANN_NAME(softmax_fast_avx512)
+#define ann_kernel_avx512 ANN_NAME(kernel_avx512)
+#define ACTIVATION ANN_NAME(ACTIVATION)
+#define ACTIVATION_LAYER ANN_NAME(ACTIVATION_LAYER)
+#define ACTIVATION_LAYER_PARTIAL ANN_NAME(ACTIVATION_LAYER_PARTIAL)
+
+#else // ANN_VARIANT_UNDEF
+
+#undef ann_fp_t
+#undef ann_acc_t
+#undef ann_kernel_t
+#undef ann_t
+#undef ann_batch_t
+#undef ann_context_t
+#undef ann_init
+#undef ann_copy
+#undef ann_free
+#undef ann_save
+#undef ann_load
+#undef ann_load_mmap
+#undef ann_random
+#undef ann_propagation_forward
+#undef ann_propagation_backward
+#undef ann_train_numeric
+#undef ann_gradient_numeric
+#undef ann_context_init
+#undef ann_context_free
+#undef ann_propagation_forward_context
+#undef ann_propagation_backward_context
+#undef ann_batch_init
+#undef ann_batch_free
+#undef ann_propagation_forward_batch
+#undef ann_propagation_backward_batch
+#undef ann_gradient_batch
+#undef ann_gradient_apply
+#undef ann_gradient_apply_range
+#undef ann_error_total
+#undef ann_set_activation
+#undef ann_set_accuracy
+#undef ann_set_simd
+#undef ann_set_layout
+#undef ann_layout_sync
+#undef ann_set_optimizer
+#undef ann_optimizer_step
+#undef ann_simd_detect
+#undef ann_print_weight
+#undef ann_print_neuron
+#undef ann_rebase
+#undef ann_file_t
+#undef ann_file_offset
+#undef ann_file_check
+#undef ann_transpose_n
+#undef ann_transpose_size
+#undef ann_optimizer_state_n
+#undef ann_optimize_row
+#undef ann_forward
+#undef ann_backward
+#undef ann_backward_update
+#undef ann_delta_batch
+#undef ann_random_range
+#undef ann_layer_forward_batch
+#undef ann_layer_delta_batch
+#undef ann_layer_gradient_batch
+#undef ann_error
+#undef ann_error_partial
+#undef ann_loss
+#undef ann_activation_identity
+#undef ann_activation_identity_partial
+#undef ann_activation_binary
+#undef ann_activation_binary_partial
+#undef ann_activation_sign
+#undef ann_activation_sign_partial
+#undef ann_activation_sigmoid
+#undef ann_activation_sigmoid_partial
+#undef ann_activation_relu
+#undef ann_activation_relu_partial
+#undef ann_activation_elu
+#undef ann_activation_elu_partial
+#undef ann_activation_lrelu
+#undef ann_activation_lrelu_partial
+#undef ann_activation_tanh
+#undef ann_activation_tanh_partial
+#undef ann_activation_gelu
+#undef ann_activation_gelu_partial
+#undef ann_activation_softmax_layer
+#undef ann_activation_resolve
+#undef ann_activation_identity_layer
+#undef ann_activation_identity_layer_partial
+#undef ann_activation_binary_layer
+#undef ann_activation_binary_layer_partial
+#undef ann_activation_sigmoid_layer
+#undef ann_activation_sigmoid_layer_partial
+#undef ann_activation_relu_layer
+#undef ann_activation_relu_layer_partial
+#undef ann_activation_elu_layer
+#undef ann_activation_elu_layer_partial
+#undef ann_activation_lrelu_layer
+#undef ann_activation_lrelu_layer_partial
+#undef ann_activation_tanh_layer
+#undef ann_activation_tanh_layer_partial
+#undef ann_activation_gelu_layer
+#undef ann_activation_gelu_layer_partial
+#undef ann_dot_scalar
+#undef ann_dot4_scalar
+#undef ann_axpy_scalar
+#undef ann_delta_scalar
+#undef ann_gradient_scalar
+#undef ann_update_scalar
+#undef ann_kernel_scalar
+#undef ann_dot_sse2
+#undef ann_dot4_sse2
+#undef ann_axpy_sse2
+#undef ann_delta_sse2
+#undef ann_gradient_sse2
+#undef ann_update_sse2
+#undef ann_sigmoid_approximate_sse2
+#undef ann_tanh_approximate_sse2
+#undef ann_elu_approximate_sse2
+#undef ann_gelu_approximate_sse2
+#undef ann_softmax_approximate_sse2
+#undef ann_sigmoid_fast_sse2
+#undef ann_tanh_fast_sse2
+#undef ann_elu_fast_sse2
+#undef ann_gelu_fast_sse2
+#undef ann_softmax_fast_sse2
+#undef ann_kernel_sse2
+#undef ann_dot_avx2
+#undef ann_dot4_avx2
+#undef ann_axpy_avx2
+#undef ann_delta_avx2
+#undef ann_gradient_avx2
+#undef ann_update_avx2
+#undef ann_sigmoid_approximate_avx2
+#undef ann_tanh_approximate_avx2
+#undef ann_elu_approximate_avx2
+#undef ann_gelu_approximate_avx2
+#undef ann_softmax_approximate_avx2
+#undef ann_sigmoid_fast_avx2
+#undef ann_tanh_fast_avx2
+#undef ann_elu_fast_avx2
+#undef ann_gelu_fast_avx2
+#undef ann_softmax_fast_avx2
+#undef ann_kernel_avx2
+#undef ann_dot_avx512
+#undef ann_dot4_avx512
+#undef ann_axpy_avx512
+#undef ann_delta_avx512
+#undef ann_gradient_avx512
+#undef ann_update_avx512
+#undef ann_sigmoid_approximate_avx512
+#undef ann_tanh_approximate_avx512
+#undef ann_elu_approximate_avx512
+#undef ann_gelu_approximate_avx512
+#undef ann_softmax_approximate_avx512
+#undef ann_sigmoid_fast_avx512
+#undef ann_tanh_fast_avx512
+#undef ann_elu_fast_avx512
+#undef ann_gelu_fast_avx512
+#undef ann_softmax_fast_avx512
+#undef ann_kernel_avx512
+#undef ACTIVATION
+#undef ACTIVATION_LAYER
+#undef ACTIVATION_LAYER_PARTIAL
+
+#undef ANN_NAME
+#undef ANN_PASTE
+#undef ANN_PASTE_
+
+#undef ANN_FP
+#undef ANN_ACC
+#undef ANN_PREFIX
+#undef ANN_VARIANT_UNDEF
+
+#endif // ANN_VARIANT_UNDEF
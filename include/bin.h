@@ -9,15 +9,183 @@
 
 #include "type.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define BIN_POSIX
+#define BIN_MMAP
+#endif
+
+#if defined(__linux__) && defined(__LP64__)
+#define BIN_INSERT_RANGE
+#endif
+
+// The largest number of bytes moved at a time when inserting blocks
+#ifndef BIN_INSERT_CHUNK
+#define BIN_INSERT_CHUNK (1 << 20)
+#endif
+
+// The largest number of bytes read at a time by range scans and multiple key
+// searches
+#ifndef BIN_SCAN_CHUNK
+#define BIN_SCAN_CHUNK (1 << 20)
+#endif
+
 typedef struct {
   uint_t length;
   uint_t block_size;
 } bin_meta_t;
 
+// bin_index_t
+//
+// A sparse index of the keys of a bin_t, holding the key of every stride'th
+// block as a fence pointer. A search bisects the fences in memory, then reads
+// the stride blocks between two fences at once. The index may be saved beside
+// the file, as a header holding the length covered and the stride followed by
+// the keys, so that it need not be rebuilt when the file is opened again.
+
+typedef struct {
+  // The number of blocks between fences
+  uint_t stride;
+
+  // The number of blocks of the file covered by the fences
+  uint_t length;
+
+  // The fences, the key of every stride'th block
+  bin_key_t *key;
+  uint_t key_n;
+  uint_t capacity;
+
+  // The path of the saved index or NULL, and the number of keys and blocks
+  // covered when it was last saved
+  char *path;
+  uint_t saved_n;
+  uint_t saved_length;
+} bin_index_t;
+
+// bin_segment_t
+//
+// A segment of a bin_model_t, predicting the index of a key from the first
+// key of the segment and its index
+
+typedef struct {
+  bin_key_t key;
+  uint_t index;
+  double slope;
+} bin_segment_t;
+
+// bin_model_t
+//
+// A learned index of the keys of a bin_t, approximating the index of each key
+// with a piecewise linear function of the key, which is never more than error
+// blocks wrong for a key of the file. A search predicts the index of the key,
+// then reads the window of blocks about it at once. The segments are fit
+// greedily as the keys arrive, each extended for as long as some slope keeps
+// every key since its start within the error, so that evenly spaced keys need
+// few segments however many there are.
+
+typedef struct {
+  // The largest difference between the predicted and actual index of a key
+  uint_t error;
+
+  // The number of blocks of the file covered by the segments
+  uint_t length;
+
+  // The segments, in the order of their keys
+  bin_segment_t *segment;
+  uint_t segment_n;
+  uint_t capacity;
+
+  // The range of slopes which keep every key of the last segment within the
+  // error, the upper bound negative while it is unbounded
+  double slope_min;
+  double slope_max;
+} bin_model_t;
+
+// bin_t
+//
+// A bin.h file opened by descriptor, with its header cached in memory. Blocks
+// are read and written with a single positioned system call each, and the
+// header is only written back by bin_sync() or bin_fd_close(), so the length
+// on disk lags behind until then.
+
+typedef struct {
+  // The file descriptor of the opened file
+  int fd;
+
+  // Whether the file was opened for writing
+  int write;
+
+  // Whether the cached header differs from the header on disk
+  int dirty;
+
+  // The cached header
+  bin_meta_t meta;
+
+  // The sparse index of the keys, or NULL
+  bin_index_t *index;
+
+  // The learned index of the keys, or NULL
+  bin_model_t *model;
+
+  // The number of blocks read by searches, as a measure of their cost
+  uint_t probe_n;
+
+  // The header mapped into memory when the file is shared between a single
+  // writer and any number of readers, or NULL, and whether the writer flushes
+  // the blocks to the storage device before publishing their length
+  bin_meta_t *shared;
+  int durable;
+} bin_t;
+
+// bin_range_t
+//
+// An iterator over the blocks of a bin_t with keys in a range, which reads
+// them in runs of up to BIN_SCAN_CHUNK bytes
+
+typedef struct {
+  // The file, which must not be changed while iterating
+  bin_t *bin;
+
+  // The index of the first block in the range, of the next block to read,
+  // and of the first block after the range
+  uint_t start;
+  uint_t next;
+  uint_t end;
+
+  // The blocks returned by the last bin_range_next()
+  uint8_t *chunk;
+  uint_t chunk_n;
+} bin_range_t;
+
+// bin_map_t
+//
+// A bin.h file mapped into memory, so that the header and the blocks are read
+// and written in place without a system call. The file is grown geometrically
+// as blocks are added, and trimmed to its length when closed.
+
+typedef struct {
+  // The file descriptor of the mapped file
+  int fd;
+
+  // Whether the file was opened for writing
+  int write;
+
+  // The header, at the start of the mapping
+  bin_meta_t *meta;
+
+  // The first block, directly after the header
+  uint8_t *block;
+
+  // The number of blocks which fit within the mapping
+  uint_t capacity;
+
+  // The size of the mapping in bytes
+  uint_t map_n;
+} bin_map_t;
+
 FILE *bin_init(char const *, uint_t);
 FILE *bin_open(char const *path);
 void bin_close(FILE *);
-void bin_read(FILE *, int_t, void *, uint_t);
+uint_t bin_read(FILE *, int_t, void *, uint_t);
 void bin_write(FILE *, int_t, void *, uint_t);
 void bin_insert(FILE *, int_t, void *, uint_t);
 void bin_append(FILE *, void *, uint_t);
@@ -28,17 +196,108 @@ uint_t bin_block_size(FILE *);
 int_t bin_search(FILE *, bin_key_t);
 uint_t bin_fuzzy_index(int_t);
 
+#ifdef BIN_POSIX
+bin_t *bin_fd_init(char const *, uint_t);
+bin_t *bin_fd_open(char const *, int);
+int bin_fd_close(bin_t *);
+int bin_fd_read(bin_t const *, int_t, void *, uint_t);
+int bin_fd_write(bin_t *, int_t, void const *, uint_t);
+int bin_fd_insert(bin_t *, int_t, void const *, uint_t);
+int bin_fd_append(bin_t *, void const *, uint_t);
+int bin_fd_merge(bin_t *, void const *, uint_t);
+int bin_sync(bin_t *);
+int bin_fd_index(bin_t *, uint_t, char const *);
+int bin_fd_model(bin_t *, uint_t);
+int bin_fd_share(bin_t *, int);
+uint_t bin_fd_refresh(bin_t *);
+
+uint_t bin_fd_length(bin_t const *);
+uint_t bin_fd_block_size(bin_t const *);
+
+int_t bin_fd_search(bin_t *, bin_key_t);
+int_t bin_fd_search_interpolate(bin_t *, bin_key_t);
+int bin_fd_search_sorted(bin_t *, bin_key_t const *, uint_t, int_t *);
+int bin_fd_lower_bound(bin_t *, bin_key_t, uint_t *);
+
+bin_range_t *bin_fd_range(bin_t *, bin_key_t, bin_key_t);
+uint_t bin_range_next(bin_range_t *, void const **);
+void bin_range_free(bin_range_t *);
+#endif
+
+#ifdef BIN_MMAP
+bin_map_t *bin_map_init(char const *, uint_t);
+bin_map_t *bin_map_open(char const *, int);
+int bin_map_close(bin_map_t *);
+void bin_map_read(bin_map_t const *, int_t, void *, uint_t);
+int bin_map_write(bin_map_t *, int_t, void const *, uint_t);
+int bin_map_insert(bin_map_t *, int_t, void const *, uint_t);
+int bin_map_append(bin_map_t *, void const *, uint_t);
+void *bin_map_block(bin_map_t const *, int_t);
+
+uint_t bin_map_length(bin_map_t const *);
+uint_t bin_map_block_size(bin_map_t const *);
+
+int_t bin_map_search(bin_map_t const *, bin_key_t);
+#endif
+
 #endif // BIN_H
 
 #ifdef BIN_IMPLEMENTATION // IMPLEMENTATION
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef BIN_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef BIN_INSERT_RANGE
+#include <linux/falloc.h>
+#include <sys/syscall.h>
+#endif
 
 static void bin_write_length(FILE *, uint_t);
 static void bin_write_block_size(FILE *, uint_t);
 
-#define index_bytes(i, bs) ((i * bs) + sizeof(bin_meta_t))
+#ifdef BIN_POSIX
+static int bin_fd_pread(int, void *, uint_t, uint_t);
+static int bin_fd_pwrite(int, void const *, uint_t, uint_t);
+static int bin_fd_shift(bin_t *, uint_t, uint_t);
+static int bin_fd_key(bin_t *, uint_t, bin_key_t *);
+static int_t bin_block_search(uint8_t const *, int_t, int_t, uint_t,
+                              bin_key_t);
+static int bin_index_update(bin_t *);
+static int bin_index_push(bin_index_t *, bin_key_t);
+static int bin_index_save(bin_index_t *);
+static void bin_index_reset(bin_index_t *);
+static int_t bin_index_search(bin_t *, bin_key_t);
+static int bin_model_update(bin_t *);
+static int bin_model_push(bin_model_t *, bin_key_t, uint_t);
+static void bin_model_reset(bin_model_t *);
+static int_t bin_model_search(bin_t *, bin_key_t);
+#endif
+
+#ifdef BIN_INSERT_RANGE
+static int bin_fd_insert_range(int, uint_t, uint_t);
+#endif
+
+#ifdef BIN_MMAP
+static bin_map_t *bin_map_create(int, int);
+static int bin_map_reserve(bin_map_t *, uint_t);
+#endif
+
+#define index_bytes(i, bs) (((i) * (bs)) + sizeof(bin_meta_t))
+
+#define chunk_blocks(bs)                                                       \
+  ((BIN_INSERT_CHUNK > (bs)) ? BIN_INSERT_CHUNK / (bs) : 1)
+
+#define scan_blocks(bs) ((BIN_SCAN_CHUNK > (bs)) ? BIN_SCAN_CHUNK / (bs) : 1)
+
+#define block_key(block, k) memcpy(&(k), (block), sizeof(bin_key_t))
 
 #define member_sizeof(type, member) (sizeof(((type *)0)->member))
 
@@ -99,14 +358,17 @@ void bin_close(FILE *f) { fclose(f); }
 // i - The initial index of the read
 // data - The block_t buffer to be read into
 // n - The number of elements to read into the buffer
+//
+// return - The number of elements read, fewer than n if the file is shorter
+//          than its header claims or could not be read
 
-void bin_read(FILE *f, int_t i, void *data, uint_t n) {
+uint_t bin_read(FILE *f, int_t i, void *data, uint_t n) {
   uint_t bs = bin_block_size(f);
 
   assert(0 <= i && (i + n) <= bin_length(f));
 
   fseek(f, index_bytes(i, bs), SEEK_SET);
-  fread(data, bs, n, f);
+  return fread(data, bs, n, f);
 }
 
 // bin_write()
@@ -154,7 +416,8 @@ void bin_append(FILE *f, void *data, uint_t n) {
 
 // bin_insert()
 //
-// Inserts the given data into the binary file
+// Inserts the given data into the binary file, shifting the following blocks
+// from the end backwards, BIN_INSERT_CHUNK bytes at a time
 //
 // f - The file to be inserted into
 // i - The initial index of the insertion
@@ -167,16 +430,24 @@ void bin_insert(FILE *f, int_t i, void *data, uint_t n) {
 
   assert(0 <= i && i <= l);
 
-  uint_t tmp_n = (l - i) * bs;
+  uint_t chunk_n = chunk_blocks(bs);
+  uint8_t *tmp = (uint8_t *)malloc(chunk_n * bs);
 
-  uint8_t tmp[tmp_n];
+  for (uint_t end = l; end > (uint_t)i;) {
+    uint_t k = (end - i < chunk_n) ? end - i : chunk_n;
+    end -= k;
 
-  fseek(f, index_bytes(i, bs), SEEK_SET);
-  fread(tmp, bs, l - i, f);
+    fseek(f, index_bytes(end, bs), SEEK_SET);
+    fread(tmp, bs, k, f);
+
+    fseek(f, index_bytes(end + n, bs), SEEK_SET);
+    fwrite(tmp, bs, k, f);
+  }
+
+  free(tmp);
 
   fseek(f, index_bytes(i, bs), SEEK_SET);
   fwrite(data, bs, n, f);
-  fwrite(tmp, 1, tmp_n, f);
 
   bin_write_length(f, l + n);
 }
@@ -296,4 +567,1689 @@ static void bin_write_block_size(FILE *f, uint_t block_size) {
   fwrite(&block_size, member_sizeof(bin_meta_t, block_size), 1, f);
 }
 
+#ifdef BIN_POSIX
+
+// bin_fd_init()
+//
+// Creates the desired binary file, opened by descriptor
+//
+// path - The path and file name for the desired file
+// block_size - The size of each block in bytes
+//
+// return - The newly created file, or NULL on failure
+
+bin_t *bin_fd_init(char const *path, uint_t block_size) {
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (fd < 0)
+    return NULL;
+
+  bin_t *b = (bin_t *)malloc(sizeof(bin_t));
+
+  b->fd = fd;
+  b->write = 1;
+  b->dirty = 1;
+  b->meta = (bin_meta_t){.length = 0, .block_size = block_size};
+  b->index = NULL;
+  b->model = NULL;
+  b->probe_n = 0;
+  b->shared = NULL;
+  b->durable = 0;
+
+  if (bin_sync(b) != 0) {
+    close(fd);
+    free(b);
+    return NULL;
+  }
+
+  return b;
+}
+
+// bin_fd_open()
+//
+// Opens the desired binary file by descriptor, reading its header once
+//
+// path - The path and file name for the desired file
+// write - Non-zero to open the file for writing as well as reading
+//
+// return - The newly opened file, or NULL on failure
+
+bin_t *bin_fd_open(char const *path, int write) {
+  int fd = open(path, write ? O_RDWR : O_RDONLY);
+
+  if (fd < 0)
+    return NULL;
+
+  bin_meta_t meta;
+
+  if (bin_fd_pread(fd, &meta, sizeof(meta), 0) != 0 || meta.block_size == 0) {
+    close(fd);
+    return NULL;
+  }
+
+  bin_t *b = (bin_t *)malloc(sizeof(bin_t));
+
+  b->fd = fd;
+  b->write = write;
+  b->dirty = 0;
+  b->meta = meta;
+  b->index = NULL;
+  b->model = NULL;
+  b->probe_n = 0;
+  b->shared = NULL;
+  b->durable = 0;
+
+  return b;
+}
+
+// bin_fd_close()
+//
+// Writes back the header and the saved index if they have changed, then
+// closes the desired binary file
+//
+// b - The file to be closed
+//
+// return - 0 on success, or -1 if the header or index could not be written
+
+int bin_fd_close(bin_t *b) {
+  int error = bin_sync(b);
+
+  if (b->index) {
+    free(b->index->key);
+    free(b->index->path);
+    free(b->index);
+  }
+
+  if (b->model) {
+    free(b->model->segment);
+    free(b->model);
+  }
+
+  if (b->shared)
+    munmap(b->shared, sizeof(bin_meta_t));
+
+  close(b->fd);
+  free(b);
+
+  return error;
+}
+
+// bin_fd_read()
+//
+// Read the desired blocks into the buffer
+//
+// b - The file
+// i - The initial index of the read
+// data - The block_t buffer to be read into
+// n - The number of elements to read into the buffer
+//
+// return - 0 on success, or -1 on failure
+
+int bin_fd_read(bin_t const *b, int_t i, void *data, uint_t n) {
+  uint_t bs = b->meta.block_size;
+
+  assert(0 <= i && (i + n) <= b->meta.length);
+
+  return bin_fd_pread(b->fd, data, n * bs, index_bytes(i, bs));
+}
+
+// bin_fd_write()
+//
+// Write the buffer into the file, extending it past its end if needed. Only
+// the cached length is updated, unless the file is shared, when the new length
+// is published at once.
+//
+// b - The file
+// i - The initial index of the write
+// data - The block_t buffer to write from
+// n - The number of elements to write from the buffer
+//
+// return - 0 on success, or -1 on failure or if the file is shared and
+//          blocks would be overwritten
+
+int bin_fd_write(bin_t *b, int_t i, void const *data, uint_t n) {
+  uint_t l = b->meta.length;
+  uint_t bs = b->meta.block_size;
+
+  assert(b->write && 0 <= i && i <= l);
+
+  // Readers of a shared file may be reading any block before its length
+  if (b->shared && (uint_t)i < l)
+    return -1;
+
+  if (bin_fd_pwrite(b->fd, data, n * bs, index_bytes(i, bs)) != 0)
+    return -1;
+
+  bin_index_t *index = b->index;
+
+  // Overwritten keys may have moved the fences, while appended keys are
+  // added to the index without reading them back, unless it has fallen
+  // behind and is to be brought up to date by the next search
+  if (index && (uint_t)i < l)
+    bin_index_reset(index);
+
+  if (index && index->length == l) {
+    for (uint_t j = l; j < i + n; j++) {
+      if (j % index->stride == 0) {
+        bin_key_t k;
+        block_key((uint8_t const *)data + (j - i) * bs, k);
+
+        if (bin_index_push(index, k) != 0)
+          break;
+      }
+
+      index->length = j + 1;
+    }
+  }
+
+  bin_model_t *model = b->model;
+
+  if (model && (uint_t)i < l)
+    bin_model_reset(model);
+
+  if (model && model->length == l) {
+    for (uint_t j = l; j < i + n; j++) {
+      bin_key_t k;
+      block_key((uint8_t const *)data + (j - i) * bs, k);
+
+      if (bin_model_push(model, k, j) != 0)
+        break;
+    }
+  }
+
+  if (i + n > l) {
+    b->meta.length = i + n;
+    b->dirty = 1;
+  }
+
+  return b->shared ? bin_sync(b) : 0;
+}
+
+// bin_fd_insert()
+//
+// Inserts the given data into the file. Where the file system allows, the
+// following blocks are moved by inserting a range into the file, without
+// copying them, and otherwise they are shifted from the end backwards,
+// BIN_INSERT_CHUNK bytes at a time.
+//
+// b - The file
+// i - The initial index of the insertion
+// data - The blocks to insert
+// n - The number of blocks to be inserted
+//
+// return - 0 on success, or -1 on failure or if the file is shared and blocks
+//          would be moved
+
+int bin_fd_insert(bin_t *b, int_t i, void const *data, uint_t n) {
+  uint_t l = b->meta.length;
+  uint_t bs = b->meta.block_size;
+
+  assert(b->write && 0 <= i && i <= l);
+
+  if (b->shared && (uint_t)i < l)
+    return -1;
+
+  if ((uint_t)i < l && bin_fd_shift(b, i, n) != 0)
+    return -1;
+
+  if (bin_fd_pwrite(b->fd, data, n * bs, index_bytes(i, bs)) != 0)
+    return -1;
+
+  if (b->index)
+    bin_index_reset(b->index);
+
+  if (b->model)
+    bin_model_reset(b->model);
+
+  b->meta.length = l + n;
+  b->dirty = 1;
+
+  return b->shared ? bin_sync(b) : 0;
+}
+
+// bin_fd_append()
+//
+// Appends the given data to the end of the file, in a single system call
+//
+// b - The file to be appended to
+// data - The blocks to append
+// n - The number of block to be appended
+//
+// return - 0 on success, or -1 on failure
+
+int bin_fd_append(bin_t *b, void const *data, uint_t n) {
+  return bin_fd_write(b, b->meta.length, data, n);
+}
+
+// bin_fd_merge()
+//
+// Inserts a batch of blocks, sorted by key, among the blocks of the file in a
+// single pass. The file is merged with the batch from the end backwards, from
+// the position of the smallest key in the batch, so that each block moves
+// once. Blocks of the batch follow any blocks of the file with equal keys.
+//
+// b - The file
+// data - The blocks to insert, sorted by key
+// n - The number of blocks to insert
+//
+// return - 0 on success, or -1 on failure, after which the blocks from the
+//          smallest key of the batch onwards may have been overwritten, or if
+//          the file is shared
+
+int bin_fd_merge(bin_t *b, void const *data, uint_t n) {
+  uint8_t const *src = (uint8_t const *)data;
+  uint_t l = b->meta.length;
+  uint_t bs = b->meta.block_size;
+
+  assert(b->write);
+
+  if (n == 0)
+    return 0;
+
+  if (b->shared)
+    return -1;
+
+  // The blocks before the smallest key of the batch are not moved
+  bin_key_t k_file, k_batch;
+  block_key(src, k_batch);
+
+  uint_t start = bin_fuzzy_index(bin_fd_search(b, k_batch));
+
+  uint_t chunk_n = chunk_blocks(bs);
+  uint8_t *in = (uint8_t *)malloc(chunk_n * bs);
+  uint8_t *out = (uint8_t *)malloc(chunk_n * bs);
+
+  // The blocks of the file from start to j and of the batch up to k remain
+  // to be merged. The blocks of the file from in_i to j are held in in, and
+  // out is filled from its end, out_n blocks before dest.
+  uint_t j = l, k = n, in_i = l;
+  uint_t dest = l + n, out_n = 0;
+  int error = 0;
+
+  while (k > 0 && !error) {
+    uint8_t const *x = src + (k - 1) * bs;
+    uint8_t const *y = NULL;
+
+    if (j > start) {
+      if (j == in_i) {
+        in_i = (j - start > chunk_n) ? j - chunk_n : start;
+        error = bin_fd_pread(b->fd, in, (j - in_i) * bs, index_bytes(in_i, bs));
+      }
+
+      y = in + (j - 1 - in_i) * bs;
+      block_key(x, k_batch);
+      block_key(y, k_file);
+    }
+
+    // The larger key is placed first, the block of the batch on a tie
+    if (y && k_file > k_batch) {
+      x = y;
+      j--;
+    } else {
+      k--;
+    }
+
+    memcpy(out + (chunk_n - 1 - out_n) * bs, x, bs);
+
+    // Every block written lies after those of the file not yet read
+    if (++out_n == chunk_n) {
+      dest -= out_n;
+      error |= bin_fd_pwrite(b->fd, out, out_n * bs, index_bytes(dest, bs));
+      out_n = 0;
+    }
+  }
+
+  if (!error && out_n > 0) {
+    dest -= out_n;
+    error = bin_fd_pwrite(b->fd, out + (chunk_n - out_n) * bs, out_n * bs,
+                          index_bytes(dest, bs));
+  }
+
+  free(in);
+  free(out);
+
+  if (b->index)
+    bin_index_reset(b->index);
+
+  if (b->model)
+    bin_model_reset(b->model);
+
+  if (error)
+    return -1;
+
+  b->meta.length = l + n;
+  b->dirty = 1;
+
+  return 0;
+}
+
+// bin_sync()
+//
+// Writes the cached header back to the file if it has changed, after which
+// other readers of the file observe its length, and saves the index if it is
+// saved beside the file. This does not flush the file to the storage device,
+// unless the file is shared durably, when the blocks are flushed before their
+// length is published.
+//
+// b - The file
+//
+// return - 0 on success, or -1 on failure
+
+int bin_sync(bin_t *b) {
+  if (b->index && b->index->path && bin_index_save(b->index) != 0)
+    return -1;
+
+  if (!b->dirty)
+    return 0;
+
+  if (b->shared) {
+#ifdef __APPLE__
+    if (b->durable && fsync(b->fd) != 0)
+      return -1;
+#else
+    if (b->durable && fdatasync(b->fd) != 0)
+      return -1;
+#endif
+
+    // Only the length changes, published by a single aligned store that
+    // readers load whole and after which the blocks it covers are visible
+    __atomic_store_n(&b->shared->length, b->meta.length, __ATOMIC_RELEASE);
+  } else if (bin_fd_pwrite(b->fd, &b->meta, sizeof(b->meta), 0) != 0) {
+    return -1;
+  }
+
+  b->dirty = 0;
+
+  return 0;
+}
+
+// bin_fd_share()
+//
+// Shares the file between a single writer and any number of readers, in this
+// or other processes, without locking. The header is mapped into memory, and
+// every change to the length by the writer is published by bin_sync() with a
+// single atomic store, after the blocks it covers have been written, so that
+// a reader never sees a length covering blocks not yet in place. Only when
+// durable are the blocks also flushed to the storage device first, so that
+// the file after a system crash or power loss never holds such a length;
+// otherwise it may hold a length covering blocks that never reached the
+// device. Writes, insertions and merges that would move or overwrite blocks
+// fail, appends publish their length at once, and appends queued by
+// bin_async.h are published by bin_sync() once they complete. Readers tail
+// the file by polling bin_fd_refresh().
+//
+// b - The file, by the writer opened for writing
+// durable - Non-zero for the writer to flush the blocks before publishing
+//
+// return - 0 on success, or -1 on failure
+
+int bin_fd_share(bin_t *b, int durable) {
+  assert(!b->shared);
+
+  if (b->write && bin_sync(b) != 0)
+    return -1;
+
+  void *p = mmap(NULL, sizeof(bin_meta_t),
+                 b->write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+                 b->fd, 0);
+
+  if (p == MAP_FAILED)
+    return -1;
+
+  b->shared = (bin_meta_t *)p;
+  b->durable = durable;
+
+  bin_fd_refresh(b);
+
+  return 0;
+}
+
+// bin_fd_refresh()
+//
+// Updates the cached length of a shared file to the length last published by
+// the writer, after which the blocks it covers may be read
+//
+// b - The shared file
+//
+// return - The length
+
+uint_t bin_fd_refresh(bin_t *b) {
+  assert(b->shared);
+
+  if (!b->write)
+    b->meta.length = __atomic_load_n(&b->shared->length, __ATOMIC_ACQUIRE);
+
+  return b->meta.length;
+}
+
+// bin_fd_index()
+//
+// Keeps a sparse index of the keys of the file, which bin_fd_search() then
+// uses. Appended keys are added to the index as they are written, and the
+// index is otherwise built, or brought up to date after the file has been
+// changed, by the next search.
+//
+// b - The file
+// stride - The number of blocks between the keys held
+// path - The path of the index saved beside the file, which is loaded now if
+//        it was saved with the same stride and matches the file, and saved
+//        by bin_sync(), or NULL to keep the index in memory alone
+//
+// return - 0 on success, or -1 on failure
+
+int bin_fd_index(bin_t *b, uint_t stride, char const *path) {
+  assert(!b->index && stride > 0);
+
+  bin_index_t *index = (bin_index_t *)calloc(1, sizeof(bin_index_t));
+
+  if (!index)
+    return -1;
+
+  index->stride = stride;
+  b->index = index;
+
+  if (!path)
+    return 0;
+
+  index->path = strdup(path);
+
+  int fd = open(path, O_RDONLY);
+  bin_meta_t meta;
+
+  if (fd < 0)
+    return 0;
+
+  // The saved index is used only if it covers no more than the file, and the
+  // last key held is still that of the file
+  uint_t key_n = 0;
+  bin_key_t k;
+
+  if (bin_fd_pread(fd, &meta, sizeof(meta), 0) == 0 &&
+      meta.block_size == stride && meta.length <= b->meta.length) {
+    key_n = (meta.length + stride - 1) / stride;
+    index->key = (bin_key_t *)malloc(sizeof(bin_key_t) * (key_n + 1));
+    index->capacity = key_n + 1;
+
+    if (bin_fd_pread(fd, index->key, sizeof(bin_key_t) * key_n,
+                     sizeof(meta)) != 0 ||
+        (key_n > 0 &&
+         (bin_fd_pread(b->fd, &k, sizeof(k),
+                       index_bytes((key_n - 1) * stride, b->meta.block_size)) !=
+              0 ||
+          k != index->key[key_n - 1])))
+      key_n = 0;
+  }
+
+  close(fd);
+
+  if (key_n > 0) {
+    index->key_n = key_n;
+    index->saved_n = key_n;
+    index->length = meta.length;
+    index->saved_length = meta.length;
+  }
+
+  return 0;
+}
+
+// bin_fd_model()
+//
+// Keeps a learned index of the keys of the file, which bin_fd_search() then
+// uses in preference to a sparse index. Appended keys are fit as they are
+// written, and the model is otherwise fit, or brought up to date after the
+// file has been changed, by the next search, reading the whole file.
+//
+// b - The file
+// error - The largest number of blocks by which a key may be mispredicted,
+//         each search reading twice as many blocks about the prediction
+//
+// return - 0 on success, or -1 on failure
+
+int bin_fd_model(bin_t *b, uint_t error) {
+  assert(!b->model);
+
+  bin_model_t *model = (bin_model_t *)calloc(1, sizeof(bin_model_t));
+
+  if (!model)
+    return -1;
+
+  model->error = error;
+  b->model = model;
+
+  return 0;
+}
+
+// bin_fd_length()
+//
+// return - The cached length / number of entries in the file
+
+uint_t bin_fd_length(bin_t const *b) { return b->meta.length; }
+
+// bin_fd_block_size()
+//
+// return - The block size for the entries in the file
+
+uint_t bin_fd_block_size(bin_t const *b) { return b->meta.block_size; }
+
+// bin_fd_search()
+//
+// Search for a given key in the file, as bin_search(), with a single system
+// call per probe. With a learned or sparse index, the blocks about the key are
+// found in memory and then read at once.
+//
+// b - The file to be searched within
+// k - The key to search for
+//
+// return - The block_t index of the key. In the case that the key is not found,
+//          The returned value is -( index + 1 ) where index is that of the
+//          first element greater than k or bin_fd_length().
+
+int_t bin_fd_search(bin_t *b, bin_key_t k) {
+  if (b->model && bin_model_update(b) == 0)
+    return bin_model_search(b, k);
+
+  if (b->index && bin_index_update(b) == 0)
+    return bin_index_search(b, k);
+
+  int_t l = 0;
+  int_t r = b->meta.length - 1;
+
+  bin_key_t key;
+
+  while (l <= r) {
+    int_t m = (l + r) / 2;
+
+    if (bin_fd_key(b, m, &key) != 0)
+      return -(l + 1);
+
+    if (key < k)
+      l = m + 1;
+
+    else if (key > k)
+      r = m - 1;
+
+    else
+      return m;
+  }
+
+  return -(l + 1);
+}
+
+// bin_fd_search_interpolate()
+//
+// Search for a given key in the file, as bin_fd_search(), probing where the
+// key would lie were the keys between the bounds evenly spaced. Evenly spaced
+// keys are found in few probes, while any probe which fails to halve the
+// range is followed by bisection, so that skewed keys take at most about
+// twice the probes of bisection.
+//
+// b - The file to be searched within
+// k - The key to search for
+//
+// return - As bin_fd_search()
+
+int_t bin_fd_search_interpolate(bin_t *b, bin_key_t k) {
+  int_t n = b->meta.length;
+
+  if (n == 0)
+    return -1;
+
+  // The key lies strictly between the keys at the bounds
+  int_t l = 0;
+  int_t r = n - 1;
+
+  bin_key_t k_l, k_r;
+
+  if (bin_fd_key(b, l, &k_l) != 0 || k <= k_l)
+    return (k == k_l) ? 0 : -1;
+
+  if (bin_fd_key(b, r, &k_r) != 0 || k >= k_r)
+    return (k == k_r) ? r : -(n + 1);
+
+  int bisect = 0;
+
+  while (r - l > 1) {
+    int_t m = (l + r) / 2;
+
+    if (!bisect)
+      m = l + (int_t)((double)(k - k_l) / (double)(k_r - k_l) * (r - l));
+
+    m = (m <= l) ? l + 1 : (m >= r) ? r - 1 : m;
+
+    bin_key_t key;
+    int_t width = r - l;
+
+    if (bin_fd_key(b, m, &key) != 0)
+      return -(l + 2);
+
+    if (key < k) {
+      l = m;
+      k_l = key;
+    }
+
+    else if (key > k) {
+      r = m;
+      k_r = key;
+    }
+
+    else
+      return m;
+
+    bisect = (r - l) > width / 2;
+  }
+
+  return -(r + 1);
+}
+
+// bin_fd_search_sorted()
+//
+// Search for many keys, sorted in ascending order, in a single pass over the
+// file. Each key is first sought among the blocks read for the keys before it,
+// and otherwise searched for as by bin_fd_search(), after which the following
+// BIN_SCAN_CHUNK bytes are read at once if the next key lies within them. Keys
+// close together thus cost a share of one sequential read, and keys far apart
+// a search each.
+//
+// b - The file to be searched within
+// key - The keys to search for, in ascending order
+// n - The number of keys
+// index - The result of bin_fd_search() for each key
+//
+// return - 0 on success, or -1 on failure
+
+int bin_fd_search_sorted(bin_t *b, bin_key_t const *key, uint_t n,
+                         int_t *index) {
+  uint_t l = b->meta.length;
+  uint_t bs = b->meta.block_size;
+
+  uint_t chunk_n = scan_blocks(bs);
+  uint8_t *chunk = (uint8_t *)malloc(chunk_n * bs);
+
+  if (!chunk)
+    return -1;
+
+  // The blocks held from start, following the result of an earlier key, so
+  // that no later key lies before them
+  uint_t start = 0, fill = 0;
+  bin_key_t last;
+
+  for (uint_t s = 0; s < n; s++) {
+    if (fill > 0 && key[s] <= last) {
+      int_t i = bin_block_search(chunk, 0, fill - 1, bs, key[s]);
+      index[s] = (i >= 0) ? (int_t)start + i : i - (int_t)start;
+
+      continue;
+    }
+
+    index[s] = bin_fd_search(b, key[s]);
+    fill = 0;
+
+    if (s + 1 == n)
+      break;
+
+    // A single probe decides whether the next key lies within the next chunk
+    start = bin_fuzzy_index(index[s]);
+    uint_t m = (l - start < chunk_n) ? l - start : chunk_n;
+
+    if (m > 0 && bin_fd_key(b, start + m - 1, &last) == 0 &&
+        key[s + 1] <= last) {
+      b->probe_n++;
+
+      if (bin_fd_pread(b->fd, chunk, m * bs, index_bytes(start, bs)) != 0) {
+        free(chunk);
+        return -1;
+      }
+
+      fill = m;
+    }
+  }
+
+  free(chunk);
+
+  return 0;
+}
+
+// bin_fd_lower_bound()
+//
+// Find the first block with a key no less than the given key. A key found by
+// bin_fd_search() is followed back over any repeats of it, doubling the step
+// each time, and the first is then bisected.
+//
+// b - The file to be searched within
+// k - The key to search for
+// index - Set to the index of the first block with a key no less than k, or
+//         bin_fd_length() if there is none or on failure
+//
+// return - 0 on success, or -1 if a key could not be read
+
+int bin_fd_lower_bound(bin_t *b, bin_key_t k, uint_t *index) {
+  int_t i = bin_fd_search(b, k);
+  *index = b->meta.length;
+
+  if (i < 0) {
+    *index = bin_fuzzy_index(i);
+    return 0;
+  }
+
+  // The key at lo is less than k, and the key at hi equals it
+  int_t lo = i, hi = i;
+  bin_key_t key;
+
+  for (int_t step = 1;; step *= 2) {
+    lo = hi - step;
+
+    if (lo < 0)
+      break;
+
+    if (bin_fd_key(b, lo, &key) != 0)
+      return -1;
+
+    if (key < k)
+      break;
+
+    hi = lo;
+  }
+
+  lo = (lo < -1) ? -1 : lo;
+
+  while (hi - lo > 1) {
+    int_t m = lo + (hi - lo) / 2;
+
+    if (bin_fd_key(b, m, &key) != 0)
+      return -1;
+
+    if (key < k)
+      lo = m;
+    else
+      hi = m;
+  }
+
+  *index = hi;
+
+  return 0;
+}
+
+// bin_fd_range()
+//
+// Begins iterating over the blocks with keys from k_0 up to but excluding k_1
+//
+// b - The file to be iterated over
+// k_0 - The smallest key of the range
+// k_1 - The first key past the range
+//
+// return - The iterator, or NULL on failure
+
+bin_range_t *bin_fd_range(bin_t *b, bin_key_t k_0, bin_key_t k_1) {
+  bin_range_t *range = (bin_range_t *)malloc(sizeof(bin_range_t));
+
+  if (!range)
+    return NULL;
+
+  range->bin = b;
+
+  if (bin_fd_lower_bound(b, k_0, &range->start) != 0 ||
+      (k_1 > k_0 && bin_fd_lower_bound(b, k_1, &range->end) != 0)) {
+    free(range);
+    return NULL;
+  }
+
+  range->end = (k_1 > k_0) ? range->end : range->start;
+  range->next = range->start;
+  range->chunk_n = scan_blocks(b->meta.block_size);
+  range->chunk = (uint8_t *)malloc(range->chunk_n * b->meta.block_size);
+
+  if (!range->chunk) {
+    free(range);
+    return NULL;
+  }
+
+  return range;
+}
+
+// bin_range_next()
+//
+// Reads the next run of blocks of the range
+//
+// range - The iterator
+// blocks - Set to the blocks read, valid until the next call
+//
+// return - The number of blocks read, 0 at the end of the range or on failure
+
+uint_t bin_range_next(bin_range_t *range, void const **blocks) {
+  uint_t bs = range->bin->meta.block_size;
+  uint_t n = range->end - range->next;
+  n = (n < range->chunk_n) ? n : range->chunk_n;
+
+  if (n == 0 || bin_fd_pread(range->bin->fd, range->chunk, n * bs,
+                             index_bytes(range->next, bs)) != 0)
+    return 0;
+
+  range->next += n;
+  *blocks = range->chunk;
+
+  return n;
+}
+
+// bin_range_free()
+//
+// Frees the iterator
+//
+// range - The iterator to be freed
+
+void bin_range_free(bin_range_t *range) {
+  free(range->chunk);
+  free(range);
+}
+
+// bin_fd_key()
+//
+// Read the key of a block, counting the probe
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_fd_key(bin_t *b, uint_t i, bin_key_t *k) {
+  b->probe_n++;
+
+  return bin_fd_pread(b->fd, k, sizeof(bin_key_t),
+                      index_bytes(i, b->meta.block_size));
+}
+
+// bin_block_search()
+//
+// Bisect blocks held in memory for a given key, from l to r inclusive
+//
+// return - The index of the key, or -( index + 1 ) where index is that of the
+//          first block greater than k
+
+static int_t bin_block_search(uint8_t const *block, int_t l, int_t r, uint_t bs,
+                              bin_key_t k) {
+  while (l <= r) {
+    int_t m = (l + r) / 2;
+    bin_key_t key;
+    block_key(block + m * bs, key);
+
+    if (key < k)
+      l = m + 1;
+
+    else if (key > k)
+      r = m - 1;
+
+    else
+      return m;
+  }
+
+  return -(l + 1);
+}
+
+// bin_fd_pread()
+//
+// Read exactly n bytes at the given offset, continuing after short reads
+//
+// return - 0 on success, or -1 on failure or at the end of the file
+
+static int bin_fd_pread(int fd, void *data, uint_t n, uint_t offset) {
+  uint8_t *p = (uint8_t *)data;
+
+  while (n > 0) {
+    ssize_t r = pread(fd, p, n, offset);
+
+    if (r <= 0)
+      return -1;
+
+    p += r;
+    n -= r;
+    offset += r;
+  }
+
+  return 0;
+}
+
+// bin_fd_pwrite()
+//
+// Write exactly n bytes at the given offset, continuing after short writes
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_fd_pwrite(int fd, void const *data, uint_t n, uint_t offset) {
+  uint8_t const *p = (uint8_t const *)data;
+
+  while (n > 0) {
+    ssize_t r = pwrite(fd, p, n, offset);
+
+    if (r <= 0)
+      return -1;
+
+    p += r;
+    n -= r;
+    offset += r;
+  }
+
+  return 0;
+}
+
+// bin_index_update()
+//
+// Add the keys of the blocks appended since the index was last brought up to
+// date, reading each key from the file
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_index_update(bin_t *b) {
+  bin_index_t *index = b->index;
+  uint_t l = b->meta.length;
+
+  if (index->length > l)
+    bin_index_reset(index);
+
+  for (uint_t j = index->key_n * index->stride; j < l; j += index->stride) {
+    bin_key_t k;
+
+    if (bin_fd_key(b, j, &k) != 0 || bin_index_push(index, k) != 0)
+      return -1;
+  }
+
+  index->length = l;
+
+  return 0;
+}
+
+// bin_index_push()
+//
+// Add a key to the end of the index, growing it geometrically
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_index_push(bin_index_t *index, bin_key_t k) {
+  if (index->key_n == index->capacity) {
+    uint_t capacity = (index->capacity > 0) ? 2 * index->capacity : 64;
+    bin_key_t *key =
+        (bin_key_t *)realloc(index->key, sizeof(bin_key_t) * capacity);
+
+    if (!key)
+      return -1;
+
+    index->key = key;
+    index->capacity = capacity;
+  }
+
+  index->key[index->key_n++] = k;
+
+  return 0;
+}
+
+// bin_index_save()
+//
+// Write the keys added to the index since it was last saved, and the header
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_index_save(bin_index_t *index) {
+  if (index->saved_n == index->key_n && index->saved_length == index->length)
+    return 0;
+
+  int fd = open(index->path, O_WRONLY | O_CREAT, 0644);
+
+  if (fd < 0)
+    return -1;
+
+  bin_meta_t meta = {.length = index->length, .block_size = index->stride};
+  uint_t key_i = sizeof(meta) + sizeof(bin_key_t) * index->saved_n;
+  uint_t key_n = index->key_n - index->saved_n;
+
+  int error =
+      bin_fd_pwrite(fd, index->key + index->saved_n, sizeof(bin_key_t) * key_n,
+                    key_i) ||
+      ftruncate(fd, sizeof(meta) + sizeof(bin_key_t) * index->key_n) ||
+      bin_fd_pwrite(fd, &meta, sizeof(meta), 0);
+
+  close(fd);
+
+  if (error)
+    return -1;
+
+  index->saved_n = index->key_n;
+  index->saved_length = index->length;
+
+  return 0;
+}
+
+// bin_index_reset()
+//
+// Empty the index, to be rebuilt by the next search
+
+static void bin_index_reset(bin_index_t *index) {
+  index->key_n = 0;
+  index->length = 0;
+  index->saved_n = 0;
+}
+
+// bin_index_search()
+//
+// Search for a given key by bisecting the fences, then the blocks between the
+// two fences about the key, read at once
+//
+// return - As bin_fd_search()
+
+static int_t bin_index_search(bin_t *b, bin_key_t k) {
+  bin_index_t const *index = b->index;
+  uint_t bs = b->meta.block_size;
+
+  // The last fence no greater than the key
+  int_t l = 0;
+  int_t r = index->key_n - 1;
+
+  while (l <= r) {
+    int_t m = (l + r) / 2;
+
+    if (index->key[m] <= k)
+      l = m + 1;
+    else
+      r = m - 1;
+  }
+
+  if (r < 0)
+    return -1;
+
+  uint_t start = r * index->stride;
+
+  if (index->key[r] == k)
+    return start;
+
+  uint_t end = start + index->stride;
+  end = (end < b->meta.length) ? end : b->meta.length;
+
+  uint8_t *block = (uint8_t *)malloc((end - start) * bs);
+  b->probe_n++;
+
+  if (!block || bin_fd_pread(b->fd, block, (end - start) * bs,
+                             index_bytes(start, bs)) != 0) {
+    free(block);
+    return -(start + 1);
+  }
+
+  int_t i = bin_block_search(block, 1, end - start - 1, bs, k);
+
+  free(block);
+
+  return (i >= 0) ? (int_t)start + i : i - (int_t)start;
+}
+
+// bin_model_update()
+//
+// Fit the keys of the blocks appended since the model was last brought up to
+// date, reading the file sequentially
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_model_update(bin_t *b) {
+  bin_model_t *model = b->model;
+  uint_t l = b->meta.length;
+  uint_t bs = b->meta.block_size;
+
+  if (model->length > l)
+    bin_model_reset(model);
+
+  if (model->length == l)
+    return 0;
+
+  uint_t chunk_n = chunk_blocks(bs);
+  uint8_t *chunk = (uint8_t *)malloc(chunk_n * bs);
+  int error = !chunk;
+
+  for (uint_t j = model->length; j < l && !error; j += chunk_n) {
+    uint_t n = (l - j < chunk_n) ? l - j : chunk_n;
+    error = bin_fd_pread(b->fd, chunk, n * bs, index_bytes(j, bs));
+
+    for (uint_t i = 0; i < n && !error; i++) {
+      bin_key_t k;
+      block_key(chunk + i * bs, k);
+
+      error = bin_model_push(model, k, j + i);
+    }
+  }
+
+  free(chunk);
+
+  return error ? -1 : 0;
+}
+
+// bin_model_push()
+//
+// Fit the key of the next block, narrowing the slopes of the last segment to
+// keep the block within the error, or starting a new segment at the block
+// when no slope would
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_model_push(bin_model_t *model, bin_key_t k, uint_t i) {
+  if (model->segment_n > 0) {
+    bin_segment_t *s = model->segment + model->segment_n - 1;
+    double dk = (double)(k - s->key);
+    double di = (double)i - (double)s->index;
+
+    // A repeated first key is found at the start of the segment
+    if (dk <= 0) {
+      model->length = i + 1;
+      return 0;
+    }
+
+    double slope_min = (di - model->error) / dk;
+    double slope_max = (di + model->error) / dk;
+
+    if (slope_min < model->slope_min)
+      slope_min = model->slope_min;
+
+    if (model->slope_max >= 0 && slope_max > model->slope_max)
+      slope_max = model->slope_max;
+
+    if (slope_min <= slope_max) {
+      model->slope_min = slope_min;
+      model->slope_max = slope_max;
+
+      s->slope = (slope_min + slope_max) / 2;
+      model->length = i + 1;
+
+      return 0;
+    }
+  }
+
+  if (model->segment_n == model->capacity) {
+    uint_t capacity = (model->capacity > 0) ? 2 * model->capacity : 16;
+    bin_segment_t *segment = (bin_segment_t *)realloc(
+        model->segment, sizeof(bin_segment_t) * capacity);
+
+    if (!segment)
+      return -1;
+
+    model->segment = segment;
+    model->capacity = capacity;
+  }
+
+  model->segment[model->segment_n++] =
+      (bin_segment_t){.key = k, .index = i, .slope = 0};
+
+  model->slope_min = 0;
+  model->slope_max = -1;
+  model->length = i + 1;
+
+  return 0;
+}
+
+// bin_model_reset()
+//
+// Empty the model, to be fit again by the next search
+
+static void bin_model_reset(bin_model_t *model) {
+  model->segment_n = 0;
+  model->length = 0;
+}
+
+// bin_model_search()
+//
+// Search for a given key by predicting its index, then bisecting the window
+// of blocks about the prediction, read at once. Should the window not bracket
+// the key, the file is bisected instead.
+//
+// return - As bin_fd_search()
+
+static int_t bin_model_search(bin_t *b, bin_key_t k) {
+  bin_model_t const *model = b->model;
+  int_t n = b->meta.length;
+  uint_t bs = b->meta.block_size;
+
+  if (n == 0)
+    return -1;
+
+  // The last segment starting no later than the key
+  int_t l = 0;
+  int_t r = model->segment_n - 1;
+
+  while (l <= r) {
+    int_t m = (l + r) / 2;
+
+    if (model->segment[m].key <= k)
+      l = m + 1;
+    else
+      r = m - 1;
+  }
+
+  if (r < 0)
+    return -1;
+
+  bin_segment_t const *s = model->segment + r;
+
+  if (s->key == k)
+    return s->index;
+
+  // A key past the last of the segment lies before the next segment. The
+  // window reaches a block further each side, so that the blocks about a
+  // missing key, both within the error, are read.
+  double p = s->index + s->slope * (double)(k - s->key);
+  int_t next = (r + 1 < (int_t)model->segment_n) ? (int_t)s[1].index : n;
+  p = (p < next) ? p : next;
+
+  int_t e = model->error + 1;
+  int_t start = (p - e > 0) ? (int_t)(p - e) : 0;
+  int_t end = (p + e + 1 < n) ? (int_t)(p + e + 1) : n;
+  start = (start < end) ? start : end - 1;
+
+  uint8_t *block = (uint8_t *)malloc((end - start) * bs);
+  b->probe_n++;
+
+  if (!block || bin_fd_pread(b->fd, block, (end - start) * bs,
+                             index_bytes(start, bs)) != 0) {
+    free(block);
+    return -(start + 1);
+  }
+
+  bin_key_t first, last;
+  block_key(block, first);
+  block_key(block + (end - start - 1) * bs, last);
+
+  int_t i = bin_block_search(block, 0, end - start - 1, bs, k);
+
+  free(block);
+
+  if (i >= 0)
+    return start + i;
+
+  if ((start == 0 || first < k) && (end == n || last > k))
+    return i - start;
+
+  bin_model_t *m = b->model;
+  b->model = NULL;
+  i = bin_fd_search(b, k);
+  b->model = m;
+
+  return i;
+}
+
+// bin_fd_shift()
+//
+// Move the blocks of the file from i onwards n blocks towards its end,
+// leaving the blocks between to be overwritten
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_fd_shift(bin_t *b, uint_t i, uint_t n) {
+  uint_t l = b->meta.length;
+  uint_t bs = b->meta.block_size;
+
+#ifdef BIN_INSERT_RANGE
+  int inserted = bin_fd_insert_range(b->fd, index_bytes(i, bs), n * bs);
+
+  // Once the range is inserted the blocks have moved, and must not be shifted
+  // again
+  if (inserted != -1)
+    return inserted == 0 ? 0 : -1;
+#endif
+
+  uint_t chunk_n = chunk_blocks(bs);
+  uint8_t *tmp = (uint8_t *)malloc(chunk_n * bs);
+  int error = 0;
+
+  for (uint_t end = l; end > i && !error;) {
+    uint_t k = (end - i < chunk_n) ? end - i : chunk_n;
+    end -= k;
+
+    error = bin_fd_pread(b->fd, tmp, k * bs, index_bytes(end, bs)) ||
+            bin_fd_pwrite(b->fd, tmp, k * bs, index_bytes(end + n, bs));
+  }
+
+  free(tmp);
+
+  return error ? -1 : 0;
+}
+
+#ifdef BIN_INSERT_RANGE
+
+// bin_fd_insert_range()
+//
+// Insert n bytes of space into the file at the given offset without copying
+// the bytes after it, which requires n to be a multiple of the file system's
+// block size. The range is inserted at the preceding boundary of a file
+// system block, and the few bytes from there to the offset are copied back.
+//
+// return - 0 on success, -1 if the range could not be inserted, in which case
+//          the file is unchanged, or -2 if the range was inserted but the
+//          bytes before the offset could not be copied back
+
+static int bin_fd_insert_range(int fd, uint_t offset, uint_t n) {
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || st.st_blksize <= 0 || n % st.st_blksize != 0 ||
+      offset >= (uint_t)st.st_size)
+    return -1;
+
+  uint_t aligned = offset - offset % st.st_blksize;
+
+  if (syscall(SYS_fallocate, fd, FALLOC_FL_INSERT_RANGE, (off_t)aligned,
+              (off_t)n) != 0)
+    return -1;
+
+  uint_t head_n = offset - aligned;
+  uint8_t *head = (uint8_t *)malloc(head_n + 1);
+
+  int error = bin_fd_pread(fd, head, head_n, aligned + n) ||
+              bin_fd_pwrite(fd, head, head_n, aligned);
+
+  free(head);
+
+  return error ? -2 : 0;
+}
+
+#endif // BIN_INSERT_RANGE
+
+#endif // BIN_POSIX
+
+#ifdef BIN_MMAP
+
+// The smallest number of blocks a writable mapping is grown to
+#define BIN_MAP_CAPACITY 64
+
+// bin_map_init()
+//
+// Creates the desired binary file, mapped into memory
+//
+// path - The path and file name for the desired file
+// block_size - The size of each block in bytes
+//
+// return - The newly created mapping, or NULL on failure
+
+bin_map_t *bin_map_init(char const *path, uint_t block_size) {
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (fd < 0)
+    return NULL;
+
+  bin_meta_t meta = {.length = 0, .block_size = block_size};
+
+  if (pwrite(fd, &meta, sizeof(meta), 0) != sizeof(meta)) {
+    close(fd);
+    return NULL;
+  }
+
+  return bin_map_create(fd, 1);
+}
+
+// bin_map_open()
+//
+// Opens the desired binary file, mapped into memory
+//
+// path - The path and file name for the desired file
+// write - Non-zero to open the file for writing as well as reading
+//
+// return - The newly opened mapping, or NULL on failure
+
+bin_map_t *bin_map_open(char const *path, int write) {
+  int fd = open(path, write ? O_RDWR : O_RDONLY);
+
+  if (fd < 0)
+    return NULL;
+
+  return bin_map_create(fd, write);
+}
+
+// bin_map_close()
+//
+// Unmaps and closes the desired binary file, trimming a writable file to its
+// length
+//
+// m - The mapping to be closed
+//
+// return - 0 on success, or -1 if the file could not be trimmed, in which case
+//          the unused capacity remains after the last block
+
+int bin_map_close(bin_map_t *m) {
+  uint_t n = index_bytes(m->meta->length, m->meta->block_size);
+  int error = 0;
+
+  munmap(m->meta, m->map_n);
+
+  if (m->write)
+    error = ftruncate(m->fd, n);
+
+  close(m->fd);
+  free(m);
+
+  return error ? -1 : 0;
+}
+
+// bin_map_read()
+//
+// Copy the desired blocks into the buffer
+//
+// m - The mapping
+// i - The initial index of the read
+// data - The block_t buffer to be read into
+// n - The number of elements to read into the buffer
+
+void bin_map_read(bin_map_t const *m, int_t i, void *data, uint_t n) {
+  assert(0 <= i && (i + n) <= m->meta->length);
+
+  memcpy(data, bin_map_block(m, i), n * m->meta->block_size);
+}
+
+// bin_map_write()
+//
+// Write the buffer into the mapping, extending it past its end if needed
+//
+// m - The mapping
+// i - The initial index of the write
+// data - The block_t buffer to write from
+// n - The number of elements to write from the buffer
+//
+// return - 0 on success, or -1 if the file could not be grown
+
+int bin_map_write(bin_map_t *m, int_t i, void const *data, uint_t n) {
+  uint_t l = m->meta->length;
+
+  assert(m->write && 0 <= i && i <= l);
+
+  if (bin_map_reserve(m, i + n) != 0)
+    return -1;
+
+  memcpy(bin_map_block(m, i), data, n * m->meta->block_size);
+
+  if (i + n > l)
+    m->meta->length = i + n;
+
+  return 0;
+}
+
+// bin_map_insert()
+//
+// Inserts the given data into the mapping, moving the following blocks in
+// place
+//
+// m - The mapping
+// i - The initial index of the insertion
+// data - The blocks to insert
+// n - The number of blocks to be inserted
+//
+// return - 0 on success, or -1 if the file could not be grown
+
+int bin_map_insert(bin_map_t *m, int_t i, void const *data, uint_t n) {
+  uint_t l = m->meta->length;
+  uint_t bs = m->meta->block_size;
+
+  assert(m->write && 0 <= i && i <= l);
+
+  if (bin_map_reserve(m, l + n) != 0)
+    return -1;
+
+  uint8_t *b_i = bin_map_block(m, i);
+
+  memmove(b_i + n * bs, b_i, (l - i) * bs);
+  memcpy(b_i, data, n * bs);
+
+  m->meta->length = l + n;
+
+  return 0;
+}
+
+// bin_map_append()
+//
+// Appends the given data to the end of the mapping
+//
+// m - The mapping to be appended to
+// data - The blocks to append
+// n - The number of block to be appended
+//
+// return - 0 on success, or -1 if the file could not be grown
+
+int bin_map_append(bin_map_t *m, void const *data, uint_t n) {
+  return bin_map_write(m, m->meta->length, data, n);
+}
+
+// bin_map_block()
+//
+// The address of a block within the mapping, through which it may be read or
+// written without copying. The address is invalidated by any operation which
+// grows the file.
+//
+// m - The mapping
+// i - The index of the block
+//
+// return - The address of the block
+
+void *bin_map_block(bin_map_t const *m, int_t i) {
+  return m->block + i * m->meta->block_size;
+}
+
+// bin_map_length()
+//
+// return - The length / number of entries in the mapping
+
+uint_t bin_map_length(bin_map_t const *m) { return m->meta->length; }
+
+// bin_map_block_size()
+//
+// return - The block size for the entries in the mapping
+
+uint_t bin_map_block_size(bin_map_t const *m) { return m->meta->block_size; }
+
+// bin_map_search()
+//
+// Search for a given key in the mapping, as bin_search()
+//
+// m - The mapping to be searched within
+// k - The key to search for
+//
+// return - The block_t index of the key. In the case that the key is not found,
+//          The returned value is -( index + 1 ) where index is that of the
+//          first element greater than k or bin_map_length().
+
+int_t bin_map_search(bin_map_t const *m, bin_key_t k) {
+  int_t l = 0;
+  int_t r = m->meta->length - 1;
+
+  bin_key_t key;
+
+  while (l <= r) {
+    int_t mid = (l + r) / 2;
+    memcpy(&key, bin_map_block(m, mid), sizeof(key));
+
+    if (key < k)
+      l = mid + 1;
+
+    else if (key > k)
+      r = mid - 1;
+
+    else
+      return mid;
+  }
+
+  return -(l + 1);
+}
+
+// bin_map_create()
+//
+// Map an opened binary file, holding at least its header. A file too short
+// for the length in its header, as left by a crash or a truncation, is
+// rejected, as its blocks would be read past the end of the mapping.
+//
+// fd - The file descriptor
+// write - Whether the file was opened for writing
+//
+// return - The mapping, or NULL on failure
+
+static bin_map_t *bin_map_create(int fd, int write) {
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || (uint_t)st.st_size < sizeof(bin_meta_t)) {
+    close(fd);
+    return NULL;
+  }
+
+  void *map = mmap(NULL, st.st_size, write ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED, fd, 0);
+
+  if (map == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+
+  bin_meta_t const *meta = (bin_meta_t const *)map;
+
+  if (meta->block_size == 0 ||
+      meta->length > (st.st_size - sizeof(bin_meta_t)) / meta->block_size) {
+    munmap(map, st.st_size);
+    close(fd);
+    return NULL;
+  }
+
+  bin_map_t *m = (bin_map_t *)malloc(sizeof(bin_map_t));
+
+  m->fd = fd;
+  m->write = write;
+  m->meta = (bin_meta_t *)map;
+  m->block = (uint8_t *)map + sizeof(bin_meta_t);
+  m->map_n = st.st_size;
+  m->capacity = (st.st_size - sizeof(bin_meta_t)) / m->meta->block_size;
+
+  return m;
+}
+
+// bin_map_reserve()
+//
+// Grow the file and its mapping to hold at least n blocks, at least doubling
+// the capacity each time so that appending is amortized
+//
+// m - The mapping
+// n - The number of blocks required
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_map_reserve(bin_map_t *m, uint_t n) {
+  if (n <= m->capacity)
+    return 0;
+
+  uint_t capacity = 2 * m->capacity;
+  capacity = (capacity > BIN_MAP_CAPACITY) ? capacity : BIN_MAP_CAPACITY;
+  capacity = (capacity > n) ? capacity : n;
+
+  uint_t map_n = index_bytes(capacity, m->meta->block_size);
+
+  if (ftruncate(m->fd, map_n) != 0)
+    return -1;
+
+  void *map =
+      mmap(NULL, map_n, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+
+  if (map == MAP_FAILED)
+    return -1;
+
+  munmap(m->meta, m->map_n);
+
+  m->meta = (bin_meta_t *)map;
+  m->block = (uint8_t *)map + sizeof(bin_meta_t);
+  m->capacity = capacity;
+  m->map_n = map_n;
+
+  return 0;
+}
+
+#endif // BIN_MMAP
+
 #endif
@@ -0,0 +1,466 @@
+// bin_appender.h - Buffered, group committed appends to bin.h files
+//
+// Accumulates appended blocks in a ring buffer and writes them to the end of a
+// bin_t in groups, each with a single pwritev() and a single header update,
+// so that appending a block costs a copy rather than a system call. The groups
+// may be written on a background thread, which takes whatever has accumulated
+// since the last group, and each group may be flushed to the storage device
+// with fdatasync() according to a policy.
+//
+// Requires bin.h, which is included here when it has not been already, so
+// bin_key_t must be declared first as for bin.h. Link with -lpthread.
+
+#ifndef BIN_APPENDER_H
+#define BIN_APPENDER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "./type.h"
+
+#ifndef BIN_H
+#include "./bin.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  // Never flush to the storage device, leaving it to the operating system
+  BIN_SYNC_NONE,
+
+  // Flush after every group
+  BIN_SYNC_GROUP,
+
+  // Flush at most once per interval, and at least once per interval while
+  // there are unflushed groups on the background thread
+  BIN_SYNC_INTERVAL
+} bin_sync_policy_t;
+
+typedef struct {
+  // The file appended to, which must not be used until the appender is freed
+  bin_t *bin;
+
+  // The ring of ring_n blocks. The blocks from tail to head, counted from the
+  // first append, have been accepted but not yet written.
+  uint8_t *ring;
+  uint_t ring_n;
+  uint_t block_size;
+  uint_t head;
+  uint_t tail;
+
+  // The flush policy, the interval in seconds for BIN_SYNC_INTERVAL, the time
+  // of the last flush, and whether groups have been written since
+  bin_sync_policy_t policy;
+  double interval;
+  double synced;
+  int unsynced;
+
+  // The number of groups written, and of flushes with the seconds they took
+  uint_t group_n;
+  uint_t sync_n;
+  double sync_time;
+
+  // Set once a write or flush fails, after which every call fails
+  int error;
+
+  // Whether groups are written on the background thread, and the requests to
+  // it to flush everything accepted or to stop
+  int threaded;
+  int flush;
+  int stop;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} bin_appender_t;
+
+bin_appender_t *bin_appender_init(bin_t *, uint_t, bin_sync_policy_t, double,
+                                  int);
+int bin_appender_free(bin_appender_t *);
+int bin_appender_append(bin_appender_t *, void const *, uint_t);
+int bin_appender_flush(bin_appender_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BIN_APPENDER_H
+
+////////////////////////////////////////////////////////////////////////////////
+// IMPELEMENTATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef BIN_APPENDER_IMPLEMENTATION
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+static void *bin_appender_thread(void *);
+static int bin_appender_write(bin_appender_t *, uint_t, uint_t);
+static int bin_appender_sync(bin_appender_t *);
+static int bin_appender_due(bin_appender_t const *);
+static double bin_appender_now(void);
+
+// bin_appender_init()
+//
+// Creates an appender to the end of a file opened for writing
+//
+// bin - The file to append to
+// ring_n - The number of blocks buffered, and so the largest group
+// policy - When groups are flushed to the storage device
+// interval - The seconds between flushes for BIN_SYNC_INTERVAL
+// threaded - Non-zero to write the groups on a background thread
+//
+// return - The appender, or NULL on failure
+
+bin_appender_t *bin_appender_init(bin_t *bin, uint_t ring_n,
+                                  bin_sync_policy_t policy, double interval,
+                                  int threaded) {
+  assert(bin->write && ring_n > 0);
+
+  bin_appender_t *a = (bin_appender_t *)malloc(sizeof(bin_appender_t));
+
+  if (!a)
+    return NULL;
+
+  a->bin = bin;
+  a->block_size = bin_fd_block_size(bin);
+  a->ring_n = ring_n;
+  a->ring = (uint8_t *)malloc(ring_n * a->block_size);
+  a->head = 0;
+  a->tail = 0;
+
+  a->policy = policy;
+  a->interval = interval;
+  a->synced = bin_appender_now();
+  a->unsynced = 0;
+
+  a->group_n = 0;
+  a->sync_n = 0;
+  a->sync_time = 0;
+
+  a->error = 0;
+  a->threaded = threaded;
+  a->flush = 0;
+  a->stop = 0;
+
+  if (!a->ring) {
+    free(a);
+    return NULL;
+  }
+
+  if (threaded) {
+    pthread_mutex_init(&a->mutex, NULL);
+    pthread_cond_init(&a->cond, NULL);
+
+    if (pthread_create(&a->thread, NULL, bin_appender_thread, a) != 0) {
+      pthread_mutex_destroy(&a->mutex);
+      pthread_cond_destroy(&a->cond);
+      free(a->ring);
+      free(a);
+      return NULL;
+    }
+  }
+
+  return a;
+}
+
+// bin_appender_free()
+//
+// Flushes every accepted block, stops the background thread and frees the
+// appender. The file remains open.
+//
+// a - The appender to free
+//
+// return - 0 on success, or -1 if any write or flush failed
+
+int bin_appender_free(bin_appender_t *a) {
+  int error = bin_appender_flush(a);
+
+  if (a->threaded) {
+    pthread_mutex_lock(&a->mutex);
+    a->stop = 1;
+    pthread_cond_broadcast(&a->cond);
+    pthread_mutex_unlock(&a->mutex);
+
+    pthread_join(a->thread, NULL);
+
+    pthread_mutex_destroy(&a->mutex);
+    pthread_cond_destroy(&a->cond);
+  }
+
+  free(a->ring);
+  free(a);
+
+  return error;
+}
+
+// bin_appender_append()
+//
+// Accepts blocks to append to the file, copying them into the ring. When the
+// ring is full, the oldest group is written first, or on the background thread
+// the call waits for it to be written.
+//
+// a - The appender
+// data - The blocks to append
+// n - The number of blocks to append
+//
+// return - 0 on success, or -1 if any write or flush has failed
+
+int bin_appender_append(bin_appender_t *a, void const *data, uint_t n) {
+  uint8_t const *src = (uint8_t const *)data;
+  uint_t bs = a->block_size;
+
+  if (a->threaded)
+    pthread_mutex_lock(&a->mutex);
+
+  while (n > 0 && !a->error) {
+    uint_t space = a->ring_n - (a->head - a->tail);
+
+    if (space == 0) {
+      if (a->threaded) {
+        pthread_cond_wait(&a->cond, &a->mutex);
+      } else if (bin_appender_write(a, a->tail, a->head) == 0) {
+        a->tail = a->head;
+      } else {
+        a->error = 1;
+      }
+
+      continue;
+    }
+
+    // The free space may wrap around the end of the ring
+    uint_t i = a->head % a->ring_n;
+    uint_t k = (n < space) ? n : space;
+    k = (k < a->ring_n - i) ? k : a->ring_n - i;
+
+    memcpy(a->ring + i * bs, src, k * bs);
+
+    // The background thread only waits while the ring is empty
+    int wake = a->threaded && a->head == a->tail;
+
+    a->head += k;
+    src += k * bs;
+    n -= k;
+
+    if (wake)
+      pthread_cond_broadcast(&a->cond);
+  }
+
+  int error = a->error;
+
+  if (a->threaded)
+    pthread_mutex_unlock(&a->mutex);
+
+  return error ? -1 : 0;
+}
+
+// bin_appender_flush()
+//
+// Writes every accepted block and the header, then flushes the file to the
+// storage device unless the policy is BIN_SYNC_NONE
+//
+// a - The appender
+//
+// return - 0 on success, or -1 if any write or flush has failed
+
+int bin_appender_flush(bin_appender_t *a) {
+  if (a->threaded) {
+    pthread_mutex_lock(&a->mutex);
+    a->flush = 1;
+    pthread_cond_broadcast(&a->cond);
+
+    while (a->flush && !a->error)
+      pthread_cond_wait(&a->cond, &a->mutex);
+
+    int error = a->error;
+    pthread_mutex_unlock(&a->mutex);
+
+    return error ? -1 : 0;
+  }
+
+  if (!a->error && a->head > a->tail) {
+    if (bin_appender_write(a, a->tail, a->head) == 0)
+      a->tail = a->head;
+    else
+      a->error = 1;
+  }
+
+  if (!a->error && a->policy != BIN_SYNC_NONE && a->unsynced &&
+      bin_appender_sync(a) != 0)
+    a->error = 1;
+
+  return a->error ? -1 : 0;
+}
+
+// bin_appender_thread()
+//
+// Writes the accepted blocks as they arrive, each time as a single group of
+// everything accepted since the last, and flushes the file when due
+
+static void *bin_appender_thread(void *arg) {
+  bin_appender_t *a = (bin_appender_t *)arg;
+
+  pthread_mutex_lock(&a->mutex);
+
+  for (;;) {
+    while (!a->stop && !a->error && a->head == a->tail && !a->flush &&
+           !bin_appender_due(a)) {
+      if (a->policy == BIN_SYNC_INTERVAL && a->unsynced) {
+        double at = a->synced + a->interval;
+        struct timespec t = {.tv_sec = (time_t)at,
+                             .tv_nsec = (long)((at - (time_t)at) * 1e9)};
+
+        pthread_cond_timedwait(&a->cond, &a->mutex, &t);
+      } else {
+        pthread_cond_wait(&a->cond, &a->mutex);
+      }
+    }
+
+    if (a->error || (a->stop && a->head == a->tail))
+      break;
+
+    uint_t tail = a->tail;
+    uint_t head = a->head;
+    int flush = a->flush;
+
+    pthread_mutex_unlock(&a->mutex);
+
+    int error = 0;
+
+    if (head > tail)
+      error = bin_appender_write(a, tail, head);
+
+    if (!error && flush && a->policy != BIN_SYNC_NONE && a->unsynced)
+      error = bin_appender_sync(a);
+
+    else if (!error && bin_appender_due(a))
+      error = bin_appender_sync(a);
+
+    pthread_mutex_lock(&a->mutex);
+
+    a->tail = head;
+    a->error |= error;
+
+    if (flush && a->tail == a->head)
+      a->flush = 0;
+
+    pthread_cond_broadcast(&a->cond);
+  }
+
+  pthread_cond_broadcast(&a->cond);
+  pthread_mutex_unlock(&a->mutex);
+
+  return NULL;
+}
+
+// bin_appender_write()
+//
+// Write the blocks of the ring from tail to head to the end of the file with
+// a single pwritev(), continuing after a partial write as bin_fd_pwrite()
+// does, then update the header, and flush the file when the policy requires it
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_appender_write(bin_appender_t *a, uint_t tail, uint_t head) {
+  bin_t *bin = a->bin;
+  uint_t bs = a->block_size;
+
+  uint_t n = head - tail;
+  uint_t i = tail % a->ring_n;
+  uint_t first = (n < a->ring_n - i) ? n : a->ring_n - i;
+
+  struct iovec iov[2] = {{a->ring + i * bs, first * bs},
+                         {a->ring, (n - first) * bs}};
+
+  struct iovec *v = iov;
+  int v_n = (first < n) ? 2 : 1;
+  uint_t offset = sizeof(bin_meta_t) + bin->meta.length * bs;
+
+  while (v_n > 0) {
+    ssize_t w = pwritev(bin->fd, v, v_n, offset);
+
+    if (w <= 0)
+      return -1;
+
+    offset += w;
+
+    // Skip the vectors written in full, and the written part of the next
+    while (v_n > 0 && (size_t)w >= v->iov_len) {
+      w -= v->iov_len;
+      v++;
+      v_n--;
+    }
+
+    if (v_n > 0) {
+      v->iov_base = (uint8_t *)v->iov_base + w;
+      v->iov_len -= w;
+    }
+  }
+
+  bin->meta.length += n;
+  bin->dirty = 1;
+
+  if (bin_sync(bin) != 0)
+    return -1;
+
+  a->group_n++;
+  a->unsynced = 1;
+
+  if (a->policy == BIN_SYNC_GROUP ||
+      (a->policy == BIN_SYNC_INTERVAL && bin_appender_due(a)))
+    return bin_appender_sync(a);
+
+  return 0;
+}
+
+// bin_appender_sync()
+//
+// Flush the file, its data and its header, to the storage device
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_appender_sync(bin_appender_t *a) {
+  double t0 = bin_appender_now();
+
+#ifdef __APPLE__
+  int error = fsync(a->bin->fd);
+#else
+  int error = fdatasync(a->bin->fd);
+#endif
+
+  a->synced = bin_appender_now();
+  a->sync_time += a->synced - t0;
+  a->sync_n++;
+  a->unsynced = 0;
+
+  return error ? -1 : 0;
+}
+
+// bin_appender_due()
+//
+// return - Whether the interval has passed since the last flush, with groups
+//          written since
+
+static int bin_appender_due(bin_appender_t const *a) {
+  return a->policy == BIN_SYNC_INTERVAL && a->unsynced &&
+         bin_appender_now() >= a->synced + a->interval;
+}
+
+// bin_appender_now()
+//
+// return - The current time in seconds, on the clock of the condition variable
+
+static double bin_appender_now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_REALTIME, &t);
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+#endif // BIN_APPENDER_IMPLEMENTATION
@@ -0,0 +1,697 @@
+// bin_async.h - Asynchronous reads and appends across many bin.h files
+//
+// Queues reads and appends of blocks against any number of bin_t files, and
+// returns their completions in batches, so that a single thread may keep many
+// operations in flight rather than waiting on each in turn. On Linux the
+// operations are submitted to the kernel through io_uring, queued without a
+// system call and submitted together when completions are next reaped.
+// Elsewhere, or where io_uring is unavailable, a pool of threads performs
+// them instead.
+//
+// Requires bin.h, which is included here when it has not been already, so
+// bin_key_t must be declared first as for bin.h. Link with -lpthread.
+
+#ifndef BIN_ASYNC_H
+#define BIN_ASYNC_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "./type.h"
+
+#ifndef BIN_H
+#include "./bin.h"
+#endif
+
+#if defined(__linux__)
+#define BIN_ASYNC_URING
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bin_async_result_t
+//
+// The completion of an operation
+
+typedef struct {
+  // The argument given when the operation was queued
+  void *user;
+
+  // 0 on success, or -1 on failure
+  int error;
+} bin_async_result_t;
+
+// bin_async_slot_t
+//
+// An operation in flight
+
+typedef struct {
+  int fd;
+  int write;
+  uint8_t *data;
+  uint_t size;
+  uint_t offset;
+
+  void *user;
+  int error;
+} bin_async_slot_t;
+
+typedef struct {
+  // The operations in flight, at most depth, and those slots unused
+  bin_async_slot_t *slot;
+  uint_t depth;
+  uint_t *free_slot;
+  uint_t free_n;
+
+  // Whether io_uring is used, rather than the pool of threads
+  int uring;
+
+  // The io_uring instance and its mapped rings, with the number of queued
+  // operations not yet submitted to the kernel
+  int ring_fd;
+  void *sq_map;
+  void *cq_map;
+  void *sqe_map;
+  uint_t sq_map_n;
+  uint_t cq_map_n;
+  uint_t sqe_map_n;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  void *cqe;
+  uint_t pending_n;
+
+  // The pool of threads, with rings of the slots queued and completed
+  pthread_t *thread;
+  uint_t thread_n;
+  uint_t *queue;
+  uint_t queue_head;
+  uint_t queue_tail;
+  uint_t *done;
+  uint_t done_head;
+  uint_t done_tail;
+  int stop;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t work;
+  pthread_cond_t complete;
+} bin_async_t;
+
+bin_async_t *bin_async_init(uint_t, uint_t, int);
+void bin_async_free(bin_async_t *);
+int bin_async_read(bin_async_t *, bin_t *, int_t, void *, uint_t, void *);
+int bin_async_append(bin_async_t *, bin_t *, void const *, uint_t, void *);
+int bin_async_submit(bin_async_t *);
+uint_t bin_async_reap(bin_async_t *, bin_async_result_t *, uint_t, uint_t);
+uint_t bin_async_flight(bin_async_t const *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BIN_ASYNC_H
+
+////////////////////////////////////////////////////////////////////////////////
+// IMPELEMENTATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef BIN_ASYNC_IMPLEMENTATION
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef BIN_ASYNC_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+static int bin_async_queue(bin_async_t *, bin_t *, int, void *, uint_t,
+                           uint_t, void *);
+static void *bin_async_thread(void *);
+static int bin_async_perform(bin_async_slot_t *);
+
+#ifdef BIN_ASYNC_URING
+static int bin_async_uring_init(bin_async_t *);
+static void bin_async_uring_free(bin_async_t *);
+static int bin_async_uring_probe(int);
+static int bin_async_uring_enter(bin_async_t *, uint_t);
+static void bin_async_uring_prepare(bin_async_t *, uint_t);
+#endif
+
+// bin_async_init()
+//
+// Creates a queue of asynchronous operations
+//
+// depth - The largest number of operations in flight at once
+// thread_n - The number of threads performing the operations where io_uring
+//            is not used
+// uring - Non-zero to use io_uring where it is available
+//
+// return - The queue, or NULL on failure
+
+bin_async_t *bin_async_init(uint_t depth, uint_t thread_n, int uring) {
+  assert(depth > 0 && thread_n > 0);
+
+  bin_async_t *a = (bin_async_t *)calloc(1, sizeof(bin_async_t));
+
+  if (!a)
+    return NULL;
+
+  a->depth = depth;
+  a->slot = (bin_async_slot_t *)malloc(sizeof(bin_async_slot_t) * depth);
+  a->free_slot = (uint_t *)malloc(sizeof(uint_t) * depth);
+  a->ring_fd = -1;
+
+  pthread_mutex_init(&a->mutex, NULL);
+  pthread_cond_init(&a->work, NULL);
+  pthread_cond_init(&a->complete, NULL);
+
+  if (!a->slot || !a->free_slot) {
+    bin_async_free(a);
+    return NULL;
+  }
+
+  for (uint_t i = 0; i < depth; i++) {
+    a->free_slot[a->free_n++] = depth - 1 - i;
+  }
+
+#ifdef BIN_ASYNC_URING
+  if (uring && bin_async_uring_init(a) == 0) {
+    a->uring = 1;
+    return a;
+  }
+#endif
+
+  a->queue = (uint_t *)malloc(sizeof(uint_t) * depth);
+  a->done = (uint_t *)malloc(sizeof(uint_t) * depth);
+  a->thread = (pthread_t *)malloc(sizeof(pthread_t) * thread_n);
+
+  if (!a->queue || !a->done || !a->thread) {
+    bin_async_free(a);
+    return NULL;
+  }
+
+  for (; a->thread_n < thread_n; a->thread_n++) {
+    if (pthread_create(a->thread + a->thread_n, NULL, bin_async_thread, a) !=
+        0) {
+      bin_async_free(a);
+      return NULL;
+    }
+  }
+
+  return a;
+}
+
+// bin_async_free()
+//
+// Waits for any operations in flight, discarding their completions, then
+// frees the queue. Should io_uring fail, the operations still in flight are
+// abandoned rather than waited on forever.
+//
+// a - The queue to be freed
+
+void bin_async_free(bin_async_t *a) {
+  bin_async_result_t result[16];
+
+  while ((a->uring || a->thread_n > 0) && bin_async_flight(a) > 0) {
+    if (bin_async_reap(a, result, 16, 1) == 0)
+      break;
+  }
+
+#ifdef BIN_ASYNC_URING
+  if (a->uring)
+    bin_async_uring_free(a);
+#endif
+
+  if (a->thread_n > 0) {
+    pthread_mutex_lock(&a->mutex);
+    a->stop = 1;
+    pthread_cond_broadcast(&a->work);
+    pthread_mutex_unlock(&a->mutex);
+
+    for (uint_t t = 0; t < a->thread_n; t++) {
+      pthread_join(a->thread[t], NULL);
+    }
+  }
+
+  pthread_mutex_destroy(&a->mutex);
+  pthread_cond_destroy(&a->work);
+  pthread_cond_destroy(&a->complete);
+
+  free(a->slot);
+  free(a->free_slot);
+  free(a->queue);
+  free(a->done);
+  free(a->thread);
+  free(a);
+}
+
+// bin_async_read()
+//
+// Queues a read of blocks into a buffer, which must remain valid until the
+// read completes
+//
+// a - The queue
+// b - The file
+// i - The initial index of the read
+// data - The block_t buffer to be read into
+// n - The number of elements to read into the buffer
+// user - An argument returned with the completion
+//
+// return - 0 on success, or -1 if depth operations are already in flight
+
+int bin_async_read(bin_async_t *a, bin_t *b, int_t i, void *data, uint_t n,
+                   void *user) {
+  uint_t bs = bin_fd_block_size(b);
+
+  assert(0 <= i && i + n <= bin_fd_length(b));
+
+  return bin_async_queue(a, b, 0, data, n * bs,
+                         sizeof(bin_meta_t) + (uint_t)i * bs, user);
+}
+
+// bin_async_append()
+//
+// Queues an append of blocks to the end of a file opened for writing, from a
+// buffer which must remain valid until the append completes. The cached
+// length of the file grows at once, so that further appends follow, but the
+// blocks are only in place once the append completes, after which bin_sync()
+// writes the header.
+//
+// a - The queue
+// b - The file
+// data - The blocks to append
+// n - The number of blocks to append
+// user - An argument returned with the completion
+//
+// return - 0 on success, or -1 if depth operations are already in flight
+
+int bin_async_append(bin_async_t *a, bin_t *b, void const *data, uint_t n,
+                     void *user) {
+  uint_t bs = bin_fd_block_size(b);
+  uint_t l = bin_fd_length(b);
+
+  assert(b->write);
+
+  if (bin_async_queue(a, b, 1, (void *)data, n * bs,
+                      sizeof(bin_meta_t) + l * bs, user) != 0)
+    return -1;
+
+  b->meta.length = l + n;
+  b->dirty = 1;
+
+  return 0;
+}
+
+// bin_async_submit()
+//
+// Submits the queued operations to the kernel without waiting for any to
+// complete. The pool of threads starts on each operation as it is queued.
+//
+// a - The queue
+//
+// return - 0 on success, or -1 on failure
+
+int bin_async_submit(bin_async_t *a) {
+#ifdef BIN_ASYNC_URING
+  if (a->uring)
+    return bin_async_uring_enter(a, 0);
+#endif
+
+  return 0;
+}
+
+// bin_async_reap()
+//
+// Submits the queued operations, then returns the completions of those
+// finished, waiting until at least min have. An operation which io_uring
+// completes in part is submitted again for the remainder, as the pool of
+// threads continues after short transfers, and only completes once whole.
+//
+// a - The queue
+// result - The completions
+// n - The largest number of completions to return
+// min - The number of completions to wait for, at most those in flight
+//
+// return - The number of completions returned, which is fewer than min only
+//          if io_uring fails
+
+uint_t bin_async_reap(bin_async_t *a, bin_async_result_t *result, uint_t n,
+                      uint_t min) {
+  uint_t k = 0;
+
+  min = (min < n) ? min : n;
+
+  assert(min <= bin_async_flight(a));
+
+#ifdef BIN_ASYNC_URING
+  if (a->uring) {
+    struct io_uring_cqe *cqe = (struct io_uring_cqe *)a->cqe;
+
+    for (;;) {
+      unsigned head = *a->cq_head;
+      unsigned tail = __atomic_load_n(a->cq_tail, __ATOMIC_ACQUIRE);
+
+      for (; head != tail && k < n; head++) {
+        struct io_uring_cqe *c = cqe + (head & *a->cq_mask);
+        bin_async_slot_t *s = a->slot + c->user_data;
+
+        if (c->res > 0 && (uint_t)c->res < s->size) {
+          s->data += c->res;
+          s->size -= c->res;
+          s->offset += c->res;
+
+          bin_async_uring_prepare(a, c->user_data);
+          continue;
+        }
+
+        result[k].user = s->user;
+        result[k].error = (c->res < 0 || (uint_t)c->res != s->size);
+        k++;
+
+        a->free_slot[a->free_n++] = c->user_data;
+      }
+
+      __atomic_store_n(a->cq_head, head, __ATOMIC_RELEASE);
+
+      if (k >= min && a->pending_n == 0)
+        return k;
+
+      if (bin_async_uring_enter(a, (k < min) ? min - k : 0) != 0)
+        return k;
+    }
+  }
+#endif
+
+  pthread_mutex_lock(&a->mutex);
+
+  for (;;) {
+    for (; a->done_head != a->done_tail && k < n; a->done_head++, k++) {
+      uint_t i = a->done[a->done_head % a->depth];
+
+      result[k].user = a->slot[i].user;
+      result[k].error = a->slot[i].error;
+
+      a->free_slot[a->free_n++] = i;
+    }
+
+    if (k >= min)
+      break;
+
+    pthread_cond_wait(&a->complete, &a->mutex);
+  }
+
+  pthread_mutex_unlock(&a->mutex);
+
+  return k;
+}
+
+// bin_async_flight()
+//
+// return - The number of operations queued and not yet reaped
+
+uint_t bin_async_flight(bin_async_t const *a) { return a->depth - a->free_n; }
+
+// bin_async_queue()
+//
+// Queue an operation in a free slot
+//
+// return - 0 on success, or -1 if no slot is free
+
+static int bin_async_queue(bin_async_t *a, bin_t *b, int write, void *data,
+                           uint_t size, uint_t offset, void *user) {
+  if (a->uring) {
+    if (a->free_n == 0)
+      return -1;
+  } else {
+    pthread_mutex_lock(&a->mutex);
+
+    if (a->free_n == 0) {
+      pthread_mutex_unlock(&a->mutex);
+      return -1;
+    }
+  }
+
+  uint_t i = a->free_slot[--a->free_n];
+
+  a->slot[i] = (bin_async_slot_t){.fd = b->fd,
+                                  .write = write,
+                                  .data = (uint8_t *)data,
+                                  .size = size,
+                                  .offset = offset,
+                                  .user = user,
+                                  .error = 0};
+
+#ifdef BIN_ASYNC_URING
+  if (a->uring) {
+    bin_async_uring_prepare(a, i);
+    return 0;
+  }
+#endif
+
+  a->queue[a->queue_tail++ % a->depth] = i;
+
+  pthread_cond_signal(&a->work);
+  pthread_mutex_unlock(&a->mutex);
+
+  return 0;
+}
+
+// bin_async_thread()
+//
+// Perform the queued operations in turn, placing each in the completed ring
+
+static void *bin_async_thread(void *arg) {
+  bin_async_t *a = (bin_async_t *)arg;
+
+  pthread_mutex_lock(&a->mutex);
+
+  for (;;) {
+    while (!a->stop && a->queue_head == a->queue_tail)
+      pthread_cond_wait(&a->work, &a->mutex);
+
+    if (a->queue_head == a->queue_tail)
+      break;
+
+    uint_t i = a->queue[a->queue_head++ % a->depth];
+    bin_async_slot_t s = a->slot[i];
+
+    pthread_mutex_unlock(&a->mutex);
+
+    int error = bin_async_perform(&s);
+
+    pthread_mutex_lock(&a->mutex);
+
+    a->slot[i].error = error;
+    a->done[a->done_tail++ % a->depth] = i;
+
+    pthread_cond_signal(&a->complete);
+  }
+
+  pthread_mutex_unlock(&a->mutex);
+
+  return NULL;
+}
+
+// bin_async_perform()
+//
+// Read or write the whole of a slot's buffer, continuing after short
+// transfers
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_async_perform(bin_async_slot_t *s) {
+  uint8_t *p = s->data;
+  uint_t n = s->size;
+  uint_t offset = s->offset;
+
+  while (n > 0) {
+    ssize_t r = s->write ? pwrite(s->fd, p, n, offset)
+                         : pread(s->fd, p, n, offset);
+
+    if (r <= 0)
+      return -1;
+
+    p += r;
+    n -= r;
+    offset += r;
+  }
+
+  return 0;
+}
+
+#ifdef BIN_ASYNC_URING
+
+// bin_async_uring_init()
+//
+// Set up an io_uring instance with a submission ring of depth entries, and
+// map its rings
+//
+// return - 0 on success, or -1 if io_uring or its read and write operations
+//          are unavailable
+
+static int bin_async_uring_init(bin_async_t *a) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+
+  int fd = syscall(SYS_io_uring_setup, a->depth, &p);
+
+  if (fd < 0)
+    return -1;
+
+  if (bin_async_uring_probe(fd) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  a->ring_fd = fd;
+  a->sq_map_n = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  a->cq_map_n = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  a->sqe_map_n = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  // Both rings may share a single mapping
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    a->sq_map_n = (a->sq_map_n > a->cq_map_n) ? a->sq_map_n : a->cq_map_n;
+    a->cq_map_n = 0;
+  }
+
+  a->sq_map = mmap(NULL, a->sq_map_n, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  a->cq_map = a->cq_map_n ? mmap(NULL, a->cq_map_n, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, fd,
+                                 IORING_OFF_CQ_RING)
+                          : a->sq_map;
+  a->sqe_map = mmap(NULL, a->sqe_map_n, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+  if (a->sq_map == MAP_FAILED || a->cq_map == MAP_FAILED ||
+      a->sqe_map == MAP_FAILED) {
+    bin_async_uring_free(a);
+    return -1;
+  }
+
+  uint8_t *sq = (uint8_t *)a->sq_map;
+  uint8_t *cq = (uint8_t *)a->cq_map;
+
+  a->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+  a->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+  a->sq_array = (unsigned *)(sq + p.sq_off.array);
+  a->cq_head = (unsigned *)(cq + p.cq_off.head);
+  a->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+  a->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+  a->cqe = cq + p.cq_off.cqes;
+
+  return 0;
+}
+
+// bin_async_uring_free()
+//
+// Unmap the rings and close the io_uring instance
+
+static void bin_async_uring_free(bin_async_t *a) {
+  if (a->sqe_map && a->sqe_map != MAP_FAILED)
+    munmap(a->sqe_map, a->sqe_map_n);
+
+  if (a->cq_map_n && a->cq_map && a->cq_map != MAP_FAILED)
+    munmap(a->cq_map, a->cq_map_n);
+
+  if (a->sq_map && a->sq_map != MAP_FAILED)
+    munmap(a->sq_map, a->sq_map_n);
+
+  close(a->ring_fd);
+}
+
+// bin_async_uring_probe()
+//
+// Check that the kernel supports IORING_OP_READ and IORING_OP_WRITE, added in
+// Linux 5.6 alongside the probe itself, so that earlier kernels, on which
+// io_uring_setup() succeeds but every operation would fail, use the pool of
+// threads instead
+//
+// return - 0 if both operations are supported, or -1 otherwise
+
+static int bin_async_uring_probe(int fd) {
+  uint_t op_n = 256;
+  struct io_uring_probe *probe = (struct io_uring_probe *)calloc(
+      1, sizeof(struct io_uring_probe) +
+             op_n * sizeof(struct io_uring_probe_op));
+
+  if (!probe)
+    return -1;
+
+  int error = syscall(SYS_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+                      op_n) < 0;
+
+  int ops[] = {IORING_OP_READ, IORING_OP_WRITE};
+
+  for (uint_t i = 0; i < 2 && !error; i++) {
+    error = ops[i] > probe->last_op ||
+            !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+  }
+
+  free(probe);
+
+  return error ? -1 : 0;
+}
+
+// bin_async_uring_enter()
+//
+// Submit the queued operations to the kernel, waiting for min completions
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_async_uring_enter(bin_async_t *a, uint_t min) {
+  long r;
+
+  do {
+    r = syscall(SYS_io_uring_enter, a->ring_fd, a->pending_n, min,
+                min ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  } while (r < 0 && errno == EINTR);
+
+  if (r < 0)
+    return -1;
+
+  a->pending_n -= r;
+
+  return 0;
+}
+
+// bin_async_uring_prepare()
+//
+// Queue the operation of a slot on the submission ring, to be submitted by
+// the next bin_async_uring_enter(). The ring holds depth entries, and each
+// slot has at most one entry queued, so an entry is always free.
+//
+// i - The index of the slot
+
+static void bin_async_uring_prepare(bin_async_t *a, uint_t i) {
+  bin_async_slot_t const *s = a->slot + i;
+
+  unsigned tail = *a->sq_tail;
+  unsigned index = tail & *a->sq_mask;
+  struct io_uring_sqe *sqe = (struct io_uring_sqe *)a->sqe_map + index;
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = s->write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = s->fd;
+  sqe->addr = (uint64_t)(uintptr_t)s->data;
+  sqe->len = s->size;
+  sqe->off = s->offset;
+  sqe->user_data = i;
+
+  a->sq_array[index] = index;
+  __atomic_store_n(a->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  a->pending_n++;
+}
+
+#endif // BIN_ASYNC_URING
+
+#endif // BIN_ASYNC_IMPLEMENTATION
@@ -0,0 +1,795 @@
+// bin_part.h - Time partitioned stores of bin.h files
+//
+// Spreads the blocks of a single key ordered series over many bin.h files,
+// each holding the keys of a fixed width range, such as an hour, laid out in
+// a directory for each wider range, such as a day:
+//
+//   root/<first key of the directory>/<first key of the partition>.bin
+//
+// A manifest of the partitions and the smallest and largest key each holds is
+// built from the directory tree when the store is opened, so that searches
+// and range scans only open the partitions that may hold the keys sought.
+// The blocks of the store are numbered in key order across every partition,
+// as if they were held in a single file. Old data is dropped a directory at
+// a time.
+//
+// The key must be an integer type. Requires bin.h and flat.h, which are
+// included here when they have not been already, so bin_key_t must be
+// declared first as for bin.h.
+
+#ifndef BIN_PART_H
+#define BIN_PART_H
+
+#include <stdint.h>
+#include "./type.h"
+
+#ifndef BIN_H
+#include "./bin.h"
+#endif
+
+#ifndef FLAT_H
+#include "./flat.h"
+#endif
+
+// The largest number of partitions held open at once, beyond which the least
+// recently used is closed
+#ifndef BIN_PART_OPEN_MAX
+#define BIN_PART_OPEN_MAX 64
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bin_part_file_t
+//
+// An entry of the manifest, a single partition
+
+typedef struct {
+  // The first key of the range of the partition
+  bin_key_t start;
+
+  // The smallest and largest keys held, when the partition is not empty
+  bin_key_t first;
+  bin_key_t last;
+
+  // The number of blocks held, and the number held by the partitions before
+  uint_t length;
+  uint_t offset;
+
+  // The partition while open, or NULL, and when it was last used
+  bin_t *bin;
+  uint_t used;
+} bin_part_file_t;
+
+typedef struct {
+  // The root of the directory tree
+  char *root;
+
+  // Whether the store was opened for writing
+  int write;
+
+  // The block size of every partition
+  uint_t block_size;
+
+  // The width of the key range of each partition and of each directory, a
+  // multiple of it
+  bin_key_t width;
+  bin_key_t dir_width;
+
+  // The manifest, ordered by key
+  bin_part_file_t *part;
+  uint_t part_n;
+  uint_t capacity;
+
+  // Whether the offsets of the manifest are up to date
+  int offset_valid;
+
+  // The number of partitions open, and a counter for when each was used
+  uint_t open_n;
+  uint_t clock;
+} bin_part_t;
+
+// bin_part_range_t
+//
+// An iterator over the blocks of a store with keys in a range, partition by
+// partition
+
+typedef struct {
+  // The store, which must not be changed while iterating
+  bin_part_t *store;
+
+  // The range of keys, from k_0 up to but excluding k_1
+  bin_key_t k_0;
+  bin_key_t k_1;
+
+  // The next partition of the manifest to be iterated over, and the iterator
+  // over the current one, or NULL
+  uint_t next;
+  bin_range_t *range;
+} bin_part_range_t;
+
+bin_part_t *bin_part_open(char const *, uint_t, bin_key_t, bin_key_t, int);
+int bin_part_close(bin_part_t *);
+int bin_part_append(bin_part_t *, void const *, uint_t);
+int bin_part_read(bin_part_t *, int_t, void *, uint_t);
+int bin_part_sync(bin_part_t *);
+int bin_part_drop(bin_part_t *, bin_key_t);
+
+uint_t bin_part_length(bin_part_t *);
+int_t bin_part_search(bin_part_t *, bin_key_t);
+
+bin_part_range_t *bin_part_range(bin_part_t *, bin_key_t, bin_key_t);
+uint_t bin_part_range_next(bin_part_range_t *, void const **);
+void bin_part_range_free(bin_part_range_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BIN_PART_H
+
+////////////////////////////////////////////////////////////////////////////////
+// IMPELEMENTATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef BIN_PART_IMPLEMENTATION
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bin_key_t bin_part_floor(bin_key_t, bin_key_t);
+static char *bin_part_dir_path(bin_part_t const *, bin_key_t);
+static char *bin_part_file_path(bin_part_t const *, bin_key_t);
+static int bin_part_parse(char const *, char const *, bin_key_t *);
+static int bin_part_load(bin_part_t *, bin_key_t);
+static bin_part_file_t *bin_part_insert(bin_part_t *, uint_t, bin_key_t);
+static uint_t bin_part_find(bin_part_t const *, bin_key_t);
+static bin_t *bin_part_bin(bin_part_t *, bin_part_file_t *);
+static void bin_part_offsets(bin_part_t *);
+static int bin_part_release(bin_part_t *, bin_part_file_t *);
+
+// bin_part_open()
+//
+// Opens a store, building its manifest from the directory tree. The tree is
+// created when opened for writing if it does not exist.
+//
+// root - The root directory of the store
+// block_size - The size of each block in bytes
+// width - The width of the key range of each partition
+// dir_width - The width of the key range of each directory, a multiple of
+//             width
+// write - Non-zero to open the store for writing as well as reading
+//
+// return - The opened store, or NULL on failure or if any partition has a
+//          different block size
+
+bin_part_t *bin_part_open(char const *root, uint_t block_size,
+                          bin_key_t width, bin_key_t dir_width, int write) {
+  assert(width > 0 && dir_width >= width && dir_width % width == 0);
+
+  if (write && MKDIR(root) != 0 && errno != EEXIST)
+    return NULL;
+
+  bin_part_t *p = (bin_part_t *)calloc(1, sizeof(bin_part_t));
+
+  if (!p)
+    return NULL;
+
+  p->root = strdup(root);
+  p->write = write;
+  p->block_size = block_size;
+  p->width = width;
+  p->dir_width = dir_width;
+  p->offset_valid = 1;
+
+  char **dirs = flat_directory_entries(root);
+  int error = !p->root || !dirs;
+
+  for (uint_t d = 0; dirs && dirs[d]; d++) {
+    bin_key_t dir;
+
+    if (!error && bin_part_parse(dirs[d], "", &dir) == 0 &&
+        bin_part_floor(dir, dir_width) == dir)
+      error = bin_part_load(p, dir);
+
+    free(dirs[d]);
+  }
+
+  free(dirs);
+
+  if (error) {
+    bin_part_close(p);
+    return NULL;
+  }
+
+  return p;
+}
+
+// bin_part_close()
+//
+// Closes every open partition and frees the store
+//
+// p - The store to be closed
+//
+// return - 0 on success, or -1 if any partition could not be closed
+
+int bin_part_close(bin_part_t *p) {
+  int error = 0;
+
+  for (uint_t j = 0; j < p->part_n; j++) {
+    error |= bin_part_release(p, p->part + j);
+  }
+
+  free(p->part);
+  free(p->root);
+  free(p);
+
+  return error ? -1 : 0;
+}
+
+// bin_part_append()
+//
+// Adds blocks, sorted by key, to the partitions of their keys, which are
+// created as needed. Each run of blocks is appended to its partition when it
+// follows the keys already held, and otherwise merged among them.
+//
+// p - The store
+// data - The blocks to add, sorted by key
+// n - The number of blocks to add
+//
+// return - 0 on success, or -1 on failure
+
+int bin_part_append(bin_part_t *p, void const *data, uint_t n) {
+  uint8_t const *src = (uint8_t const *)data;
+  uint_t bs = p->block_size;
+
+  assert(p->write);
+
+  for (uint_t i = 0; i < n;) {
+    bin_key_t k;
+    memcpy(&k, src + i * bs, sizeof(bin_key_t));
+
+    // The run of blocks with keys in the same partition
+    bin_key_t start = bin_part_floor(k, p->width);
+    bin_key_t last = k, next;
+    uint_t run = 1;
+
+    for (; i + run < n; run++) {
+      memcpy(&next, src + (i + run) * bs, sizeof(bin_key_t));
+
+      if (next >= start + p->width)
+        break;
+
+      last = next;
+    }
+
+    uint_t j = bin_part_find(p, start);
+    bin_part_file_t *f = (j < p->part_n && p->part[j].start == start)
+                             ? p->part + j
+                             : bin_part_insert(p, j, start);
+    bin_t *b = f ? bin_part_bin(p, f) : NULL;
+
+    if (!b)
+      return -1;
+
+    int error = (f->length == 0 || k >= f->last)
+                    ? bin_fd_append(b, src + i * bs, run)
+                    : bin_fd_merge(b, src + i * bs, run);
+
+    if (error)
+      return -1;
+
+    f->first = (f->length == 0 || k < f->first) ? k : f->first;
+    f->last = (f->length == 0 || last > f->last) ? last : f->last;
+    f->length += run;
+    p->offset_valid = 0;
+
+    i += run;
+  }
+
+  return 0;
+}
+
+// bin_part_read()
+//
+// Read the desired blocks into the buffer, numbered in key order across every
+// partition
+//
+// p - The store
+// i - The initial index of the read
+// data - The block_t buffer to be read into
+// n - The number of elements to read into the buffer
+//
+// return - 0 on success, or -1 on failure
+
+int bin_part_read(bin_part_t *p, int_t i, void *data, uint_t n) {
+  uint8_t *dest = (uint8_t *)data;
+
+  bin_part_offsets(p);
+
+  assert(0 <= i && i + n <= bin_part_length(p));
+
+  // The last partition starting at or before i
+  uint_t l = 0, r = p->part_n;
+
+  while (r - l > 1) {
+    uint_t m = l + (r - l) / 2;
+
+    if (p->part[m].offset <= (uint_t)i)
+      l = m;
+    else
+      r = m;
+  }
+
+  for (uint_t j = l; n > 0; j++) {
+    bin_part_file_t *f = p->part + j;
+    uint_t from = i - f->offset;
+
+    if (from >= f->length)
+      continue;
+
+    uint_t k = (n < f->length - from) ? n : f->length - from;
+    bin_t *b = bin_part_bin(p, f);
+
+    if (!b || bin_fd_read(b, from, dest, k) != 0)
+      return -1;
+
+    dest += k * p->block_size;
+    i += k;
+    n -= k;
+  }
+
+  return 0;
+}
+
+// bin_part_sync()
+//
+// Writes back the header of every open partition
+//
+// p - The store
+//
+// return - 0 on success, or -1 on failure
+
+int bin_part_sync(bin_part_t *p) {
+  int error = 0;
+
+  for (uint_t j = 0; j < p->part_n; j++) {
+    if (p->part[j].bin)
+      error |= bin_sync(p->part[j].bin);
+  }
+
+  return error ? -1 : 0;
+}
+
+// bin_part_drop()
+//
+// Drops every directory whose key range lies wholly before a key, removing
+// it and every file within it
+//
+// p - The store
+// before - The key before which the directories are dropped
+//
+// return - 0 on success, or -1 if any directory could not be removed
+
+int bin_part_drop(bin_part_t *p, bin_key_t before) {
+  assert(p->write);
+
+  uint_t n = 0;
+  int error = 0;
+
+  while (n < p->part_n &&
+         bin_part_floor(p->part[n].start, p->dir_width) + p->dir_width <=
+             before) {
+    bin_key_t dir = bin_part_floor(p->part[n].start, p->dir_width);
+
+    for (; n < p->part_n && p->part[n].start < dir + p->dir_width; n++) {
+      bin_part_release(p, p->part + n);
+    }
+
+    char *dir_path = bin_part_dir_path(p, dir);
+    char **entries = dir_path ? flat_directory_entries(dir_path) : NULL;
+
+    for (uint_t e = 0; entries && entries[e]; e++) {
+      char *path = flat_path(3, dir_path, "/", entries[e]);
+
+      error |= !path || unlink(path) != 0;
+
+      free(path);
+      free(entries[e]);
+    }
+
+    error |= !entries || rmdir(dir_path) != 0;
+
+    free(entries);
+    free(dir_path);
+  }
+
+  if (n > 0) {
+    memmove(p->part, p->part + n, sizeof(bin_part_file_t) * (p->part_n - n));
+    p->part_n -= n;
+    p->offset_valid = 0;
+  }
+
+  return error ? -1 : 0;
+}
+
+// bin_part_length()
+//
+// return - The number of blocks held by every partition
+
+uint_t bin_part_length(bin_part_t *p) {
+  bin_part_offsets(p);
+
+  if (p->part_n == 0)
+    return 0;
+
+  return p->part[p->part_n - 1].offset + p->part[p->part_n - 1].length;
+}
+
+// bin_part_search()
+//
+// Searches for a key, opening only the partition of its range, and only if
+// the key lies between the smallest and largest keys it holds
+//
+// p - The store
+// k - The key to find
+//
+// return - The index of the key in key order across every partition, or if
+//          it is not found, -(i + 1) where i is the index at which it would
+//          be inserted, as for bin_fd_search()
+
+int_t bin_part_search(bin_part_t *p, bin_key_t k) {
+  bin_part_offsets(p);
+
+  uint_t j = bin_part_find(p, bin_part_floor(k, p->width));
+  bin_part_file_t *f = p->part + j;
+
+  if (j == p->part_n || f->start > k || f->length == 0 || k < f->first)
+    return -(int_t)((j < p->part_n) ? f->offset : bin_part_length(p)) - 1;
+
+  if (k > f->last)
+    return -(int_t)(f->offset + f->length) - 1;
+
+  bin_t *b = bin_part_bin(p, f);
+
+  if (!b)
+    return -(int_t)f->offset - 1;
+
+  int_t i = bin_fd_search(b, k);
+
+  return (i < 0) ? i - (int_t)f->offset : i + (int_t)f->offset;
+}
+
+// bin_part_range()
+//
+// Begins iterating over the blocks with keys from k_0 up to but excluding
+// k_1, opening only the partitions which hold keys in the range
+//
+// p - The store to be iterated over
+// k_0 - The smallest key of the range
+// k_1 - The first key past the range
+//
+// return - The iterator, or NULL on failure
+
+bin_part_range_t *bin_part_range(bin_part_t *p, bin_key_t k_0, bin_key_t k_1) {
+  bin_part_range_t *range = (bin_part_range_t *)malloc(sizeof(*range));
+
+  if (!range)
+    return NULL;
+
+  range->store = p;
+  range->k_0 = k_0;
+  range->k_1 = k_1;
+  range->next = bin_part_find(p, bin_part_floor(k_0, p->width));
+  range->range = NULL;
+
+  return range;
+}
+
+// bin_part_range_next()
+//
+// Reads the next run of blocks of the range, from a single partition
+//
+// range - The iterator
+// blocks - Set to the blocks read, valid until the next call
+//
+// return - The number of blocks read, 0 at the end of the range or on failure
+
+uint_t bin_part_range_next(bin_part_range_t *range, void const **blocks) {
+  bin_part_t *p = range->store;
+
+  for (;;) {
+    if (range->range) {
+      uint_t n = bin_range_next(range->range, blocks);
+
+      if (n > 0)
+        return n;
+
+      bin_range_free(range->range);
+      range->range = NULL;
+    }
+
+    if (range->next == p->part_n || p->part[range->next].start >= range->k_1)
+      return 0;
+
+    bin_part_file_t *f = p->part + range->next++;
+
+    if (f->length == 0 || f->last < range->k_0 || f->first >= range->k_1)
+      continue;
+
+    bin_t *b = bin_part_bin(p, f);
+
+    if (!b || !(range->range = bin_fd_range(b, range->k_0, range->k_1)))
+      return 0;
+  }
+}
+
+// bin_part_range_free()
+//
+// Frees the iterator
+//
+// range - The iterator to be freed
+
+void bin_part_range_free(bin_part_range_t *range) {
+  if (range->range)
+    bin_range_free(range->range);
+
+  free(range);
+}
+
+// bin_part_floor()
+//
+// return - The largest multiple of width not greater than k
+
+static bin_key_t bin_part_floor(bin_key_t k, bin_key_t width) {
+  bin_key_t q = k / width;
+
+  if (k % width != 0 && k < 0)
+    q--;
+
+  return q * width;
+}
+
+// bin_part_dir_path()
+//
+// return - The path of the directory of a range of keys, to be freed
+
+static char *bin_part_dir_path(bin_part_t const *p, bin_key_t dir) {
+  char name[32];
+  snprintf(name, sizeof(name), "%lld", (long long)dir);
+
+  return flat_path(3, p->root, "/", name);
+}
+
+// bin_part_file_path()
+//
+// return - The path of the partition of a range of keys, to be freed
+
+static char *bin_part_file_path(bin_part_t const *p, bin_key_t start) {
+  char dir[32], name[40];
+  snprintf(dir, sizeof(dir), "%lld",
+           (long long)bin_part_floor(start, p->dir_width));
+  snprintf(name, sizeof(name), "%lld.bin", (long long)start);
+
+  return flat_path(5, p->root, "/", dir, "/", name);
+}
+
+// bin_part_parse()
+//
+// Parse the key in the name of a directory or partition, followed by suffix
+//
+// return - 0 on success, or -1 if the name is of another file
+
+static int bin_part_parse(char const *name, char const *suffix,
+                          bin_key_t *k) {
+  char *end;
+
+  errno = 0;
+  long long x = strtoll(name, &end, 10);
+
+  if (end == name || errno != 0 || strcmp(end, suffix) != 0)
+    return -1;
+
+  *k = (bin_key_t)x;
+
+  return 0;
+}
+
+// bin_part_load()
+//
+// Add the partitions of a directory to the manifest, reading the length and
+// the smallest and largest keys of each
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_part_load(bin_part_t *p, bin_key_t dir) {
+  char *dir_path = bin_part_dir_path(p, dir);
+  char **entries = dir_path ? flat_directory_entries(dir_path) : NULL;
+  uint8_t *block = (uint8_t *)malloc(p->block_size);
+  int error = !entries || !block;
+
+  for (uint_t e = 0; entries && entries[e]; e++) {
+    bin_key_t start;
+
+    if (!error && bin_part_parse(entries[e], ".bin", &start) == 0 &&
+        bin_part_floor(start, p->width) == start &&
+        bin_part_floor(start, p->dir_width) == dir) {
+      char *path = bin_part_file_path(p, start);
+      bin_t *b = path ? bin_fd_open(path, 0) : NULL;
+      bin_part_file_t *f =
+          b ? bin_part_insert(p, bin_part_find(p, start), start) : NULL;
+
+      error = !f || bin_fd_block_size(b) != p->block_size;
+
+      if (!error && (f->length = bin_fd_length(b)) > 0) {
+        error |= bin_fd_read(b, 0, block, 1) != 0;
+        memcpy(&f->first, block, sizeof(bin_key_t));
+
+        error |= bin_fd_read(b, f->length - 1, block, 1) != 0;
+        memcpy(&f->last, block, sizeof(bin_key_t));
+      }
+
+      if (b)
+        bin_fd_close(b);
+
+      free(path);
+    }
+
+    free(entries[e]);
+  }
+
+  free(entries);
+  free(dir_path);
+  free(block);
+
+  p->offset_valid = 0;
+
+  return error ? -1 : 0;
+}
+
+// bin_part_insert()
+//
+// Insert an empty partition into the manifest at index j, creating its
+// directory when the store is opened for writing
+//
+// return - The entry, or NULL on failure
+
+static bin_part_file_t *bin_part_insert(bin_part_t *p, uint_t j,
+                                        bin_key_t start) {
+  if (p->part_n == p->capacity) {
+    uint_t capacity = p->capacity ? 2 * p->capacity : 16;
+    bin_part_file_t *part = (bin_part_file_t *)realloc(
+        p->part, sizeof(bin_part_file_t) * capacity);
+
+    if (!part)
+      return NULL;
+
+    p->part = part;
+    p->capacity = capacity;
+  }
+
+  if (p->write) {
+    char *dir_path = bin_part_dir_path(p, bin_part_floor(start, p->dir_width));
+    int error = !dir_path || (MKDIR(dir_path) != 0 && errno != EEXIST);
+
+    free(dir_path);
+
+    if (error)
+      return NULL;
+  }
+
+  memmove(p->part + j + 1, p->part + j,
+          sizeof(bin_part_file_t) * (p->part_n - j));
+  p->part_n++;
+  p->offset_valid = 0;
+
+  p->part[j] = (bin_part_file_t){.start = start};
+
+  return p->part + j;
+}
+
+// bin_part_find()
+//
+// return - The index of the first partition of the manifest starting at or
+//          after a key
+
+static uint_t bin_part_find(bin_part_t const *p, bin_key_t start) {
+  uint_t l = 0, r = p->part_n;
+
+  while (l < r) {
+    uint_t m = l + (r - l) / 2;
+
+    if (p->part[m].start < start)
+      l = m + 1;
+    else
+      r = m;
+  }
+
+  return l;
+}
+
+// bin_part_bin()
+//
+// Open a partition if it is not already, creating it when it is empty and
+// the store is opened for writing, and closing the least recently used
+// partition once BIN_PART_OPEN_MAX are open
+//
+// return - The partition, or NULL on failure
+
+static bin_t *bin_part_bin(bin_part_t *p, bin_part_file_t *f) {
+  f->used = ++p->clock;
+
+  if (f->bin)
+    return f->bin;
+
+  if (p->open_n == BIN_PART_OPEN_MAX) {
+    bin_part_file_t *lru = NULL;
+
+    for (uint_t j = 0; j < p->part_n; j++) {
+      if (p->part[j].bin && (!lru || p->part[j].used < lru->used))
+        lru = p->part + j;
+    }
+
+    if (bin_part_release(p, lru) != 0)
+      return NULL;
+  }
+
+  char *path = bin_part_file_path(p, f->start);
+
+  if (!path)
+    return NULL;
+
+  if (p->write && f->length == 0 && access(path, F_OK) != 0)
+    f->bin = bin_fd_init(path, p->block_size);
+  else
+    f->bin = bin_fd_open(path, p->write);
+
+  free(path);
+
+  if (f->bin)
+    p->open_n++;
+
+  return f->bin;
+}
+
+// bin_part_offsets()
+//
+// Bring the number of blocks before each partition up to date
+
+static void bin_part_offsets(bin_part_t *p) {
+  if (p->offset_valid)
+    return;
+
+  uint_t offset = 0;
+
+  for (uint_t j = 0; j < p->part_n; j++) {
+    p->part[j].offset = offset;
+    offset += p->part[j].length;
+  }
+
+  p->offset_valid = 1;
+}
+
+// bin_part_release()
+//
+// Close a partition if it is open
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_part_release(bin_part_t *p, bin_part_file_t *f) {
+  if (!f->bin)
+    return 0;
+
+  int error = bin_fd_close(f->bin);
+  f->bin = NULL;
+  p->open_n--;
+
+  return error;
+}
+
+#endif // BIN_PART_IMPLEMENTATION
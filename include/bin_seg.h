@@ -0,0 +1,865 @@
+// bin_seg.h - Compressed, columnar segments of bin.h blocks
+//
+// Stores the same key ordered, fixed size blocks as a bin.h file, compressed.
+// The blocks are gathered into chunks, and each chunk is stored a column at a
+// time: the keys, encoded as the difference between successive differences,
+// then each word of the rest of the block, encoded as the exclusive or with
+// the same word of the block before, as for the time stamps and values of
+// Facebook's Gorilla. Regularly spaced keys then cost about a bit each, and
+// slowly changing values a few bits. An index of the first key and position
+// of each chunk, and of each column within it, at the end of the file, allows
+// any block to be read or a key searched for by decoding a single chunk, and
+// only as far into each column as the blocks read. A segment is written once,
+// in order, and is then read only.
+//
+// The key must be an integer type. Requires bin.h, which is included here
+// when it has not been already, so bin_key_t must be declared first as for
+// bin.h.
+
+#ifndef BIN_SEG_H
+#define BIN_SEG_H
+
+#include <stdint.h>
+#include "./type.h"
+
+#ifndef BIN_H
+#include "./bin.h"
+#endif
+
+// The number of blocks in each chunk
+#ifndef BIN_SEG_CHUNK
+#define BIN_SEG_CHUNK 1024
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  // As the header of a bin.h file
+  uint_t length;
+  uint_t block_size;
+
+  // The number of blocks in each chunk but the last, and of chunks
+  uint_t chunk_blocks;
+  uint_t chunk_n;
+
+  // The position of the chunk index within the file, following the chunks,
+  // and so the end of the chunks while writing
+  uint_t index_offset;
+} bin_seg_meta_t;
+
+// bin_seg_chunk_t
+//
+// The entry of a chunk in the chunk index
+
+typedef struct {
+  // The key of the first block of the chunk
+  bin_key_t key;
+
+  // The position of the chunk within the file, and the sizes in bytes of its
+  // keys, which come first, and of the whole chunk
+  uint_t offset;
+  uint_t key_size;
+  uint_t size;
+} bin_seg_chunk_t;
+
+// bin_seg_bits_t
+//
+// A stream of bits, written or read most significant bit first
+
+typedef struct {
+  uint8_t *data;
+  uint_t n;
+  uint_t capacity;
+  uint_t i;
+
+  uint64_t acc;
+  int acc_n;
+
+  // Set should the stream fail to grow
+  int error;
+} bin_seg_bits_t;
+
+typedef struct {
+  int fd;
+  bin_seg_meta_t meta;
+
+  // The columns of the block following the key, each a word of up to eight
+  // bytes, aligned as are the words of the block
+  uint_t column_n;
+  uint_t *column_offset;
+  uint_t *column_width;
+
+  // The blocks of the chunk being gathered, for a writer
+  uint8_t *block;
+  uint_t fill;
+
+  // The chunk index, entirely in memory, followed in the file by the
+  // position of each column within its chunk
+  //   - column_start is stored as [chunk_n][column_n]
+  bin_seg_chunk_t *chunk;
+  uint_t *column_start;
+  uint_t chunk_capacity;
+
+  // The encoded chunk being written or read
+  bin_seg_bits_t bits;
+
+  // Whether the segment is being written
+  int write;
+} bin_seg_t;
+
+bin_seg_t *bin_seg_init(char const *, uint_t, uint_t);
+bin_seg_t *bin_seg_open(char const *);
+int bin_seg_close(bin_seg_t *);
+int bin_seg_append(bin_seg_t *, void const *, uint_t);
+int bin_seg_read(bin_seg_t *, int_t, void *, uint_t);
+int_t bin_seg_search(bin_seg_t *, bin_key_t);
+int bin_seg_convert(char const *, char const *, uint_t);
+
+uint_t bin_seg_length(bin_seg_t const *);
+uint_t bin_seg_block_size(bin_seg_t const *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BIN_SEG_H
+
+////////////////////////////////////////////////////////////////////////////////
+// IMPELEMENTATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef BIN_SEG_IMPLEMENTATION
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bin_seg_t *bin_seg_create(int, bin_seg_meta_t const *);
+static int bin_seg_flush(bin_seg_t *);
+static int bin_seg_load(bin_seg_t *, uint_t, uint_t);
+static void bin_seg_decode(bin_seg_t *, uint_t, uint_t, uint_t, uint8_t *);
+static int bin_seg_pread(int, void *, uint_t, uint_t);
+static int bin_seg_pwrite(int, void const *, uint_t, uint_t);
+
+static void bin_seg_put(bin_seg_bits_t *, uint64_t, int);
+static uint64_t bin_seg_get(bin_seg_bits_t *, int);
+static void bin_seg_put_key(bin_seg_bits_t *, int64_t);
+static int64_t bin_seg_get_key(bin_seg_bits_t *);
+static void bin_seg_align(bin_seg_bits_t *, int);
+
+// bin_seg_init()
+//
+// Creates a segment, to which blocks are then appended in order of their keys
+//
+// path - The path and file name for the desired file
+// block_size - The size of each block in bytes
+// chunk_blocks - The number of blocks in each chunk, or 0 for BIN_SEG_CHUNK
+//
+// return - The newly created segment, or NULL on failure
+
+bin_seg_t *bin_seg_init(char const *path, uint_t block_size,
+                        uint_t chunk_blocks) {
+  assert(block_size >= sizeof(bin_key_t));
+
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (fd < 0)
+    return NULL;
+
+  bin_seg_meta_t meta = {.length = 0,
+                         .block_size = block_size,
+                         .chunk_blocks = chunk_blocks ? chunk_blocks
+                                                      : BIN_SEG_CHUNK,
+                         .chunk_n = 0,
+                         .index_offset = sizeof(bin_seg_meta_t)};
+
+  bin_seg_t *s = bin_seg_create(fd, &meta);
+
+  if (!s)
+    return NULL;
+
+  s->write = 1;
+  s->block = (uint8_t *)malloc(meta.chunk_blocks * block_size);
+
+  if (!s->block) {
+    bin_seg_close(s);
+    return NULL;
+  }
+
+  return s;
+}
+
+// bin_seg_open()
+//
+// Opens a segment for reading, loading its chunk index
+//
+// path - The path and file name for the desired file
+//
+// return - The opened segment, or NULL on failure
+
+bin_seg_t *bin_seg_open(char const *path) {
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0)
+    return NULL;
+
+  bin_seg_meta_t meta;
+
+  if (bin_seg_pread(fd, &meta, sizeof(meta), 0) != 0 ||
+      meta.block_size < sizeof(bin_key_t) || meta.chunk_blocks == 0) {
+    close(fd);
+    return NULL;
+  }
+
+  bin_seg_t *s = bin_seg_create(fd, &meta);
+
+  if (!s)
+    return NULL;
+
+  uint_t chunk_size = sizeof(bin_seg_chunk_t) * meta.chunk_n;
+  uint_t column_size = sizeof(uint_t) * meta.chunk_n * s->column_n;
+
+  s->chunk = (bin_seg_chunk_t *)malloc(chunk_size + sizeof(bin_seg_chunk_t));
+  s->column_start = (uint_t *)malloc(column_size + sizeof(uint_t));
+  s->chunk_capacity = meta.chunk_n + 1;
+
+  if (!s->chunk || !s->column_start ||
+      bin_seg_pread(fd, s->chunk, chunk_size, meta.index_offset) != 0 ||
+      bin_seg_pread(fd, s->column_start, column_size,
+                    meta.index_offset + chunk_size) != 0) {
+    bin_seg_close(s);
+    return NULL;
+  }
+
+  return s;
+}
+
+// bin_seg_close()
+//
+// Closes a segment. A segment being written is completed first, by encoding
+// the last chunk and writing the chunk index and the header.
+//
+// s - The segment to be closed
+//
+// return - 0 on success, or -1 if the segment could not be completed
+
+int bin_seg_close(bin_seg_t *s) {
+  int error = 0;
+
+  if (s->write && s->block) {
+    error = bin_seg_flush(s);
+
+    uint_t cb = s->meta.chunk_blocks;
+    s->meta.chunk_n = (s->meta.length + cb - 1) / cb;
+
+    uint_t chunk_size = sizeof(bin_seg_chunk_t) * s->meta.chunk_n;
+
+    error = error ||
+            bin_seg_pwrite(s->fd, s->chunk, chunk_size,
+                           s->meta.index_offset) ||
+            bin_seg_pwrite(s->fd, s->column_start,
+                           sizeof(uint_t) * s->meta.chunk_n * s->column_n,
+                           s->meta.index_offset + chunk_size) ||
+            bin_seg_pwrite(s->fd, &s->meta, sizeof(s->meta), 0);
+  }
+
+  close(s->fd);
+
+  free(s->column_offset);
+  free(s->column_width);
+  free(s->block);
+  free(s->chunk);
+  free(s->column_start);
+  free(s->bits.data);
+  free(s);
+
+  return error ? -1 : 0;
+}
+
+// bin_seg_append()
+//
+// Appends blocks to a segment being written, encoding each chunk as it fills
+//
+// s - The segment
+// data - The blocks to append, in order of their keys and following those
+//        already appended
+// n - The number of blocks to append
+//
+// return - 0 on success, or -1 on failure
+
+int bin_seg_append(bin_seg_t *s, void const *data, uint_t n) {
+  uint8_t const *src = (uint8_t const *)data;
+  uint_t bs = s->meta.block_size;
+
+  assert(s->write);
+
+  while (n > 0) {
+    uint_t k = s->meta.chunk_blocks - s->fill;
+    k = (k < n) ? k : n;
+
+    memcpy(s->block + s->fill * bs, src, k * bs);
+
+    s->fill += k;
+    src += k * bs;
+    n -= k;
+
+    if (s->fill == s->meta.chunk_blocks && bin_seg_flush(s) != 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+// bin_seg_read()
+//
+// Decodes the desired blocks directly into the buffer, reading each chunk
+// which holds them once
+//
+// s - The segment
+// i - The initial index of the read
+// data - The block_t buffer to be read into
+// n - The number of elements to read into the buffer
+//
+// return - 0 on success, or -1 on failure
+
+int bin_seg_read(bin_seg_t *s, int_t i, void *data, uint_t n) {
+  uint8_t *dst = (uint8_t *)data;
+  uint_t cb = s->meta.chunk_blocks;
+
+  assert(!s->write && 0 <= i && i + n <= s->meta.length);
+
+  for (uint_t j = i; j < i + n;) {
+    uint_t c = j / cb;
+    uint_t from = j - c * cb;
+    uint_t to = (i + n - c * cb < cb) ? i + n - c * cb : cb;
+
+    if (bin_seg_load(s, c, s->chunk[c].size) != 0)
+      return -1;
+
+    bin_seg_decode(s, c, from, to, dst);
+
+    dst += (to - from) * s->meta.block_size;
+    j += to - from;
+  }
+
+  return 0;
+}
+
+// bin_seg_search()
+//
+// Search for a given key, as bin_search(), by bisecting the chunk index in
+// memory, then reading and decoding the keys of a single chunk
+//
+// s - The segment to be searched within
+// k - The key to search for
+//
+// return - The block_t index of the key. In the case that the key is not found,
+//          The returned value is -( index + 1 ) where index is that of the
+//          first element greater than k or bin_seg_length().
+
+int_t bin_seg_search(bin_seg_t *s, bin_key_t k) {
+  assert(!s->write);
+
+  // The last chunk starting no later than the key
+  int_t l = 0;
+  int_t r = s->meta.chunk_n - 1;
+
+  while (l <= r) {
+    int_t m = (l + r) / 2;
+
+    if (s->chunk[m].key <= k)
+      l = m + 1;
+    else
+      r = m - 1;
+  }
+
+  if (r < 0)
+    return -1;
+
+  uint_t start = r * s->meta.chunk_blocks;
+
+  if (s->chunk[r].key == k)
+    return start;
+
+  uint_t n = s->meta.length - start;
+  n = (n < s->meta.chunk_blocks) ? n : s->meta.chunk_blocks;
+
+  if (bin_seg_load(s, r, s->chunk[r].key_size) != 0)
+    return -(int_t)(start + 1);
+
+  // The keys are decoded until one is no less than k
+  int64_t key = bin_seg_get(&s->bits, 64);
+  int64_t delta = 0;
+
+  for (uint_t j = 1; j < n; j++) {
+    delta += bin_seg_get_key(&s->bits);
+    key += delta;
+
+    if ((bin_key_t)key >= k)
+      return ((bin_key_t)key == k) ? (int_t)(start + j)
+                                       : -(int_t)(start + j + 1);
+  }
+
+  return -(int_t)(start + n + 1);
+}
+
+// bin_seg_convert()
+//
+// Writes the blocks of a bin.h file as a segment
+//
+// bin_path - The path of the bin.h file
+// seg_path - The path of the segment to be created
+// chunk_blocks - The number of blocks in each chunk, or 0 for BIN_SEG_CHUNK
+//
+// return - 0 on success, or -1 on failure
+
+int bin_seg_convert(char const *bin_path, char const *seg_path,
+                    uint_t chunk_blocks) {
+  bin_t *b = bin_fd_open(bin_path, 0);
+
+  if (!b)
+    return -1;
+
+  uint_t l = bin_fd_length(b);
+  uint_t bs = bin_fd_block_size(b);
+
+  bin_seg_t *s = bin_seg_init(seg_path, bs, chunk_blocks);
+  uint_t n = s ? s->meta.chunk_blocks * 64 : 0;
+  uint8_t *block = (uint8_t *)malloc(n * bs);
+  int error = !s || !block;
+
+  for (uint_t i = 0; i < l && !error; i += n) {
+    uint_t k = (l - i < n) ? l - i : n;
+
+    error = bin_fd_read(b, i, block, k) || bin_seg_append(s, block, k);
+  }
+
+  free(block);
+  bin_fd_close(b);
+
+  if (s && bin_seg_close(s) != 0)
+    error = 1;
+
+  return error ? -1 : 0;
+}
+
+// bin_seg_length()
+//
+// return - The length / number of entries in the segment
+
+uint_t bin_seg_length(bin_seg_t const *s) { return s->meta.length; }
+
+// bin_seg_block_size()
+//
+// return - The block size for the entries in the segment
+
+uint_t bin_seg_block_size(bin_seg_t const *s) { return s->meta.block_size; }
+
+// bin_seg_create()
+//
+// Allocate a segment for an opened file, dividing its blocks into columns:
+// the key, then words ending at each multiple of eight bytes
+
+static bin_seg_t *bin_seg_create(int fd, bin_seg_meta_t const *meta) {
+  bin_seg_t *s = (bin_seg_t *)calloc(1, sizeof(bin_seg_t));
+  uint_t bs = meta->block_size;
+
+  if (!s) {
+    close(fd);
+    return NULL;
+  }
+
+  s->fd = fd;
+  s->meta = *meta;
+  s->column_offset = (uint_t *)malloc(sizeof(uint_t) * (bs / 8 + 2));
+  s->column_width = (uint_t *)malloc(sizeof(uint_t) * (bs / 8 + 2));
+
+  if (!s->column_offset || !s->column_width) {
+    bin_seg_close(s);
+    return NULL;
+  }
+
+  for (uint_t o = sizeof(bin_key_t); o < bs; s->column_n++) {
+    uint_t end = (o / 8 + 1) * 8;
+    end = (end < bs) ? end : bs;
+
+    s->column_offset[s->column_n] = o;
+    s->column_width[s->column_n] = end - o;
+    o = end;
+  }
+
+  return s;
+}
+
+// bin_seg_flush()
+//
+// Encode the gathered blocks as a chunk, write it after the last, and add it
+// to the chunk index
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_seg_flush(bin_seg_t *s) {
+  uint_t n = s->fill;
+  uint_t bs = s->meta.block_size;
+
+  if (n == 0)
+    return 0;
+
+  bin_seg_bits_t *bits = &s->bits;
+  bits->n = 0;
+  bits->acc_n = 0;
+
+  // The keys, the first whole and each other by its change in difference
+  bin_key_t first;
+  int64_t previous = 0, delta = 0;
+
+  for (uint_t j = 0; j < n; j++) {
+    bin_key_t k;
+    memcpy(&k, s->block + j * bs, sizeof(k));
+
+    if (j == 0) {
+      first = k;
+      bin_seg_put(bits, (int64_t)k, 64);
+    } else {
+      bin_seg_put_key(bits, ((int64_t)k - previous) - delta);
+      delta = (int64_t)k - previous;
+    }
+
+    previous = k;
+  }
+
+  bin_seg_align(bits, 1);
+  uint_t key_size = bits->n;
+
+  uint_t c = s->meta.length / s->meta.chunk_blocks;
+
+  if (c == s->chunk_capacity) {
+    uint_t capacity = s->chunk_capacity ? 2 * s->chunk_capacity : 64;
+    bin_seg_chunk_t *chunk = (bin_seg_chunk_t *)realloc(
+        s->chunk, sizeof(bin_seg_chunk_t) * capacity);
+
+    if (!chunk)
+      return -1;
+
+    s->chunk = chunk;
+
+    uint_t *column_start = (uint_t *)realloc(
+        s->column_start, sizeof(uint_t) * (capacity * s->column_n + 1));
+
+    if (!column_start)
+      return -1;
+
+    s->column_start = column_start;
+    s->chunk_capacity = capacity;
+  }
+
+  // Each word, the first whole and each other by its exclusive or with the
+  // word before, of which only the meaningful bits are stored, within the
+  // leading and trailing zeros of the word before where they fit
+  for (uint_t col = 0; col < s->column_n; col++) {
+    uint_t o = s->column_offset[col];
+    uint_t w = s->column_width[col];
+
+    uint64_t previous = 0;
+    int lead = -1, trail = 0;
+
+    s->column_start[c * s->column_n + col] = bits->n;
+
+    for (uint_t j = 0; j < n; j++) {
+      uint64_t v = 0;
+      memcpy(&v, s->block + j * bs + o, w);
+
+      uint64_t x = v ^ previous;
+      previous = v;
+
+      if (j == 0) {
+        bin_seg_put(bits, v, 64);
+      } else if (x == 0) {
+        bin_seg_put(bits, 0, 1);
+      } else {
+        int l = __builtin_clzll(x);
+        int t = __builtin_ctzll(x);
+
+        if (lead >= 0 && l >= lead && t >= trail) {
+          bin_seg_put(bits, 2, 2);
+          bin_seg_put(bits, x >> trail, 64 - lead - trail);
+        } else {
+          lead = l;
+          trail = t;
+
+          bin_seg_put(bits, 3, 2);
+          bin_seg_put(bits, lead, 6);
+          bin_seg_put(bits, 63 - lead - trail, 6);
+          bin_seg_put(bits, x >> trail, 64 - lead - trail);
+        }
+      }
+    }
+
+    bin_seg_align(bits, 1);
+  }
+
+  if (bits->error)
+    return -1;
+
+  s->chunk[c] = (bin_seg_chunk_t){.key = first,
+                                  .offset = s->meta.index_offset,
+                                  .key_size = key_size,
+                                  .size = bits->n};
+
+  if (bin_seg_pwrite(s->fd, bits->data, bits->n, s->meta.index_offset) != 0)
+    return -1;
+
+  s->meta.index_offset += bits->n;
+  s->meta.length += n;
+  s->fill = 0;
+
+  return 0;
+}
+
+// bin_seg_load()
+//
+// Read the first n bytes of a chunk, to be decoded
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_seg_load(bin_seg_t *s, uint_t c, uint_t n) {
+  bin_seg_bits_t *bits = &s->bits;
+
+  if (n > bits->capacity) {
+    uint8_t *data = (uint8_t *)realloc(bits->data, n);
+
+    if (!data)
+      return -1;
+
+    bits->data = data;
+    bits->capacity = n;
+  }
+
+  bits->n = n;
+  bits->i = 0;
+  bits->acc_n = 0;
+
+  return bin_seg_pread(s->fd, bits->data, n, s->chunk[c].offset);
+}
+
+// bin_seg_decode()
+//
+// Decode the blocks from to to of a loaded chunk into dst, column by column,
+// decoding but not storing the blocks before them. Each column starts at its
+// position in the chunk index, so the blocks after to are never decoded.
+
+static void bin_seg_decode(bin_seg_t *s, uint_t c, uint_t from, uint_t to,
+                           uint8_t *dst) {
+  bin_seg_bits_t *bits = &s->bits;
+  uint_t bs = s->meta.block_size;
+
+  int64_t key = 0, delta = 0;
+
+  for (uint_t j = 0; j < to; j++) {
+    if (j == 0) {
+      key = bin_seg_get(bits, 64);
+    } else {
+      delta += bin_seg_get_key(bits);
+      key += delta;
+    }
+
+    if (j >= from) {
+      bin_key_t k = (bin_key_t)key;
+      memcpy(dst + (j - from) * bs, &k, sizeof(k));
+    }
+  }
+
+  for (uint_t col = 0; col < s->column_n; col++) {
+    uint_t o = s->column_offset[col];
+    uint_t w = s->column_width[col];
+
+    bits->i = s->column_start[c * s->column_n + col];
+    bits->acc_n = 0;
+
+    uint64_t v = 0;
+    int lead = 0, trail = 0;
+
+    for (uint_t j = 0; j < to; j++) {
+      if (j == 0) {
+        v = bin_seg_get(bits, 64);
+      } else if (bin_seg_get(bits, 1)) {
+        if (bin_seg_get(bits, 1)) {
+          lead = bin_seg_get(bits, 6);
+          trail = 63 - lead - bin_seg_get(bits, 6);
+        }
+
+        v ^= bin_seg_get(bits, 64 - lead - trail) << trail;
+      }
+
+      if (j >= from)
+        memcpy(dst + (j - from) * bs + o, &v, w);
+    }
+  }
+}
+
+// bin_seg_put()
+//
+// Write the n low bits of x, at most 64
+
+static void bin_seg_put(bin_seg_bits_t *bits, uint64_t x, int n) {
+  if (n > 32) {
+    bin_seg_put(bits, x >> 32, n - 32);
+    n = 32;
+  }
+
+  bits->acc = (bits->acc << n) | (x & ((1ULL << n) - 1));
+  bits->acc_n += n;
+
+  while (bits->acc_n >= 8) {
+    if (bits->n == bits->capacity) {
+      uint_t capacity = bits->capacity ? 2 * bits->capacity : 4096;
+      uint8_t *data = (uint8_t *)realloc(bits->data, capacity);
+
+      // The stream is abandoned, to be noticed by bin_seg_flush()
+      if (!data) {
+        bits->error = 1;
+        bits->acc_n = 0;
+        return;
+      }
+
+      bits->data = data;
+      bits->capacity = capacity;
+    }
+
+    bits->acc_n -= 8;
+    bits->data[bits->n++] = (uint8_t)(bits->acc >> bits->acc_n);
+  }
+}
+
+// bin_seg_get()
+//
+// return - The next n bits, at most 64, or zeros past the end of the stream
+
+static uint64_t bin_seg_get(bin_seg_bits_t *bits, int n) {
+  if (n > 32) {
+    uint64_t high = bin_seg_get(bits, n - 32);
+    return (high << 32) | bin_seg_get(bits, 32);
+  }
+
+  while (bits->acc_n < n) {
+    uint8_t byte = (bits->i < bits->n) ? bits->data[bits->i] : 0;
+
+    bits->acc = (bits->acc << 8) | byte;
+    bits->i++;
+    bits->acc_n += 8;
+  }
+
+  bits->acc_n -= n;
+
+  return (bits->acc >> bits->acc_n) & ((1ULL << n) - 1);
+}
+
+// bin_seg_put_key()
+//
+// Write the change in difference of a key, zigzag encoded so that small
+// changes of either sign are small, with a prefix giving its size
+
+static void bin_seg_put_key(bin_seg_bits_t *bits, int64_t dod) {
+  uint64_t z = ((uint64_t)dod << 1) ^ (uint64_t)(dod >> 63);
+
+  if (z == 0) {
+    bin_seg_put(bits, 0, 1);
+  } else if (z < (1 << 7)) {
+    bin_seg_put(bits, 2, 2);
+    bin_seg_put(bits, z, 7);
+  } else if (z < (1 << 9)) {
+    bin_seg_put(bits, 6, 3);
+    bin_seg_put(bits, z, 9);
+  } else if (z < (1 << 12)) {
+    bin_seg_put(bits, 14, 4);
+    bin_seg_put(bits, z, 12);
+  } else {
+    bin_seg_put(bits, 15, 4);
+    bin_seg_put(bits, z, 64);
+  }
+}
+
+// bin_seg_get_key()
+//
+// return - The next change in difference of a key
+
+static int64_t bin_seg_get_key(bin_seg_bits_t *bits) {
+  uint64_t z;
+
+  if (!bin_seg_get(bits, 1))
+    z = 0;
+  else if (!bin_seg_get(bits, 1))
+    z = bin_seg_get(bits, 7);
+  else if (!bin_seg_get(bits, 1))
+    z = bin_seg_get(bits, 9);
+  else if (!bin_seg_get(bits, 1))
+    z = bin_seg_get(bits, 12);
+  else
+    z = bin_seg_get(bits, 64);
+
+  return (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+}
+
+// bin_seg_align()
+//
+// Move to the next whole byte, padding with zeros when writing
+
+static void bin_seg_align(bin_seg_bits_t *bits, int write) {
+  if (write && bits->acc_n > 0)
+    bin_seg_put(bits, 0, 8 - bits->acc_n);
+
+  if (!write)
+    bits->acc_n = 0;
+}
+
+// bin_seg_pread()
+//
+// Read exactly n bytes at the given offset
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_seg_pread(int fd, void *data, uint_t n, uint_t offset) {
+  uint8_t *p = (uint8_t *)data;
+
+  while (n > 0) {
+    ssize_t r = pread(fd, p, n, offset);
+
+    if (r <= 0)
+      return -1;
+
+    p += r;
+    n -= r;
+    offset += r;
+  }
+
+  return 0;
+}
+
+// bin_seg_pwrite()
+//
+// Write exactly n bytes at the given offset
+//
+// return - 0 on success, or -1 on failure
+
+static int bin_seg_pwrite(int fd, void const *data, uint_t n, uint_t offset) {
+  uint8_t const *p = (uint8_t const *)data;
+
+  while (n > 0) {
+    ssize_t r = pwrite(fd, p, n, offset);
+
+    if (r <= 0)
+      return -1;
+
+    p += r;
+    n -= r;
+    offset += r;
+  }
+
+  return 0;
+}
+
+#endif // BIN_SEG_IMPLEMENTATION
@@ -1,6 +1,7 @@
 // flat.h - Directory traversal utility functions
 
 #ifndef FLAT_H
+#define FLAT_H
 
 #include <stdint.h>
 #include <sys/stat.h>